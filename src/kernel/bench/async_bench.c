@@ -0,0 +1,157 @@
+/*
+	This file is part of an x86_64 hobbyist operating system called KnutOS
+	Everything is openly developed on GitHub: https://github.com/Tix3Dev/KnutOS/
+
+	Copyright (C) 2021-2022  Yves Vollmeier <https://github.com/Tix3Dev>
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <bench/async_bench.h>
+#include <boot/stivale2.h>
+#include <scheduler/async.h>
+#include <scheduler/completion.h>
+#include <scheduler/thread.h>
+#include <smp/smp.h>
+#include <time/clocksource.h>
+#include <time/timer.h>
+#include <libk/alloc/kmalloc.h>
+#include <libk/debug/debug.h>
+#include <libk/definitions.h>
+#include <libk/log/log.h>
+#include <libk/stdio/stdio.h>
+
+/*  Explanation of the async task benchmark:
+    ASYNC_BENCH_TASKS operations are spread over all executors and run
+    at the same time. Each one sleeps for 1 to ASYNC_BENCH_MAX_SLEEP_MS
+    and then submits a request to a fake device, a timer whose callback
+    signals the completion event from softirq context like an IRQ
+    handler would, ASYNC_BENCH_ROUNDS times. Reported are the wall
+    time, the polls it took and the memory of all operations next to
+    what the same number of threads would need for their stacks alone.
+*/
+
+typedef struct
+{
+    async_task_t    task;
+    async_event_t   io_done;
+    timer_t	    device;
+    size_t	    id;
+    size_t	    round;
+} async_bench_op_t;
+
+static completion_t	all_done = COMPLETION_INIT("async bench done");
+static volatile size_t	ops_left;
+
+// the fake device finished the request
+static void async_bench_device_irq(void *arg)
+{
+    async_bench_op_t *op = arg;
+
+    async_event_signal(&op->io_done);
+}
+
+static async_status_t async_bench_poll(async_task_t *task)
+{
+    async_bench_op_t *op = container_of(task, async_bench_op_t, task);
+
+    ASYNC_BEGIN(task);
+
+    for (op->round = 0; op->round < ASYNC_BENCH_ROUNDS; op->round++)
+    {
+        ASYNC_SLEEP(task, 1 + (op->id + op->round) % ASYNC_BENCH_MAX_SLEEP_MS);
+
+        timer_add(&op->device, timer_get_jiffies() + 1);
+        ASYNC_WAIT_EVENT(task, &op->io_done);
+    }
+
+    ASYNC_END(task);
+}
+
+static void async_bench_done(async_task_t *task)
+{
+    (void)task;
+
+    if (__atomic_sub_fetch(&ops_left, 1, __ATOMIC_ACQ_REL) == 0)
+        complete(&all_done);
+}
+
+// keep many sleeping and I/O waiting operations in flight without a thread each
+void async_bench(void)
+{
+    async_bench_op_t *ops = kcalloc(ASYNC_BENCH_TASKS, sizeof(async_bench_op_t));
+
+    if (!ops)
+    {
+        serial_log(ERROR, "Async benchmark: out of memory\n");
+        kernel_log(ERROR, "Async benchmark: out of memory\n");
+
+        return;
+    }
+
+    size_t cpus = smp_get_online_count();
+
+    ops_left = ASYNC_BENCH_TASKS;
+    reinit_completion(&all_done);
+
+    uint64_t start = ktime_get_ns();
+
+    for (size_t i = 0; i < ASYNC_BENCH_TASKS; i++)
+    {
+        async_bench_op_t *op = &ops[i];
+
+        op->id = i;
+        async_event_init(&op->io_done);
+        timer_init(&op->device, async_bench_device_irq, op);
+        async_task_init(&op->task, async_bench_poll, async_bench_done, NULL);
+
+        if (!async_spawn_on(&op->task, i % cpus))
+        {
+            serial_log(ERROR, "Async benchmark: no executors\n");
+            kernel_log(ERROR, "Async benchmark: no executors\n");
+
+            kfree(ops);
+
+            return;
+        }
+    }
+
+    wait_for_completion(&all_done);
+
+    uint64_t elapsed = ktime_get_ns() - start;
+
+    kfree(ops);
+
+    serial_log(INFO, "Async task benchmark results:\n");
+    kernel_log(INFO, "Async task benchmark results:\n");
+
+    serial_set_color(TERM_PURPLE);
+
+    debug("%d operations x %d rounds on %d executors: %llu ms\n", ASYNC_BENCH_TASKS, ASYNC_BENCH_ROUNDS,
+          (int)cpus, elapsed / NSEC_PER_MSEC);
+    printk(GFX_PURPLE, "%d operations x %d rounds on %d executors: %llu ms\n", ASYNC_BENCH_TASKS,
+           ASYNC_BENCH_ROUNDS, (int)cpus, elapsed / NSEC_PER_MSEC);
+
+    debug("memory: %d bytes per operation, %d KiB in total (threads: %d KiB of stacks)\n",
+          (int)sizeof(async_bench_op_t), (int)(ASYNC_BENCH_TASKS * sizeof(async_bench_op_t) / 1024),
+          ASYNC_BENCH_TASKS * (THREAD_STACK_SIZE / 1024));
+    printk(GFX_PURPLE, "memory: %d bytes per operation, %d KiB in total (threads: %d KiB of stacks)\n",
+           (int)sizeof(async_bench_op_t), (int)(ASYNC_BENCH_TASKS * sizeof(async_bench_op_t) / 1024),
+           ASYNC_BENCH_TASKS * (THREAD_STACK_SIZE / 1024));
+
+    serial_set_color(TERM_COLOR_RESET);
+
+    async_print_stats();
+}
@@ -0,0 +1,27 @@
+/*
+	This file is part of an x86_64 hobbyist operating system called KnutOS
+	Everything is openly developed on GitHub: https://github.com/Tix3Dev/KnutOS/
+
+	Copyright (C) 2021-2022  Yves Vollmeier <https://github.com/Tix3Dev>
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef ASYNC_BENCH_H
+#define ASYNC_BENCH_H
+
+#define ASYNC_BENCH_TASKS	 1024	// operations in flight at once
+#define ASYNC_BENCH_ROUNDS	 4	// sleep + I/O request per operation
+#define ASYNC_BENCH_MAX_SLEEP_MS 8
+
+void async_bench(void);
+
+#endif
@@ -0,0 +1,113 @@
+/*
+	This file is part of an x86_64 hobbyist operating system called KnutOS
+	Everything is openly developed on GitHub: https://github.com/Tix3Dev/KnutOS/
+
+	Copyright (C) 2021-2022  Yves Vollmeier <https://github.com/Tix3Dev>
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <bench/ipi_bench.h>
+#include <boot/stivale2.h>
+#include <memory/mem.h>
+#include <memory/tlb.h>
+#include <smp/ipi.h>
+#include <smp/smp.h>
+#include <time/clocksource.h>
+#include <libk/debug/debug.h>
+#include <libk/log/log.h>
+#include <libk/stdio/stdio.h>
+
+/*  Explanation of the IPI benchmark:
+    First the round trip of a synchronous smp_call_function_single to
+    every other online cpu (send, run an empty function there, see it
+    finish). Then IPI_BENCH_RANGES pages that aren't next to each other
+    get shot down one shootdown at a time and then all in one batch,
+    which needs a single IPI round instead of one per page.
+*/
+
+static void ipi_bench_nop(void *arg)
+{
+    (void)arg;
+}
+
+// shoot down every other page of this function's neighborhood, nothing depends on it
+static uint64_t ipi_bench_shootdowns(bool batched)
+{
+    uintptr_t base = ALIGN_DOWN((uintptr_t)&ipi_bench_nop, PAGE_SIZE);
+    tlb_batch_t batch;
+
+    tlb_batch_init(&batch);
+
+    uint64_t start = ktime_get_ns();
+
+    for (size_t i = 0; i < IPI_BENCH_RANGES; i++)
+    {
+        uintptr_t page = base + 2 * i * PAGE_SIZE;
+
+        if (batched)
+            tlb_batch_add(&batch, page, page + PAGE_SIZE);
+        else
+            tlb_shootdown_range(page, page + PAGE_SIZE);
+    }
+
+    tlb_batch_flush(&batch);
+
+    return ktime_get_ns() - start;
+}
+
+void ipi_bench(void)
+{
+    if (smp_get_online_count() < 2)
+    {
+        serial_log(ERROR, "IPI benchmark: needs at least 2 online cpus\n");
+        kernel_log(ERROR, "IPI benchmark: needs at least 2 online cpus\n");
+
+        return;
+    }
+
+    serial_log(INFO, "IPI benchmark results:\n");
+    kernel_log(INFO, "IPI benchmark results:\n");
+
+    serial_set_color(TERM_PURPLE);
+
+    uint64_t online = smp_get_online_mask();
+
+    for (size_t i = 0; i < smp_cpu_count; i++)
+    {
+        if (!(online & (1ULL << i)) || i == smp_get_current_cpu())
+            continue;
+
+        uint64_t start = ktime_get_ns();
+
+        for (size_t round = 0; round < IPI_BENCH_ROUNDS; round++)
+            smp_call_function_single(i, ipi_bench_nop, NULL, true);
+
+        uint64_t average = (ktime_get_ns() - start) / IPI_BENCH_ROUNDS;
+
+        debug("call to cpu %d: %llu ns round trip\n", i, average);
+        printk(GFX_PURPLE, "call to cpu %d: %llu ns round trip\n", i, average);
+    }
+
+    uint64_t separate = ipi_bench_shootdowns(false);
+    uint64_t batched = ipi_bench_shootdowns(true);
+
+    debug("%d page shootdowns: %llu us separately, %llu us batched\n", IPI_BENCH_RANGES,
+          separate / NSEC_PER_USEC, batched / NSEC_PER_USEC);
+    printk(GFX_PURPLE, "%d page shootdowns: %llu us separately, %llu us batched\n", IPI_BENCH_RANGES,
+           separate / NSEC_PER_USEC, batched / NSEC_PER_USEC);
+
+    serial_set_color(TERM_COLOR_RESET);
+}
@@ -0,0 +1,180 @@
+/*
+	This file is part of an x86_64 hobbyist operating system called KnutOS
+	Everything is openly developed on GitHub: https://github.com/Tix3Dev/KnutOS/
+
+	Copyright (C) 2021-2022  Yves Vollmeier <https://github.com/Tix3Dev>
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <bench/kmalloc_bench.h>
+#include <boot/stivale2.h>
+#include <devices/cpu/cpu.h>
+#include <memory/pmm.h>
+#include <libk/alloc/kmalloc.h>
+#include <libk/debug/debug.h>
+#include <libk/log/log.h>
+#include <libk/stdio/stdio.h>
+
+static void	*objects[KMALLOC_BENCH_OBJECTS];
+static size_t	sizes[KMALLOC_BENCH_OBJECTS];
+
+// xorshift64 - a fixed seed makes every run allocate the same mix
+static uint64_t bench_random(uint64_t *state)
+{
+    uint64_t x = *state;
+
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+
+    return *state = x;
+}
+
+// synthetic mix of object sizes, roughly what a kernel heap sees:
+// 60% tiny (1 - 64), 25% small (65 - 512), 12% medium (513 - 4096), 3% big (4097 - 16384)
+static size_t bench_random_size(uint64_t *state)
+{
+    uint64_t r = bench_random(state);
+    uint64_t bucket = r % 100;
+
+    r >>= 8;
+
+    if (bucket < 60)
+        return 1 + r % 64;
+    else if (bucket < 85)
+        return 65 + r % 448;
+    else if (bucket < 97)
+        return 513 + r % 3584;
+
+    return 4097 + r % 12288;
+}
+
+// what the same request cost before size classes:
+// next power of two of size + 8 byte header, or a power of two plus a header page
+static size_t bench_pow2_size(size_t size)
+{
+    size_t result = 2;
+
+    while (result < size)
+        result <<= 1;
+
+    if (result >= PAGE_SIZE)
+        return result + PAGE_SIZE;
+
+    result = 2;
+
+    while (result < size + 8)
+        result <<= 1;
+
+    return result;
+}
+
+// measure memory overhead and throughput of kmalloc / kfree on a synthetic mix of sizes
+void kmalloc_bench(void)
+{
+    uint64_t state = 0x9E3779B97F4A7C15;
+
+    size_t requested = 0;
+    size_t usable = 0;
+    size_t pow2_usable = 0;
+    size_t used_pages_before = pmm_info.used_pages;
+
+    // --- step 1 ---
+
+    // fill the heap with KMALLOC_BENCH_OBJECTS live objects
+    uint64_t start = rdtsc();
+
+    for (size_t i = 0; i < KMALLOC_BENCH_OBJECTS; i++)
+    {
+        sizes[i] = bench_random_size(&state);
+        objects[i] = kmalloc(sizes[i]);
+    }
+
+    uint64_t fill_cycles = rdtsc() - start;
+
+    for (size_t i = 0; i < KMALLOC_BENCH_OBJECTS; i++)
+    {
+        requested += sizes[i];
+        usable += ksize(objects[i]);
+        pow2_usable += bench_pow2_size(sizes[i]);
+    }
+
+    size_t peak_pages = pmm_info.used_pages - used_pages_before;
+
+
+    // --- step 2 ---
+
+    // churn: free every other object and reallocate it with a new size
+    uint64_t churn_ops = 0;
+
+    start = rdtsc();
+
+    for (size_t round = 0; round < KMALLOC_BENCH_ROUNDS; round++)
+    {
+        for (size_t i = round % 2; i < KMALLOC_BENCH_OBJECTS; i += 2)
+        {
+            kfree(objects[i]);
+
+            sizes[i] = bench_random_size(&state);
+            objects[i] = kmalloc(sizes[i]);
+
+            churn_ops += 2;
+        }
+    }
+
+    uint64_t churn_cycles = rdtsc() - start;
+
+
+    // --- step 3 ---
+
+    // free everything again
+    start = rdtsc();
+
+    for (size_t i = 0; i < KMALLOC_BENCH_OBJECTS; i++)
+        kfree(objects[i]);
+
+    uint64_t free_cycles = rdtsc() - start;
+
+
+    // --- done ---
+
+    serial_log(INFO, "kmalloc benchmark results:\n");
+    kernel_log(INFO, "kmalloc benchmark results:\n");
+
+    serial_set_color(TERM_PURPLE);
+
+    debug("Objects: %d | Churn rounds: %d\n", KMALLOC_BENCH_OBJECTS, KMALLOC_BENCH_ROUNDS);
+    printk(GFX_PURPLE, "Objects: %d | Churn rounds: %d\n", KMALLOC_BENCH_OBJECTS, KMALLOC_BENCH_ROUNDS);
+
+    debug("Requested: %d bytes | Usable: %d bytes | Overhead: %d.%d%%\n", requested, usable,
+          (usable - requested) * 100 / requested, (usable - requested) * 1000 / requested % 10);
+    printk(GFX_PURPLE, "Requested: %d bytes | Usable: %d bytes | Overhead: %d.%d%%\n", requested, usable,
+           (usable - requested) * 100 / requested, (usable - requested) * 1000 / requested % 10);
+
+    debug("Power of two + header would use: %d bytes | Overhead: %d.%d%%\n", pow2_usable,
+          (pow2_usable - requested) * 100 / requested, (pow2_usable - requested) * 1000 / requested % 10);
+    printk(GFX_PURPLE, "Power of two + header would use: %d bytes | Overhead: %d.%d%%\n", pow2_usable,
+           (pow2_usable - requested) * 100 / requested, (pow2_usable - requested) * 1000 / requested % 10);
+
+    debug("Pages taken from the PMM: %d\n", peak_pages);
+    printk(GFX_PURPLE, "Pages taken from the PMM: %d\n", peak_pages);
+
+    debug("Cycles per op: fill %llu | churn %llu | free %llu\n", fill_cycles / KMALLOC_BENCH_OBJECTS,
+          churn_cycles / churn_ops, free_cycles / KMALLOC_BENCH_OBJECTS);
+    printk(GFX_PURPLE, "Cycles per op: fill %llu | churn %llu | free %llu\n", fill_cycles / KMALLOC_BENCH_OBJECTS,
+           churn_cycles / churn_ops, free_cycles / KMALLOC_BENCH_OBJECTS);
+
+    serial_set_color(TERM_COLOR_RESET);
+}
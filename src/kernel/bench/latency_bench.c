@@ -0,0 +1,230 @@
+/*
+	This file is part of an x86_64 hobbyist operating system called KnutOS
+	Everything is openly developed on GitHub: https://github.com/Tix3Dev/KnutOS/
+
+	Copyright (C) 2021-2022  Yves Vollmeier <https://github.com/Tix3Dev>
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <bench/latency_bench.h>
+#include <scheduler/completion.h>
+#include <scheduler/scheduler.h>
+#include <scheduler/thread.h>
+#include <smp/smp.h>
+#include <time/clocksource.h>
+#include <time/timer.h>
+#include <libk/debug/debug.h>
+#include <libk/kprintf/kprintf.h>
+#include <libk/log/log.h>
+#include <libk/stdio/stdio.h>
+
+/*  Explanation of the latency benchmark:
+    Works like cyclictest: one thread per cpu wakes up every
+    LATENCY_BENCH_INTERVAL_MS at an absolute jiffy and measures how late
+    it actually runs, while LATENCY_BENCH_LOAD_THREADS busy threads per
+    cpu compete for the same cpus. The first round runs the measuring
+    threads at normal priority, so they wait behind the time slices of
+    the load. The second one gives them a deadline reservation, then
+    only the tick and timer granularity should be left.
+*/
+
+typedef struct
+{
+    bool	deadline;
+    bool	rejected;	// admission control said no
+    uint64_t	samples;
+    uint64_t	min_ns;
+    uint64_t	max_ns;
+    uint64_t	sum_ns;
+    uint64_t	buckets[LATENCY_BENCH_BUCKETS];
+} latency_bench_result_t;
+
+static latency_bench_result_t	results[SMP_MAX_CPUS];
+static completion_t		measure_done = COMPLETION_INIT("latency bench");
+static completion_t		load_done = COMPLETION_INIT("latency bench load");
+static volatile bool		load_stop;
+
+static void latency_bench_record(latency_bench_result_t *result, uint64_t latency_ns)
+{
+    uint64_t latency_us = latency_ns / NSEC_PER_USEC;
+    size_t bucket = 0;
+
+    while (bucket < LATENCY_BENCH_BUCKETS - 1 && latency_us >= (1ULL << bucket))
+        bucket++;
+
+    result->buckets[bucket]++;
+    result->samples++;
+    result->sum_ns += latency_ns;
+
+    if (latency_ns < result->min_ns)
+        result->min_ns = latency_ns;
+
+    if (latency_ns > result->max_ns)
+        result->max_ns = latency_ns;
+}
+
+// sleep until the next period and note how late we woke up
+static void latency_bench_measure(void *arg)
+{
+    latency_bench_result_t *result = arg;
+
+    if (result->deadline)
+    {
+        uint64_t period_ns = LATENCY_BENCH_INTERVAL_MS * NSEC_PER_MSEC;
+
+        if (!thread_set_deadline(LATENCY_BENCH_DL_RUNTIME_NS, period_ns, period_ns))
+        {
+            result->rejected = true;
+            complete(&measure_done);
+            return;
+        }
+    }
+
+    uint64_t next = timer_get_jiffies() + 1;
+
+    for (size_t i = 0; i < LATENCY_BENCH_LOOPS; i++)
+    {
+        next += timer_ms_to_jiffies(LATENCY_BENCH_INTERVAL_MS);
+
+        thread_sleep_until(next);
+
+        uint64_t now = ktime_get_ns();
+        uint64_t expected = next * TIMER_NSEC_PER_JIFFY;
+
+        latency_bench_record(result, now > expected ? now - expected : 0);
+    }
+
+    complete(&measure_done);
+}
+
+static void latency_bench_load(void *arg)
+{
+    (void)arg;
+
+    while (!load_stop)
+        asm volatile("pause" : : : "memory");
+
+    complete(&load_done);
+}
+
+// one measuring thread per cpu under load, summed up into total
+static void latency_bench_round(bool deadline, latency_bench_result_t *total)
+{
+    size_t cpus = smp_cpu_count;
+    size_t measuring = 0;
+    size_t loading = 0;
+
+    load_stop = false;
+
+    for (size_t cpu = 0; cpu < cpus; cpu++)
+    {
+        for (size_t i = 0; i < LATENCY_BENCH_LOAD_THREADS; i++)
+            if (thread_create_on_cpu("load", latency_bench_load, NULL, THREAD_PRIORITY_NORMAL, cpu))
+                loading++;
+    }
+
+    for (size_t cpu = 0; cpu < cpus; cpu++)
+    {
+        results[cpu] = (latency_bench_result_t){.deadline = deadline, .min_ns = UINT64_MAX};
+
+        if (thread_create_on_cpu("cyclic", latency_bench_measure, &results[cpu], THREAD_PRIORITY_NORMAL, cpu))
+            measuring++;
+    }
+
+    for (size_t i = 0; i < measuring; i++)
+        wait_for_completion(&measure_done);
+
+    load_stop = true;
+
+    for (size_t i = 0; i < loading; i++)
+        wait_for_completion(&load_done);
+
+    *total = (latency_bench_result_t){.deadline = deadline, .min_ns = UINT64_MAX};
+
+    for (size_t cpu = 0; cpu < cpus; cpu++)
+    {
+        latency_bench_result_t *result = &results[cpu];
+
+        total->rejected |= result->rejected;
+        total->samples += result->samples;
+        total->sum_ns += result->sum_ns;
+
+        if (result->samples && result->min_ns < total->min_ns)
+            total->min_ns = result->min_ns;
+
+        if (result->max_ns > total->max_ns)
+            total->max_ns = result->max_ns;
+
+        for (size_t bucket = 0; bucket < LATENCY_BENCH_BUCKETS; bucket++)
+            total->buckets[bucket] += result->buckets[bucket];
+    }
+}
+
+static void latency_bench_print_summary(const char *name, latency_bench_result_t *total)
+{
+    uint64_t min_us = total->samples ? total->min_ns / NSEC_PER_USEC : 0;
+    uint64_t avg_us = total->samples ? total->sum_ns / total->samples / NSEC_PER_USEC : 0;
+    uint64_t max_us = total->max_ns / NSEC_PER_USEC;
+
+    debug("%-9s samples %llu | min %llu us | avg %llu us | max %llu us%s\n", name, total->samples,
+          min_us, avg_us, max_us, total->rejected ? " | some reservations rejected" : "");
+    printk(GFX_PURPLE, "%-9s samples %llu | min %llu us | avg %llu us | max %llu us%s\n", name, total->samples,
+           min_us, avg_us, max_us, total->rejected ? " | some reservations rejected" : "");
+}
+
+// wakeup latency histograms of normal and deadline threads under busy load
+void latency_bench(void)
+{
+    latency_bench_result_t normal;
+    latency_bench_result_t deadline;
+
+    serial_log(INFO, "Latency benchmark results:\n");
+    kernel_log(INFO, "Latency benchmark results:\n");
+
+    serial_set_color(TERM_PURPLE);
+
+    debug("Cpus: %d | Wakeups per cpu: %d every %d ms | Busy threads per cpu: %d\n", smp_cpu_count,
+          LATENCY_BENCH_LOOPS, LATENCY_BENCH_INTERVAL_MS, LATENCY_BENCH_LOAD_THREADS);
+    printk(GFX_PURPLE, "Cpus: %d | Wakeups per cpu: %d every %d ms | Busy threads per cpu: %d\n", smp_cpu_count,
+           LATENCY_BENCH_LOOPS, LATENCY_BENCH_INTERVAL_MS, LATENCY_BENCH_LOAD_THREADS);
+
+    latency_bench_round(false, &normal);
+    latency_bench_round(true, &deadline);
+
+    latency_bench_print_summary("normal", &normal);
+    latency_bench_print_summary("deadline", &deadline);
+
+    debug("%-12s %-10s %s\n", "latency", "normal", "deadline");
+    printk(GFX_PURPLE, "%-12s %-10s %s\n", "latency", "normal", "deadline");
+
+    for (size_t bucket = 0; bucket < LATENCY_BENCH_BUCKETS; bucket++)
+    {
+        if (!normal.buckets[bucket] && !deadline.buckets[bucket])
+            continue;
+
+        char range[16];
+
+        if (bucket == LATENCY_BENCH_BUCKETS - 1)
+            snprintf(range, sizeof(range), ">= %llu us", 1ULL << (bucket - 1));
+        else
+            snprintf(range, sizeof(range), "< %llu us", 1ULL << bucket);
+
+        debug("%-12s %-10llu %llu\n", range, normal.buckets[bucket], deadline.buckets[bucket]);
+        printk(GFX_PURPLE, "%-12s %-10llu %llu\n", range, normal.buckets[bucket], deadline.buckets[bucket]);
+    }
+
+    serial_set_color(TERM_COLOR_RESET);
+}
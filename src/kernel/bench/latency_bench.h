@@ -0,0 +1,29 @@
+/*
+	This file is part of an x86_64 hobbyist operating system called KnutOS
+	Everything is openly developed on GitHub: https://github.com/Tix3Dev/KnutOS/
+
+	Copyright (C) 2021-2022  Yves Vollmeier <https://github.com/Tix3Dev>
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef LATENCY_BENCH_H
+#define LATENCY_BENCH_H
+
+#define LATENCY_BENCH_LOOPS		1000	// wakeups per measuring thread and round
+#define LATENCY_BENCH_INTERVAL_MS	2	// period of the measuring threads
+#define LATENCY_BENCH_LOAD_THREADS	2	// busy threads per cpu, same priority as the measuring ones
+#define LATENCY_BENCH_BUCKETS		16	// power of two microseconds, the last bucket takes the rest
+#define LATENCY_BENCH_DL_RUNTIME_NS	200000	// reservation of a measuring thread in the deadline round
+
+void latency_bench(void);
+
+#endif
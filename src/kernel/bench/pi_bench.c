@@ -0,0 +1,170 @@
+/*
+	This file is part of an x86_64 hobbyist operating system called KnutOS
+	Everything is openly developed on GitHub: https://github.com/Tix3Dev/KnutOS/
+
+	Copyright (C) 2021-2022  Yves Vollmeier <https://github.com/Tix3Dev>
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <bench/pi_bench.h>
+#include <boot/stivale2.h>
+#include <scheduler/completion.h>
+#include <scheduler/mutex.h>
+#include <scheduler/pi_mutex.h>
+#include <scheduler/scheduler.h>
+#include <scheduler/thread.h>
+#include <time/clocksource.h>
+#include <libk/debug/debug.h>
+#include <libk/log/log.h>
+#include <libk/stdio/stdio.h>
+
+/*  Explanation of the priority inversion benchmark:
+    All threads run on the cpu of the caller with work stealing turned
+    off. A low priority thread takes the lock and works for
+    PI_BENCH_HOLD_MS, then PI_BENCH_MEDIUM_THREADS normal priority
+    threads start burning the cpu and a high priority thread wants the
+    lock. With a plain mutex the owner only gets the cpu back once the
+    medium threads are done, with a pi_mutex it inherits the high
+    priority and finishes first. The time the high priority thread
+    waited for the lock is reported for both.
+*/
+
+static bool		use_pi;
+static mutex_t		bench_plain_lock = MUTEX_INIT("pi bench plain");
+static pi_mutex_t	bench_pi_lock = PI_MUTEX_INIT("pi bench");
+static completion_t	low_locked = COMPLETION_INIT("pi bench locked");
+static completion_t	done = COMPLETION_INIT("pi bench done");
+static uint64_t		high_wait_ns;
+
+static void pi_bench_lock(void)
+{
+    if (use_pi)
+        pi_mutex_lock(&bench_pi_lock);
+    else
+        mutex_lock(&bench_plain_lock);
+}
+
+static void pi_bench_unlock(void)
+{
+    if (use_pi)
+        pi_mutex_unlock(&bench_pi_lock);
+    else
+        mutex_unlock(&bench_plain_lock);
+}
+
+// keep the cpu busy without giving it up voluntarily
+static void pi_bench_spin_ms(uint64_t ms)
+{
+    uint64_t end = ktime_get_ns() + ms * NSEC_PER_MSEC;
+
+    while (ktime_get_ns() < end)
+        asm volatile("pause");
+}
+
+static void pi_bench_low(void *arg)
+{
+    (void)arg;
+
+    pi_bench_lock();
+    complete(&low_locked);
+
+    pi_bench_spin_ms(PI_BENCH_HOLD_MS);
+
+    pi_bench_unlock();
+    complete(&done);
+}
+
+static void pi_bench_medium(void *arg)
+{
+    (void)arg;
+
+    pi_bench_spin_ms(PI_BENCH_LOAD_MS);
+    complete(&done);
+}
+
+static void pi_bench_high(void *arg)
+{
+    (void)arg;
+
+    uint64_t start = ktime_get_ns();
+
+    pi_bench_lock();
+    high_wait_ns = ktime_get_ns() - start;
+    pi_bench_unlock();
+
+    complete(&done);
+}
+
+// returns how long the high priority thread waited for the lock
+static uint64_t pi_bench_round(bool pi)
+{
+    size_t threads = 1;
+
+    use_pi = pi;
+    high_wait_ns = 0;
+
+    reinit_completion(&low_locked);
+    reinit_completion(&done);
+
+    if (!thread_create("pi-low", pi_bench_low, NULL, THREAD_PRIORITY_LOW))
+        return 0;
+
+    wait_for_completion(&low_locked);
+
+    for (size_t i = 0; i < PI_BENCH_MEDIUM_THREADS; i++)
+        if (thread_create("pi-medium", pi_bench_medium, NULL, THREAD_PRIORITY_NORMAL))
+            threads++;
+
+    if (thread_create("pi-high", pi_bench_high, NULL, THREAD_PRIORITY_HIGH))
+        threads++;
+
+    for (size_t i = 0; i < threads; i++)
+        wait_for_completion(&done);
+
+    return high_wait_ns;
+}
+
+// time a high priority thread waits for a lock held by a preempted low priority one
+void pi_bench(void)
+{
+    scheduler_set_stealing(false);
+
+    uint64_t boosts_before = pi_mutex_get_boosts();
+    uint64_t plain_ns = pi_bench_round(false);
+    uint64_t pi_ns = pi_bench_round(true);
+    uint64_t boosts = pi_mutex_get_boosts() - boosts_before;
+
+    scheduler_set_stealing(true);
+
+    serial_log(INFO, "Priority inheritance benchmark results:\n");
+    kernel_log(INFO, "Priority inheritance benchmark results:\n");
+
+    serial_set_color(TERM_PURPLE);
+
+    debug("Lock held for %d ms | %d medium threads busy for %d ms each\n", PI_BENCH_HOLD_MS,
+          PI_BENCH_MEDIUM_THREADS, PI_BENCH_LOAD_MS);
+    printk(GFX_PURPLE, "Lock held for %d ms | %d medium threads busy for %d ms each\n", PI_BENCH_HOLD_MS,
+           PI_BENCH_MEDIUM_THREADS, PI_BENCH_LOAD_MS);
+
+    debug("mutex:    high priority thread waited %llu us\n", plain_ns / NSEC_PER_USEC);
+    printk(GFX_PURPLE, "mutex:    high priority thread waited %llu us\n", plain_ns / NSEC_PER_USEC);
+
+    debug("pi mutex: high priority thread waited %llu us (%llu boosts)\n", pi_ns / NSEC_PER_USEC, boosts);
+    printk(GFX_PURPLE, "pi mutex: high priority thread waited %llu us (%llu boosts)\n", pi_ns / NSEC_PER_USEC,
+           boosts);
+
+    serial_set_color(TERM_COLOR_RESET);
+}
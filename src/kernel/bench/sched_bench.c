@@ -0,0 +1,151 @@
+/*
+	This file is part of an x86_64 hobbyist operating system called KnutOS
+	Everything is openly developed on GitHub: https://github.com/Tix3Dev/KnutOS/
+
+	Copyright (C) 2021-2022  Yves Vollmeier <https://github.com/Tix3Dev>
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <bench/sched_bench.h>
+#include <devices/cpu/cpu.h>
+#include <scheduler/scheduler.h>
+#include <scheduler/thread.h>
+#include <smp/smp.h>
+#include <libk/debug/debug.h>
+#include <libk/log/log.h>
+#include <libk/stdio/stdio.h>
+
+static volatile size_t	tasks_left;
+static thread_t		*bench_thread;
+static size_t		tasks_per_cpu[SMP_MAX_CPUS];
+
+// burn some cycles, count where we ran and wake up the benchmark once everyone is done
+static void sched_bench_task(void *arg)
+{
+    (void)arg;
+
+    for (size_t i = 0; i < SCHED_BENCH_SPINS; i++)
+        asm volatile("" : : : "memory");
+
+    __atomic_fetch_add(&tasks_per_cpu[smp_get_current_cpu()], 1, __ATOMIC_RELAXED);
+
+    if (__atomic_sub_fetch(&tasks_left, 1, __ATOMIC_ACQ_REL) == 0)
+        thread_unblock(bench_thread);
+}
+
+static void sched_bench_sum_stats(uint64_t *steals, uint64_t *pulled)
+{
+    *steals = 0;
+    *pulled = 0;
+
+    for (size_t i = 0; i < smp_cpu_count; i++)
+    {
+        *steals += scheduler_get_stats(i)->steals;
+        *pulled += scheduler_get_stats(i)->threads_pulled;
+    }
+}
+
+// queue SCHED_BENCH_TASKS threads on cpu 0 and wait until all of them exited,
+// only the first cpu_limit cpus may steal them -> returns the TSC cycles it took
+static uint64_t sched_bench_round(size_t cpu_limit)
+{
+    for (size_t i = 0; i < SMP_MAX_CPUS; i++)
+        tasks_per_cpu[i] = 0;
+
+    scheduler_set_cpu_limit(cpu_limit);
+
+    bench_thread = thread_current();
+    tasks_left = SCHED_BENCH_TASKS;
+
+    uint64_t start = rdtsc();
+
+    for (size_t i = 0; i < SCHED_BENCH_TASKS; i++)
+    {
+        if (!thread_create_on_cpu("bench", sched_bench_task, NULL, THREAD_PRIORITY_NORMAL, 0))
+            __atomic_sub_fetch(&tasks_left, 1, __ATOMIC_ACQ_REL);
+    }
+
+    for (;;)
+    {
+        thread_prepare_block();
+
+        if (tasks_left == 0)
+        {
+            thread_cancel_block();
+            break;
+        }
+
+        thread_yield();
+    }
+
+    uint64_t cycles = rdtsc() - start;
+
+    scheduler_set_cpu_limit(0);
+
+    return cycles;
+}
+
+// measure throughput of many short-lived threads as more cpus get to steal them
+void sched_bench(void)
+{
+    size_t online = smp_get_online_count();
+    uint64_t base_cycles = 0;
+
+    serial_log(INFO, "Scheduler benchmark results:\n");
+    kernel_log(INFO, "Scheduler benchmark results:\n");
+
+    serial_set_color(TERM_PURPLE);
+
+    debug("Tasks: %d | Spins per task: %d | Online cpus: %d\n", SCHED_BENCH_TASKS, SCHED_BENCH_SPINS, online);
+    printk(GFX_PURPLE, "Tasks: %d | Spins per task: %d | Online cpus: %d\n", SCHED_BENCH_TASKS, SCHED_BENCH_SPINS,
+           online);
+
+    // 1, 2, 4, ... cpus and finally all of them
+    for (size_t cpus = 1; ; cpus = cpus * 2 < online ? cpus * 2 : online)
+    {
+        uint64_t steals_before, pulled_before, steals_after, pulled_after;
+
+        sched_bench_sum_stats(&steals_before, &pulled_before);
+        uint64_t cycles = sched_bench_round(cpus);
+        sched_bench_sum_stats(&steals_after, &pulled_after);
+
+        if (cpus == 1)
+            base_cycles = cycles;
+
+        uint64_t speedup = base_cycles * 10 / cycles;
+
+        debug("cpus %d: %llu cycles per task | speedup %llu.%llux | steals %llu (%llu threads)\n",
+              cpus, cycles / SCHED_BENCH_TASKS, speedup / 10, speedup % 10,
+              steals_after - steals_before, pulled_after - pulled_before);
+        printk(GFX_PURPLE, "cpus %d: %llu cycles per task | speedup %llu.%llux | steals %llu (%llu threads)\n",
+               cpus, cycles / SCHED_BENCH_TASKS, speedup / 10, speedup % 10,
+               steals_after - steals_before, pulled_after - pulled_before);
+
+        if (cpus == online)
+            break;
+    }
+
+    // how the last round got spread
+    for (size_t i = 0; i < smp_cpu_count; i++)
+    {
+        if (!tasks_per_cpu[i])
+            continue;
+
+        debug("  cpu %d ran %d tasks\n", i, tasks_per_cpu[i]);
+        printk(GFX_PURPLE, "  cpu %d ran %d tasks\n", i, tasks_per_cpu[i]);
+    }
+
+    serial_set_color(TERM_COLOR_RESET);
+}
@@ -28,12 +28,24 @@ static struct stivale2_tag la57_tag =
     .next	= 0
 };
 
+// let the bootloader start the application processors
+// flags = 0 -> xAPIC mode, they spin until smp_init hands them a goto_address
+static struct stivale2_header_tag_smp smp_hdr_tag =
+{
+    .tag =
+    {
+        .identifier = STIVALE2_HEADER_TAG_SMP_ID,
+        .next	    = (uintptr_t)&la57_tag
+    },
+    .flags	= 0
+};
+
 static struct stivale2_header_tag_framebuffer framebuffer_hdr_tag =
 {
     .tag =
     {
         .identifier = STIVALE2_HEADER_TAG_FRAMEBUFFER_ID,
-        .next	    = (uintptr_t)&la57_tag
+        .next	    = (uintptr_t)&smp_hdr_tag
     },
     // bootloader automatically finds best values
     .framebuffer_width	= 0,
@@ -19,15 +19,24 @@
 
 #include <devices/apic/apic.h>
 #include <devices/cpu/cpu.h>
+#include <devices/hpet/hpet.h>
 #include <devices/pic/pic.h>
+#include <devices/pit/pit.h>
 #include <firmware/acpi/tables/madt.h>
 #include <interrupts/interrupts.h>
 #include <memory/mem.h>
+#include <time/clocksource.h>
 #include <libk/debug/debug.h>
 #include <libk/log/log.h>
 
 uintptr_t lapic_base;
 
+// timer ticks (divided by 16) per millisecond, the same on every cpu
+uint32_t lapic_timer_ticks_per_ms = 0;
+
+// TSC-deadline mode is usable (cpu support and a calibrated TSC)
+bool lapic_timer_tsc_deadline = false;
+
 /* General APIC functions */
 
 void apic_init(void)
@@ -81,7 +90,7 @@ bool apic_is_available(void)
 // if supported and then use msr
 uint32_t lapic_read_register(uint32_t reg)
 {
-    return *((volatile uint32_t *)lapic_base + reg);
+    return *((volatile uint32_t *)(lapic_base + reg));
 }
 
 // write to a local apic manager
@@ -98,15 +107,173 @@ void lapic_enable(void)
     lapic_write_register(APIC_SPURIOUS_VECTOR_REGISTER, APIC_SOFTWARE_ENABLE | SPURIOUS_INTERRUPT);
 }
 
+// id of the local apic of the cpu this runs on (bits 24..31)
+uint32_t lapic_get_id(void)
+{
+    return lapic_read_register(APIC_ID_REGISTER) >> 24;
+}
+
 // signal an end of interrupt to continue execution
 void lapic_signal_eoi(void)
 {
     lapic_write_register(APIC_EOI_REGISTER, 0);
 }
 
-void lapic_send_ipi(void)
+// count how far the timer gets during a known amount of time
+// -> measured with the HPET, the TSC clocksource or a PIT one-shot, whichever exists first
+// -> done once on the BSP, all cpus share the bus clock
+void lapic_timer_calibrate(void)
+{
+    lapic_write_register(APIC_TIMER_DIVIDE_REGISTER, APIC_TIMER_DIVIDE_BY_16);
+    lapic_write_register(APIC_LVT_TIMER_REGISTER, APIC_LVT_MASKED);
+
+    if (hpet_is_available())
+    {
+        lapic_write_register(APIC_TIMER_INITIAL_COUNT_REGISTER, 0xFFFFFFFF);
+        hpet_spin_ns(APIC_TIMER_CALIBRATION_US * NSEC_PER_USEC);
+    }
+    else if (clocksource_get_tsc_hz())
+    {
+        uint64_t cycles = clocksource_ns_to_cycles(APIC_TIMER_CALIBRATION_US * NSEC_PER_USEC);
+
+        lapic_write_register(APIC_TIMER_INITIAL_COUNT_REGISTER, 0xFFFFFFFF);
+        uint64_t start = rdtsc();
+
+        while (rdtsc() - start < cycles)
+            asm volatile("pause");
+    }
+    else
+    {
+        pit_oneshot_start(APIC_TIMER_CALIBRATION_US);
+        lapic_write_register(APIC_TIMER_INITIAL_COUNT_REGISTER, 0xFFFFFFFF);
+
+        while (!pit_oneshot_expired())
+            asm volatile("pause");
+    }
+
+    uint32_t elapsed = 0xFFFFFFFF - lapic_read_register(APIC_TIMER_CURRENT_COUNT_REGISTER);
+
+    lapic_timer_stop();
+
+    lapic_timer_ticks_per_ms = elapsed / (APIC_TIMER_CALIBRATION_US / 1000);
+
+    cpuid_registers_t regs =
+    {
+        .leaf = CPUID_GET_FEATURES,
+        .subleaf = 0
+    };
+
+    lapic_timer_tsc_deadline = cpuid(&regs) && (regs.ecx & CPUID_FEAT_ECX_TSC) && clocksource_get_tsc_hz();
+
+    serial_log(INFO, "LAPIC timer calibrated: %d ticks per ms, TSC-deadline mode %s\n", lapic_timer_ticks_per_ms,
+               lapic_timer_tsc_deadline ? "supported" : "not supported");
+    kernel_log(INFO, "LAPIC timer calibrated: %d ticks per ms, TSC-deadline mode %s\n", lapic_timer_ticks_per_ms,
+               lapic_timer_tsc_deadline ? "supported" : "not supported");
+}
+
+// fire vector hz times per second on the calling cpu
+void lapic_timer_start_periodic(uint8_t vector, uint32_t hz)
+{
+    lapic_write_register(APIC_TIMER_DIVIDE_REGISTER, APIC_TIMER_DIVIDE_BY_16);
+    lapic_write_register(APIC_LVT_TIMER_REGISTER, vector | APIC_TIMER_MODE_PERIODIC);
+    lapic_write_register(APIC_TIMER_INITIAL_COUNT_REGISTER, lapic_timer_ticks_per_ms * 1000 / hz);
+}
+
+// fire vector once on the calling cpu, ns nanoseconds from now
+// -> the 32 bit counter limits it to a few seconds, longer delays fire early
+void lapic_timer_start_oneshot(uint8_t vector, uint64_t ns)
+{
+    uint64_t count = ns * lapic_timer_ticks_per_ms / NSEC_PER_MSEC;
+
+    if (count == 0)
+        count = 1;
+    else if (count > 0xFFFFFFFF)
+        count = 0xFFFFFFFF;
+
+    lapic_write_register(APIC_TIMER_DIVIDE_REGISTER, APIC_TIMER_DIVIDE_BY_16);
+    lapic_write_register(APIC_LVT_TIMER_REGISTER, vector | APIC_TIMER_MODE_ONESHOT);
+    lapic_write_register(APIC_TIMER_INITIAL_COUNT_REGISTER, count);
+}
+
+// fire vector once on the calling cpu when the TSC reaches tsc_deadline
+// (only if lapic_timer_tsc_deadline, a deadline in the past fires right away)
+void lapic_timer_start_tsc_deadline(uint8_t vector, uint64_t tsc_deadline)
+{
+    lapic_write_register(APIC_LVT_TIMER_REGISTER, vector | APIC_TIMER_MODE_TSC_DEADLINE);
+
+    // the MMIO write to the LVT has to land before the MSR write arms the timer
+    asm volatile("mfence" : : : "memory");
+
+    wrmsr(IA32_TSC_DEADLINE, tsc_deadline);
+}
+
+// fire vector once, ns nanoseconds from now, with the most precise mode available
+void lapic_timer_start_deadline_ns(uint8_t vector, uint64_t ns)
+{
+    if (lapic_timer_tsc_deadline)
+        lapic_timer_start_tsc_deadline(vector, rdtsc() + clocksource_ns_to_cycles(ns));
+    else
+        lapic_timer_start_oneshot(vector, ns);
+}
+
+void lapic_timer_stop(void)
+{
+    lapic_write_register(APIC_LVT_TIMER_REGISTER, APIC_LVT_MASKED);
+    lapic_write_register(APIC_TIMER_INITIAL_COUNT_REGISTER, 0);
+
+    if (lapic_timer_tsc_deadline)
+        wrmsr(IA32_TSC_DEADLINE, 0);
+}
+
+// wait until the previous IPI left the local APIC
+static void lapic_wait_for_ipi(void)
+{
+    while (lapic_read_register(APIC_ICR_LOW_REGISTER) & APIC_ICR_SEND_PENDING)
+        asm volatile("pause");
+}
+
+// send a raw inter processor interrupt to a specific APIC ID
+// -> writing the low half sends it, so both halves are written with interrupts off,
+//    an IPI sent by an interrupt handler in between would change the destination
+void lapic_send_ipi(uint32_t lapic_id, uint32_t icr_low)
+{
+    uint64_t rflags = cpu_save_and_disable_interrupts();
+
+    lapic_wait_for_ipi();
+    lapic_write_register(APIC_ICR_HIGH_REGISTER, lapic_id << 24);
+    lapic_write_register(APIC_ICR_LOW_REGISTER, icr_low);
+
+    cpu_restore_interrupts(rflags);
+}
+
+void lapic_send_fixed_ipi(uint32_t lapic_id, uint8_t vector)
+{
+    lapic_send_ipi(lapic_id, APIC_ICR_DELIVERY_FIXED | APIC_ICR_LEVEL_ASSERT | vector);
+}
+
+// arrives as exception 2 even with interrupts disabled
+void lapic_send_nmi(uint32_t lapic_id)
+{
+    lapic_send_ipi(lapic_id, APIC_ICR_DELIVERY_NMI | APIC_ICR_LEVEL_ASSERT);
+}
+
+void lapic_send_nmi_all_but_self(void)
+{
+    lapic_send_ipi(0, APIC_ICR_DELIVERY_NMI | APIC_ICR_LEVEL_ASSERT | APIC_ICR_DEST_ALL_BUT_SELF);
+}
+
+// put a cpu into wait-for-SIPI state
+void lapic_send_init(uint32_t lapic_id)
+{
+    lapic_send_ipi(lapic_id, APIC_ICR_DELIVERY_INIT | APIC_ICR_LEVEL_ASSERT | APIC_ICR_TRIGGER_LEVEL);
+    lapic_send_ipi(lapic_id, APIC_ICR_DELIVERY_INIT | APIC_ICR_TRIGGER_LEVEL);	// deassert
+}
+
+// start a cpu in wait-for-SIPI state in real mode at page * 4 KiB
+// -> the bootloader starts the APs for us, this is for bringing them back later
+void lapic_send_startup(uint32_t lapic_id, uint8_t page)
 {
-    // send a raw inter processor interrupt to a specific APIC ID
+    lapic_send_ipi(lapic_id, APIC_ICR_DELIVERY_STARTUP | APIC_ICR_LEVEL_ASSERT | page);
 }
 
 /* IO APIC functions */
@@ -22,17 +22,57 @@
 #ifndef APIC_H
 #define APIC_H
 
-#define APIC_SPURIOUS_VECTOR_REGISTER	0xF
+extern uint32_t lapic_timer_ticks_per_ms;
+extern bool lapic_timer_tsc_deadline;
+
+#define APIC_ID_REGISTER		0x20
 #define APIC_EOI_REGISTER		0xB0
+#define APIC_SPURIOUS_VECTOR_REGISTER	0xF0
 #define APIC_SOFTWARE_ENABLE		(1 << 8)
 
+#define APIC_LVT_TIMER_REGISTER			0x320
+#define APIC_TIMER_INITIAL_COUNT_REGISTER	0x380
+#define APIC_TIMER_CURRENT_COUNT_REGISTER	0x390
+#define APIC_TIMER_DIVIDE_REGISTER		0x3E0
+#define APIC_LVT_MASKED				(1 << 16)
+#define APIC_TIMER_MODE_ONESHOT			(0 << 17)
+#define APIC_TIMER_MODE_PERIODIC		(1 << 17)
+#define APIC_TIMER_MODE_TSC_DEADLINE		(2 << 17)
+#define APIC_TIMER_DIVIDE_BY_16			0x3
+#define APIC_TIMER_CALIBRATION_US		10000	// measured against the HPET, TSC or PIT
+
+#define IA32_TSC_DEADLINE			0x6E0
+
+#define APIC_ICR_LOW_REGISTER		0x300
+#define APIC_ICR_HIGH_REGISTER		0x310	// destination in bits 24..31
+#define APIC_ICR_DELIVERY_FIXED		(0 << 8)
+#define APIC_ICR_DELIVERY_NMI		(4 << 8)
+#define APIC_ICR_DELIVERY_INIT		(5 << 8)
+#define APIC_ICR_DELIVERY_STARTUP	(6 << 8)
+#define APIC_ICR_SEND_PENDING		(1 << 12)
+#define APIC_ICR_LEVEL_ASSERT		(1 << 14)
+#define APIC_ICR_TRIGGER_LEVEL		(1 << 15)
+#define APIC_ICR_DEST_ALL_BUT_SELF	(3 << 18)
+
 void apic_init(void);
 bool apic_is_available(void);
 uint32_t lapic_read_register(uint32_t reg);
 void lapic_write_register(uint32_t reg, uint32_t data);
 void lapic_enable(void);
+uint32_t lapic_get_id(void);
 void lapic_signal_eoi(void);
-void lapic_send_ipi(void);
+void lapic_timer_calibrate(void);
+void lapic_timer_start_periodic(uint8_t vector, uint32_t hz);
+void lapic_timer_start_oneshot(uint8_t vector, uint64_t ns);
+void lapic_timer_start_tsc_deadline(uint8_t vector, uint64_t tsc_deadline);
+void lapic_timer_start_deadline_ns(uint8_t vector, uint64_t ns);
+void lapic_timer_stop(void);
+void lapic_send_ipi(uint32_t lapic_id, uint32_t icr_low);
+void lapic_send_fixed_ipi(uint32_t lapic_id, uint8_t vector);
+void lapic_send_nmi(uint32_t lapic_id);
+void lapic_send_nmi_all_but_self(void);
+void lapic_send_init(uint32_t lapic_id);
+void lapic_send_startup(uint32_t lapic_id, uint8_t page);
 uint32_t io_apic_read_register(size_t io_apic_i, uint8_t reg_offset);
 void io_apic_write_register(size_t io_apic_i, uint8_t reg_offset, uint32_t data);
 
@@ -157,6 +157,116 @@ static inline int cpuid(cpuid_registers_t *registers)
     return 1;
 }
 
+// read the time stamp counter
+static inline uint64_t rdtsc(void)
+{
+    uint32_t low;
+    uint32_t high;
+
+    asm volatile("rdtsc" : "=a" (low), "=d" (high));
+
+    return ((uint64_t)high << 32) | low;
+}
+
+// read a model specific register
+static inline uint64_t rdmsr(uint32_t msr)
+{
+    uint32_t low;
+    uint32_t high;
+
+    asm volatile("rdmsr" : "=a" (low), "=d" (high) : "c" (msr));
+
+    return ((uint64_t)high << 32) | low;
+}
+
+// write a model specific register
+static inline void wrmsr(uint32_t msr, uint64_t value)
+{
+    asm volatile("wrmsr" : : "c" (msr), "a" ((uint32_t)value), "d" ((uint32_t)(value >> 32)) : "memory");
+}
+
+static inline uint64_t read_cr0(void)
+{
+    uint64_t value;
+
+    asm volatile("mov %%cr0, %0" : "=r" (value));
+
+    return value;
+}
+
+static inline void write_cr0(uint64_t value)
+{
+    asm volatile("mov %0, %%cr0" : : "r" (value) : "memory");
+}
+
+static inline uint64_t read_cr4(void)
+{
+    uint64_t value;
+
+    asm volatile("mov %%cr4, %0" : "=r" (value));
+
+    return value;
+}
+
+static inline void write_cr4(uint64_t value)
+{
+    asm volatile("mov %0, %%cr4" : : "r" (value) : "memory");
+}
+
+// write an extended control register (needs CR4.OSXSAVE)
+static inline void xsetbv(uint32_t xcr, uint64_t value)
+{
+    asm volatile("xsetbv" : : "c" (xcr), "a" ((uint32_t)value), "d" ((uint32_t)(value >> 32)) : "memory");
+}
+
+// clear CR0.TS, FPU/SSE instructions don't trap anymore
+static inline void clts(void)
+{
+    asm volatile("clts" : : : "memory");
+}
+
+// set CR0.TS, the next FPU/SSE instruction raises #NM
+static inline void stts(void)
+{
+    write_cr0(read_cr0() | (1 << 3));
+}
+
+// arm address monitoring on the cache line of address for the next mwait
+static inline void monitor(const volatile void *address)
+{
+    asm volatile("monitor" : : "a" (address), "c" (0), "d" (0) : "memory");
+}
+
+// enable interrupts and wait for a store to the monitored line or an interrupt
+// -> sti only takes effect after the next instruction, no interrupt can slip in before the mwait
+static inline void sti_mwait(uint32_t hint)
+{
+    asm volatile("sti; mwait" : : "a" (hint), "c" (0) : "memory");
+}
+
+// same with hlt, only an interrupt wakes it up
+static inline void sti_hlt(void)
+{
+    asm volatile("sti; hlt" : : : "memory");
+}
+
+// disable interrupts and return the previous rflags
+static inline uint64_t cpu_save_and_disable_interrupts(void)
+{
+    uint64_t rflags;
+
+    asm volatile("pushfq; pop %0; cli" : "=r" (rflags) : : "memory");
+
+    return rflags;
+}
+
+// enable interrupts again if they were enabled in rflags (bit 9)
+static inline void cpu_restore_interrupts(uint64_t rflags)
+{
+    if (rflags & (1 << 9))
+        asm volatile("sti" : : : "memory");
+}
+
 // get cpu vendor id string by using cpuid
 static inline char *cpu_get_vendor_string(void)
 {
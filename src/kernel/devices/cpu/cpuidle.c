@@ -0,0 +1,334 @@
+/*
+	This file is part of an x86_64 hobbyist operating system called KnutOS
+	Everything is openly developed on GitHub: https://github.com/Tix3Dev/KnutOS/
+
+	Copyright (C) 2021-2022  Yves Vollmeier <https://github.com/Tix3Dev>
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <boot/stivale2.h>
+#include <devices/cpu/cpu.h>
+#include <devices/cpu/cpuidle.h>
+#include <scheduler/scheduler.h>
+#include <scheduler/thread.h>
+#include <smp/ipi.h>
+#include <smp/percpu.h>
+#include <smp/smp.h>
+#include <time/clocksource.h>
+#include <libk/log/log.h>
+#include <libk/stdio/stdio.h>
+#include <libk/string/string.h>
+
+/*  Explanation of cpuidle:
+    Every idle thread runs cpuidle_loop. Each round it predicts how
+    long the cpu will stay idle and enters the deepest state whose
+    target residency fits into that and whose exit latency is below
+    CPUIDLE_LATENCY_LIMIT_US. The prediction is the time until the
+    next LAPIC timer interrupt, or the typical recent idle duration
+    if that's shorter: the average of the last CPUIDLE_HISTORY idle
+    periods, once they are consistent enough (the largest outliers
+    are dropped until the standard deviation is below a quarter of
+    the average).
+
+    With MONITOR/MWAIT the states are the MWAIT C-states CPUID leaf 5
+    reports, otherwise there's only hlt. There is no ACPI _CST
+    parsing, latencies and residencies are conservative defaults.
+
+    A cpu in mwait monitors it's cpuidle_wake line, so the scheduler
+    wakes it up for a newly queued thread with a plain store
+    (cpuidle_kick), no IPI needed. A cpu in hlt gets a reschedule IPI.
+
+    The time spent idle is accounted when the cpu leaves the state:
+    on the first interrupt (cpuidle_interrupt_enter, before the
+    handler can switch to another thread) or right after the mwait
+    if a store woke it up.
+*/
+
+typedef struct
+{
+    const char	*name;
+    uint32_t	exit_latency_us;
+    uint32_t	target_residency_us;
+} cpuidle_default_t;
+
+// by MWAIT C-state, C1 first
+static const cpuidle_default_t cpuidle_mwait_defaults[] =
+{
+    { "C1", 2,	 2 },
+    { "C2", 10,	 20 },
+    { "C3", 80,	 211 },
+    { "C4", 133, 345 },
+    { "C5", 166, 500 },
+    { "C6", 300, 900 },
+    { "C7", 600, 1800 }
+};
+
+static cpuidle_state_t	cpuidle_states[CPUIDLE_MAX_STATES];
+static size_t		cpuidle_state_count = 0;
+
+static DEFINE_PER_CPU(cpuidle_cpu_t, cpuidle_cpu);
+static DEFINE_PER_CPU(volatile uint32_t, cpuidle_wake);	// monitored, a store ends the mwait
+static DEFINE_PER_CPU(volatile bool, cpuidle_polling);	// in mwait, a store is enough to wake it
+static DEFINE_PER_CPU(uint64_t, cpuidle_entered_ns);	// 0 if not in an idle state
+
+static void cpuidle_add_state(const char *name, cpuidle_method_t method, uint32_t hint,
+                              uint32_t exit_latency_us, uint32_t target_residency_us)
+{
+    cpuidle_state_t *state = &cpuidle_states[cpuidle_state_count++];
+
+    strncpy(state->name, name, sizeof(state->name) - 1);
+    state->method = method;
+    state->mwait_hint = hint;
+    state->exit_latency_us = exit_latency_us;
+    state->target_residency_us = target_residency_us;
+}
+
+// typical idle duration of the recent past, UINT64_MAX if there's no pattern
+static uint64_t cpuidle_typical_us(cpuidle_cpu_t *cpu)
+{
+    uint64_t limit = UINT64_MAX;
+
+    for (size_t pass = 0; pass < 3; pass++)
+    {
+        uint64_t sum = 0;
+        uint64_t max = 0;
+        size_t count = 0;
+
+        for (size_t i = 0; i < cpu->history_count; i++)
+        {
+            uint64_t value = cpu->history_us[i];
+
+            if (value > limit)
+                continue;
+
+            sum += value;
+            count++;
+
+            if (value > max)
+                max = value;
+        }
+
+        if (count <= CPUIDLE_HISTORY / 2)
+            return UINT64_MAX;
+
+        uint64_t average = sum / count;
+        uint64_t variance = 0;
+
+        for (size_t i = 0; i < cpu->history_count; i++)
+        {
+            uint64_t value = cpu->history_us[i];
+
+            if (value > limit)
+                continue;
+
+            uint64_t diff = value > average ? value - average : average - value;
+
+            variance += diff * diff;
+        }
+
+        variance /= count;
+
+        // standard deviation below a quarter of the average
+        if (variance * 16 <= average * average)
+            return average;
+
+        limit = max - 1;
+    }
+
+    return UINT64_MAX;
+}
+
+static size_t cpuidle_select(cpuidle_cpu_t *cpu)
+{
+    uint64_t next_event_us = scheduler_next_tick_ns() / NSEC_PER_USEC;
+    uint64_t typical_us = cpuidle_typical_us(cpu);
+    uint64_t predicted_us = typical_us < next_event_us ? typical_us : next_event_us;
+    size_t chosen = 0;
+
+    for (size_t i = 1; i < cpuidle_state_count; i++)
+    {
+        if (cpuidle_states[i].target_residency_us <= predicted_us &&
+            cpuidle_states[i].exit_latency_us <= CPUIDLE_LATENCY_LIMIT_US)
+            chosen = i;
+    }
+
+    return chosen;
+}
+
+// the cpu left it's idle state, account the time (interrupts off)
+static void cpuidle_account(void)
+{
+    uint64_t entered = this_cpu_read(cpuidle_entered_ns);
+
+    if (!entered)
+        return;
+
+    this_cpu_write(cpuidle_entered_ns, 0);
+    this_cpu_write(cpuidle_polling, false);
+
+    uint64_t duration = ktime_get_ns() - entered;
+    uint64_t duration_us = duration / NSEC_PER_USEC;
+    cpuidle_cpu_t *cpu = this_cpu_ptr(cpuidle_cpu);
+
+    cpu->residency_ns[cpu->state] += duration;
+
+    if (duration_us < cpuidle_states[cpu->state].target_residency_us)
+        cpu->too_deep[cpu->state]++;
+
+    cpu->history_us[cpu->history_next] = duration_us > UINT32_MAX ? UINT32_MAX : duration_us;
+    cpu->history_next = (cpu->history_next + 1) % CPUIDLE_HISTORY;
+
+    if (cpu->history_count < CPUIDLE_HISTORY)
+        cpu->history_count++;
+}
+
+// detect MONITOR/MWAIT and build the state table, done once on the BSP
+void cpuidle_init(void)
+{
+    cpuid_registers_t features = {.leaf = CPUID_GET_FEATURES};
+
+    cpuid(&features);
+
+    if (features.ecx & CPUID_FEAT_ECX_MONITOR)
+    {
+        cpuid_registers_t mwait = {.leaf = CPUID_MWAIT_LEAF};
+
+        cpuid(&mwait);
+
+        // C1 (hint 0) always works, deeper ones only if they have sub states
+        cpuidle_add_state("C1", CPUIDLE_MWAIT, 0, cpuidle_mwait_defaults[0].exit_latency_us,
+                          cpuidle_mwait_defaults[0].target_residency_us);
+
+        for (size_t c = 2; c <= 7 && cpuidle_state_count < CPUIDLE_MAX_STATES; c++)
+        {
+            if (!CPUID_MWAIT_SUBSTATES(mwait.edx, c))
+                continue;
+
+            const cpuidle_default_t *defaults = &cpuidle_mwait_defaults[c - 1];
+
+            cpuidle_add_state(defaults->name, CPUIDLE_MWAIT, (c - 1) << 4, defaults->exit_latency_us,
+                              defaults->target_residency_us);
+        }
+    }
+    else
+    {
+        cpuidle_add_state("HLT", CPUIDLE_HLT, 0, 1, 1);
+    }
+
+    serial_log(INFO, "cpuidle initialized: %s, %d states\n",
+               cpuidle_states[0].method == CPUIDLE_MWAIT ? "MWAIT" : "HLT", (int)cpuidle_state_count);
+    kernel_log(INFO, "cpuidle initialized: %s, %d states\n",
+               cpuidle_states[0].method == CPUIDLE_MWAIT ? "MWAIT" : "HLT", (int)cpuidle_state_count);
+}
+
+// body of every idle thread
+__attribute__((noreturn))
+void cpuidle_loop(void)
+{
+    for (;;)
+    {
+        asm volatile("cli" : : : "memory");
+
+        cpuidle_cpu_t *cpu = this_cpu_ptr(cpuidle_cpu);
+        size_t index = cpuidle_select(cpu);
+        const cpuidle_state_t *state = &cpuidle_states[index];
+
+        // armed before looking at the run queue, so a kick in between ends the mwait right away
+        if (state->method == CPUIDLE_MWAIT)
+        {
+            this_cpu_write(cpuidle_wake, 0);
+            monitor(this_cpu_ptr(cpuidle_wake));
+        }
+
+        if (scheduler_get_queued(smp_get_current_cpu()))
+        {
+            asm volatile("sti" : : : "memory");
+            thread_yield();
+
+            continue;
+        }
+
+        cpu->state = index;
+        cpu->usage[index]++;
+
+        this_cpu_write(cpuidle_polling, state->method == CPUIDLE_MWAIT);
+        this_cpu_write(cpuidle_entered_ns, ktime_get_ns());
+
+        if (state->method == CPUIDLE_MWAIT)
+            sti_mwait(state->mwait_hint);
+        else
+            sti_hlt();
+
+        // woken up by a store, an interrupt already did this
+        asm volatile("cli" : : : "memory");
+        cpuidle_account();
+        asm volatile("sti" : : : "memory");
+    }
+}
+
+// every hardware interrupt, before it's handler (interrupts off)
+void cpuidle_interrupt_enter(void)
+{
+    if (this_cpu_read(cpuidle_entered_ns))
+        cpuidle_account();
+}
+
+// a thread got queued on the idle cpu, make it look (interrupts off)
+void cpuidle_kick(size_t cpu)
+{
+    if (*per_cpu_ptr(cpuidle_polling, cpu))
+    {
+        __atomic_store_n(per_cpu_ptr(cpuidle_wake, cpu), 1, __ATOMIC_RELEASE);
+        this_cpu_ptr(cpuidle_cpu)->kicks_mwait++;
+    }
+    else
+    {
+        smp_send_reschedule(cpu);
+        this_cpu_ptr(cpuidle_cpu)->kicks_ipi++;
+    }
+}
+
+void cpuidle_print_info(void)
+{
+    printk(GFX_CYAN, "%-6s%-8s%-10s%-12s%s\n", "state", "method", "hint", "exit (us)", "residency (us)");
+
+    for (size_t i = 0; i < cpuidle_state_count; i++)
+    {
+        cpuidle_state_t *state = &cpuidle_states[i];
+
+        printk(GFX_WHITE, "%-6s%-8s0x%-8x%-12d%d\n", state->name, state->method == CPUIDLE_MWAIT ? "mwait" : "hlt",
+               state->mwait_hint, state->exit_latency_us, state->target_residency_us);
+    }
+
+    printk(GFX_CYAN, "%-5s%-6s%-12s%-14s%-10s%-12s%s\n", "cpu", "state", "entered", "residency (ms)", "too deep",
+           "kicks store", "kicks ipi");
+
+    for (size_t i = 0; i < smp_cpu_count; i++)
+    {
+        cpuidle_cpu_t *cpu = per_cpu_ptr(cpuidle_cpu, i);
+
+        for (size_t s = 0; s < cpuidle_state_count; s++)
+        {
+            printk(GFX_WHITE, "%-5d%-6s%-12llu%-14llu%-10llu", i, cpuidle_states[s].name, cpu->usage[s],
+                   cpu->residency_ns[s] / NSEC_PER_MSEC, cpu->too_deep[s]);
+
+            if (s == 0)
+                printk(GFX_WHITE, "%-12llu%llu\n", cpu->kicks_mwait, cpu->kicks_ipi);
+            else
+                printk(GFX_WHITE, "\n");
+        }
+    }
+}
@@ -0,0 +1,68 @@
+/*
+	This file is part of an x86_64 hobbyist operating system called KnutOS
+	Everything is openly developed on GitHub: https://github.com/Tix3Dev/KnutOS/
+
+	Copyright (C) 2021-2022  Yves Vollmeier <https://github.com/Tix3Dev>
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifndef CPUIDLE_H
+#define CPUIDLE_H
+
+#define CPUID_MWAIT_LEAF		0x5
+#define CPUID_MWAIT_SUBSTATES(edx, c)	(((edx) >> ((c) * 4)) & 0xF)	// sub C-states of C-state c
+
+#define CPUIDLE_MAX_STATES		8
+#define CPUIDLE_HISTORY			8	// idle durations the prediction looks at
+#define CPUIDLE_LATENCY_LIMIT_US	200	// never pick a state that takes longer to leave
+
+typedef enum
+{
+    CPUIDLE_HLT,
+    CPUIDLE_MWAIT
+} cpuidle_method_t;
+
+typedef struct
+{
+    char		name[8];
+    cpuidle_method_t	method;
+    uint32_t		mwait_hint;		// eax of mwait: C-state - 1 in bits 4..7
+    uint32_t		exit_latency_us;
+    uint32_t		target_residency_us;	// the least idle time it pays off for
+} cpuidle_state_t;
+
+// per cpu governor state and statistics
+typedef struct
+{
+    uint32_t	history_us[CPUIDLE_HISTORY];
+    size_t	history_next;
+    size_t	history_count;
+
+    size_t	state;				// last entered
+    uint64_t	usage[CPUIDLE_MAX_STATES];
+    uint64_t	residency_ns[CPUIDLE_MAX_STATES];
+    uint64_t	too_deep[CPUIDLE_MAX_STATES];	// left before target_residency
+    uint64_t	kicks_mwait;			// wakeups of other cpus by a store
+    uint64_t	kicks_ipi;
+} cpuidle_cpu_t;
+
+void cpuidle_init(void);
+__attribute__((noreturn)) void cpuidle_loop(void);
+void cpuidle_interrupt_enter(void);
+void cpuidle_kick(size_t cpu);
+void cpuidle_print_info(void);
+
+#endif
@@ -0,0 +1,416 @@
+/*
+	This file is part of an x86_64 hobbyist operating system called KnutOS
+	Everything is openly developed on GitHub: https://github.com/Tix3Dev/KnutOS/
+
+	Copyright (C) 2021-2022  Yves Vollmeier <https://github.com/Tix3Dev>
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <boot/stivale2.h>
+#include <devices/cpu/cpu.h>
+#include <devices/cpu/fpu.h>
+#include <interrupts/interrupts.h>
+#include <scheduler/thread.h>
+#include <smp/percpu.h>
+#include <smp/smp.h>
+#include <libk/alloc/kmalloc.h>
+#include <libk/log/log.h>
+#include <libk/stdio/stdio.h>
+#include <libk/string/string.h>
+
+/*  Explanation of the FPU state handling:
+    The kernel is built with -mno-sse, so the compiler never touches the
+    x87/SSE/AVX registers on it's own. Code that wants them (vectorized
+    copies, checksums, blitting) brackets itself with kernel_fpu_begin and
+    kernel_fpu_end, everything else doesn't pay for the extra state.
+
+    CR0.TS is set whenever the registers don't belong to the running
+    thread, so it's first FPU instruction raises #NM. The handler loads
+    the thread's save area (XRSTOR, or FXRSTOR without XSAVE support) and
+    clears TS, unless this cpu still holds exactly that state from before
+    (fpu_owner), then clearing TS is enough. When a thread whose registers
+    are live gets switched away from, they're written back to it's area
+    (XSAVEOPT skips the components that didn't change since the restore)
+    and TS is set again. Threads that never use the FPU never allocate an
+    area and never take a fault.
+
+    Save areas are sized from CPUID leaf 0xD after enabling all supported
+    components in XCR0 and allocated on the first kernel_fpu_begin of a
+    thread. Without a thread to save into (interrupt context, interrupts
+    disabled, no scheduler yet) the section runs with interrupts off:
+    whatever is live gets saved to the current thread's area, the clean
+    init state is loaded and TS is set again at the end.
+*/
+
+#define FPU_NO_OWNER		SIZE_MAX
+#define FPU_FCW_OFFSET		0
+#define FPU_MXCSR_OFFSET	24
+
+static fpu_save_mode_t fpu_save_mode = FPU_SAVE_NONE;
+static uint64_t fpu_xcr0 = 0;
+static size_t fpu_state_size = 0;
+static void *fpu_init_state = NULL;	// clean state every area starts from
+
+static DEFINE_PER_CPU(bool, fpu_ready);
+static DEFINE_PER_CPU(size_t, fpu_owner);	// tid whose registers this cpu holds
+static DEFINE_PER_CPU(bool, fpu_atomic_section);
+static DEFINE_PER_CPU(uint64_t, fpu_atomic_rflags);
+
+static DEFINE_PER_CPU(uint64_t, fpu_restores);
+static DEFINE_PER_CPU(uint64_t, fpu_restores_avoided);
+static DEFINE_PER_CPU(uint64_t, fpu_saves);
+static DEFINE_PER_CPU(uint64_t, fpu_atomic_sections);
+
+static const char *fpu_save_mode_names[] =
+{
+    [FPU_SAVE_NONE]	= "none",
+    [FPU_SAVE_FXSAVE]	= "fxsave",
+    [FPU_SAVE_XSAVE]	= "xsave",
+    [FPU_SAVE_XSAVEOPT]	= "xsaveopt"
+};
+
+// the requested-feature mask is all ones, XCR0 limits it to the enabled components
+static inline void fpu_save(void *state)
+{
+    switch (fpu_save_mode)
+    {
+        case FPU_SAVE_XSAVEOPT:
+            asm volatile("xsaveopt64 (%0)" : : "r" (state), "a" (UINT32_MAX), "d" (UINT32_MAX) : "memory");
+            break;
+        case FPU_SAVE_XSAVE:
+            asm volatile("xsave64 (%0)" : : "r" (state), "a" (UINT32_MAX), "d" (UINT32_MAX) : "memory");
+            break;
+        case FPU_SAVE_FXSAVE:
+            asm volatile("fxsave64 (%0)" : : "r" (state) : "memory");
+            break;
+        default:
+            break;
+    }
+}
+
+static inline void fpu_restore(const void *state)
+{
+    switch (fpu_save_mode)
+    {
+        case FPU_SAVE_XSAVEOPT:
+        case FPU_SAVE_XSAVE:
+            asm volatile("xrstor64 (%0)" : : "r" (state), "a" (UINT32_MAX), "d" (UINT32_MAX) : "memory");
+            break;
+        case FPU_SAVE_FXSAVE:
+            asm volatile("fxrstor64 (%0)" : : "r" (state) : "memory");
+            break;
+        default:
+            break;
+    }
+}
+
+// turn on SSE (and XSAVE with all chosen components) on this cpu
+static void fpu_enable(void)
+{
+    write_cr0((read_cr0() & ~(uint64_t)CR0_EM) | CR0_MP | CR0_NE);
+
+    uint64_t cr4 = read_cr4() | CR4_OSFXSR | CR4_OSXMMEXCPT;
+
+    if (fpu_save_mode == FPU_SAVE_XSAVE || fpu_save_mode == FPU_SAVE_XSAVEOPT)
+        cr4 |= CR4_OSXSAVE;
+
+    write_cr4(cr4);
+
+    if (cr4 & CR4_OSXSAVE)
+        xsetbv(XCR0, fpu_xcr0);
+}
+
+// pick the save instruction and the components, build the init state, enable it on the BSP
+bool fpu_init(void)
+{
+    cpuid_registers_t features = {.leaf = CPUID_GET_FEATURES};
+
+    cpuid(&features);
+
+    fpu_save_mode = FPU_SAVE_FXSAVE;
+    fpu_xcr0 = XCR0_X87 | XCR0_SSE;
+
+    if (features.ecx & CPUID_FEAT_ECX_XSAVE)
+    {
+        cpuid_registers_t xsave = {.leaf = CPUID_XSAVE_LEAF, .subleaf = 0};
+
+        cpuid(&xsave);
+
+        uint64_t supported = ((uint64_t)xsave.edx << 32) | xsave.eax;
+
+        if ((features.ecx & CPUID_FEAT_ECX_AVX) && (supported & XCR0_AVX))
+        {
+            fpu_xcr0 |= XCR0_AVX;
+
+            // the three AVX-512 components can only be enabled together
+            if ((supported & XCR0_AVX512) == XCR0_AVX512)
+                fpu_xcr0 |= XCR0_AVX512;
+        }
+
+        cpuid_registers_t xsave_ext = {.leaf = CPUID_XSAVE_LEAF, .subleaf = 1};
+
+        cpuid(&xsave_ext);
+
+        fpu_save_mode = (xsave_ext.eax & CPUID_XSAVE_XSAVEOPT) ? FPU_SAVE_XSAVEOPT : FPU_SAVE_XSAVE;
+    }
+
+    fpu_enable();
+
+    fpu_state_size = FPU_FXSAVE_SIZE;
+
+    if (fpu_save_mode != FPU_SAVE_FXSAVE)
+    {
+        // ebx is the size needed for the components currently enabled in XCR0
+        cpuid_registers_t xsave = {.leaf = CPUID_XSAVE_LEAF, .subleaf = 0};
+
+        cpuid(&xsave);
+
+        fpu_state_size = xsave.ebx;
+    }
+
+    fpu_init_state = kmalloc_aligned(fpu_state_size, FPU_STATE_ALIGN);
+
+    if (!fpu_init_state)
+    {
+        fpu_save_mode = FPU_SAVE_NONE;
+
+        serial_log(ERROR, "Couldn't allocate the initial FPU state\n");
+        kernel_log(ERROR, "Couldn't allocate the initial FPU state\n");
+
+        return false;
+    }
+
+    // an all-zero XSAVE header means init state for every component,
+    // only the control words are always taken from the legacy area
+    memset(fpu_init_state, 0, fpu_state_size);
+    *(uint16_t *)((uint8_t *)fpu_init_state + FPU_FCW_OFFSET) = FPU_DEFAULT_FCW;
+    *(uint32_t *)((uint8_t *)fpu_init_state + FPU_MXCSR_OFFSET) = FPU_DEFAULT_MXCSR;
+
+    fpu_init_cpu();
+
+    serial_log(INFO, "FPU state managed with %s, XCR0: 0x%llx, %d bytes per thread\n",
+               fpu_save_mode_names[fpu_save_mode], fpu_xcr0, fpu_state_size);
+    kernel_log(INFO, "FPU state managed with %s, XCR0: 0x%llx, %d bytes per thread\n",
+               fpu_save_mode_names[fpu_save_mode], fpu_xcr0, fpu_state_size);
+
+    return true;
+}
+
+// enable the FPU on the calling cpu, load the clean state and make the first use trap
+void fpu_init_cpu(void)
+{
+    if (fpu_save_mode == FPU_SAVE_NONE)
+        return;
+
+    fpu_enable();
+
+    clts();
+    fpu_restore(fpu_init_state);
+    stts();
+
+    this_cpu_write(fpu_owner, FPU_NO_OWNER);
+    this_cpu_write(fpu_atomic_section, false);
+    this_cpu_write(fpu_ready, true);
+}
+
+bool fpu_is_available(void)
+{
+    return fpu_save_mode != FPU_SAVE_NONE;
+}
+
+size_t fpu_get_state_size(void)
+{
+    return fpu_state_size;
+}
+
+static bool fpu_alloc_state(thread_t *thread)
+{
+    void *state = kmalloc_aligned(fpu_state_size, FPU_STATE_ALIGN);
+
+    if (!state)
+        return false;
+
+    memcpy(state, fpu_init_state, fpu_state_size);
+    thread->fpu_state = state;
+
+    return true;
+}
+
+// #NM: the running thread touched the FPU while CR0.TS was set
+// -> returns false if it wasn't allowed to, the caller treats it as a fatal exception
+bool fpu_handle_device_not_available(void)
+{
+    if (!this_cpu_read(fpu_ready) || in_interrupt())
+        return false;
+
+    thread_t *thread = thread_current();
+
+    if (!thread || !thread->fpu_state)
+        return false;
+
+    size_t cpu = smp_get_current_cpu();
+
+    clts();
+
+    if (this_cpu_read(fpu_owner) == thread->tid && thread->fpu_cpu == cpu)
+    {
+        this_cpu_inc(fpu_restores_avoided);
+        return true;
+    }
+
+    fpu_restore(thread->fpu_state);
+
+    this_cpu_write(fpu_owner, thread->tid);
+    thread->fpu_cpu = cpu;
+
+    this_cpu_inc(fpu_restores);
+
+    return true;
+}
+
+// called by the scheduler (interrupts off) before switching away from thread
+void fpu_switch_out(thread_t *thread)
+{
+    if (!this_cpu_read(fpu_ready) || (read_cr0() & CR0_TS))
+        return;
+
+    if (thread->fpu_state && thread->state != THREAD_DEAD)
+    {
+        fpu_save(thread->fpu_state);
+        this_cpu_inc(fpu_saves);
+    }
+    else
+    {
+        this_cpu_write(fpu_owner, FPU_NO_OWNER);
+    }
+
+    stts();
+}
+
+void fpu_free_state(thread_t *thread)
+{
+    if (!thread->fpu_state)
+        return;
+
+    kfree(thread->fpu_state);
+    thread->fpu_state = NULL;
+}
+
+// start using FPU/SSE/AVX registers, returns false if that's not possible
+// (too early in boot or nested in another section), the caller has to
+// take a scalar path then
+bool kernel_fpu_begin(void)
+{
+    if (!this_cpu_read(fpu_ready))
+        return false;
+
+    uint64_t rflags = cpu_save_and_disable_interrupts();
+    thread_t *thread = thread_current();
+
+    // a preemptible thread uses it's own area, the registers get saved on every switch away
+    if ((rflags & (1 << 9)) && !in_interrupt() && thread && !thread->is_idle)
+    {
+        cpu_restore_interrupts(rflags);
+
+        if (thread->fpu_state || fpu_alloc_state(thread))
+            return true;
+
+        rflags = cpu_save_and_disable_interrupts();
+    }
+
+    if (this_cpu_read(fpu_atomic_section))
+    {
+        cpu_restore_interrupts(rflags);
+        return false;
+    }
+
+    // someone else's registers can only be live if they belong to the interrupted thread
+    if (!(read_cr0() & CR0_TS))
+    {
+        thread = thread_current();
+
+        if (thread && thread->fpu_state)
+        {
+            fpu_save(thread->fpu_state);
+            this_cpu_inc(fpu_saves);
+        }
+    }
+
+    this_cpu_write(fpu_owner, FPU_NO_OWNER);
+    this_cpu_write(fpu_atomic_rflags, rflags);
+    this_cpu_write(fpu_atomic_section, true);
+    this_cpu_inc(fpu_atomic_sections);
+
+    clts();
+    fpu_restore(fpu_init_state);
+
+    return true;
+}
+
+// end a section started by a successful kernel_fpu_begin
+// -> a thread keeps it's registers live until it gets switched away from
+void kernel_fpu_end(void)
+{
+    if (!this_cpu_read(fpu_atomic_section))
+        return;
+
+    uint64_t rflags = this_cpu_read(fpu_atomic_rflags);
+
+    this_cpu_write(fpu_atomic_section, false);
+    stts();
+
+    cpu_restore_interrupts(rflags);
+}
+
+// copy with 16 byte SSE2 moves, only between kernel_fpu_begin and kernel_fpu_end
+// -> the target attribute lets the asm name xmm registers despite -mno-sse
+__attribute__((target("sse2")))
+void memcpy_sse2(void *dest, const void *src, size_t n)
+{
+    uint8_t *d = dest;
+    const uint8_t *s = src;
+
+    for (; n >= 64; n -= 64, d += 64, s += 64)
+    {
+        asm volatile("movdqu 0(%1), %%xmm0\n\t"
+                     "movdqu 16(%1), %%xmm1\n\t"
+                     "movdqu 32(%1), %%xmm2\n\t"
+                     "movdqu 48(%1), %%xmm3\n\t"
+                     "movdqu %%xmm0, 0(%0)\n\t"
+                     "movdqu %%xmm1, 16(%0)\n\t"
+                     "movdqu %%xmm2, 32(%0)\n\t"
+                     "movdqu %%xmm3, 48(%0)"
+                     : : "r" (d), "r" (s) : "memory", "xmm0", "xmm1", "xmm2", "xmm3");
+    }
+
+    if (n)
+        memcpy(d, s, n);
+}
+
+void fpu_print_info(void)
+{
+    printk(GFX_CYAN, "Save mode: %s, XCR0: 0x%llx, state: %d bytes\n",
+           fpu_save_mode_names[fpu_save_mode], fpu_xcr0, fpu_state_size);
+
+    printk(GFX_CYAN, "%-5s %-12s %-12s %-12s %-12s\n", "cpu", "restores", "avoided", "saves", "atomic");
+
+    for (size_t i = 0; i < smp_cpu_count; i++)
+    {
+        printk(GFX_WHITE, "%-5d %-12llu %-12llu %-12llu %-12llu\n", i,
+               *per_cpu_ptr(fpu_restores, i), *per_cpu_ptr(fpu_restores_avoided, i),
+               *per_cpu_ptr(fpu_saves, i), *per_cpu_ptr(fpu_atomic_sections, i));
+    }
+}
@@ -0,0 +1,76 @@
+/*
+	This file is part of an x86_64 hobbyist operating system called KnutOS
+	Everything is openly developed on GitHub: https://github.com/Tix3Dev/KnutOS/
+
+	Copyright (C) 2021-2022  Yves Vollmeier <https://github.com/Tix3Dev>
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifndef FPU_H
+#define FPU_H
+
+#define CR0_MP			(1 << 1)	// wait/fwait honour CR0.TS
+#define CR0_EM			(1 << 2)	// emulate the x87, has to be off
+#define CR0_TS			(1 << 3)	// task switched -> FPU/SSE instructions raise #NM
+#define CR0_NE			(1 << 5)	// report x87 errors as #MF instead of IRQ 13
+
+#define CR4_OSFXSR		(1 << 9)
+#define CR4_OSXMMEXCPT		(1 << 10)
+#define CR4_OSXSAVE		(1 << 18)
+
+#define XCR0			0
+#define XCR0_X87		(1 << 0)
+#define XCR0_SSE		(1 << 1)
+#define XCR0_AVX		(1 << 2)
+#define XCR0_AVX512		(7 << 5)	// opmask, upper halves of zmm0-15, zmm16-31
+
+#define CPUID_XSAVE_LEAF	0xD
+#define CPUID_XSAVE_XSAVEOPT	(1 << 0)	// subleaf 1, eax
+
+#define FPU_FXSAVE_SIZE		512
+#define FPU_XSAVE_HEADER_SIZE	64		// follows the legacy area
+#define FPU_STATE_ALIGN		64
+#define FPU_DEFAULT_FCW		0x037F		// all x87 exceptions masked, extended precision
+#define FPU_DEFAULT_MXCSR	0x1F80		// all SSE exceptions masked, round to nearest
+
+#define FPU_NM_VECTOR		7
+
+struct thread;
+
+typedef enum
+{
+    FPU_SAVE_NONE,	// fpu_init didn't run (yet)
+    FPU_SAVE_FXSAVE,
+    FPU_SAVE_XSAVE,
+    FPU_SAVE_XSAVEOPT
+} fpu_save_mode_t;
+
+bool fpu_init(void);
+void fpu_init_cpu(void);
+bool fpu_is_available(void);
+size_t fpu_get_state_size(void);
+
+bool fpu_handle_device_not_available(void);
+void fpu_switch_out(struct thread *thread);
+void fpu_free_state(struct thread *thread);
+
+bool kernel_fpu_begin(void);
+void kernel_fpu_end(void);
+void memcpy_sse2(void *dest, const void *src, size_t n);
+
+void fpu_print_info(void);
+
+#endif
@@ -16,11 +16,14 @@
 */
 
 #include <stdarg.h>
+#include <stdbool.h>
 #include <stddef.h>
 
 #include <boot/stivale2.h>
 #include <boot/stivale2_boot.h>
+#include <devices/cpu/fpu.h>
 #include <devices/framebuffer/framebuffer.h>
+#include <libk/string/string.h>
 // #include <libk/log/log.h>
 
 #define SSFN_CONSOLEBITMAP_TRUECOLOR	// use the special renderer for 32 bit truecolor packed pixels
@@ -217,19 +220,33 @@ void framebuffer_draw_circle(int x_center, int y_center, int radius, uint32_t co
 // memmove the screen by one 'glyph height'
 void framebuffer_move_one_row_up(void)
 {
-    uint32_t *fb = (uint32_t *)gfx.fb_addr;
+    uint8_t *fb = (uint8_t *)gfx.fb_addr;
+    size_t row_size = gfx.fb_width * sizeof(uint32_t);
+
+    // whole rows at once, with SSE2 if it's usable here
+    bool simd = kernel_fpu_begin();
 
-    for (int column = gfx.glyph_height; column < gfx.fb_height; column++)
+    for (int y = gfx.glyph_height; y < gfx.fb_height; y++)
     {
-        for (int row = 0; row < gfx.fb_width; row++)
-        {
-            size_t current_index = column * (gfx.fb_pitch / sizeof(uint32_t)) + row;
-            uint32_t current_color = fb[current_index];
-            fb[current_index] = ssfn_dst.bg;
+        uint8_t *src = fb + y * gfx.fb_pitch;
+        uint8_t *dest = fb + (y - gfx.glyph_height) * gfx.fb_pitch;
 
-            size_t new_index = (column - gfx.glyph_height) * (gfx.fb_pitch / sizeof(uint32_t)) + row;
-            fb[new_index] = current_color;
-        }
+        if (simd)
+            memcpy_sse2(dest, src, row_size);
+        else
+            memcpy(dest, src, row_size);
+    }
+
+    if (simd)
+        kernel_fpu_end();
+
+    // the rows at the bottom that got free
+    for (int y = gfx.fb_height - gfx.glyph_height; y < gfx.fb_height; y++)
+    {
+        uint32_t *row = (uint32_t *)(fb + y * gfx.fb_pitch);
+
+        for (int x = 0; x < gfx.fb_width; x++)
+            row[x] = ssfn_dst.bg;
     }
 }
 
@@ -0,0 +1,280 @@
+/*
+	This file is part of an x86_64 hobbyist operating system called KnutOS
+	Everything is openly developed on GitHub: https://github.com/Tix3Dev/KnutOS/
+
+	Copyright (C) 2021-2022  Yves Vollmeier <https://github.com/Tix3Dev>
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <boot/stivale2.h>
+#include <devices/apic/apic.h>
+#include <devices/hpet/hpet.h>
+#include <firmware/acpi/acpi.h>
+#include <firmware/acpi/tables/hpet.h>
+#include <memory/mem.h>
+#include <memory/vmm.h>
+#include <libk/log/log.h>
+#include <libk/stdio/stdio.h>
+
+/*  Explanation of the HPET:
+    The high precision event timer is a free running up-counter with a
+    fixed frequency of at least 10 MHz, plus a number of comparators that
+    fire once the counter reaches their value. It's found through the
+    ACPI "HPET" table, which holds the physical address of a 1 KiB MMIO
+    register block. The block is already covered by the higher half
+    mapping of the first 4 GiB, but that one is write-back cached, so the
+    page is remapped with caching disabled before anything is read.
+
+    The capabilities register reports the counter period in femtoseconds,
+    how many comparators exist and whether the counter is 64 bit wide. A
+    read of the main counter is a single (uncached) MMIO load, slower than
+    rdtsc but constant in rate regardless of P- and C-states, which makes
+    it a good calibration reference and a fallback clocksource.
+
+    Comparators are used in one-shot mode. Without an interrupt vector
+    they're only polled through hpet_timer_expired. With one, the
+    interrupt is delivered as an MSI (FSB delivery) straight to the
+    LAPIC of the arming cpu, as the IO APIC redirection table isn't
+    programmed by the kernel.
+*/
+
+static uintptr_t hpet_base = 0;
+static uint64_t	hpet_frequency = 0;
+static uint64_t	hpet_period_fs = 0;
+static uint64_t	ticks_to_ns_mult = 0;
+static uint64_t	ns_to_ticks_mult = 0;
+static uint8_t	hpet_timer_count = 0;
+static bool	hpet_64bit = false;
+
+static uint64_t hpet_timer_deadline[HPET_MAX_TIMERS];
+
+static inline uint64_t hpet_read_register(uint32_t reg)
+{
+    return *((volatile uint64_t *)(hpet_base + reg));
+}
+
+static inline void hpet_write_register(uint32_t reg, uint64_t data)
+{
+    *((volatile uint64_t *)(hpet_base + reg)) = data;
+}
+
+// find the HPET, map it uncached and start the main counter
+bool hpet_init(void)
+{
+    hpet_table_t *hpet_table = (hpet_table_t *)acpi_find_sdt_table("HPET");
+
+    if (!hpet_table || hpet_table->header.length < sizeof(hpet_table_t))
+    {
+        serial_log(WARNING, "No HPET found\n");
+        kernel_log(WARNING, "No HPET found\n");
+
+        return false;
+    }
+
+    if (hpet_table->address.address_space_id != ACPI_ADDRESS_SPACE_SYSTEM_MEMORY)
+    {
+        serial_log(WARNING, "HPET isn't memory mapped, ignoring it\n");
+        kernel_log(WARNING, "HPET isn't memory mapped, ignoring it\n");
+
+        return false;
+    }
+
+    uintptr_t physical_address = hpet_table->address.address;
+
+    hpet_base = phys_to_higher_half_data(physical_address);
+    vmm_map_page(vmm_get_kernel_page_directory(), physical_address, hpet_base,
+                 PTE_PRESENT | PTE_READ_WRITE | PTE_WRITE_THROUGH | PTE_CHACHE_DISABLED);
+
+    uint64_t capabilities = hpet_read_register(HPET_CAPABILITIES_REGISTER);
+
+    hpet_period_fs = HPET_CAP_PERIOD_FS(capabilities);
+
+    if (hpet_period_fs == 0 || hpet_period_fs > HPET_MAX_PERIOD_FS)
+    {
+        serial_log(WARNING, "HPET reports an invalid period of %llu fs, ignoring it\n", hpet_period_fs);
+        kernel_log(WARNING, "HPET reports an invalid period of %llu fs, ignoring it\n", hpet_period_fs);
+
+        hpet_base = 0;
+
+        return false;
+    }
+
+    hpet_frequency = 1000000000000000ULL / hpet_period_fs;
+    hpet_64bit = capabilities & HPET_CAP_COUNT_SIZE_64;
+    hpet_timer_count = HPET_CAP_NUM_TIMERS(capabilities);
+
+    if (hpet_timer_count > HPET_MAX_TIMERS)
+        hpet_timer_count = HPET_MAX_TIMERS;
+
+    // 1 ns = 10^6 fs, both factors fit into 64 bit before the shift
+    ticks_to_ns_mult = (hpet_period_fs << HPET_SHIFT) / 1000000;
+    ns_to_ticks_mult = (1000000ULL << HPET_SHIFT) / hpet_period_fs;
+
+    // stop the counter, no legacy replacement routing, no comparator interrupts
+    hpet_write_register(HPET_CONFIG_REGISTER, 0);
+
+    for (uint8_t i = 0; i < hpet_timer_count; i++)
+    {
+        uint64_t config = hpet_read_register(HPET_TIMER_CONFIG_REGISTER(i));
+
+        config &= ~(HPET_TIMER_INTERRUPT_ENABLE | HPET_TIMER_PERIODIC | HPET_TIMER_FSB_ENABLE);
+        hpet_write_register(HPET_TIMER_CONFIG_REGISTER(i), config);
+    }
+
+    hpet_write_register(HPET_MAIN_COUNTER_REGISTER, 0);
+    hpet_write_register(HPET_CONFIG_REGISTER, HPET_CONFIG_ENABLE);
+
+    serial_log(INFO, "HPET initialized: %llu kHz, %s bit counter, %u comparators\n",
+               hpet_frequency / 1000, hpet_64bit ? "64" : "32", hpet_timer_count);
+    kernel_log(INFO, "HPET initialized: %llu kHz, %s bit counter, %u comparators\n",
+               hpet_frequency / 1000, hpet_64bit ? "64" : "32", hpet_timer_count);
+
+    return true;
+}
+
+bool hpet_is_available(void)
+{
+    return hpet_base != 0;
+}
+
+uint64_t hpet_read_counter(void)
+{
+    return hpet_read_register(HPET_MAIN_COUNTER_REGISTER);
+}
+
+uint64_t hpet_get_frequency(void)
+{
+    return hpet_frequency;
+}
+
+uint64_t hpet_ticks_to_ns(uint64_t ticks)
+{
+    return ((unsigned __int128)ticks * ticks_to_ns_mult) >> HPET_SHIFT;
+}
+
+uint64_t hpet_ns_to_ticks(uint64_t ns)
+{
+    return ((unsigned __int128)ns * ns_to_ticks_mult) >> HPET_SHIFT;
+}
+
+// a 32 bit counter wraps after ~5 minutes at 14.3 MHz
+bool hpet_counter_is_64bit(void)
+{
+    return hpet_64bit;
+}
+
+// busy wait for at least ns nanoseconds
+void hpet_spin_ns(uint64_t ns)
+{
+    uint64_t mask = hpet_64bit ? UINT64_MAX : UINT32_MAX;
+    uint64_t start = hpet_read_counter();
+    uint64_t ticks = hpet_ns_to_ticks(ns);
+
+    while (((hpet_read_counter() - start) & mask) < ticks)
+        asm volatile("pause");
+}
+
+uint8_t hpet_get_timer_count(void)
+{
+    return hpet_timer_count;
+}
+
+// fire comparator timer once in ns nanoseconds
+// -> vector 0 means no interrupt, only poll it with hpet_timer_expired
+// -> returns false if the comparator doesn't exist or can't deliver the interrupt
+bool hpet_timer_arm_oneshot(uint8_t timer, uint8_t vector, uint64_t ns)
+{
+    if (!hpet_base || timer >= hpet_timer_count)
+        return false;
+
+    uint64_t config = hpet_read_register(HPET_TIMER_CONFIG_REGISTER(timer));
+
+    if (vector && !(config & HPET_TIMER_FSB_CAPABLE))
+        return false;
+
+    // edge triggered, one-shot, disabled while the comparator changes
+    config &= ~(HPET_TIMER_LEVEL_TRIGGERED | HPET_TIMER_INTERRUPT_ENABLE | HPET_TIMER_PERIODIC |
+                HPET_TIMER_FSB_ENABLE);
+    hpet_write_register(HPET_TIMER_CONFIG_REGISTER(timer), config);
+
+    uint64_t ticks = hpet_ns_to_ticks(ns);
+
+    if (ticks < HPET_TIMER_MIN_TICKS)
+        ticks = HPET_TIMER_MIN_TICKS;
+
+    uint64_t deadline = hpet_read_counter() + ticks;
+
+    hpet_timer_deadline[timer] = deadline;
+    hpet_write_register(HPET_TIMER_COMPARATOR_REGISTER(timer), deadline);
+
+    if (vector)
+    {
+        // low half is the MSI data (the vector), high half the MSI address
+        hpet_write_register(HPET_TIMER_FSB_ROUTE_REGISTER(timer),
+                            ((uint64_t)(HPET_MSI_ADDRESS | (lapic_get_id() << 12)) << 32) | vector);
+        hpet_write_register(HPET_TIMER_CONFIG_REGISTER(timer),
+                            config | HPET_TIMER_FSB_ENABLE | HPET_TIMER_INTERRUPT_ENABLE);
+    }
+
+    return true;
+}
+
+// whether the main counter passed the comparator value of the last arm
+bool hpet_timer_expired(uint8_t timer)
+{
+    if (!hpet_base || timer >= hpet_timer_count)
+        return true;
+
+    uint64_t elapsed = hpet_read_counter() - hpet_timer_deadline[timer];
+
+    if (hpet_64bit)
+        return (int64_t)elapsed >= 0;
+
+    return (int32_t)(uint32_t)elapsed >= 0;
+}
+
+void hpet_timer_disarm(uint8_t timer)
+{
+    if (!hpet_base || timer >= hpet_timer_count)
+        return;
+
+    uint64_t config = hpet_read_register(HPET_TIMER_CONFIG_REGISTER(timer));
+
+    config &= ~(HPET_TIMER_INTERRUPT_ENABLE | HPET_TIMER_FSB_ENABLE);
+    hpet_write_register(HPET_TIMER_CONFIG_REGISTER(timer), config);
+}
+
+void hpet_print_info(void)
+{
+    if (!hpet_base)
+    {
+        printk(GFX_WHITE, "HPET: not available\n");
+
+        return;
+    }
+
+    printk(GFX_WHITE, "HPET: %llu kHz (%llu fs period), %s bit counter, %u comparators\n",
+           hpet_frequency / 1000, hpet_period_fs, hpet_64bit ? "64" : "32", hpet_timer_count);
+
+    for (uint8_t i = 0; i < hpet_timer_count; i++)
+    {
+        uint64_t config = hpet_read_register(HPET_TIMER_CONFIG_REGISTER(i));
+
+        printk(GFX_WHITE, "  comparator %u: %s bit%s%s\n", i,
+               config & HPET_TIMER_SIZE_64 ? "64" : "32",
+               config & HPET_TIMER_PERIODIC_CAPABLE ? ", periodic" : "",
+               config & HPET_TIMER_FSB_CAPABLE ? ", fsb" : "");
+    }
+}
@@ -0,0 +1,70 @@
+/*
+	This file is part of an x86_64 hobbyist operating system called KnutOS
+	Everything is openly developed on GitHub: https://github.com/Tix3Dev/KnutOS/
+
+	Copyright (C) 2021-2022  Yves Vollmeier <https://github.com/Tix3Dev>
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifndef HPET_H
+#define HPET_H
+
+#define HPET_CAPABILITIES_REGISTER	0x000
+#define HPET_CONFIG_REGISTER		0x010
+#define HPET_INTERRUPT_STATUS_REGISTER	0x020
+#define HPET_MAIN_COUNTER_REGISTER	0x0F0
+#define HPET_TIMER_CONFIG_REGISTER(n)	(0x100 + 0x20 * (n))
+#define HPET_TIMER_COMPARATOR_REGISTER(n)	(0x108 + 0x20 * (n))
+#define HPET_TIMER_FSB_ROUTE_REGISTER(n)	(0x110 + 0x20 * (n))
+
+#define HPET_CAP_COUNT_SIZE_64		(1 << 13)
+#define HPET_CAP_NUM_TIMERS(cap)	((((cap) >> 8) & 0x1F) + 1)
+#define HPET_CAP_PERIOD_FS(cap)		((cap) >> 32)	    // counter period in femtoseconds
+#define HPET_MAX_PERIOD_FS		100000000	    // 100 ns, upper limit by the spec
+
+#define HPET_CONFIG_ENABLE		(1 << 0)
+#define HPET_CONFIG_LEGACY_ROUTE	(1 << 1)
+
+#define HPET_TIMER_LEVEL_TRIGGERED	(1 << 1)
+#define HPET_TIMER_INTERRUPT_ENABLE	(1 << 2)
+#define HPET_TIMER_PERIODIC		(1 << 3)
+#define HPET_TIMER_PERIODIC_CAPABLE	(1 << 4)
+#define HPET_TIMER_SIZE_64		(1 << 5)
+#define HPET_TIMER_FORCE_32		(1 << 8)
+#define HPET_TIMER_FSB_ENABLE		(1 << 14)
+#define HPET_TIMER_FSB_CAPABLE		(1 << 15)
+
+#define HPET_MAX_TIMERS			32
+#define HPET_MSI_ADDRESS		0xFEE00000	    // MSI writes go to the LAPIC of the destination id
+#define HPET_SHIFT			32		    // fixed point shift of the conversion factor
+#define HPET_TIMER_MIN_TICKS		16		    // closer deadlines may pass before the comparator is written
+
+bool hpet_init(void);
+bool hpet_is_available(void);
+uint64_t hpet_read_counter(void);
+uint64_t hpet_get_frequency(void);
+uint64_t hpet_ticks_to_ns(uint64_t ticks);
+uint64_t hpet_ns_to_ticks(uint64_t ns);
+bool hpet_counter_is_64bit(void);
+void hpet_spin_ns(uint64_t ns);
+
+uint8_t hpet_get_timer_count(void);
+bool hpet_timer_arm_oneshot(uint8_t timer, uint8_t vector, uint64_t ns);
+bool hpet_timer_expired(uint8_t timer);
+void hpet_timer_disarm(uint8_t timer);
+
+void hpet_print_info(void);
+
+#endif
@@ -0,0 +1,60 @@
+/*
+	This file is part of an x86_64 hobbyist operating system called KnutOS
+	Everything is openly developed on GitHub: https://github.com/Tix3Dev/KnutOS/
+
+	Copyright (C) 2021-2022  Yves Vollmeier <https://github.com/Tix3Dev>
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <stdint.h>
+
+#include <devices/pit/pit.h>
+#include <libk/io/io.h>
+
+// the PIT is only used as a known reference to calibrate other timers
+// channel 2 is used, as it can be polled through port 0x61 without an IRQ
+
+// arm channel 2 in mode 0 (interrupt on terminal count) for microseconds
+// -> longer durations get capped to PIT_MAX_ONESHOT_US
+void pit_oneshot_start(uint32_t microseconds)
+{
+    if (microseconds > PIT_MAX_ONESHOT_US)
+        microseconds = PIT_MAX_ONESHOT_US;
+
+    uint32_t count = (uint64_t)PIT_FREQUENCY * microseconds / 1000000;
+
+    // gate low and speaker off, so the counter waits for the rising edge
+    io_outb(PIT_CHANNEL2_GATE, io_inb(PIT_CHANNEL2_GATE) & ~0x3);
+
+    // channel 2, lobyte/hibyte, mode 0, binary
+    io_outb(PIT_COMMAND, 0xB0);
+    io_outb(PIT_CHANNEL2_DATA, count & 0xFF);
+    io_outb(PIT_CHANNEL2_DATA, (count >> 8) & 0xFF);
+
+    // rising edge on the gate starts counting
+    io_outb(PIT_CHANNEL2_GATE, io_inb(PIT_CHANNEL2_GATE) | 0x1);
+}
+
+// the output of channel 2 goes high once the count reached zero
+uint8_t pit_oneshot_expired(void)
+{
+    return io_inb(PIT_CHANNEL2_GATE) & 0x20;
+}
+
+// busy wait, only meant for early calibration
+void pit_sleep_us(uint32_t microseconds)
+{
+    pit_oneshot_start(microseconds);
+
+    while (!pit_oneshot_expired())
+        asm volatile("pause");
+}
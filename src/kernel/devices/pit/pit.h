@@ -0,0 +1,34 @@
+/*
+	This file is part of an x86_64 hobbyist operating system called KnutOS
+	Everything is openly developed on GitHub: https://github.com/Tix3Dev/KnutOS/
+
+	Copyright (C) 2021-2022  Yves Vollmeier <https://github.com/Tix3Dev>
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <stdint.h>
+
+#ifndef PIT_H
+#define PIT_H
+
+#define PIT_FREQUENCY		1193182	    // input clock of the PIT in Hz
+#define PIT_CHANNEL2_DATA	0x42	    // channel 2 data port (PC speaker channel)
+#define PIT_COMMAND		0x43	    // mode / command register
+#define PIT_CHANNEL2_GATE	0x61	    // bit 0: channel 2 gate, bit 1: speaker, bit 5: channel 2 output
+
+#define PIT_MAX_ONESHOT_US	54925	    // 16 bit counter at PIT_FREQUENCY
+
+void pit_oneshot_start(uint32_t microseconds);
+uint8_t pit_oneshot_expired(void);
+void pit_sleep_us(uint32_t microseconds);
+
+#endif
@@ -18,18 +18,32 @@
 // The standard_keycodes array + the KEY enum is from this tutorial:
 // http://www.brokenthorn.com/Resources/OSDev19.html
 
+#include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 
 #include <boot/stivale2.h>
 #include <devices/pic/pic.h>
 #include <devices/ps2/keyboard/keyboard.h>
+#include <scheduler/workqueue.h>
 #include <libk/io/io.h>
+#include <libk/lock/spinlock.h>
 #include <libk/log/log.h>
 
 static uint8_t is_keyboard_active = 0;	// boolean whether keyboard IRQ should get processed
 
 static void (*final_handler)(KEY_INFO_t);
 
+// scancodes read by the IRQ handler, decoded by keyboard_work on a worker thread
+static uint8_t	    scancode_queue[KB_SCANCODE_QUEUE_SIZE];
+static size_t	    scancode_head = 0;
+static size_t	    scancode_tail = 0;
+static spinlock_t   scancode_lock = SPINLOCK_INIT("keyboard scancodes");
+static work_t	    keyboard_work;
+
+static void keyboard_process_scancode(uint8_t scancode);
+static void keyboard_work_func(void *arg);
+
 static uint32_t standard_keycodes[] =
 {
 //  key			scancode
@@ -139,6 +153,8 @@ void keyboard_init(void)
     // enable scanning (so that the keyboard will send scan codes)
     keyboard_send_command(0xF4);
 
+    work_init(&keyboard_work, keyboard_work_func, NULL);
+
     serial_log(INFO, "Keyboard driver initialized\n");
     kernel_log(INFO, "Keyboard driver initialized\n");
 }
@@ -152,6 +168,7 @@ void keyboard_send_command(uint8_t command_byte)
 }
 
 // gets called whenever a keyboard IRQ occurrs
+// -> only reads the scancode and defers everything else to keyboard_work
 void keyboard_irq_handler(void)
 {
     // read from keyboard controller so that in any case it will be able to send more IRQs
@@ -161,6 +178,40 @@ void keyboard_irq_handler(void)
     if (!is_keyboard_active)
         return;
 
+    spinlock_acquire(&scancode_lock);
+
+    if (scancode_tail - scancode_head < KB_SCANCODE_QUEUE_SIZE)
+        scancode_queue[scancode_tail++ % KB_SCANCODE_QUEUE_SIZE] = scancode;
+
+    spinlock_release(&scancode_lock);
+
+    schedule_work(&keyboard_work);
+}
+
+// decode every queued scancode and pass the keys on, runs on a worker thread
+static void keyboard_work_func(void *arg)
+{
+    (void)arg;
+
+    for (;;)
+    {
+        uint64_t rflags = spinlock_acquire_irqsave(&scancode_lock);
+
+        bool has_scancode = scancode_head != scancode_tail;
+        uint8_t scancode = has_scancode ? scancode_queue[scancode_head++ % KB_SCANCODE_QUEUE_SIZE] : 0;
+
+        spinlock_release_irqrestore(&scancode_lock, rflags);
+
+        if (!has_scancode)
+            break;
+
+        keyboard_process_scancode(scancode);
+    }
+}
+
+// keep track of the modifier keys and hand the key to the final handler
+static void keyboard_process_scancode(uint8_t scancode)
+{
     KEY_INFO_t key_info;
 
     key_info.keycode		= KEY_UNKNOWN;
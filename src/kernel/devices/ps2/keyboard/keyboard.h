@@ -25,6 +25,7 @@
 
 #define KB_CONTROLLER_DATA	0x60 // keyboard controller data register
 #define KB_CONTROLLER_COMMAND	0x64 // keyboard controller command register
+#define KB_SCANCODE_QUEUE_SIZE	128  // scancodes buffered between the IRQ and the worker
 
 typedef enum {
 	KEY_SPACE		= ' ',
@@ -15,14 +15,27 @@
 	along with this program.  If not, see <https://www.gnu.org/licenses/>.
 */
 
+#include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 
 // #include <boot/stivale2.h>
+#include <devices/pic/pic.h>
 #include <devices/serial/serial.h>
+#include <scheduler/wait.h>
 #include <libk/io/io.h>
+#include <libk/lock/spinlock.h>
 // #include <libk/log/log.h>
 // #include <libk/stdio/stdio.h>
 
+// bytes read by the IRQ handler, serial_recv sleeps on serial_rx_wait while it's empty
+static char	    serial_rx_buffer[SERIAL_RX_BUFFER_SIZE];
+static size_t	    serial_rx_head = 0;
+static size_t	    serial_rx_tail = 0;
+static spinlock_t   serial_rx_lock = SPINLOCK_INIT("serial rx");
+static wait_queue_t serial_rx_wait = WAIT_QUEUE_INIT("serial rx wait");
+static bool	    serial_rx_irq_enabled = false;
+
 // set COM1 offsets to init value
 void serial_init(void)
 {
@@ -44,9 +57,60 @@ int is_serial_received(void)
     return io_inb(COM1 + 5) & 1;
 }
 
-// read data from COM1
+// let COM1 raise an IRQ for every received byte instead of polling for it
+// -> needs the scheduler, serial_recv sleeps from now on
+void serial_enable_receive_irq(void)
+{
+    serial_rx_irq_enabled = true;
+
+    io_outb(COM1 + 1, 0x01);	// interrupt enable register: data available
+    pic_clear_mask(SERIAL_IRQ);
+}
+
+// buffer everything the UART received and wake up the readers
+void serial_irq_handler(void)
+{
+    spinlock_acquire(&serial_rx_lock);
+
+    while (is_serial_received())
+    {
+        char c = io_inb(COM1);
+
+        if (serial_rx_tail - serial_rx_head < SERIAL_RX_BUFFER_SIZE)
+            serial_rx_buffer[serial_rx_tail++ % SERIAL_RX_BUFFER_SIZE] = c;
+    }
+
+    spinlock_release(&serial_rx_lock);
+
+    wake_up_all(&serial_rx_wait);
+}
+
+static bool serial_rx_pop(char *c)
+{
+    uint64_t rflags = spinlock_acquire_irqsave(&serial_rx_lock);
+
+    bool has_data = serial_rx_head != serial_rx_tail;
+
+    if (has_data)
+        *c = serial_rx_buffer[serial_rx_head++ % SERIAL_RX_BUFFER_SIZE];
+
+    spinlock_release_irqrestore(&serial_rx_lock, rflags);
+
+    return has_data;
+}
+
+// read data from COM1, sleeps until there is some once the receive IRQ is enabled
 char serial_recv(void)
 {
+    char c;
+
+    if (serial_rx_irq_enabled)
+    {
+        wait_event(&serial_rx_wait, serial_rx_pop(&c));
+
+        return c;
+    }
+
     while (is_serial_received() == 0);
 
     return io_inb(COM1);
@@ -20,6 +20,9 @@
 
 #define COM1 0x3f8
 
+#define SERIAL_IRQ		4	// COM1 on the PIC
+#define SERIAL_RX_BUFFER_SIZE	256	// received bytes buffered until serial_recv
+
 // bash color codes
 #define TERM_BLACK	    "\e[0;30m"
 #define TERM_RED	    "\e[0;31m"
@@ -32,6 +35,8 @@
 #define TERM_COLOR_RESET    "\e[0m"
 
 void serial_init(void);
+void serial_enable_receive_irq(void);
+void serial_irq_handler(void);
 char serial_recv(void);
 void serial_send_char(char c);
 void serial_send_string(char *str);
@@ -21,10 +21,33 @@ typedef struct {
     uint32_t pm1b_evt_blk;
     uint32_t pm1a_cnt_blk;
     uint32_t pm1b_cnt_blk;
-    // ... (other fields omitted for brevity)
-    uint16_t pm1_evt_len;
-    uint16_t pm1_cnt_len;
+    uint32_t pm2_cnt_blk;
+    uint32_t pm_tmr_blk;        // I/O port of the ACPI PM timer, 0 if there is none
+    uint32_t gpe0_blk;
+    uint32_t gpe1_blk;
+    uint8_t pm1_evt_len;
+    uint8_t pm1_cnt_len;
+    uint8_t pm2_cnt_len;
+    uint8_t pm_tmr_len;         // 4 if the PM timer is supported
+    uint8_t gpe0_blk_len;
+    uint8_t gpe1_blk_len;
+    uint8_t gpe1_base;
+    uint8_t cst_cnt;
+    uint16_t p_lvl2_lat;
+    uint16_t p_lvl3_lat;
+    uint16_t flush_size;
+    uint16_t flush_stride;
+    uint8_t duty_offset;
+    uint8_t duty_width;
+    uint8_t day_alrm;
+    uint8_t mon_alrm;
+    uint8_t century;
+    uint16_t iapc_boot_arch;
+    uint8_t reserved2;
+    uint32_t flags;
     // ... (add more fields as needed)
 } __attribute__((packed)) fadt_t;
 
+#define FADT_FLAG_TMR_VAL_EXT   (1 << 8)    // PM timer is 32 bit instead of 24 bit
+
 #endif // FADT_H
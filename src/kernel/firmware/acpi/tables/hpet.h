@@ -0,0 +1,48 @@
+/*
+	This file is part of an x86_64 hobbyist operating system called KnutOS
+	Everything is openly developed on GitHub: https://github.com/Tix3Dev/KnutOS/
+
+	Copyright (C) 2021-2022  Yves Vollmeier <https://github.com/Tix3Dev>
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <stdint.h>
+
+#include <firmware/acpi/tables/sdth.h>
+
+#ifndef HPET_TABLE_H
+#define HPET_TABLE_H
+
+#define ACPI_ADDRESS_SPACE_SYSTEM_MEMORY    0
+#define ACPI_ADDRESS_SPACE_SYSTEM_IO	    1
+
+// generic address structure, used by ACPI to describe register blocks
+typedef struct __attribute__((__packed__))
+{
+    uint8_t address_space_id;	// ACPI_ADDRESS_SPACE_*
+    uint8_t register_bit_width;
+    uint8_t register_bit_offset;
+    uint8_t reserved;
+    uint64_t address;
+} acpi_generic_address_t;
+
+typedef struct __attribute__((__packed__))
+{
+    sdt_header_t header;
+    uint32_t event_timer_block_id;  // hardware revision, comparator count, vendor id
+    acpi_generic_address_t address; // base of the MMIO register block
+    uint8_t hpet_number;
+    uint16_t minimum_tick;	    // minimum periodic tick in counter ticks
+    uint8_t page_protection;
+} hpet_table_t;
+
+#endif
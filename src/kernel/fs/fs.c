@@ -1,70 +1,131 @@
 #include "fs.h"
+#include <scheduler/mutex.h>
+#include <scheduler/rcu.h>
 #include <libk/string/string.h>
+#include <libk/alloc/kmalloc.h>
 
-fs_file_t fs_files[FS_MAX_FILES] = {0};
+// readers (fs_read, fs_list, fs_exists) only take rcu_read_lock, writers
+// serialize on fs_lock, publish a new file and free the old one after a grace period
+fs_file_t *fs_files[FS_MAX_FILES] = {0};
 
-int fs_create(const char *name) {
-    if (fs_exists(name)) return -1;
+static mutex_t fs_lock = MUTEX_INIT("fs");
+
+static void fs_free_file(rcu_head_t *head) {
+    kfree(container_of(head, fs_file_t, rcu));
+}
+
+// slot of a file, -1 if there is none (fs_lock held)
+static int fs_find(const char *name) {
+    for (int i = 0; i < FS_MAX_FILES; ++i)
+        if (fs_files[i] && strcmp(fs_files[i]->name, name) == 0)
+            return i;
+    return -1;
+}
+
+// file or NULL, only valid until rcu_read_unlock
+static fs_file_t *fs_lookup(const char *name) {
     for (int i = 0; i < FS_MAX_FILES; ++i) {
-        if (!fs_files[i].used) {
-            strncpy(fs_files[i].name, name, FS_MAX_FILENAME-1);
-            fs_files[i].name[FS_MAX_FILENAME-1] = 0;
-            fs_files[i].size = 0;
-            fs_files[i].used = 1;
-            return 0;
+        fs_file_t *file = rcu_dereference(fs_files[i]);
+        if (file && strcmp(file->name, name) == 0)
+            return file;
+    }
+    return NULL;
+}
+
+int fs_create(const char *name) {
+    int ret = -1;
+    mutex_lock(&fs_lock);
+    if (fs_find(name) < 0) {
+        for (int i = 0; i < FS_MAX_FILES; ++i) {
+            if (!fs_files[i]) {
+                fs_file_t *file = kmalloc(sizeof(fs_file_t));
+                if (!file) break;
+                strncpy(file->name, name, FS_MAX_FILENAME-1);
+                file->name[FS_MAX_FILENAME-1] = 0;
+                file->size = 0;
+                rcu_assign_pointer(fs_files[i], file);
+                ret = 0;
+                break;
+            }
         }
     }
-    return -1;
+    mutex_unlock(&fs_lock);
+    return ret;
 }
 
 int fs_delete(const char *name) {
-    for (int i = 0; i < FS_MAX_FILES; ++i) {
-        if (fs_files[i].used && strcmp(fs_files[i].name, name) == 0) {
-            fs_files[i].used = 0;
-            return 0;
-        }
+    mutex_lock(&fs_lock);
+    int i = fs_find(name);
+    if (i >= 0) {
+        fs_file_t *file = fs_files[i];
+        rcu_assign_pointer(fs_files[i], NULL);
+        call_rcu(&file->rcu, fs_free_file);
     }
-    return -1;
+    mutex_unlock(&fs_lock);
+    return i >= 0 ? 0 : -1;
 }
 
 int fs_write(const char *name, const char *data, size_t size) {
-    for (int i = 0; i < FS_MAX_FILES; ++i) {
-        if (fs_files[i].used && strcmp(fs_files[i].name, name) == 0) {
-            size_t to_copy = size > FS_MAX_FILESIZE ? FS_MAX_FILESIZE : size;
-            memcpy(fs_files[i].data, data, to_copy);
-            fs_files[i].size = to_copy;
-            return 0;
+    int ret = -1;
+    mutex_lock(&fs_lock);
+    int i = fs_find(name);
+    if (i >= 0) {
+        size_t to_copy = size > FS_MAX_FILESIZE ? FS_MAX_FILESIZE : size;
+        // readers may still be copying the old contents, so never write in place
+        fs_file_t *file = kmalloc(sizeof(fs_file_t) + to_copy);
+        if (file) {
+            fs_file_t *old = fs_files[i];
+            memcpy(file->name, old->name, FS_MAX_FILENAME);
+            memcpy(file->data, data, to_copy);
+            file->size = to_copy;
+            rcu_assign_pointer(fs_files[i], file);
+            call_rcu(&old->rcu, fs_free_file);
+            ret = 0;
         }
     }
-    return -1;
+    mutex_unlock(&fs_lock);
+    return ret;
 }
 
 int fs_read(const char *name, char *buf, size_t bufsize) {
-    for (int i = 0; i < FS_MAX_FILES; ++i) {
-        if (fs_files[i].used && strcmp(fs_files[i].name, name) == 0) {
-            size_t to_copy = fs_files[i].size > bufsize ? bufsize : fs_files[i].size;
-            memcpy(buf, fs_files[i].data, to_copy);
-            return (int)to_copy;
-        }
+    int ret = -1;
+    rcu_read_lock();
+    fs_file_t *file = fs_lookup(name);
+    if (file) {
+        size_t to_copy = file->size > bufsize ? bufsize : file->size;
+        memcpy(buf, file->data, to_copy);
+        ret = (int)to_copy;
     }
-    return -1;
+    rcu_read_unlock();
+    return ret;
 }
 
-int fs_list(char names[FS_MAX_FILES][FS_MAX_FILENAME], int *count) {
+// names are copied into the caller's arena, so listing needs no stack buffer
+char **fs_list(arena_t *arena, int *count) {
     int n = 0;
+    char **names = arena_alloc(arena, FS_MAX_FILES * sizeof(char *));
+    if (!names)
+        return NULL;
+    rcu_read_lock();
     for (int i = 0; i < FS_MAX_FILES; ++i) {
-        if (fs_files[i].used) {
-            strncpy(names[n++], fs_files[i].name, FS_MAX_FILENAME-1);
-            names[n-1][FS_MAX_FILENAME-1] = 0;
+        fs_file_t *file = rcu_dereference(fs_files[i]);
+        if (file) {
+            names[n] = arena_strndup(arena, file->name, FS_MAX_FILENAME-1);
+            if (!names[n]) {
+                rcu_read_unlock();
+                return NULL;
+            }
+            n++;
         }
     }
+    rcu_read_unlock();
     *count = n;
-    return 0;
+    return names;
 }
 
 int fs_exists(const char *name) {
-    for (int i = 0; i < FS_MAX_FILES; ++i)
-        if (fs_files[i].used && strcmp(fs_files[i].name, name) == 0)
-            return 1;
-    return 0;
+    rcu_read_lock();
+    int exists = fs_lookup(name) != NULL;
+    rcu_read_unlock();
+    return exists;
 }
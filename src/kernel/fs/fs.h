@@ -1,22 +1,27 @@
 #pragma once
 #include <stddef.h>
 
+#include <scheduler/rcu.h>
+#include <libk/alloc/arena.h>
+
 #define FS_MAX_FILES 64
 #define FS_MAX_FILENAME 32
 #define FS_MAX_FILESIZE 4096
 
+// never changed once published, fs_write publishes a new copy
 typedef struct {
     char name[FS_MAX_FILENAME];
     size_t size;
-    char data[FS_MAX_FILESIZE];
-    int used;
+    rcu_head_t rcu;
+    char data[];    // size bytes, allocated together with the header
 } fs_file_t;
 
-extern fs_file_t fs_files[FS_MAX_FILES];
+// NULL = free slot, read with rcu_dereference inside rcu_read_lock
+extern fs_file_t *fs_files[FS_MAX_FILES];
 
 int fs_create(const char *name);
 int fs_delete(const char *name);
 int fs_write(const char *name, const char *data, size_t size);
 int fs_read(const char *name, char *buf, size_t bufsize);
-int fs_list(char names[FS_MAX_FILES][FS_MAX_FILENAME], int *count);
+char **fs_list(arena_t *arena, int *count);
 int fs_exists(const char *name);
@@ -18,124 +18,134 @@
 // special thanks to this site (as parts of the code are from there):
 // https://blog.llandsmeer.com/tech/2019/07/21/uefi-x64-userland.html
 
+#include <stddef.h>
 #include <stdint.h>
 
 #include <gdt/gdt.h>
+#include <smp/smp.h>
 #include <libk/log/log.h>
 
 extern void _load_gdt_and_tss_asm(struct GDT_Pointer *ptr);
 
-static struct TSS	    tss;
-static struct GDT	    gdt;
-static struct GDT_Pointer   gdt_pointer;
+// every cpu needs its own TSS (busy bit, stacks) and therefore its own GDT
+static struct TSS	    tss[SMP_MAX_CPUS];
+static struct GDT	    gdt[SMP_MAX_CPUS];
+static struct GDT_Pointer   gdt_pointer[SMP_MAX_CPUS];
 
 // set the arguments for a given segment
-void create_descriptors(void)
+static void create_descriptors(struct GDT *gdt)
 {
     // 0x00: null
-    gdt.null.limit_15_0				    = 0;
-    gdt.null.base_15_0				    = 0;
-    gdt.null.base_23_16				    = 0;
-    gdt.null.type				    = 0x00;
-    gdt.null.limit_19_16_and_flags		    = 0x00;
-    gdt.null.base_31_24				    = 0;
+    gdt->null.limit_15_0			    = 0;
+    gdt->null.base_15_0				    = 0;
+    gdt->null.base_23_16			    = 0;
+    gdt->null.type				    = 0x00;
+    gdt->null.limit_19_16_and_flags		    = 0x00;
+    gdt->null.base_31_24			    = 0;
 
     // 0x08: kernel code (kernel base selector)
-    gdt.kernel_code.limit_15_0			    = 0;
-    gdt.kernel_code.base_15_0			    = 0;
-    gdt.kernel_code.base_23_16			    = 0;
-    gdt.kernel_code.type			    = 0x9A;
-    gdt.kernel_code.limit_19_16_and_flags	    = 0xA0;
-    gdt.kernel_code.base_31_24			    = 0;
+    gdt->kernel_code.limit_15_0			    = 0;
+    gdt->kernel_code.base_15_0			    = 0;
+    gdt->kernel_code.base_23_16			    = 0;
+    gdt->kernel_code.type			    = 0x9A;
+    gdt->kernel_code.limit_19_16_and_flags	    = 0xA0;
+    gdt->kernel_code.base_31_24			    = 0;
 
     // 0x10: kernel data
-    gdt.kernel_data.limit_15_0			    = 0;
-    gdt.kernel_data.base_15_0			    = 0;
-    gdt.kernel_data.base_23_16			    = 0;
-    gdt.kernel_data.type			    = 0x92;
-    gdt.kernel_data.limit_19_16_and_flags	    = 0xA0;
-    gdt.kernel_data.base_31_24			    = 0;
+    gdt->kernel_data.limit_15_0			    = 0;
+    gdt->kernel_data.base_15_0			    = 0;
+    gdt->kernel_data.base_23_16			    = 0;
+    gdt->kernel_data.type			    = 0x92;
+    gdt->kernel_data.limit_19_16_and_flags	    = 0xA0;
+    gdt->kernel_data.base_31_24			    = 0;
 
     // 0x18: null (user base selector)
-    gdt.null2.limit_15_0			    = 0;
-    gdt.null2.base_15_0	    			    = 0;
-    gdt.null2.base_23_16    			    = 0;
-    gdt.null2.type				    = 0x00;
-    gdt.null2.limit_19_16_and_flags		    = 0x00;
-    gdt.null2.base_31_24			    = 0;
+    gdt->null2.limit_15_0			    = 0;
+    gdt->null2.base_15_0			    = 0;
+    gdt->null2.base_23_16			    = 0;
+    gdt->null2.type				    = 0x00;
+    gdt->null2.limit_19_16_and_flags		    = 0x00;
+    gdt->null2.base_31_24			    = 0;
 
     // 0x20: user data
-    gdt.user_data.limit_15_0			    = 0;
-    gdt.user_data.base_15_0			    = 0;
-    gdt.user_data.base_23_16			    = 0;
-    gdt.user_data.type				    = 0x92;
-    gdt.user_data.limit_19_16_and_flags		    = 0xA0;
-    gdt.user_data.base_31_24			    = 0;
+    gdt->user_data.limit_15_0			    = 0;
+    gdt->user_data.base_15_0			    = 0;
+    gdt->user_data.base_23_16			    = 0;
+    gdt->user_data.type				    = 0x92;
+    gdt->user_data.limit_19_16_and_flags	    = 0xA0;
+    gdt->user_data.base_31_24			    = 0;
 
     // 0x28: user code
-    gdt.user_code.limit_15_0			    = 0;
-    gdt.user_code.base_15_0			    = 0;
-    gdt.user_code.base_23_16			    = 0;
-    gdt.user_code.type				    = 0x9A;
-    gdt.user_code.limit_19_16_and_flags		    = 0xA0;
-    gdt.user_code.base_31_24			    = 0;
+    gdt->user_code.limit_15_0			    = 0;
+    gdt->user_code.base_15_0			    = 0;
+    gdt->user_code.base_23_16			    = 0;
+    gdt->user_code.type				    = 0x9A;
+    gdt->user_code.limit_19_16_and_flags	    = 0xA0;
+    gdt->user_code.base_31_24			    = 0;
 
     // 0x30: ovmf data
-    gdt.ovmf_data.limit_15_0			    = 0;
-    gdt.ovmf_data.base_15_0			    = 0;
-    gdt.ovmf_data.base_23_16			    = 0;
-    gdt.ovmf_data.type				    = 0x92;
-    gdt.ovmf_data.limit_19_16_and_flags		    = 0xA0;
-    gdt.ovmf_data.base_31_24			    = 0;
+    gdt->ovmf_data.limit_15_0			    = 0;
+    gdt->ovmf_data.base_15_0			    = 0;
+    gdt->ovmf_data.base_23_16			    = 0;
+    gdt->ovmf_data.type				    = 0x92;
+    gdt->ovmf_data.limit_19_16_and_flags	    = 0xA0;
+    gdt->ovmf_data.base_31_24			    = 0;
 
     // 0x38: ovmf code
-    gdt.ovmf_code.limit_15_0			    = 0;
-    gdt.ovmf_code.base_15_0			    = 0;
-    gdt.ovmf_code.base_23_16			    = 0;
-    gdt.ovmf_code.type				    = 0x9A;
-    gdt.ovmf_code.limit_19_16_and_flags		    = 0xA0;
-    gdt.ovmf_code.base_31_24			    = 0;
+    gdt->ovmf_code.limit_15_0			    = 0;
+    gdt->ovmf_code.base_15_0			    = 0;
+    gdt->ovmf_code.base_23_16			    = 0;
+    gdt->ovmf_code.type				    = 0x9A;
+    gdt->ovmf_code.limit_19_16_and_flags	    = 0xA0;
+    gdt->ovmf_code.base_31_24			    = 0;
 
     // 0x40: tss low
-    gdt.tss_low.limit_15_0			    = 0;
-    gdt.tss_low.base_15_0			    = 0;
-    gdt.tss_low.base_23_16			    = 0;
-    gdt.tss_low.type				    = 0x89;
-    gdt.tss_low.limit_19_16_and_flags		    = 0xA0;
-    gdt.tss_low.base_31_24			    = 0;
+    gdt->tss_low.limit_15_0			    = 0;
+    gdt->tss_low.base_15_0			    = 0;
+    gdt->tss_low.base_23_16			    = 0;
+    gdt->tss_low.type				    = 0x89;
+    gdt->tss_low.limit_19_16_and_flags		    = 0xA0;
+    gdt->tss_low.base_31_24			    = 0;
 
     // 0x48: tss high
-    gdt.tss_high.limit_15_0			    = 0;
-    gdt.tss_high.base_15_0			    = 0;
-    gdt.tss_high.base_23_16			    = 0;
-    gdt.tss_high.type				    = 0x00;
-    gdt.tss_high.limit_19_16_and_flags		    = 0x00;
-    gdt.tss_high.base_31_24			    = 0;
+    gdt->tss_high.limit_15_0			    = 0;
+    gdt->tss_high.base_15_0			    = 0;
+    gdt->tss_high.base_23_16			    = 0;
+    gdt->tss_high.type				    = 0x00;
+    gdt->tss_high.limit_19_16_and_flags		    = 0x00;
+    gdt->tss_high.base_31_24			    = 0;
 }
 
-// create descriptors and load GDT and TSS
+// create descriptors and load GDT and TSS of the bootstrap processor
 void gdt_init(void)
 {
-    create_descriptors();
+    gdt_init_cpu(0);
 
-    // memzero the TSS
-    for (uint64_t i = 0; i < sizeof(tss); i++)
-        ((uint8_t *)(void *)&tss)[i] = 0;
+    serial_log(INFO, "GDT initialized\n");
+    kernel_log(INFO, "GDT initialized\n");
+}
 
-    uint64_t tss_base = ((uint64_t)&tss);
+// create descriptors and load GDT and TSS of the calling cpu
+// -> also used by the application processors during SMP bring-up
+void gdt_init_cpu(size_t cpu)
+{
+    create_descriptors(&gdt[cpu]);
 
-    gdt.tss_low.base_15_0   = tss_base		& 0xffff;
-    gdt.tss_low.base_23_16  = (tss_base >> 16)	& 0xff;
-    gdt.tss_low.base_31_24  = (tss_base >> 24)	& 0xff;
-    gdt.tss_low.limit_15_0  = sizeof(tss);
-    gdt.tss_high.limit_15_0 = (tss_base >> 32)	& 0xffff;
-    gdt.tss_high.base_15_0  = (tss_base >> 48)	& 0xffff;
+    // memzero the TSS
+    for (uint64_t i = 0; i < sizeof(tss[cpu]); i++)
+        ((uint8_t *)(void *)&tss[cpu])[i] = 0;
 
-    gdt_pointer.limit	= sizeof(gdt) - 1;
-    gdt_pointer.base	= (uint64_t)&gdt;
+    uint64_t tss_base = ((uint64_t)&tss[cpu]);
 
-    _load_gdt_and_tss_asm(&gdt_pointer);
+    gdt[cpu].tss_low.base_15_0   = tss_base		& 0xffff;
+    gdt[cpu].tss_low.base_23_16  = (tss_base >> 16)	& 0xff;
+    gdt[cpu].tss_low.base_31_24  = (tss_base >> 24)	& 0xff;
+    gdt[cpu].tss_low.limit_15_0  = sizeof(tss[cpu]);
+    gdt[cpu].tss_high.limit_15_0 = (tss_base >> 32)	& 0xffff;
+    gdt[cpu].tss_high.base_15_0  = (tss_base >> 48)	& 0xffff;
 
-    serial_log(INFO, "GDT initialized\n");
-    kernel_log(INFO, "GDT initialized\n");
+    gdt_pointer[cpu].limit	= sizeof(gdt[cpu]) - 1;
+    gdt_pointer[cpu].base	= (uint64_t)&gdt[cpu];
+
+    _load_gdt_and_tss_asm(&gdt_pointer[cpu]);
 }
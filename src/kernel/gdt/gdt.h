@@ -15,6 +15,9 @@
 	along with this program.  If not, see <https://www.gnu.org/licenses/>.
 */
 
+#include <stddef.h>
+#include <stdint.h>
+
 #ifndef GDT_H
 #define GDT_H
 
@@ -73,5 +76,6 @@ struct GDT_Pointer
 } __attribute__((packed)); // for no special compiler optimization
 
 void gdt_init(void);
+void gdt_init_cpu(size_t cpu);
 
 #endif
@@ -19,6 +19,7 @@
 
 #include <devices/pic/pic.h>
 #include <interrupts/idt.h>
+#include <interrupts/interrupts.h>
 #include <libk/io/io.h>
 #include <libk/log/log.h>
 
@@ -100,8 +101,16 @@ void idt_init(void)
     create_descriptor(46, 0x8E);
     create_descriptor(47, 0x8E);
 
+    // scheduler tick and yield
+    create_descriptor(LAPIC_TIMER_INTERRUPT, 0x8E);
+    create_descriptor(SCHEDULER_YIELD_INTERRUPT, 0x8E);
+
+    // inter processor interrupts
+    create_descriptor(IPI_CALL_FUNCTION_INTERRUPT, 0x8E);
+    create_descriptor(IPI_RESCHEDULE_INTERRUPT, 0x8E);
+
     // apic spurious interrupt
-    create_descriptor(255, 0x8E);
+    create_descriptor(SPURIOUS_INTERRUPT, 0x8E);
 
     // mask keyboard IRQ
     pic_set_mask(1);
@@ -110,8 +119,15 @@ void idt_init(void)
     idt_pointer.limit = sizeof(idt) - 1;
     idt_pointer.base = (uint64_t)&idt;
 
-    _load_idt_asm(&idt_pointer);
+    idt_load();
 
     serial_log(INFO, "IDT initialized\n");
     kernel_log(INFO, "IDT initialized\n");
 }
+
+// load the (shared) IDT on the calling cpu and enable interrupts
+// -> the application processors use the table the BSP created
+void idt_load(void)
+{
+    _load_idt_asm(&idt_pointer);
+}
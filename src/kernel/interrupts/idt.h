@@ -38,5 +38,6 @@ struct IDT_Pointer
 }__attribute__((packed)); // for no special compiler optimization
 
 void idt_init(void);
+void idt_load(void);
 
 #endif
@@ -18,9 +18,18 @@
 #include <stdint.h>
 
 #include <boot/stivale2.h>
+#include <devices/apic/apic.h>
+#include <devices/cpu/cpuidle.h>
+#include <devices/cpu/fpu.h>
 #include <devices/pic/pic.h>
 #include <devices/ps2/keyboard/keyboard.h>
+#include <devices/serial/serial.h>
 #include <interrupts/interrupts.h>
+#include <interrupts/softirq.h>
+#include <scheduler/rcu.h>
+#include <scheduler/scheduler.h>
+#include <smp/ipi.h>
+#include <smp/percpu.h>
 #include <libk/debug/debug.h>
 #include <libk/stdio/stdio.h>
 
@@ -60,21 +69,43 @@ static const char *exceptions[] =
     "— : Intel reserved. Do not use."
 };
 
+// nesting depth of hardware interrupts (not exceptions) on this cpu
+static DEFINE_PER_CPU(uint32_t, interrupt_depth);
+
+static uint64_t interrupt_dispatch(interrupt_cpu_state_t *cpu, uint64_t rsp);
+
+// whether this cpu is running an interrupt handler or softirqs right now
+bool in_interrupt(void)
+{
+    return this_cpu_read(interrupt_depth) != 0;
+}
+
 uint64_t isr_handler(uint64_t rsp)
 {
     interrupt_cpu_state_t *cpu = (interrupt_cpu_state_t*)rsp;
 
+    // lazy FPU restore, anything else using the FPU is a bug
+    if (cpu->isr_number == FPU_NM_VECTOR && fpu_handle_device_not_available())
+        return rsp;
+
+    // doesn't return if another cpu is halting everyone
+    if (cpu->isr_number == NMI_VECTOR)
+        ipi_handle_nmi();
+
     // handle exceptions
     if (cpu->isr_number <= 31)
     {
+        // the other cpus would keep scribbling over the dump
+        smp_stop_other_cpus();
+
         serial_set_color(TERM_RED);
-        debug("\n────────────────────────\n");
-        debug("⚠ EXCEPTION OCCURRED! ⚠\n\n");
-        debug("⤷ ISR-No. %d: %s\n", cpu->isr_number, exceptions[cpu->isr_number]);
-        debug("⤷ Error code: 0x%.16llx\n\n\n", cpu->error_code);
+        debug_impl("\n────────────────────────\n");
+        debug_impl("⚠ EXCEPTION OCCURRED! ⚠\n\n");
+        debug_impl("⤷ ISR-No. %d: %s\n", cpu->isr_number, exceptions[cpu->isr_number]);
+        debug_impl("⤷ Error code: 0x%.16llx\n\n\n", cpu->error_code);
         serial_set_color(TERM_CYAN);
-        debug("ℹ Register dump:\n\n");
-        debug("⤷ rax: 0x%.16llx, rbx:    0x%.16llx, rcx: 0x%.16llx, rdx: 0x%.16llx\n"
+        debug_impl("ℹ Register dump:\n\n");
+        debug_impl("⤷ rax: 0x%.16llx, rbx:    0x%.16llx, rcx: 0x%.16llx, rdx: 0x%.16llx\n"
               "⤷ rsi: 0x%.16llx, rdi:    0x%.16llx, rbp: 0x%.16llx, r8 : 0x%.16llx\n"
               "⤷ r9 : 0x%.16llx, r10:    0x%.16llx, r11: 0x%.16llx, r12: 0x%.16llx\n"
               "⤷ r13: 0x%.16llx, r14:    0x%.16llx, r15: 0x%.16llx, ss : 0x%.16llx\n"
@@ -108,16 +139,71 @@ uint64_t isr_handler(uint64_t rsp)
         while (1)
             asm volatile("cli; hlt");
     }
+
+    // the idle state ends here, before the handler may switch to a thread
+    cpuidle_interrupt_enter();
+
+    this_cpu_inc(interrupt_depth);
+    rsp = interrupt_dispatch(cpu, rsp);
+    this_cpu_add(interrupt_depth, -1);
+
+    return rsp;
+}
+
+static uint64_t interrupt_dispatch(interrupt_cpu_state_t *cpu, uint64_t rsp)
+{
     // handle IRQ's / hardware interrupts
-    else if (cpu->isr_number >= 32 && cpu->isr_number <= 47)
+    if (cpu->isr_number >= 32 && cpu->isr_number <= 47)
     {
         // keyboard IRQ check -> call handler
         if (cpu->isr_number == 33)
             keyboard_irq_handler();
+        else if (cpu->isr_number == 32 + SERIAL_IRQ)
+            serial_irq_handler();
 
         pic_signal_EOI(cpu->isr_number);
+
+        softirq_run();
+
+        // the handler may have woken up a thread on an idle cpu
+        return scheduler_irq_exit(rsp);
+    }
+    // scheduler tick -> may return the stack of another thread
+    else if (cpu->isr_number == LAPIC_TIMER_INTERRUPT)
+    {
+        lapic_signal_eoi();
+
+        // expired timers first, they may make threads ready
+        softirq_raise(SOFTIRQ_TIMER);
+        rcu_tick();
+        softirq_run();
+
+        return scheduler_tick(rsp);
+    }
+    else if (cpu->isr_number == SCHEDULER_YIELD_INTERRUPT)
+    {
+        return scheduler_yield_from_interrupt(rsp);
+    }
+    else if (cpu->isr_number == IPI_CALL_FUNCTION_INTERRUPT)
+    {
+        lapic_signal_eoi();
+
+        ipi_handle_call_function();
+        softirq_run();
+
+        // the function may have woken up a thread on an idle cpu
+        return scheduler_irq_exit(rsp);
+    }
+    else if (cpu->isr_number == IPI_RESCHEDULE_INTERRUPT)
+    {
+        lapic_signal_eoi();
+
+        ipi_handle_reschedule();
+        softirq_run();
+
+        return scheduler_irq_exit(rsp);
     }
-    else if (cpu->isr_number == 255)
+    else if (cpu->isr_number == SPURIOUS_INTERRUPT)
     {
 	// apic spurious interrupt
     }
@@ -15,11 +15,20 @@
 	along with this program.  If not, see <https://www.gnu.org/licenses/>.
 */
 
+#include <stdbool.h>
+
 #include <devices/cpu/cpu.h>
 
 #ifndef INTERRUPTS_H
 #define INTERRUPTS_H
 
-#define SPURIOUS_INTERRUPT 255
+#define LAPIC_TIMER_INTERRUPT	48  // scheduler tick, fired by every cpu's LAPIC timer
+#define SCHEDULER_YIELD_INTERRUPT 49  // "int" to give up the cpu voluntarily
+#define IPI_CALL_FUNCTION_INTERRUPT 50  // another cpu queued smp_call_function work for this one
+#define IPI_RESCHEDULE_INTERRUPT 51  // a thread got queued on this idle cpu
+#define NMI_VECTOR		2
+#define SPURIOUS_INTERRUPT	255
+
+bool in_interrupt(void);
 
 #endif
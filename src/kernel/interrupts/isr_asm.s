@@ -16,6 +16,7 @@
 %include "src/kernel/assembly/definitions.inc"
 
 extern isr_handler
+extern scheduler_finish_switch
 
 global _isr_handler_asm
 global _isr_names_asm
@@ -27,6 +28,7 @@ _isr_handler_asm:
     mov	    rdi, rsp    ; pass the stack pointer as an argument to the c function
     call    isr_handler ; call the c function
     mov	    rsp, rax    ; get the new stack pointer returned
+    call    scheduler_finish_switch ; now on the new stack, the old thread may run elsewhere
     
     popa64		; pop all
     add	    rsp, 16	; pop error code and int number
@@ -101,6 +103,216 @@ ISR_STUB_NO_ERR 45
 ISR_STUB_NO_ERR 46
 ISR_STUB_NO_ERR 47
 
+; vectors above the ISA IRQs (LAPIC timer, IPIs, spurious interrupt ...)
+ISR_STUB_NO_ERR 48
+ISR_STUB_NO_ERR 49
+ISR_STUB_NO_ERR 50
+ISR_STUB_NO_ERR 51
+ISR_STUB_NO_ERR 52
+ISR_STUB_NO_ERR 53
+ISR_STUB_NO_ERR 54
+ISR_STUB_NO_ERR 55
+ISR_STUB_NO_ERR 56
+ISR_STUB_NO_ERR 57
+ISR_STUB_NO_ERR 58
+ISR_STUB_NO_ERR 59
+ISR_STUB_NO_ERR 60
+ISR_STUB_NO_ERR 61
+ISR_STUB_NO_ERR 62
+ISR_STUB_NO_ERR 63
+ISR_STUB_NO_ERR 64
+ISR_STUB_NO_ERR 65
+ISR_STUB_NO_ERR 66
+ISR_STUB_NO_ERR 67
+ISR_STUB_NO_ERR 68
+ISR_STUB_NO_ERR 69
+ISR_STUB_NO_ERR 70
+ISR_STUB_NO_ERR 71
+ISR_STUB_NO_ERR 72
+ISR_STUB_NO_ERR 73
+ISR_STUB_NO_ERR 74
+ISR_STUB_NO_ERR 75
+ISR_STUB_NO_ERR 76
+ISR_STUB_NO_ERR 77
+ISR_STUB_NO_ERR 78
+ISR_STUB_NO_ERR 79
+ISR_STUB_NO_ERR 80
+ISR_STUB_NO_ERR 81
+ISR_STUB_NO_ERR 82
+ISR_STUB_NO_ERR 83
+ISR_STUB_NO_ERR 84
+ISR_STUB_NO_ERR 85
+ISR_STUB_NO_ERR 86
+ISR_STUB_NO_ERR 87
+ISR_STUB_NO_ERR 88
+ISR_STUB_NO_ERR 89
+ISR_STUB_NO_ERR 90
+ISR_STUB_NO_ERR 91
+ISR_STUB_NO_ERR 92
+ISR_STUB_NO_ERR 93
+ISR_STUB_NO_ERR 94
+ISR_STUB_NO_ERR 95
+ISR_STUB_NO_ERR 96
+ISR_STUB_NO_ERR 97
+ISR_STUB_NO_ERR 98
+ISR_STUB_NO_ERR 99
+ISR_STUB_NO_ERR 100
+ISR_STUB_NO_ERR 101
+ISR_STUB_NO_ERR 102
+ISR_STUB_NO_ERR 103
+ISR_STUB_NO_ERR 104
+ISR_STUB_NO_ERR 105
+ISR_STUB_NO_ERR 106
+ISR_STUB_NO_ERR 107
+ISR_STUB_NO_ERR 108
+ISR_STUB_NO_ERR 109
+ISR_STUB_NO_ERR 110
+ISR_STUB_NO_ERR 111
+ISR_STUB_NO_ERR 112
+ISR_STUB_NO_ERR 113
+ISR_STUB_NO_ERR 114
+ISR_STUB_NO_ERR 115
+ISR_STUB_NO_ERR 116
+ISR_STUB_NO_ERR 117
+ISR_STUB_NO_ERR 118
+ISR_STUB_NO_ERR 119
+ISR_STUB_NO_ERR 120
+ISR_STUB_NO_ERR 121
+ISR_STUB_NO_ERR 122
+ISR_STUB_NO_ERR 123
+ISR_STUB_NO_ERR 124
+ISR_STUB_NO_ERR 125
+ISR_STUB_NO_ERR 126
+ISR_STUB_NO_ERR 127
+ISR_STUB_NO_ERR 128
+ISR_STUB_NO_ERR 129
+ISR_STUB_NO_ERR 130
+ISR_STUB_NO_ERR 131
+ISR_STUB_NO_ERR 132
+ISR_STUB_NO_ERR 133
+ISR_STUB_NO_ERR 134
+ISR_STUB_NO_ERR 135
+ISR_STUB_NO_ERR 136
+ISR_STUB_NO_ERR 137
+ISR_STUB_NO_ERR 138
+ISR_STUB_NO_ERR 139
+ISR_STUB_NO_ERR 140
+ISR_STUB_NO_ERR 141
+ISR_STUB_NO_ERR 142
+ISR_STUB_NO_ERR 143
+ISR_STUB_NO_ERR 144
+ISR_STUB_NO_ERR 145
+ISR_STUB_NO_ERR 146
+ISR_STUB_NO_ERR 147
+ISR_STUB_NO_ERR 148
+ISR_STUB_NO_ERR 149
+ISR_STUB_NO_ERR 150
+ISR_STUB_NO_ERR 151
+ISR_STUB_NO_ERR 152
+ISR_STUB_NO_ERR 153
+ISR_STUB_NO_ERR 154
+ISR_STUB_NO_ERR 155
+ISR_STUB_NO_ERR 156
+ISR_STUB_NO_ERR 157
+ISR_STUB_NO_ERR 158
+ISR_STUB_NO_ERR 159
+ISR_STUB_NO_ERR 160
+ISR_STUB_NO_ERR 161
+ISR_STUB_NO_ERR 162
+ISR_STUB_NO_ERR 163
+ISR_STUB_NO_ERR 164
+ISR_STUB_NO_ERR 165
+ISR_STUB_NO_ERR 166
+ISR_STUB_NO_ERR 167
+ISR_STUB_NO_ERR 168
+ISR_STUB_NO_ERR 169
+ISR_STUB_NO_ERR 170
+ISR_STUB_NO_ERR 171
+ISR_STUB_NO_ERR 172
+ISR_STUB_NO_ERR 173
+ISR_STUB_NO_ERR 174
+ISR_STUB_NO_ERR 175
+ISR_STUB_NO_ERR 176
+ISR_STUB_NO_ERR 177
+ISR_STUB_NO_ERR 178
+ISR_STUB_NO_ERR 179
+ISR_STUB_NO_ERR 180
+ISR_STUB_NO_ERR 181
+ISR_STUB_NO_ERR 182
+ISR_STUB_NO_ERR 183
+ISR_STUB_NO_ERR 184
+ISR_STUB_NO_ERR 185
+ISR_STUB_NO_ERR 186
+ISR_STUB_NO_ERR 187
+ISR_STUB_NO_ERR 188
+ISR_STUB_NO_ERR 189
+ISR_STUB_NO_ERR 190
+ISR_STUB_NO_ERR 191
+ISR_STUB_NO_ERR 192
+ISR_STUB_NO_ERR 193
+ISR_STUB_NO_ERR 194
+ISR_STUB_NO_ERR 195
+ISR_STUB_NO_ERR 196
+ISR_STUB_NO_ERR 197
+ISR_STUB_NO_ERR 198
+ISR_STUB_NO_ERR 199
+ISR_STUB_NO_ERR 200
+ISR_STUB_NO_ERR 201
+ISR_STUB_NO_ERR 202
+ISR_STUB_NO_ERR 203
+ISR_STUB_NO_ERR 204
+ISR_STUB_NO_ERR 205
+ISR_STUB_NO_ERR 206
+ISR_STUB_NO_ERR 207
+ISR_STUB_NO_ERR 208
+ISR_STUB_NO_ERR 209
+ISR_STUB_NO_ERR 210
+ISR_STUB_NO_ERR 211
+ISR_STUB_NO_ERR 212
+ISR_STUB_NO_ERR 213
+ISR_STUB_NO_ERR 214
+ISR_STUB_NO_ERR 215
+ISR_STUB_NO_ERR 216
+ISR_STUB_NO_ERR 217
+ISR_STUB_NO_ERR 218
+ISR_STUB_NO_ERR 219
+ISR_STUB_NO_ERR 220
+ISR_STUB_NO_ERR 221
+ISR_STUB_NO_ERR 222
+ISR_STUB_NO_ERR 223
+ISR_STUB_NO_ERR 224
+ISR_STUB_NO_ERR 225
+ISR_STUB_NO_ERR 226
+ISR_STUB_NO_ERR 227
+ISR_STUB_NO_ERR 228
+ISR_STUB_NO_ERR 229
+ISR_STUB_NO_ERR 230
+ISR_STUB_NO_ERR 231
+ISR_STUB_NO_ERR 232
+ISR_STUB_NO_ERR 233
+ISR_STUB_NO_ERR 234
+ISR_STUB_NO_ERR 235
+ISR_STUB_NO_ERR 236
+ISR_STUB_NO_ERR 237
+ISR_STUB_NO_ERR 238
+ISR_STUB_NO_ERR 239
+ISR_STUB_NO_ERR 240
+ISR_STUB_NO_ERR 241
+ISR_STUB_NO_ERR 242
+ISR_STUB_NO_ERR 243
+ISR_STUB_NO_ERR 244
+ISR_STUB_NO_ERR 245
+ISR_STUB_NO_ERR 246
+ISR_STUB_NO_ERR 247
+ISR_STUB_NO_ERR 248
+ISR_STUB_NO_ERR 249
+ISR_STUB_NO_ERR 250
+ISR_STUB_NO_ERR 251
+ISR_STUB_NO_ERR 252
+ISR_STUB_NO_ERR 253
+ISR_STUB_NO_ERR 254
+ISR_STUB_NO_ERR 255
+
 _isr_names_asm:
     ISR_NAME 0
     ISR_NAME 1
@@ -151,3 +363,212 @@ _isr_names_asm:
     ISR_NAME 45
     ISR_NAME 46
     ISR_NAME 47
+
+    ISR_NAME 48
+    ISR_NAME 49
+    ISR_NAME 50
+    ISR_NAME 51
+    ISR_NAME 52
+    ISR_NAME 53
+    ISR_NAME 54
+    ISR_NAME 55
+    ISR_NAME 56
+    ISR_NAME 57
+    ISR_NAME 58
+    ISR_NAME 59
+    ISR_NAME 60
+    ISR_NAME 61
+    ISR_NAME 62
+    ISR_NAME 63
+    ISR_NAME 64
+    ISR_NAME 65
+    ISR_NAME 66
+    ISR_NAME 67
+    ISR_NAME 68
+    ISR_NAME 69
+    ISR_NAME 70
+    ISR_NAME 71
+    ISR_NAME 72
+    ISR_NAME 73
+    ISR_NAME 74
+    ISR_NAME 75
+    ISR_NAME 76
+    ISR_NAME 77
+    ISR_NAME 78
+    ISR_NAME 79
+    ISR_NAME 80
+    ISR_NAME 81
+    ISR_NAME 82
+    ISR_NAME 83
+    ISR_NAME 84
+    ISR_NAME 85
+    ISR_NAME 86
+    ISR_NAME 87
+    ISR_NAME 88
+    ISR_NAME 89
+    ISR_NAME 90
+    ISR_NAME 91
+    ISR_NAME 92
+    ISR_NAME 93
+    ISR_NAME 94
+    ISR_NAME 95
+    ISR_NAME 96
+    ISR_NAME 97
+    ISR_NAME 98
+    ISR_NAME 99
+    ISR_NAME 100
+    ISR_NAME 101
+    ISR_NAME 102
+    ISR_NAME 103
+    ISR_NAME 104
+    ISR_NAME 105
+    ISR_NAME 106
+    ISR_NAME 107
+    ISR_NAME 108
+    ISR_NAME 109
+    ISR_NAME 110
+    ISR_NAME 111
+    ISR_NAME 112
+    ISR_NAME 113
+    ISR_NAME 114
+    ISR_NAME 115
+    ISR_NAME 116
+    ISR_NAME 117
+    ISR_NAME 118
+    ISR_NAME 119
+    ISR_NAME 120
+    ISR_NAME 121
+    ISR_NAME 122
+    ISR_NAME 123
+    ISR_NAME 124
+    ISR_NAME 125
+    ISR_NAME 126
+    ISR_NAME 127
+    ISR_NAME 128
+    ISR_NAME 129
+    ISR_NAME 130
+    ISR_NAME 131
+    ISR_NAME 132
+    ISR_NAME 133
+    ISR_NAME 134
+    ISR_NAME 135
+    ISR_NAME 136
+    ISR_NAME 137
+    ISR_NAME 138
+    ISR_NAME 139
+    ISR_NAME 140
+    ISR_NAME 141
+    ISR_NAME 142
+    ISR_NAME 143
+    ISR_NAME 144
+    ISR_NAME 145
+    ISR_NAME 146
+    ISR_NAME 147
+    ISR_NAME 148
+    ISR_NAME 149
+    ISR_NAME 150
+    ISR_NAME 151
+    ISR_NAME 152
+    ISR_NAME 153
+    ISR_NAME 154
+    ISR_NAME 155
+    ISR_NAME 156
+    ISR_NAME 157
+    ISR_NAME 158
+    ISR_NAME 159
+    ISR_NAME 160
+    ISR_NAME 161
+    ISR_NAME 162
+    ISR_NAME 163
+    ISR_NAME 164
+    ISR_NAME 165
+    ISR_NAME 166
+    ISR_NAME 167
+    ISR_NAME 168
+    ISR_NAME 169
+    ISR_NAME 170
+    ISR_NAME 171
+    ISR_NAME 172
+    ISR_NAME 173
+    ISR_NAME 174
+    ISR_NAME 175
+    ISR_NAME 176
+    ISR_NAME 177
+    ISR_NAME 178
+    ISR_NAME 179
+    ISR_NAME 180
+    ISR_NAME 181
+    ISR_NAME 182
+    ISR_NAME 183
+    ISR_NAME 184
+    ISR_NAME 185
+    ISR_NAME 186
+    ISR_NAME 187
+    ISR_NAME 188
+    ISR_NAME 189
+    ISR_NAME 190
+    ISR_NAME 191
+    ISR_NAME 192
+    ISR_NAME 193
+    ISR_NAME 194
+    ISR_NAME 195
+    ISR_NAME 196
+    ISR_NAME 197
+    ISR_NAME 198
+    ISR_NAME 199
+    ISR_NAME 200
+    ISR_NAME 201
+    ISR_NAME 202
+    ISR_NAME 203
+    ISR_NAME 204
+    ISR_NAME 205
+    ISR_NAME 206
+    ISR_NAME 207
+    ISR_NAME 208
+    ISR_NAME 209
+    ISR_NAME 210
+    ISR_NAME 211
+    ISR_NAME 212
+    ISR_NAME 213
+    ISR_NAME 214
+    ISR_NAME 215
+    ISR_NAME 216
+    ISR_NAME 217
+    ISR_NAME 218
+    ISR_NAME 219
+    ISR_NAME 220
+    ISR_NAME 221
+    ISR_NAME 222
+    ISR_NAME 223
+    ISR_NAME 224
+    ISR_NAME 225
+    ISR_NAME 226
+    ISR_NAME 227
+    ISR_NAME 228
+    ISR_NAME 229
+    ISR_NAME 230
+    ISR_NAME 231
+    ISR_NAME 232
+    ISR_NAME 233
+    ISR_NAME 234
+    ISR_NAME 235
+    ISR_NAME 236
+    ISR_NAME 237
+    ISR_NAME 238
+    ISR_NAME 239
+    ISR_NAME 240
+    ISR_NAME 241
+    ISR_NAME 242
+    ISR_NAME 243
+    ISR_NAME 244
+    ISR_NAME 245
+    ISR_NAME 246
+    ISR_NAME 247
+    ISR_NAME 248
+    ISR_NAME 249
+    ISR_NAME 250
+    ISR_NAME 251
+    ISR_NAME 252
+    ISR_NAME 253
+    ISR_NAME 254
+    ISR_NAME 255
@@ -0,0 +1,140 @@
+/*
+	This file is part of an x86_64 hobbyist operating system called KnutOS
+	Everything is openly developed on GitHub: https://github.com/Tix3Dev/KnutOS/
+
+	Copyright (C) 2021-2022  Yves Vollmeier <https://github.com/Tix3Dev>
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <boot/stivale2.h>
+#include <interrupts/softirq.h>
+#include <smp/percpu.h>
+#include <smp/smp.h>
+#include <libk/stdio/stdio.h>
+
+/*  Explanation of softirqs:
+    Hardware interrupt handlers should only acknowledge the device and
+    note what's left to do, everything else is deferred. A softirq is
+    such a deferred vector: the handler marks it pending in a per cpu
+    bitmask (softirq_raise) and softirq_run, called by isr_handler on
+    the way out of every hardware interrupt, runs the handlers of all
+    pending vectors with interrupts enabled again.
+
+    While softirqs run, the interrupted thread can't be switched away
+    from (the scheduler checks softirq_in_progress), so the per cpu state
+    stays valid and a nested interrupt doesn't start a second round on
+    the same stack. Vectors raised while running are picked up by the
+    next round, after SOFTIRQ_MAX_RESTART rounds the rest waits for the
+    next interrupt so a flood of work can't starve threads.
+
+    Softirq handlers must not block. Work that needs to sleep goes to
+    a workqueue instead (scheduler/workqueue.h).
+*/
+
+static void (*softirq_handlers[SOFTIRQ_COUNT])(void);
+
+static const char *softirq_names[SOFTIRQ_COUNT] =
+{
+    [SOFTIRQ_TIMER] = "timer",
+    [SOFTIRQ_RCU] = "rcu"
+};
+
+static DEFINE_PER_CPU(uint32_t, softirq_pending);
+static DEFINE_PER_CPU(bool, softirq_active);
+static DEFINE_PER_CPU(uint64_t, softirq_rounds);
+static DEFINE_PER_CPU(uint64_t, softirq_counts[SOFTIRQ_COUNT]);
+
+// set the handler of a vector, done once at boot
+void softirq_register(softirq_t nr, void (*handler)(void))
+{
+    softirq_handlers[nr] = handler;
+}
+
+// mark a vector pending on this cpu, it runs on the next interrupt exit
+// -> a single "or" on the per cpu mask, safe against interrupts without disabling them
+void softirq_raise(softirq_t nr)
+{
+    this_cpu_or(softirq_pending, 1U << nr);
+}
+
+// run all pending vectors of this cpu (called with interrupts off, returns with them off)
+void softirq_run(void)
+{
+    if (this_cpu_read(softirq_active) || !this_cpu_read(softirq_pending))
+        return;
+
+    this_cpu_write(softirq_active, true);
+
+    for (size_t restart = 0; restart < SOFTIRQ_MAX_RESTART; restart++)
+    {
+        uint32_t pending = this_cpu_read(softirq_pending);
+
+        if (!pending)
+            break;
+
+        this_cpu_write(softirq_pending, 0);
+        this_cpu_inc(softirq_rounds);
+
+        asm volatile("sti" : : : "memory");
+
+        for (size_t nr = 0; nr < SOFTIRQ_COUNT; nr++)
+        {
+            if (!(pending & (1U << nr)) || !softirq_handlers[nr])
+                continue;
+
+            softirq_handlers[nr]();
+            this_cpu_inc(softirq_counts[nr]);
+        }
+
+        asm volatile("cli" : : : "memory");
+    }
+
+    this_cpu_write(softirq_active, false);
+}
+
+// whether this cpu is running softirq handlers right now (interrupts may be on)
+bool softirq_in_progress(void)
+{
+    return this_cpu_read(softirq_active);
+}
+
+// how often every vector ran on every cpu
+void softirq_print_stats(void)
+{
+    printk(GFX_CYAN, "%-10s", "cpu");
+
+    for (size_t i = 0; i < smp_cpu_count; i++)
+        printk(GFX_CYAN, "%-10d", i);
+
+    printk(GFX_CYAN, "\n");
+
+    for (size_t nr = 0; nr < SOFTIRQ_COUNT; nr++)
+    {
+        printk(GFX_WHITE, "%-10s", softirq_names[nr]);
+
+        for (size_t i = 0; i < smp_cpu_count; i++)
+            printk(GFX_WHITE, "%-10llu", (*per_cpu_ptr(softirq_counts, i))[nr]);
+
+        printk(GFX_WHITE, "\n");
+    }
+
+    printk(GFX_WHITE, "%-10s", "rounds");
+
+    for (size_t i = 0; i < smp_cpu_count; i++)
+        printk(GFX_WHITE, "%-10llu", *per_cpu_ptr(softirq_rounds, i));
+
+    printk(GFX_WHITE, "\n");
+}
@@ -0,0 +1,40 @@
+/*
+	This file is part of an x86_64 hobbyist operating system called KnutOS
+	Everything is openly developed on GitHub: https://github.com/Tix3Dev/KnutOS/
+
+	Copyright (C) 2021-2022  Yves Vollmeier <https://github.com/Tix3Dev>
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifndef SOFTIRQ_H
+#define SOFTIRQ_H
+
+#define SOFTIRQ_MAX_RESTART	10	// rounds per interrupt exit, the rest waits for the next interrupt
+
+// lower number = runs first
+typedef enum
+{
+    SOFTIRQ_TIMER,	    // expired timer wheel callbacks
+    SOFTIRQ_RCU,	    // callbacks whose grace period ended
+    SOFTIRQ_COUNT
+} softirq_t;
+
+void softirq_register(softirq_t nr, void (*handler)(void));
+void softirq_raise(softirq_t nr);
+void softirq_run(void);
+bool softirq_in_progress(void);
+void softirq_print_stats(void);
+
+#endif
@@ -23,7 +23,11 @@
 #include <boot/stivale2_boot.h>
 #include <devices/apic/apic.h>
 #include <devices/cpu/cpu.h>
+#include <devices/cpu/cpuidle.h>
+#include <devices/cpu/fpu.h>
+#include <devices/hpet/hpet.h>
 #include <devices/ps2/keyboard/keyboard.h>
+#include <devices/serial/serial.h>
 #include <firmware/acpi/acpi.h>
 #include <gdt/gdt.h>
 #include <interrupts/idt.h>
@@ -31,7 +35,14 @@
 #include <memory/pmm.h>
 #include <memory/slab.h>
 #include <memory/vmm.h>
+#include <scheduler/async.h>
+#include <scheduler/scheduler.h>
+#include <scheduler/workqueue.h>
 #include <shell/shell_screen.h>
+#include <smp/ipi.h>
+#include <smp/percpu.h>
+#include <smp/smp.h>
+#include <time/clocksource.h>
 #include <logo.h>
 #include <libk/debug/debug.h>
 #include <libk/log/log.h>
@@ -63,25 +74,36 @@ void kmain(struct stivale2_struct *stivale2_struct)
     idt_init();
 
     slab_init();
+    percpu_init();
 
     char *vendor_string = cpu_get_vendor_string();
     serial_log(INFO, "CPU Vendor ID String: %s\n", vendor_string);
     kernel_log(INFO, "CPU Vendor ID String: %s\n", vendor_string);
 
+    fpu_init();
+    cpuidle_init();
+
     acpi_init(global_stivale2_struct);
+    hpet_init();
+    clocksource_init();
 
     apic_init();
+    ipi_init();
 
-     keyboard_init(); // NOTE: is_keyboard_active is still false so no processing
+    scheduler_init();
+
+    smp_init(global_stivale2_struct);
 
-    // TODO: proper timer
-    // for (long i = 0; i < 5500000000; i++)	// ~10 seconds
-    // 	asm ("nop");
+    workqueue_init();
+    async_init();
+    serial_enable_receive_irq();
+
+     keyboard_init(); // NOTE: is_keyboard_active is still false so no processing
 
      shell_screen_init();
 
-    for (;;)
-        asm ("hlt");
+    // this context is the BSP's idle thread
+    cpuidle_loop();
 }
 
 // Annotated system_reboot() implementation for x86_64
@@ -15,6 +15,7 @@
 	along with this program.  If not, see <https://www.gnu.org/licenses/>.
 */
 
+#include <stdbool.h>
 #include <stdint.h>
 #include <stddef.h>
 
@@ -23,6 +24,7 @@
 #include <memory/pmm.h>
 #include <libk/alloc/bitmap.h>
 #include <libk/debug/debug.h>
+#include <libk/lock/mcs_lock.h>
 #include <libk/log/log.h>
 #include <libk/stdio/stdio.h>
 #include <libk/string/string.h>
@@ -32,6 +34,13 @@ BITMAP_t bitmap;
 
 size_t highest_page;
 
+static page_t	*page_array;
+static size_t	page_array_count;
+
+// protects the bitmap and used_pages, the PMM is used from every cpu
+// -> the most contended lock during allocation heavy work, so a queue lock
+static mcs_lock_t pmm_lock = MCS_LOCK_INIT("pmm");
+
 // setup the bitmap
 void pmm_init(struct stivale2_struct *stivale2_struct)
 {
@@ -94,6 +103,11 @@ void pmm_init(struct stivale2_struct *stivale2_struct)
 
     bitmap.size = bitmap_byte_size;
 
+    // calculate page descriptor array size
+    page_array_count = highest_page / PAGE_SIZE;
+
+    size_t page_array_byte_size = ALIGN_UP(page_array_count * sizeof(page_t), PAGE_SIZE);
+
     serial_log(INFO, "Memory specifications:\n");
     kernel_log(INFO, "Memory specifications:\n");
 
@@ -107,6 +121,9 @@ void pmm_init(struct stivale2_struct *stivale2_struct)
     debug("Size of bitmap: %d kB\n", bitmap.size / 1024);
     printk(GFX_PURPLE, "Size of bitmap: %d kB\n", bitmap.size / 1024);
 
+    debug("Size of page descriptor array: %d kB\n", page_array_byte_size / 1024);
+    printk(GFX_PURPLE, "Size of page descriptor array: %d kB\n", page_array_byte_size / 1024);
+
     serial_set_color(TERM_COLOR_RESET);
 
 
@@ -137,11 +154,39 @@ void pmm_init(struct stivale2_struct *stivale2_struct)
     }
 
 
+    // search for first large enough page of memory to host the page descriptor array
+    for (uint64_t i = 0; i < pmm_info.memory_map->entries; i++)
+    {
+        current_entry = &pmm_info.memory_map->memmap[i];
+
+        if (current_entry->type != STIVALE2_MMAP_USABLE)
+            continue;
+
+        if (current_entry->length >= page_array_byte_size)
+        {
+            serial_set_color(TERM_PURPLE);
+            debug("Page descriptor array stored between 0x%.8lx and 0x%.8lx\n", current_entry->base,
+                  current_entry->base + page_array_byte_size - 1);
+            serial_set_color(TERM_COLOR_RESET);
+
+            page_array		    = (page_t *)(phys_to_higher_half_data(current_entry->base));
+
+            current_entry->base	    += page_array_byte_size;
+            current_entry->length   -= page_array_byte_size;
+
+            break;
+        }
+    }
+
+
     // --- step 5 ---
 
     // set bitmap to default - all bits used
     memset((void *)bitmap.map, 0xFF, bitmap.size);
 
+    // no frame has an owner yet
+    memset((void *)page_array, 0, page_array_byte_size);
+
 
     // --- step 6 ---
 
@@ -201,21 +246,27 @@ const char *get_memory_map_entry_type(uint32_t type)
     }
 }
 
-// traverse the bitmap -> for each bit and check if bit is free or used
-// return index
+// traverse the bitmap -> for each bit check if bit is free or used
+// until page_count free bits in a row are found
+// return address of the first one
 void *pmm_find_first_free_page(size_t page_count)
 {
     // can't find in no memory
     if (page_count == 0)
         return NULL;
 
-    for (size_t counter = 0; counter < page_count; counter++)
+    size_t run_length = 0;
+
+    for (size_t i = 0; i < PAGE_TO_BIT(highest_page); i++)
     {
-        for (size_t i = 0; i < PAGE_TO_BIT(highest_page); i++)
+        if (bitmap_check_bit(&bitmap, i))
         {
-            if (!bitmap_check_bit(&bitmap, i))
-                return (void *)BIT_TO_PAGE(i);
+            run_length = 0;
+            continue;
         }
+
+        if (++run_length == page_count)
+            return (void *)BIT_TO_PAGE(i - page_count + 1);
     }
 
     // nothing big enough
@@ -232,10 +283,16 @@ void *pmm_alloc(size_t page_count)
     if (pmm_info.used_pages <= 0)
         return NULL;
 
+    mcs_node_t node;
+    uint64_t rflags = mcs_lock_acquire_irqsave(&pmm_lock, &node);
+
     void *pointer = pmm_find_first_free_page(page_count);
 
     if (pointer == NULL)
+    {
+        mcs_lock_release_irqrestore(&pmm_lock, &node, rflags);
         return NULL;
+    }
 
 
     uint64_t index = (uint64_t)pointer / PAGE_SIZE;
@@ -245,9 +302,43 @@ void *pmm_alloc(size_t page_count)
 
     pmm_info.used_pages += page_count;
 
+    mcs_lock_release_irqrestore(&pmm_lock, &node, rflags);
+
     return (void *)(uint64_t)(phys_to_higher_half_data(index * PAGE_SIZE));
 }
 
+// convert pointer to index
+// check if all page_count frames starting there are free and mark them as used
+// -> physical memory allocation at a fixed address (e.g. to grow an allocation in place)
+bool pmm_alloc_at(void *pointer, size_t page_count)
+{
+    uint64_t index = higher_half_data_to_phys((uint64_t)pointer) / PAGE_SIZE;
+
+    if (index + page_count > PAGE_TO_BIT(highest_page))
+        return false;
+
+    mcs_node_t node;
+    uint64_t rflags = mcs_lock_acquire_irqsave(&pmm_lock, &node);
+
+    for (size_t i = 0; i < page_count; i++)
+    {
+        if (bitmap_check_bit(&bitmap, index + i))
+        {
+            mcs_lock_release_irqrestore(&pmm_lock, &node, rflags);
+            return false;
+        }
+    }
+
+    for (size_t i = 0; i < page_count; i++)
+        bitmap_set_bit(&bitmap, index + i);
+
+    pmm_info.used_pages += page_count;
+
+    mcs_lock_release_irqrestore(&pmm_lock, &node, rflags);
+
+    return true;
+}
+
 // convert pointer to index
 // unset the matching bit
 // -> physical memory freeing for n pages
@@ -255,8 +346,25 @@ void pmm_free(void *pointer, size_t page_count)
 {
     uint64_t index = higher_half_data_to_phys((uint64_t)pointer) / PAGE_SIZE;
 
+    mcs_node_t node;
+    uint64_t rflags = mcs_lock_acquire_irqsave(&pmm_lock, &node);
+
     for (size_t i = 0; i < page_count; i++)
         bitmap_unset_bit(&bitmap, index + i);
 
     pmm_info.used_pages -= page_count;
+
+    mcs_lock_release_irqrestore(&pmm_lock, &node, rflags);
+}
+
+// look up the descriptor of the frame a (higher half) pointer lies in
+// -> O(1), as the array is indexed by the page frame number
+page_t *pmm_get_page(void *pointer)
+{
+    uint64_t pfn = higher_half_data_to_phys((uint64_t)pointer) / PAGE_SIZE;
+
+    if (pfn >= page_array_count)
+        return NULL;
+
+    return &page_array[pfn];
 }
@@ -20,6 +20,19 @@
 #ifndef PMM_H
 #define PMM_H
 
+// page descriptor flags
+#define PAGE_FLAG_SLAB		(1 << 0)    // frame is owned by a slab cache
+#define PAGE_FLAG_HEAD		(1 << 1)    // first frame of a multi-page kmalloc allocation
+
+// per-frame descriptor (struct page equivalent), indexed by the page frame number
+typedef struct
+{
+    uint8_t	flags;
+    uint8_t	slab_index;	// owning slab cache, if PAGE_FLAG_SLAB is set
+    uint16_t	reserved;
+    uint32_t	page_count;	// frames spanned by the allocation, if PAGE_FLAG_HEAD is set
+} page_t;
+
 struct PMM_Info_Struct
 {
     size_t	memory_size;
@@ -28,10 +41,14 @@ struct PMM_Info_Struct
     struct	stivale2_struct_tag_memmap *memory_map;
 };
 
+extern struct PMM_Info_Struct pmm_info;
+
 void pmm_init(struct stivale2_struct *stivale2_struct);
 const char *get_memory_map_entry_type(uint32_t type);
 void *pmm_find_first_free_page(size_t page_count);
 void *pmm_alloc(size_t page_count);
+bool pmm_alloc_at(void *pointer, size_t page_count);
 void pmm_free(void *pointer, size_t page_count);
+page_t *pmm_get_page(void *pointer);
 
 #endif
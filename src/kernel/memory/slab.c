@@ -24,72 +24,108 @@
 #include <memory/mem.h>
 #include <memory/pmm.h>
 #include <memory/slab.h>
+#include <libk/alloc/kmalloc_profile.h>
 #include <libk/debug/debug.h>
+#include <libk/lock/spinlock.h>
 #include <libk/log/log.h>
-#include <libk/math/math.h>
 #include <libk/stdio/stdio.h>
 
 /*  Explanation of the method used here for slab allocations:
-    Instead of a linked list which would normally be used, this allocator
-    is based on an array. It holds 11 slabs. The smallest size is 2^1
-    and the biggest is 2^11.
-    Each slab contains an array of objects.
-    Each object is either
-    free - holding an address of free memory
-    or
-    used - holding NULL.
-
-    Now, when allocating memory, we search for a free object in the slab
-    of the machting size (parameter). If we find one, we set it to used
-    and return it's pointer. So, that it's memory can't be used anymore.
+    There are 20 slab caches, one per size class. The size classes
+    are spaced so that an allocation never wastes more than a third
+    of it's object: 8, 16, 24, 32, 48, 64, 96, ... up to 8192 bytes.
+    Each cache owns whole pages, which it requests from the PMM
+    whenever it runs out of objects ("grows"). The owning cache
+    is recorded in the page descriptor of every such page.
+
+    Free objects are linked together in a free list, whose link
+    is stored in the first 8 bytes of the free object itself.
+    Allocated objects don't carry any metadata.
+
+    Now, when allocating memory, we look up the size class of the
+    size parameter in a table, pop the first object off the free list
+    of the matching cache and return it's pointer.
 
     UNTIL we free the memory (by passing it's pointer) in slab_free.
-    For that we just search for a used object and then set it to the
-    passed pointer. The memory which the pointer points to, can now be
-    overwritten i.e. used again once somebody allocates memory again.
+    For that we look up the page descriptor of the pointer, which
+    tells us the owning cache in O(1), and push the object back onto
+    the free list of that cache. The memory which the pointer points
+    to, can now be overwritten i.e. used again once somebody allocates
+    memory again.
 */
 
+// object size and pages per grow of each size class
+// the page count is chosen so that little memory is left over at the end of a slab
+static const struct
+{
+    size_t size;
+    size_t pages;
+} size_classes[SLAB_COUNT] =
+{
+    {8, 1},	{16, 1},    {24, 1},	{32, 1},
+    {48, 1},	{64, 1},    {96, 1},	{128, 1},
+    {192, 1},	{256, 1},   {384, 3},	{512, 1},
+    {768, 3},	{1024, 1},  {1536, 3},	{2048, 1},
+    {3072, 3},	{4096, 1},  {6144, 3},	{8192, 2}
+};
+
+// size class of every size up to 1024 bytes, indexed by (size - 1) / 8
+static const uint8_t size_index_small[128] =
+{
+    [0]		= 0,	// 1 - 8
+    [1]		= 1,	// 9 - 16
+    [2]		= 2,	// 17 - 24
+    [3]		= 3,	// 25 - 32
+    [4 ... 5]	= 4,	// 33 - 48
+    [6 ... 7]	= 5,	// 49 - 64
+    [8 ... 11]	= 6,	// 65 - 96
+    [12 ... 15]	= 7,	// 97 - 128
+    [16 ... 23]	= 8,	// 129 - 192
+    [24 ... 31]	= 9,	// 193 - 256
+    [32 ... 47]	= 10,	// 257 - 384
+    [48 ... 63]	= 11,	// 385 - 512
+    [64 ... 95]	= 12,	// 513 - 768
+    [96 ... 127] = 13	// 769 - 1024
+};
+
+// size class of every size from 1025 up to 8192 bytes, indexed by (size - 1) / 256
+static const uint8_t size_index_large[32] =
+{
+    [4 ... 5]	= 14,	// 1025 - 1536
+    [6 ... 7]	= 15,	// 1537 - 2048
+    [8 ... 11]	= 16,	// 2049 - 3072
+    [12 ... 15]	= 17,	// 3073 - 4096
+    [16 ... 23]	= 18,	// 4097 - 6144
+    [24 ... 31]	= 19	// 6145 - 8192
+};
+
 static slab_t slabs[SLAB_COUNT];
 
+// one lock for all caches, held while popping / pushing a free list or growing
+static spinlock_t slab_lock = SPINLOCK_INIT("slab");
+
 /* utility functions */
 
-static int32_t find_free_object(int32_t slab_index);
-static int32_t find_allocated_object(int32_t slab_index);
+static int32_t slab_size_to_index(size_t size);
+static bool slab_grow(int32_t slab_index);
 
 /* core functions */
 
-// create array of slabs, which all are of different sizes
-// ranging from 2 to 2048 but only power of 2
-
-void *internal_mem_ptr = NULL;
-size_t internal_mem_len = 0;
 uint32_t page_alloc_count = 0;
 
+// create array of slabs, one for each size class
+// ranging from 8 to 8192 bytes
 void slab_init(void)
 {
     for (int32_t i = 0; i < SLAB_COUNT; i++)
     {
-        slabs[i].size = pow(2, i + 1);
-        slabs[i].is_full = false;
-
-        int32_t objects_per_slab = MAX_SLAB_SIZE / pow(2, i + 1);
-
-        for (int j = 0; j < objects_per_slab; j++)
-        {
-            if (!internal_mem_ptr || internal_mem_ptr == (void *)internal_mem_len)
-            {
-                internal_mem_ptr = pmm_alloc(1);
-                internal_mem_len = (size_t)internal_mem_ptr + PAGE_SIZE;
+        slabs[i].size = size_classes[i].size;
+        slabs[i].pages = size_classes[i].pages;
+        slabs[i].object_count = 0;
+        slabs[i].free_count = 0;
+        slabs[i].free_list = NULL;
 
-                page_alloc_count++;
-            }
-
-            slabs[i].objects[j] = internal_mem_ptr;
-            internal_mem_ptr += slabs[i].size;
-        }
-
-        slabs[i].address_range.start = slabs[i].objects[0];
-        slabs[i].address_range.end = slabs[i].objects[0] + 1024 - slabs[i].size;
+        slab_grow(i);
     }
 
     serial_log(INFO, "Slab allocator statistics:\n");
@@ -100,8 +136,8 @@ void slab_init(void)
     debug("Slabs created: %d\n", SLAB_COUNT);
     printk(GFX_PURPLE, "Slabs created: %d\n", SLAB_COUNT);
 
-    debug("Smallest slab: 2 bytes | Biggest slab: %d bytes\n", MAX_SLAB_SIZE);
-    printk(GFX_PURPLE, "Smallest slab: 2 bytes | Biggest slab: %d bytes\n", MAX_SLAB_SIZE);
+    debug("Smallest slab: %d bytes | Biggest slab: %d bytes\n", MIN_SLAB_SIZE, MAX_SLAB_SIZE);
+    printk(GFX_PURPLE, "Smallest slab: %d bytes | Biggest slab: %d bytes\n", MIN_SLAB_SIZE, MAX_SLAB_SIZE);
 
     debug("Memory used to create slabs: %d bytes = %d pages\n", page_alloc_count * PAGE_SIZE, page_alloc_count);
     printk(GFX_PURPLE, "Memory used to create slabs: %d bytes = %d pages\n", page_alloc_count * PAGE_SIZE, page_alloc_count);
@@ -112,92 +148,148 @@ void slab_init(void)
     kernel_log(INFO, "Slab allocator initialized\n");
 }
 
-// search for a free object in the matching slab according to the
-// size parameter and allocate it by setting it's value to NULL
+// allocate an object and account it to the caller if profiling is enabled
 void *slab_alloc(size_t size)
 {
-    void *return_value = NULL;
+    void *ptr = slab_cache_alloc(size);
 
-    for (int32_t i = 0; i < SLAB_COUNT; i++)
-    {
-        if (slabs[i].size != size)
-            continue;
+    kmalloc_profile_alloc(ptr, slab_round_size(size), __builtin_return_address(0));
 
-        if (slabs[i].is_full)
-            return return_value;
+    return ptr;
+}
 
-        int32_t free_object_index = find_free_object(i);
+// free an object allocated with slab_alloc
+void slab_free(void *ptr)
+{
+    kmalloc_profile_free(ptr);
 
-        if (free_object_index == -1)
-            slabs[i].is_full = true;
-        else
-        {
-            return_value = slabs[i].objects[free_object_index];
-            slabs[i].objects[free_object_index] = NULL;
-        }
+    slab_cache_free(ptr);
+}
+
+// pop a free object off the slab of the size class the size parameter
+// belongs to, grow the slab if it ran out of objects
+// -> not profiled, kmalloc accounts the allocation itself
+void *slab_cache_alloc(size_t size)
+{
+    int32_t i = slab_size_to_index(size);
 
-        return return_value;
+    if (i == -1)
+        return NULL;
+
+    uint64_t rflags = spinlock_acquire_irqsave(&slab_lock);
+
+    if (!slabs[i].free_list && !slab_grow(i))
+    {
+        spinlock_release_irqrestore(&slab_lock, rflags);
+        return NULL;
     }
 
-    return return_value;
+    void *object = slabs[i].free_list;
+
+    slabs[i].free_list = *(void **)object;
+    slabs[i].free_count--;
+
+    spinlock_release_irqrestore(&slab_lock, rflags);
+
+    return object;
 }
 
-// search for a slab of matching size according to the ptr paramater
-// free it by setting it's value to the ptr which was previously checked
-void slab_free(void *ptr)
+// find the owning slab through the page descriptor of ptr
+// and push the object back onto it's free list
+void slab_cache_free(void *ptr)
 {
     if (!ptr)
         return;
 
-    void *ptr_without_base;
+    page_t *page = pmm_get_page(ptr);
 
-    for (int32_t i = 0; i < SLAB_COUNT; i++)
-    {
-        ptr_without_base = ptr - slabs[i].address_range.start + (void *)slabs[i].size;
+    // not an object of a slab
+    if (!page || !(page->flags & PAGE_FLAG_SLAB))
+        return;
 
-        if (ptr >= slabs[i].address_range.start && ptr <= slabs[i].address_range.end)
-        {
-            // yes, ptr is in the range of a slab
+    slab_t *slab = &slabs[page->slab_index];
 
-            if ((size_t)ptr_without_base % slabs[i].size == 0)
-            {
-                // yes, ptr is an object of the slab
+    uint64_t rflags = spinlock_acquire_irqsave(&slab_lock);
 
-                int32_t allocated_object_index = find_allocated_object(i);
+    *(void **)ptr = slab->free_list;
+    slab->free_list = ptr;
+    slab->free_count++;
 
-                if (allocated_object_index == -1)
-                    return;
+    spinlock_release_irqrestore(&slab_lock, rflags);
+}
 
-                slabs[i].objects[allocated_object_index] = ptr;
-            }
-        }
-    }
+// return the object size of a slab (used by ksize)
+size_t slab_get_size(uint8_t slab_index)
+{
+    if (slab_index >= SLAB_COUNT)
+        return 0;
+
+    return slabs[slab_index].size;
+}
+
+// return the object size an allocation of size bytes would get
+// or 0 if it's too big for the slab allocator
+size_t slab_round_size(size_t size)
+{
+    int32_t i = slab_size_to_index(size);
+
+    if (i == -1)
+        return 0;
+
+    return size_classes[i].size;
 }
 
 /* utility functions */
 
-// find an object in the matching slab, i.e. by searching for
-// non-NULL values
-static int32_t find_free_object(int32_t slab_index)
+// look up the size class of a size in the tables above
+static int32_t slab_size_to_index(size_t size)
 {
-    int32_t objects_per_slab = MAX_SLAB_SIZE / pow(2, slab_index + 1);
+    if (size == 0)
+        size = 1;
+
+    if (size <= 1024)
+        return size_index_small[(size - 1) / 8];
 
-    for (int32_t i = 0; i < objects_per_slab; i++)
-        if (slabs[slab_index].objects[i] != NULL)
-            return i;
+    if (size <= MAX_SLAB_SIZE)
+        return size_index_large[(size - 1) / 256];
 
     return -1;
 }
 
-// find an object in the matching slab, i.e. by searching for
-// NULL values
-static int32_t find_allocated_object(int32_t slab_index)
+// request new pages from the PMM, mark them as owned by the slab
+// and carve them into objects
+static bool slab_grow(int32_t slab_index)
 {
-    int32_t objects_per_slab = MAX_SLAB_SIZE / pow(2, slab_index + 1);
+    slab_t *slab = &slabs[slab_index];
 
-    for (int32_t i = 0; i < objects_per_slab; i++)
-        if (slabs[slab_index].objects[i] == NULL)
-            return i;
+    uint8_t *pages = pmm_alloc(slab->pages);
 
-    return -1;
+    if (!pages)
+        return false;
+
+    page_alloc_count += slab->pages;
+
+    for (size_t i = 0; i < slab->pages; i++)
+    {
+        page_t *page = pmm_get_page(pages + i * PAGE_SIZE);
+
+        page->flags = PAGE_FLAG_SLAB;
+        page->slab_index = slab_index;
+    }
+
+    size_t objects_per_slab = (slab->pages * PAGE_SIZE) / slab->size;
+
+    // push in reverse order, so that objects are handed out with ascending addresses
+    for (size_t i = objects_per_slab; i > 0; i--)
+    {
+        void *object = pages + (i - 1) * slab->size;
+
+        *(void **)object = slab->free_list;
+        slab->free_list = object;
+    }
+
+    slab->object_count += objects_per_slab;
+    slab->free_count += objects_per_slab;
+
+    return true;
 }
@@ -16,29 +16,34 @@
 */
 
 #include <stdbool.h>
-
-#include <libk/definitions.h>
+#include <stddef.h>
+#include <stdint.h>
 
 #ifndef SLAB_H
 #define SLAB_H
 
-#define SLAB_COUNT		11	// how many slab_t's there will be
-#define MAX_SLAB_SIZE		2048	// until pow(2, SLAB_COUNT)
-#define MAX_OBJECTS_PER_SLAB	1024	// smallest slab possible is 2 -> MAX_SLAB_SIZE / 2
+#define SLAB_COUNT		20	// how many slab_t's (size classes) there will be
+#define MIN_SLAB_SIZE		8	// a free object has to be able to hold a pointer
+#define MAX_SLAB_SIZE		8192	// biggest size class, bigger requests go to the PMM
 
-// an object in the objects array either is a pointer to
-// free memory, or NULL which means it's allocated
+// a slab cache hands out objects of exactly one size
+// free objects are linked together through their first 8 bytes,
+// allocated objects carry no metadata at all
 typedef struct
 {
-    addr_range_t    address_range;
-
     size_t  size;
-    bool    is_full;
-    void    *objects[MAX_OBJECTS_PER_SLAB];
+    size_t  pages;		// pages requested from the PMM whenever the slab grows
+    size_t  object_count;	// objects carved out so far
+    size_t  free_count;		// objects currently in free_list
+    void    *free_list;
 } slab_t;
 
 void slab_init(void);
 void *slab_alloc(size_t size);
 void slab_free(void *ptr);
+void *slab_cache_alloc(size_t size);
+void slab_cache_free(void *ptr);
+size_t slab_get_size(uint8_t slab_index);
+size_t slab_round_size(size_t size);
 
 #endif
@@ -0,0 +1,181 @@
+/*
+	This file is part of an x86_64 hobbyist operating system called KnutOS
+	Everything is openly developed on GitHub: https://github.com/Tix3Dev/KnutOS/
+
+	Copyright (C) 2021-2022  Yves Vollmeier <https://github.com/Tix3Dev>
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <devices/cpu/cpu.h>
+#include <memory/mem.h>
+#include <memory/tlb.h>
+#include <smp/ipi.h>
+#include <libk/stdio/stdio.h>
+
+/*  Explanation of TLB shootdowns:
+    Every cpu caches translations in it's own TLB, so after a mapping
+    got removed or changed, all cpus have to invalidate it before the
+    page can be reused. Changes are collected in a tlb_batch_t as page
+    ranges (adjacent ones get merged) and tlb_batch_flush invalidates
+    them locally and on every other online cpu with one synchronous
+    smp_call_function, i.e. at most one IPI per cpu for the whole
+    batch. Up to TLB_FLUSH_ALL_PAGES pages are invalidated one by one
+    with invlpg, more than that (or more ranges than fit) flush the
+    whole TLB, global pages included.
+*/
+
+static uint64_t tlb_shootdowns = 0;
+static uint64_t tlb_pages_flushed = 0;
+static uint64_t tlb_full_flushes = 0;
+
+static inline void tlb_invlpg(uintptr_t address)
+{
+    asm volatile("invlpg (%0)" : : "r" (address) : "memory");
+}
+
+void tlb_flush_local_range(uintptr_t start, uintptr_t end)
+{
+    for (uintptr_t address = ALIGN_DOWN(start, PAGE_SIZE); address < end; address += PAGE_SIZE)
+        tlb_invlpg(address);
+}
+
+// a CR3 reload keeps global pages, toggling CR4.PGE drops them too
+void tlb_flush_local_all(void)
+{
+    uint64_t cr4 = read_cr4();
+
+    if (cr4 & (1 << 7))
+    {
+        write_cr4(cr4 & ~(1ULL << 7));
+        write_cr4(cr4);
+    }
+    else
+    {
+        uint64_t cr3;
+
+        asm volatile("mov %%cr3, %0" : "=r" (cr3));
+        asm volatile("mov %0, %%cr3" : : "r" (cr3) : "memory");
+    }
+}
+
+// flush a batch on the calling cpu, also the IPI function
+static void tlb_flush_batch_local(void *arg)
+{
+    tlb_batch_t *batch = arg;
+
+    if (batch->flush_all)
+    {
+        tlb_flush_local_all();
+
+        return;
+    }
+
+    for (size_t i = 0; i < batch->count; i++)
+        tlb_flush_local_range((uintptr_t)batch->ranges[i].start, (uintptr_t)batch->ranges[i].end);
+}
+
+void tlb_batch_init(tlb_batch_t *batch)
+{
+    batch->count = 0;
+    batch->pages = 0;
+    batch->flush_all = false;
+}
+
+// note that the translations of [start, end) changed
+void tlb_batch_add(tlb_batch_t *batch, uintptr_t start, uintptr_t end)
+{
+    start = ALIGN_DOWN(start, PAGE_SIZE);
+    end = ALIGN_UP(end, PAGE_SIZE);
+
+    if (batch->flush_all || start >= end)
+        return;
+
+    batch->pages += (end - start) / PAGE_SIZE;
+
+    if (batch->pages > TLB_FLUSH_ALL_PAGES)
+    {
+        batch->flush_all = true;
+
+        return;
+    }
+
+    // extend the last range, unmapping page after page is the common case
+    if (batch->count)
+    {
+        addr_range_t *last = &batch->ranges[batch->count - 1];
+
+        if ((uintptr_t)last->end == start)
+        {
+            last->end = (void *)end;
+
+            return;
+        }
+
+        if ((uintptr_t)last->start == end)
+        {
+            last->start = (void *)start;
+
+            return;
+        }
+    }
+
+    if (batch->count == TLB_BATCH_MAX_RANGES)
+    {
+        batch->flush_all = true;
+
+        return;
+    }
+
+    batch->ranges[batch->count].start = (void *)start;
+    batch->ranges[batch->count].end = (void *)end;
+    batch->count++;
+}
+
+// invalidate the batch on every online cpu, returns once all of them are done
+// -> only then the old pages may be reused
+void tlb_batch_flush(tlb_batch_t *batch)
+{
+    if (!batch->count && !batch->flush_all)
+        return;
+
+    // interrupts stay off across both halves, a thread moved to another cpu in
+    // between would skip that one
+    on_each_cpu(tlb_flush_batch_local, batch, true);
+
+    __atomic_fetch_add(&tlb_shootdowns, 1, __ATOMIC_RELAXED);
+
+    if (batch->flush_all)
+        __atomic_fetch_add(&tlb_full_flushes, 1, __ATOMIC_RELAXED);
+    else
+        __atomic_fetch_add(&tlb_pages_flushed, batch->pages, __ATOMIC_RELAXED);
+
+    tlb_batch_init(batch);
+}
+
+void tlb_shootdown_range(uintptr_t start, uintptr_t end)
+{
+    tlb_batch_t batch;
+
+    tlb_batch_init(&batch);
+    tlb_batch_add(&batch, start, end);
+    tlb_batch_flush(&batch);
+}
+
+void tlb_print_stats(void)
+{
+    printk(GFX_CYAN, "TLB shootdowns: %llu (%llu pages one by one, %llu full flushes)\n",
+           tlb_shootdowns, tlb_pages_flushed, tlb_full_flushes);
+}
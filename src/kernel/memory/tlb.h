@@ -0,0 +1,47 @@
+/*
+	This file is part of an x86_64 hobbyist operating system called KnutOS
+	Everything is openly developed on GitHub: https://github.com/Tix3Dev/KnutOS/
+
+	Copyright (C) 2021-2022  Yves Vollmeier <https://github.com/Tix3Dev>
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <libk/definitions.h>
+
+#ifndef TLB_H
+#define TLB_H
+
+#define TLB_FLUSH_ALL_PAGES	32	// above that many pages reloading the whole TLB is cheaper
+#define TLB_BATCH_MAX_RANGES	16
+
+// invalidations collected while changing page tables, flushed with one IPI round
+typedef struct
+{
+    addr_range_t    ranges[TLB_BATCH_MAX_RANGES];  // page aligned, end exclusive
+    size_t	    count;
+    size_t	    pages;
+    bool	    flush_all;	// too many ranges or pages
+} tlb_batch_t;
+
+void tlb_flush_local_range(uintptr_t start, uintptr_t end);
+void tlb_flush_local_all(void);
+void tlb_batch_init(tlb_batch_t *batch);
+void tlb_batch_add(tlb_batch_t *batch, uintptr_t start, uintptr_t end);
+void tlb_batch_flush(tlb_batch_t *batch);
+void tlb_shootdown_range(uintptr_t start, uintptr_t end);
+void tlb_print_stats(void);
+
+#endif
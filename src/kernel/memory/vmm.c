@@ -21,6 +21,7 @@
 #include <boot/stivale2.h>
 #include <boot/stivale2_boot.h>
 #include <memory/pmm.h>
+#include <memory/tlb.h>
 #include <memory/vmm.h>
 #include <libk/debug/debug.h>
 #include <libk/log/log.h>
@@ -95,6 +96,12 @@ void vmm_init(void)
     kernel_log(INFO, "VMM initialized\n");
 }
 
+// page directory set up by vmm_init, shared by all cpus
+PAGE_DIR vmm_get_kernel_page_directory(void)
+{
+    return root_page_directory;
+}
+
 // set each table in the page directory to not used
 PAGE_DIR vmm_create_page_directory(void)
 {
@@ -203,7 +210,8 @@ void vmm_map_page(PAGE_DIR current_page_directory, uintptr_t physical_address, u
     vmm_flush_tlb((void *)virtual_address);
 }
 
-void vmm_unmap_page(PAGE_DIR current_page_directory, uintptr_t virtual_address)
+// remove the mapping, the TLBs still have to be flushed
+static void vmm_clear_page(PAGE_DIR current_page_directory, uintptr_t virtual_address)
 {
     if (is_la57_enabled())	// 5-level paging is enabled
     {
@@ -246,8 +254,29 @@ void vmm_unmap_page(PAGE_DIR current_page_directory, uintptr_t virtual_address)
 
         page_map_level1[index1] = 0;
     }
+}
 
-    vmm_flush_tlb((void *)virtual_address);
+// unmap a page on every cpu
+void vmm_unmap_page(PAGE_DIR current_page_directory, uintptr_t virtual_address)
+{
+    vmm_clear_page(current_page_directory, virtual_address);
+    tlb_shootdown_range(virtual_address, virtual_address + PAGE_SIZE);
+}
+
+// unmap page_count pages with a single shootdown for all of them
+void vmm_unmap_range(PAGE_DIR current_page_directory, uintptr_t virtual_address, size_t page_count)
+{
+    tlb_batch_t batch;
+
+    tlb_batch_init(&batch);
+
+    for (size_t i = 0; i < page_count; i++)
+    {
+        vmm_clear_page(current_page_directory, virtual_address + i * PAGE_SIZE);
+        tlb_batch_add(&batch, virtual_address + i * PAGE_SIZE, virtual_address + (i + 1) * PAGE_SIZE);
+    }
+
+    tlb_batch_flush(&batch);
 }
 
 // invalidate a single page in the translation lookaside buffer
@@ -15,6 +15,9 @@
 	along with this program.  If not, see <https://www.gnu.org/licenses/>.
 */
 
+#include <stddef.h>
+#include <stdint.h>
+
 #include <memory/mem.h>
 
 #ifndef VMM_H
@@ -37,9 +40,11 @@ typedef uint64_t *PAGE_DIR;
 
 bool is_la57_enabled(void);
 void vmm_init(void);
+PAGE_DIR vmm_get_kernel_page_directory(void);
 PAGE_DIR vmm_create_page_directory(void);
 void vmm_map_page(PAGE_DIR vmm, uintptr_t physical_address, uintptr_t virtual_address, int flags);
 void vmm_unmap_page(PAGE_DIR current_page_directory, uintptr_t virtual_address);
+void vmm_unmap_range(PAGE_DIR current_page_directory, uintptr_t virtual_address, size_t page_count);
 void vmm_flush_tlb(void *address);
 void vmm_activate_page_directory(PAGE_DIR vmm);
 
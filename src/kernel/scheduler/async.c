@@ -0,0 +1,344 @@
+/*
+	This file is part of an x86_64 hobbyist operating system called KnutOS
+	Everything is openly developed on GitHub: https://github.com/Tix3Dev/KnutOS/
+
+	Copyright (C) 2021-2022  Yves Vollmeier <https://github.com/Tix3Dev>
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <boot/stivale2.h>
+#include <devices/cpu/cpu.h>
+#include <scheduler/async.h>
+#include <scheduler/thread.h>
+#include <smp/smp.h>
+#include <time/timer.h>
+#include <libk/alloc/kmalloc.h>
+#include <libk/kprintf/kprintf.h>
+#include <libk/lock/spinlock.h>
+#include <libk/log/log.h>
+#include <libk/stdio/stdio.h>
+
+/*  Explanation of async tasks:
+    A driver operation that mostly waits (for a timeout, an IRQ, a
+    request to complete) doesn't need a thread and it's 16 KiB stack.
+    An async_task is a stackless coroutine: a poll function that runs
+    until it has to wait, records where it stopped (ASYNC_AWAIT stores
+    the line, ASYNC_BEGIN switches back to it) and returns
+    ASYNC_PENDING. Whatever it waits for calls async_wake, which puts
+    the task on the ready queue of it's executor, and the next poll
+    continues after the await. A task costs sizeof(async_task_t), so a
+    driver can keep thousands of operations in flight.
+
+    Every cpu has an executor thread that polls the tasks of it's ready
+    queue one after another, like a workqueue worker. A task always
+    belongs to the same executor, so it's never polled twice at once.
+    queued is cleared right before the poll, a wakeup that comes in
+    while it runs queues the task again and it just gets polled once
+    more, awaits check their condition again anyway.
+
+    Poll functions run in thread context but must not block, that
+    would stall every other task of the executor. Things to await:
+    - ASYNC_SLEEP: a timer of the timer wheel wakes the task
+    - ASYNC_WAIT_EVENT: an async_event, signalled by interrupt
+      handlers or whoever completes an I/O request
+*/
+
+static async_executor_t	*async_executors = NULL;
+static size_t		async_executor_count = 0;
+static spinlock_t	async_event_locks[ASYNC_EVENT_LOCKS];
+
+static inline spinlock_t *async_event_lock(async_event_t *event)
+{
+    return &async_event_locks[((uintptr_t)event >> 4) % ASYNC_EVENT_LOCKS];
+}
+
+// take task off the waiters of event (lock of event held)
+static void async_event_remove_waiter(async_event_t *event, async_task_t *task)
+{
+    async_task_t *prev = NULL;
+
+    for (async_task_t *waiter = event->head; waiter; prev = waiter, waiter = waiter->wait_next)
+    {
+        if (waiter != task)
+            continue;
+
+        if (prev)
+            prev->wait_next = task->wait_next;
+        else
+            event->head = task->wait_next;
+
+        if (event->tail == task)
+            event->tail = prev;
+
+        break;
+    }
+
+    task->wait_next = NULL;
+    task->waiting_on = NULL;
+}
+
+static void async_executor_main(void *arg)
+{
+    async_executor_t *executor = arg;
+
+    for (;;)
+    {
+        // marked blocked before looking, so an async_wake in between isn't lost
+        thread_prepare_block();
+
+        uint64_t rflags = spinlock_acquire_irqsave(&executor->lock);
+        async_task_t *task = executor->head;
+
+        if (!task)
+        {
+            spinlock_release_irqrestore(&executor->lock, rflags);
+            thread_yield();
+            continue;
+        }
+
+        executor->head = task->next;
+
+        if (!executor->head)
+            executor->tail = NULL;
+
+        task->next = NULL;
+        __atomic_store_n(&task->queued, false, __ATOMIC_RELEASE);
+        executor->polls++;
+
+        spinlock_release_irqrestore(&executor->lock, rflags);
+
+        thread_cancel_block();
+
+        if (task->poll(task) == ASYNC_DONE)
+        {
+            __atomic_fetch_add(&executor->completed, 1, __ATOMIC_RELAXED);
+
+            if (task->done)
+                task->done(task);
+        }
+    }
+}
+
+static void async_timer_callback(void *arg)
+{
+    async_task_t *task = arg;
+
+    task->timer_fired = true;
+    async_wake(task);
+}
+
+// start an executor on every cpu, call after smp_init
+void async_init(void)
+{
+    for (size_t i = 0; i < ASYNC_EVENT_LOCKS; i++)
+        spinlock_init(&async_event_locks[i], "async event");
+
+    size_t count = smp_cpu_count ? smp_cpu_count : 1;
+    async_executor_t *executors = kcalloc(count, sizeof(async_executor_t));
+
+    if (!executors)
+    {
+        serial_log(ERROR, "Async executors: out of memory\n");
+        kernel_log(ERROR, "Async executors: out of memory\n");
+
+        return;
+    }
+
+    for (size_t i = 0; i < count; i++)
+    {
+        async_executor_t *executor = &executors[i];
+        char thread_name[THREAD_NAME_LENGTH];
+
+        spinlock_init(&executor->lock, "async executor");
+        snprintf(thread_name, sizeof(thread_name), "async/%d", (int)i);
+
+        executor->thread = thread_create_on_cpu(thread_name, async_executor_main, executor, THREAD_PRIORITY_HIGH, i);
+
+        if (!executor->thread)
+        {
+            serial_log(ERROR, "Async executors: couldn't create the executor of cpu %d\n", (int)i);
+            kernel_log(ERROR, "Async executors: couldn't create the executor of cpu %d\n", (int)i);
+        }
+    }
+
+    async_executors = executors;
+    async_executor_count = count;
+
+    serial_log(INFO, "Async executors initialized: %d executors, %d bytes per task\n",
+               (int)count, (int)sizeof(async_task_t));
+    kernel_log(INFO, "Async executors initialized: %d executors, %d bytes per task\n",
+               (int)count, (int)sizeof(async_task_t));
+}
+
+void async_task_init(async_task_t *task, async_status_t (*poll)(async_task_t *task),
+                     void (*done)(async_task_t *task), void *arg)
+{
+    task->poll = poll;
+    task->done = done;
+    task->arg = arg;
+
+    task->resume = 0;
+    task->cpu = 0;
+    task->queued = false;
+    task->timer_fired = false;
+
+    task->next = NULL;
+    task->wait_next = NULL;
+    task->waiting_on = NULL;
+    timer_init(&task->timer, async_timer_callback, task);
+}
+
+// hand the task to the executor of cpu, it gets polled the first time soon
+// returns false if there are no executors yet
+bool async_spawn_on(async_task_t *task, size_t cpu)
+{
+    if (!async_executors)
+        return false;
+
+    async_executor_t *executor = &async_executors[cpu % async_executor_count];
+
+    task->cpu = executor - async_executors;
+    __atomic_fetch_add(&executor->spawned, 1, __ATOMIC_RELAXED);
+
+    async_wake(task);
+
+    return true;
+}
+
+// spawn on the executor of the calling cpu
+bool async_spawn(async_task_t *task)
+{
+    uint64_t rflags = cpu_save_and_disable_interrupts();
+
+    bool spawned = async_spawn_on(task, smp_get_current_cpu());
+
+    cpu_restore_interrupts(rflags);
+
+    return spawned;
+}
+
+// queue the task to be polled again, callable from interrupt handlers
+// -> does nothing if it's queued already
+void async_wake(async_task_t *task)
+{
+    if (__atomic_exchange_n(&task->queued, true, __ATOMIC_ACQ_REL))
+        return;
+
+    async_executor_t *executor = &async_executors[task->cpu];
+    uint64_t rflags = spinlock_acquire_irqsave(&executor->lock);
+
+    task->next = NULL;
+
+    if (executor->tail)
+        executor->tail->next = task;
+    else
+        executor->head = task;
+
+    executor->tail = task;
+
+    spinlock_release_irqrestore(&executor->lock, rflags);
+
+    if (executor->thread)
+        thread_unblock(executor->thread);
+}
+
+// arm the timer of ASYNC_SLEEP, the await then waits for timer_fired
+void async_sleep_start(async_task_t *task, uint64_t ms)
+{
+    task->timer_fired = false;
+    timer_add(&task->timer, timer_get_jiffies() + timer_ms_to_jiffies(ms));
+}
+
+void async_event_init(async_event_t *event)
+{
+    *event = (async_event_t)ASYNC_EVENT_INIT;
+}
+
+// let one await through, wakes the oldest waiter, callable from interrupt handlers
+void async_event_signal(async_event_t *event)
+{
+    spinlock_t *lock = async_event_lock(event);
+    uint64_t rflags = spinlock_acquire_irqsave(lock);
+
+    async_task_t *task = event->head;
+
+    event->count++;
+
+    if (task)
+    {
+        event->head = task->wait_next;
+
+        if (!event->head)
+            event->tail = NULL;
+
+        task->wait_next = NULL;
+        task->waiting_on = NULL;
+
+        // still under the lock, the task can't consume the signal, finish and be freed before
+        async_wake(task);
+    }
+
+    spinlock_release_irqrestore(lock, rflags);
+}
+
+// the condition of ASYNC_WAIT_EVENT: consume a signal, or register task as a waiter
+// -> another task may consume the signal first, the woken one then just waits again
+bool async_event_try_wait(async_event_t *event, async_task_t *task)
+{
+    spinlock_t *lock = async_event_lock(event);
+    uint64_t rflags = spinlock_acquire_irqsave(lock);
+
+    bool signalled = event->count > 0;
+
+    if (signalled)
+    {
+        event->count--;
+
+        // woken by something else, a later signal must not wake a finished task
+        if (task->waiting_on == event)
+            async_event_remove_waiter(event, task);
+    }
+    else if (task->waiting_on != event)
+    {
+        task->wait_next = NULL;
+        task->waiting_on = event;
+
+        if (event->tail)
+            event->tail->wait_next = task;
+        else
+            event->head = task;
+
+        event->tail = task;
+    }
+
+    spinlock_release_irqrestore(lock, rflags);
+
+    return signalled;
+}
+
+void async_print_stats(void)
+{
+    printk(GFX_CYAN, "%-16s %-4s %-10s %-10s %s\n", "executor", "cpu", "spawned", "polls", "completed");
+
+    for (size_t i = 0; i < async_executor_count; i++)
+    {
+        async_executor_t *executor = &async_executors[i];
+
+        printk(GFX_WHITE, "%-16s %-4d %-10llu %-10llu %llu\n",
+               executor->thread ? executor->thread->name : "-", i, executor->spawned, executor->polls,
+               executor->completed);
+    }
+}
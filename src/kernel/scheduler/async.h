@@ -0,0 +1,130 @@
+/*
+	This file is part of an x86_64 hobbyist operating system called KnutOS
+	Everything is openly developed on GitHub: https://github.com/Tix3Dev/KnutOS/
+
+	Copyright (C) 2021-2022  Yves Vollmeier <https://github.com/Tix3Dev>
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <scheduler/thread.h>
+#include <time/timer.h>
+#include <libk/definitions.h>
+#include <libk/lock/spinlock.h>
+
+#ifndef ASYNC_H
+#define ASYNC_H
+
+#define ASYNC_EVENT_LOCKS	64	// events hash onto these, so they need no lock of their own
+
+typedef enum
+{
+    ASYNC_PENDING,	// waits for something, polled again once it's woken up
+    ASYNC_DONE
+} async_status_t;
+
+struct async_event;
+
+// stackless coroutine, usually embedded in the request it works on
+// -> locals don't survive an await, keep the state in the surrounding struct
+typedef struct async_task
+{
+    async_status_t	(*poll)(struct async_task *task);
+    void		(*done)(struct async_task *task);   // after the last poll, may free the task
+    void		*arg;
+
+    uint32_t		resume;		// line of the await to continue at, 0 = start
+    size_t		cpu;		// executor that polls it
+    volatile bool	queued;		// in the ready queue of it's executor
+    volatile bool	timer_fired;
+
+    struct async_task	*next;		// ready queue
+    struct async_task	*wait_next;	// waiters of an event
+    struct async_event	*waiting_on;
+    timer_t		timer;		// ASYNC_SLEEP
+} async_task_t;
+
+// counting event for IRQs and I/O completions, every signal lets one await through
+typedef struct async_event
+{
+    uint32_t		count;		// signals not consumed yet
+    async_task_t	*head;		// waiters, FIFO
+    async_task_t	*tail;
+} async_event_t;
+
+#define ASYNC_EVENT_INIT	{ .count = 0, .head = NULL, .tail = NULL }
+
+// the ready queue and executor thread of one cpu
+typedef struct
+{
+    spinlock_t		lock;
+    async_task_t	*head;
+    async_task_t	*tail;
+    thread_t		*thread;
+
+    uint64_t		spawned;
+    uint64_t		polls;
+    uint64_t		completed;
+} async_executor_t;
+
+// the body of a poll function: ASYNC_BEGIN, awaits, ASYNC_END
+// -> a switch on the resume line (Duff's device), awaits can't share a line
+#define ASYNC_BEGIN(task)	switch ((task)->resume) { case 0:
+
+#define ASYNC_END(task)		} (task)->resume = 0; return ASYNC_DONE
+
+// continue once condition is true, it's evaluated again on every wakeup
+#define ASYNC_AWAIT(task, condition)					\
+    do									\
+    {									\
+        (task)->resume = __LINE__;					\
+        __attribute__((fallthrough));					\
+    case __LINE__:							\
+        if (!(condition))						\
+            return ASYNC_PENDING;					\
+    } while (0)
+
+// let the other tasks of the executor run first
+#define ASYNC_YIELD(task)						\
+    do									\
+    {									\
+        (task)->resume = __LINE__;					\
+        async_wake(task);						\
+        return ASYNC_PENDING;						\
+    case __LINE__:;							\
+    } while (0)
+
+#define ASYNC_SLEEP(task, ms)						\
+    do									\
+    {									\
+        async_sleep_start((task), (ms));				\
+        ASYNC_AWAIT((task), (task)->timer_fired);			\
+    } while (0)
+
+#define ASYNC_WAIT_EVENT(task, event)	ASYNC_AWAIT((task), async_event_try_wait((event), (task)))
+
+void async_init(void);
+void async_task_init(async_task_t *task, async_status_t (*poll)(async_task_t *task),
+                     void (*done)(async_task_t *task), void *arg);
+bool async_spawn(async_task_t *task);
+bool async_spawn_on(async_task_t *task, size_t cpu);
+void async_wake(async_task_t *task);
+void async_sleep_start(async_task_t *task, uint64_t ms);
+void async_event_init(async_event_t *event);
+void async_event_signal(async_event_t *event);
+bool async_event_try_wait(async_event_t *event, async_task_t *task);
+void async_print_stats(void);
+
+#endif
@@ -0,0 +1,107 @@
+/*
+	This file is part of an x86_64 hobbyist operating system called KnutOS
+	Everything is openly developed on GitHub: https://github.com/Tix3Dev/KnutOS/
+
+	Copyright (C) 2021-2022  Yves Vollmeier <https://github.com/Tix3Dev>
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <scheduler/completion.h>
+#include <scheduler/wait.h>
+
+void completion_init(completion_t *completion, const char *name)
+{
+    *completion = (completion_t)COMPLETION_INIT(name);
+}
+
+// for completions on the stack or in freed memory, once the wait returned
+void completion_destroy(completion_t *completion)
+{
+    wait_queue_destroy(&completion->waiters);
+}
+
+// make it reusable, nobody may be waiting on it
+void reinit_completion(completion_t *completion)
+{
+    __atomic_store_n(&completion->done, 0, __ATOMIC_RELEASE);
+}
+
+// consume one completion if there is one, never sleeps
+// -> done only changes under the queue lock, so once a waiter saw it the
+//    completer is finished with the completion and it may be freed
+bool try_wait_for_completion(completion_t *completion)
+{
+    uint64_t rflags = spinlock_acquire_irqsave(&completion->waiters.lock);
+    bool done = completion->done > 0;
+
+    if (done && completion->done != COMPLETION_DONE_ALL)
+        completion->done--;
+
+    spinlock_release_irqrestore(&completion->waiters.lock, rflags);
+
+    return done;
+}
+
+void wait_for_completion(completion_t *completion)
+{
+    if (try_wait_for_completion(completion))
+        return;
+
+    wait_event(&completion->waiters, try_wait_for_completion(completion));
+}
+
+// returns false if it didn't complete within ms milliseconds
+bool wait_for_completion_timeout(completion_t *completion, uint64_t ms)
+{
+    if (try_wait_for_completion(completion))
+        return true;
+
+    return wait_event_timeout(&completion->waiters, try_wait_for_completion(completion), ms);
+}
+
+// whether a wait would return right away
+bool completion_done(completion_t *completion)
+{
+    uint64_t rflags = spinlock_acquire_irqsave(&completion->waiters.lock);
+    bool done = completion->done != 0;
+
+    spinlock_release_irqrestore(&completion->waiters.lock, rflags);
+
+    return done;
+}
+
+// wake up one waiter, or let the next wait return right away (usable from interrupt handlers)
+void complete(completion_t *completion)
+{
+    uint64_t rflags = spinlock_acquire_irqsave(&completion->waiters.lock);
+
+    if (completion->done != COMPLETION_DONE_ALL)
+        completion->done++;
+
+    wake_up_one_locked(&completion->waiters);
+
+    spinlock_release_irqrestore(&completion->waiters.lock, rflags);
+}
+
+// wake up every waiter, all later waits return right away until reinit_completion
+void complete_all(completion_t *completion)
+{
+    uint64_t rflags = spinlock_acquire_irqsave(&completion->waiters.lock);
+
+    completion->done = COMPLETION_DONE_ALL;
+    wake_up_all_locked(&completion->waiters);
+
+    spinlock_release_irqrestore(&completion->waiters.lock, rflags);
+}
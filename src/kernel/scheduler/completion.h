@@ -0,0 +1,47 @@
+/*
+	This file is part of an x86_64 hobbyist operating system called KnutOS
+	Everything is openly developed on GitHub: https://github.com/Tix3Dev/KnutOS/
+
+	Copyright (C) 2021-2022  Yves Vollmeier <https://github.com/Tix3Dev>
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <scheduler/wait.h>
+
+#ifndef COMPLETION_H
+#define COMPLETION_H
+
+#define COMPLETION_DONE_ALL	UINT32_MAX	// complete_all: every present and future wait returns
+
+// "this has happened" event, e.g. a thread waiting for a device request to finish
+typedef struct
+{
+    volatile uint32_t	done;	    // completions not consumed by a wait yet
+    wait_queue_t	waiters;
+} completion_t;
+
+#define COMPLETION_INIT(completion_name)	{ .done = 0, .waiters = WAIT_QUEUE_INIT(completion_name) }
+
+void completion_init(completion_t *completion, const char *name);
+void completion_destroy(completion_t *completion);
+void reinit_completion(completion_t *completion);
+void wait_for_completion(completion_t *completion);
+bool wait_for_completion_timeout(completion_t *completion, uint64_t ms);
+bool try_wait_for_completion(completion_t *completion);
+bool completion_done(completion_t *completion);
+void complete(completion_t *completion);
+void complete_all(completion_t *completion);
+
+#endif
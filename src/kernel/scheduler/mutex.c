@@ -0,0 +1,127 @@
+/*
+	This file is part of an x86_64 hobbyist operating system called KnutOS
+	Everything is openly developed on GitHub: https://github.com/Tix3Dev/KnutOS/
+
+	Copyright (C) 2021-2022  Yves Vollmeier <https://github.com/Tix3Dev>
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include <scheduler/mutex.h>
+#include <scheduler/thread.h>
+#include <scheduler/wait.h>
+#include <smp/smp.h>
+#include <libk/lock/lock_stat.h>
+
+/*  Explanation of the mutex:
+    Taking a free mutex is a single compare-and-swap of the owner field.
+    If it's taken, sleeping right away would cost two context switches,
+    which is a waste when the owner is running on another cpu and about
+    to release it. So the waiter spins (adaptive spinning) as long as the
+    owner is on a cpu, at most MUTEX_SPIN_LIMIT iterations. Once the
+    owner is preempted or blocked itself, or the limit is reached, the
+    waiter sleeps on the wait queue until mutex_unlock wakes one up.
+
+    A woken waiter competes with spinners and new lockers for the mutex
+    and goes back to sleep if it loses. That's unfair, but keeps the
+    mutex busy instead of handing it to a thread that first has to be
+    scheduled in.
+
+    The owner's descriptor is only read while spinning; thread
+    descriptors come from the slab allocator and stay mapped, so reading
+    a stale one just ends the spin.
+*/
+
+static inline bool mutex_try_acquire(mutex_t *mutex, thread_t *self)
+{
+    thread_t *expected = NULL;
+
+    return __atomic_compare_exchange_n(&mutex->owner, &expected, self, false,
+                                       __ATOMIC_ACQUIRE, __ATOMIC_RELAXED);
+}
+
+// returns whether the mutex got acquired while spinning
+static bool mutex_spin_on_owner(mutex_t *mutex, thread_t *self)
+{
+    if (smp_cpu_count < 2)
+        return false;
+
+    for (size_t i = 0; i < MUTEX_SPIN_LIMIT; i++)
+    {
+        thread_t *owner = mutex->owner;
+
+        if (!owner)
+        {
+            if (mutex_try_acquire(mutex, self))
+                return true;
+        }
+        else if (!owner->on_cpu)
+        {
+            return false;
+        }
+
+        asm volatile("pause");
+    }
+
+    return false;
+}
+
+void mutex_init(mutex_t *mutex, const char *name)
+{
+    *mutex = (mutex_t)MUTEX_INIT(name);
+}
+
+// may sleep, never call it from an interrupt handler or with interrupts off
+void mutex_lock(mutex_t *mutex)
+{
+    thread_t *self = thread_current();
+    bool contended = false;
+
+    if (!mutex_try_acquire(mutex, self))
+    {
+        contended = true;
+
+        if (!mutex_spin_on_owner(mutex, self))
+            wait_event(&mutex->waiters, mutex_try_acquire(mutex, self));
+    }
+
+    lock_stat_acquired(&mutex->stat, contended, true);
+}
+
+bool mutex_trylock(mutex_t *mutex)
+{
+    if (!mutex_try_acquire(mutex, thread_current()))
+        return false;
+
+    lock_stat_acquired(&mutex->stat, false, true);
+
+    return true;
+}
+
+void mutex_unlock(mutex_t *mutex)
+{
+    lock_stat_released(&mutex->stat);
+
+    // seq_cst store = xchg, a full barrier, so the waiter check below can't pass the release
+    // -> a waiter queues itself before it retries the compare-and-swap
+    __atomic_store_n(&mutex->owner, NULL, __ATOMIC_SEQ_CST);
+
+    if (wait_queue_has_waiters(&mutex->waiters))
+        wake_up_one(&mutex->waiters);
+}
+
+bool mutex_is_locked(mutex_t *mutex)
+{
+    return mutex->owner != NULL;
+}
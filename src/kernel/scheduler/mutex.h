@@ -0,0 +1,46 @@
+/*
+	This file is part of an x86_64 hobbyist operating system called KnutOS
+	Everything is openly developed on GitHub: https://github.com/Tix3Dev/KnutOS/
+
+	Copyright (C) 2021-2022  Yves Vollmeier <https://github.com/Tix3Dev>
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <stdbool.h>
+
+#include <scheduler/thread.h>
+#include <scheduler/wait.h>
+#include <libk/lock/lock_stat.h>
+
+#ifndef MUTEX_H
+#define MUTEX_H
+
+#define MUTEX_SPIN_LIMIT	10000	// pause iterations spent on a running owner before sleeping
+
+// sleeping lock, only for thread context
+typedef struct
+{
+    thread_t *volatile	owner;	    // NULL if the mutex is free
+    wait_queue_t	waiters;
+    lock_stat_t		stat;
+} mutex_t;
+
+#define MUTEX_INIT(mutex_name)						\
+    { .owner = NULL, .waiters = WAIT_QUEUE_INIT(mutex_name), .stat = LOCK_STAT_INIT(mutex_name, "mutex") }
+
+void mutex_init(mutex_t *mutex, const char *name);
+void mutex_lock(mutex_t *mutex);
+bool mutex_trylock(mutex_t *mutex);
+void mutex_unlock(mutex_t *mutex);
+bool mutex_is_locked(mutex_t *mutex);
+
+#endif
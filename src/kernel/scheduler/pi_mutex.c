@@ -0,0 +1,318 @@
+/*
+	This file is part of an x86_64 hobbyist operating system called KnutOS
+	Everything is openly developed on GitHub: https://github.com/Tix3Dev/KnutOS/
+
+	Copyright (C) 2021-2022  Yves Vollmeier <https://github.com/Tix3Dev>
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <scheduler/pi_mutex.h>
+#include <scheduler/scheduler.h>
+#include <scheduler/thread.h>
+#include <libk/debug/debug.h>
+#include <libk/lock/lock_stat.h>
+#include <libk/lock/spinlock.h>
+
+/*  Explanation of the priority inheritance mutex:
+    With a plain mutex, a high priority thread waiting for a lock held
+    by a low priority one waits for every medium priority thread that
+    preempts the owner in the meantime (unbounded priority inversion).
+    A pi_mutex lends the owner the priority of it's highest waiter until
+    it unlocks. If the owner is blocked on another pi_mutex itself, the
+    boost is passed on to that mutex's owner and so on, at most
+    PI_MUTEX_MAX_CHAIN links (that also ends the walk on a deadlock
+    cycle). Deadline threads count as THREAD_PRIORITY_HIGH waiters.
+
+    Taking a free mutex and releasing one without waiters is a single
+    compare-and-swap of the owner field. Everything else happens under
+    the global pi_lock, which keeps the waiter lists, blocked-on links
+    and the per thread lists of held mutexes consistent across a chain.
+    A waiter sets PI_MUTEX_HAS_WAITERS in the owner field, so the owner
+    has to take the slow path. There the mutex is handed directly to
+    the highest priority waiter, nobody can steal it in between, and
+    the old owner falls back to the priority it still inherits through
+    other mutexes.
+
+    Lock order: pi_lock, then run queue locks.
+*/
+
+static spinlock_t   pi_lock = SPINLOCK_INIT("pi mutex");
+static uint64_t	    pi_boosts = 0;
+
+static inline thread_t *pi_mutex_owner(pi_mutex_t *mutex)
+{
+    return (thread_t *)(mutex->owner & ~(uintptr_t)PI_MUTEX_HAS_WAITERS);
+}
+
+// deadline threads run before every priority anyway
+static inline thread_priority_t pi_thread_priority(thread_t *thread)
+{
+    return thread->policy == THREAD_POLICY_DEADLINE ? THREAD_PRIORITY_HIGH : thread->priority;
+}
+
+static inline bool pi_mutex_try_acquire(pi_mutex_t *mutex, thread_t *self)
+{
+    uintptr_t expected = 0;
+
+    return __atomic_compare_exchange_n(&mutex->owner, &expected, (uintptr_t)self, false,
+                                       __ATOMIC_ACQUIRE, __ATOMIC_RELAXED);
+}
+
+// the pi_lock has to be held for all of the following
+
+static void pi_waiter_insert(pi_mutex_t *mutex, pi_waiter_t *waiter)
+{
+    thread_priority_t priority = pi_thread_priority(waiter->thread);
+    pi_waiter_t **link = &mutex->waiters;
+
+    while (*link && pi_thread_priority((*link)->thread) <= priority)
+        link = &(*link)->next;
+
+    waiter->next = *link;
+    *link = waiter;
+}
+
+// the priority of a waiter changed, move it to it's new place
+static void pi_waiter_requeue(pi_mutex_t *mutex, thread_t *thread)
+{
+    for (pi_waiter_t **link = &mutex->waiters; *link; link = &(*link)->next)
+    {
+        pi_waiter_t *waiter = *link;
+
+        if (waiter->thread != thread)
+            continue;
+
+        *link = waiter->next;
+        pi_waiter_insert(mutex, waiter);
+
+        return;
+    }
+}
+
+static void pi_held_remove(thread_t *thread, pi_mutex_t *mutex)
+{
+    for (pi_mutex_t **link = &thread->pi_held; *link; link = &(*link)->held_next)
+    {
+        if (*link == mutex)
+        {
+            *link = mutex->held_next;
+            mutex->held_next = NULL;
+
+            return;
+        }
+    }
+}
+
+// own priority, or the one of the highest waiter of any held mutex if that's higher
+static thread_priority_t pi_effective_priority(thread_t *thread)
+{
+    thread_priority_t priority = thread->base_priority;
+
+    for (pi_mutex_t *mutex = thread->pi_held; mutex; mutex = mutex->held_next)
+    {
+        thread_priority_t inherited = pi_thread_priority(mutex->waiters->thread);
+
+        if (inherited < priority)
+            priority = inherited;
+    }
+
+    return priority;
+}
+
+// recompute the priority of thread and pass a change on along the chain of owners
+static void pi_adjust_chain(thread_t *thread)
+{
+    for (size_t depth = 0; depth < PI_MUTEX_MAX_CHAIN; depth++)
+    {
+        thread_priority_t priority = pi_effective_priority(thread);
+
+        if (priority == thread->priority)
+            return;
+
+        if (priority < thread->priority)
+            pi_boosts++;
+
+        trace("pi: %s tid %d (%s) from %s to %s, chain depth %d\n",
+              priority < thread->priority ? "boost" : "unboost", thread->tid, thread->name,
+              thread_priority_to_string(thread->priority), thread_priority_to_string(priority), depth);
+
+        scheduler_set_priority(thread, priority);
+
+        pi_mutex_t *mutex = thread->pi_blocked_on;
+
+        if (!mutex)
+            return;
+
+        pi_waiter_requeue(mutex, thread);
+        thread = pi_mutex_owner(mutex);
+    }
+}
+
+static void pi_mutex_lock_slow(pi_mutex_t *mutex, thread_t *self)
+{
+    pi_waiter_t waiter = {.thread = self, .next = NULL};
+    uint64_t rflags = spinlock_acquire_irqsave(&pi_lock);
+
+    // announce ourselves, from now on the owner can't release it on the fast path
+    for (;;)
+    {
+        uintptr_t owner = mutex->owner;
+
+        // got free in the meantime (a mutex with waiters is handed over instead)
+        if (!owner)
+        {
+            if (pi_mutex_try_acquire(mutex, self))
+            {
+                spinlock_release_irqrestore(&pi_lock, rflags);
+                return;
+            }
+
+            continue;
+        }
+
+        if ((owner & PI_MUTEX_HAS_WAITERS) ||
+                __atomic_compare_exchange_n(&mutex->owner, &owner, owner | PI_MUTEX_HAS_WAITERS, false,
+                                            __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+            break;
+    }
+
+    thread_t *owner = pi_mutex_owner(mutex);
+
+    // first waiter: the owner's priority depends on this mutex from now on
+    if (!mutex->waiters)
+    {
+        mutex->held_next = owner->pi_held;
+        owner->pi_held = mutex;
+    }
+
+    pi_waiter_insert(mutex, &waiter);
+    self->pi_blocked_on = mutex;
+
+    pi_adjust_chain(owner);
+
+    // pi_mutex_unlock hands the mutex over and wakes us up under the pi_lock,
+    // so being marked blocked before dropping it can't miss that
+    while (pi_mutex_owner(mutex) != self)
+    {
+        thread_prepare_block();
+        spinlock_release_irqrestore(&pi_lock, rflags);
+
+        thread_yield();
+
+        rflags = spinlock_acquire_irqsave(&pi_lock);
+    }
+
+    spinlock_release_irqrestore(&pi_lock, rflags);
+}
+
+static void pi_mutex_unlock_slow(pi_mutex_t *mutex, thread_t *self)
+{
+    uint64_t rflags = spinlock_acquire_irqsave(&pi_lock);
+
+    pi_waiter_t *top = mutex->waiters;
+    thread_t *next = top->thread;
+
+    // top lives on next's stack, don't touch it once next can run
+    mutex->waiters = top->next;
+    next->pi_blocked_on = NULL;
+
+    pi_held_remove(self, mutex);
+
+    if (mutex->waiters)
+    {
+        mutex->held_next = next->pi_held;
+        next->pi_held = mutex;
+    }
+
+    __atomic_store_n(&mutex->owner, (uintptr_t)next | (mutex->waiters ? PI_MUTEX_HAS_WAITERS : 0),
+                     __ATOMIC_RELEASE);
+
+    // drop what we inherited through this mutex, the new owner inherits from the remaining waiters
+    pi_adjust_chain(self);
+    pi_adjust_chain(next);
+
+    bool yield = pi_thread_priority(next) < pi_thread_priority(self);
+
+    thread_unblock(next);
+
+    spinlock_release_irqrestore(&pi_lock, rflags);
+
+    // let it run right away if it's more important than we are now
+    if (yield)
+        thread_yield();
+}
+
+void pi_mutex_init(pi_mutex_t *mutex, const char *name)
+{
+    *mutex = (pi_mutex_t)PI_MUTEX_INIT(name);
+}
+
+// may sleep, never call it from an interrupt handler or with interrupts off
+void pi_mutex_lock(pi_mutex_t *mutex)
+{
+    thread_t *self = thread_current();
+    bool contended = false;
+
+    if (!pi_mutex_try_acquire(mutex, self))
+    {
+        contended = true;
+        pi_mutex_lock_slow(mutex, self);
+    }
+
+    lock_stat_acquired(&mutex->stat, contended, true);
+}
+
+bool pi_mutex_trylock(pi_mutex_t *mutex)
+{
+    if (!pi_mutex_try_acquire(mutex, thread_current()))
+        return false;
+
+    lock_stat_acquired(&mutex->stat, false, true);
+
+    return true;
+}
+
+void pi_mutex_unlock(pi_mutex_t *mutex)
+{
+    thread_t *self = thread_current();
+    uintptr_t expected = (uintptr_t)self;
+
+    lock_stat_released(&mutex->stat);
+
+    if (!__atomic_compare_exchange_n(&mutex->owner, &expected, 0, false, __ATOMIC_RELEASE, __ATOMIC_RELAXED))
+        pi_mutex_unlock_slow(mutex, self);
+}
+
+bool pi_mutex_is_locked(pi_mutex_t *mutex)
+{
+    return mutex->owner != 0;
+}
+
+// the base priority of thread changed, recompute it and everything it's boosting
+void pi_mutex_adjust_priority(thread_t *thread)
+{
+    uint64_t rflags = spinlock_acquire_irqsave(&pi_lock);
+
+    pi_adjust_chain(thread);
+
+    spinlock_release_irqrestore(&pi_lock, rflags);
+}
+
+// how often a thread got boosted so far
+uint64_t pi_mutex_get_boosts(void)
+{
+    return pi_boosts;
+}
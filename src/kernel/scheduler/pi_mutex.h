@@ -0,0 +1,59 @@
+/*
+	This file is part of an x86_64 hobbyist operating system called KnutOS
+	Everything is openly developed on GitHub: https://github.com/Tix3Dev/KnutOS/
+
+	Copyright (C) 2021-2022  Yves Vollmeier <https://github.com/Tix3Dev>
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <scheduler/thread.h>
+#include <libk/lock/lock_stat.h>
+
+#ifndef PI_MUTEX_H
+#define PI_MUTEX_H
+
+#define PI_MUTEX_HAS_WAITERS	1	// ored into owner, forces the owner into the slow unlock path
+#define PI_MUTEX_MAX_CHAIN	16	// blocked-on links followed when propagating a boost
+
+// a thread waiting for a pi_mutex, lives on the waiter's stack
+typedef struct pi_waiter
+{
+    thread_t		*thread;
+    struct pi_waiter	*next;
+} pi_waiter_t;
+
+// sleeping lock with priority inheritance, only for thread context
+// -> the owner runs at the highest priority of all threads blocked on it,
+//    directly or through a chain of other pi_mutexes
+typedef struct pi_mutex
+{
+    volatile uintptr_t	owner;	    // thread_t * of the owner (| PI_MUTEX_HAS_WAITERS), 0 if free
+    pi_waiter_t		*waiters;   // highest priority first, FIFO within a priority
+    struct pi_mutex	*held_next; // next mutex with waiters held by the same owner
+    lock_stat_t		stat;
+} pi_mutex_t;
+
+#define PI_MUTEX_INIT(mutex_name)					\
+    { .owner = 0, .waiters = NULL, .held_next = NULL, .stat = LOCK_STAT_INIT(mutex_name, "pi mutex") }
+
+void pi_mutex_init(pi_mutex_t *mutex, const char *name);
+void pi_mutex_lock(pi_mutex_t *mutex);
+bool pi_mutex_trylock(pi_mutex_t *mutex);
+void pi_mutex_unlock(pi_mutex_t *mutex);
+bool pi_mutex_is_locked(pi_mutex_t *mutex);
+void pi_mutex_adjust_priority(thread_t *thread);
+uint64_t pi_mutex_get_boosts(void);
+
+#endif
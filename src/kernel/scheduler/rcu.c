@@ -0,0 +1,307 @@
+/*
+	This file is part of an x86_64 hobbyist operating system called KnutOS
+	Everything is openly developed on GitHub: https://github.com/Tix3Dev/KnutOS/
+
+	Copyright (C) 2021-2022  Yves Vollmeier <https://github.com/Tix3Dev>
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <devices/cpu/cpu.h>
+#include <interrupts/softirq.h>
+#include <scheduler/completion.h>
+#include <scheduler/rcu.h>
+#include <smp/percpu.h>
+#include <smp/smp.h>
+#include <time/clocksource.h>
+#include <libk/lock/spinlock.h>
+#include <libk/stdio/stdio.h>
+
+/*  Explanation of RCU (read-copy-update):
+    Data that is read far more often than it changes is published
+    through a pointer. A writer never modifies what readers can see,
+    it builds a new copy, swaps the pointer (rcu_assign_pointer) and
+    hands the old copy to call_rcu. Readers only mark their section
+    with rcu_read_lock/rcu_read_unlock, a per cpu counter that keeps
+    the scheduler from preempting the cpu, so they take no lock and
+    write no shared cache line.
+
+    The old copy can be freed once every reader that might still see
+    it is gone, i.e. after a grace period: every cpu passed through a
+    quiescent state, a point where it's not inside a read section. A
+    voluntary context switch is one, so is every tick that interrupted
+    a context with a read depth of 0 (that covers idle cpus too).
+
+    rcu_gp_seq counts grace period starts and ends, it's odd while one
+    is running. call_rcu tags the callback with the value the counter
+    has to reach so that a full grace period started after the call
+    (rcu_seq_snap), queues it on the calling cpu and the tick of that
+    cpu starts a grace period if none is running. Starting one records
+    the online cpus, every cpu clears it's bit on the next quiescent
+    state and the last one ends the grace period. Callbacks run in
+    SOFTIRQ_RCU on the cpu that queued them.
+
+    A cpu with queued callbacks keeps it's tick. A cpu that stopped
+    it's tick wakes up at least every SCHEDULER_IDLE_BALANCE_MS, so an
+    idle system still finishes it's grace periods.
+*/
+
+typedef struct
+{
+    rcu_head_t	*head;	    // oldest first, gp_seq never decreases along the list
+    rcu_head_t	*tail;
+    size_t	pending;
+    uint64_t	queued;
+    uint64_t	invoked;
+} rcu_cpu_t;
+
+typedef struct
+{
+    rcu_head_t	    head;
+    completion_t    done;
+} rcu_synchronize_t;
+
+static spinlock_t	    rcu_lock = SPINLOCK_INIT("rcu");
+static volatile uint64_t    rcu_gp_seq = 0;
+static volatile uint64_t    rcu_gp_pending_cpus = 0;   // cpus that still owe a quiescent state
+static uint64_t		    rcu_gp_start_ns = 0;
+static uint64_t		    rcu_gp_count = 0;
+static uint64_t		    rcu_gp_total_ns = 0;
+static uint64_t		    rcu_gp_max_ns = 0;
+
+DEFINE_PER_CPU(uint32_t, rcu_read_depth);
+static DEFINE_PER_CPU(uint64_t, rcu_qs_seq);	// grace period this cpu already reported for
+static DEFINE_PER_CPU(rcu_cpu_t, rcu_cpu);
+
+// counter value at which a grace period that starts after now has ended
+static inline uint64_t rcu_seq_snap(void)
+{
+    return (__atomic_load_n(&rcu_gp_seq, __ATOMIC_ACQUIRE) + 3) & ~1ULL;
+}
+
+static inline bool rcu_seq_done(uint64_t seq, uint64_t needed)
+{
+    return (int64_t)(seq - needed) >= 0;
+}
+
+// begin a grace period for all online cpus (interrupts off)
+static void rcu_gp_start(void)
+{
+    spinlock_acquire(&rcu_lock);
+
+    if (!(rcu_gp_seq & 1))
+    {
+        uint64_t cpus = 0;
+
+        for (size_t i = 0; i < smp_cpu_count; i++)
+        {
+            if (smp_cpus[i].state == CPU_STATE_ONLINE)
+                cpus |= 1ULL << i;
+        }
+
+        rcu_gp_pending_cpus = cpus;
+        rcu_gp_start_ns = ktime_get_ns();
+
+        __atomic_store_n(&rcu_gp_seq, rcu_gp_seq + 1, __ATOMIC_RELEASE);
+    }
+
+    spinlock_release(&rcu_lock);
+}
+
+// this cpu is outside of any read section right now (interrupts off)
+static void rcu_report_qs(void)
+{
+    uint64_t seq = __atomic_load_n(&rcu_gp_seq, __ATOMIC_ACQUIRE);
+
+    if (!(seq & 1) || this_cpu_read(rcu_qs_seq) == seq)
+        return;
+
+    this_cpu_write(rcu_qs_seq, seq);
+
+    uint64_t bit = 1ULL << this_cpu_read(percpu_cpu_number);
+
+    spinlock_acquire(&rcu_lock);
+
+    if (rcu_gp_seq == seq && (rcu_gp_pending_cpus & bit))
+    {
+        rcu_gp_pending_cpus &= ~bit;
+
+        // last one, every reader of the old copies is gone
+        if (!rcu_gp_pending_cpus)
+        {
+            uint64_t duration = ktime_get_ns() - rcu_gp_start_ns;
+
+            rcu_gp_count++;
+            rcu_gp_total_ns += duration;
+
+            if (duration > rcu_gp_max_ns)
+                rcu_gp_max_ns = duration;
+
+            __atomic_store_n(&rcu_gp_seq, seq + 1, __ATOMIC_RELEASE);
+        }
+    }
+
+    spinlock_release(&rcu_lock);
+}
+
+// SOFTIRQ_RCU: run the callbacks of this cpu whose grace period ended
+static void rcu_process_callbacks(void)
+{
+    uint64_t seq = __atomic_load_n(&rcu_gp_seq, __ATOMIC_ACQUIRE);
+
+    uint64_t rflags = cpu_save_and_disable_interrupts();
+    rcu_cpu_t *cpu = this_cpu_ptr(rcu_cpu);
+
+    rcu_head_t *done = cpu->head;
+    rcu_head_t *last = NULL;
+    size_t count = 0;
+
+    while (cpu->head && rcu_seq_done(seq, cpu->head->gp_seq))
+    {
+        last = cpu->head;
+        cpu->head = cpu->head->next;
+        count++;
+    }
+
+    if (last)
+    {
+        last->next = NULL;
+
+        if (!cpu->head)
+            cpu->tail = NULL;
+    }
+    else
+    {
+        done = NULL;
+    }
+
+    cpu->pending -= count;
+    cpu->invoked += count;
+
+    cpu_restore_interrupts(rflags);
+
+    // the callbacks may queue new ones
+    while (done)
+    {
+        rcu_head_t *next = done->next;
+
+        done->func(done);
+        done = next;
+    }
+}
+
+static void rcu_wakeme(rcu_head_t *head)
+{
+    rcu_synchronize_t *sync = container_of(head, rcu_synchronize_t, head);
+
+    complete(&sync->done);
+}
+
+void rcu_init(void)
+{
+    softirq_register(SOFTIRQ_RCU, rcu_process_callbacks);
+}
+
+// run func(head) once every read section that started before this call ended
+// -> the object must already be unreachable for new readers
+void call_rcu(rcu_head_t *head, void (*func)(rcu_head_t *head))
+{
+    head->next = NULL;
+    head->func = func;
+
+    // the store that unpublished the object must not pass the counter load below
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+    uint64_t rflags = cpu_save_and_disable_interrupts();
+    rcu_cpu_t *cpu = this_cpu_ptr(rcu_cpu);
+
+    head->gp_seq = rcu_seq_snap();
+
+    if (cpu->tail)
+        cpu->tail->next = head;
+    else
+        cpu->head = head;
+
+    cpu->tail = head;
+    cpu->pending++;
+    cpu->queued++;
+
+    cpu_restore_interrupts(rflags);
+}
+
+// block until a full grace period passed (thread context only)
+void synchronize_rcu(void)
+{
+    rcu_synchronize_t sync;
+
+    completion_init(&sync.done, "synchronize_rcu");
+    call_rcu(&sync.head, rcu_wakeme);
+    wait_for_completion(&sync.done);
+    completion_destroy(&sync.done);
+}
+
+// called on every LAPIC timer interrupt before the softirqs run (interrupts off)
+void rcu_tick(void)
+{
+    rcu_cpu_t *cpu = this_cpu_ptr(rcu_cpu);
+    uint64_t seq = __atomic_load_n(&rcu_gp_seq, __ATOMIC_ACQUIRE);
+
+    // the newest callback needs a grace period nobody started yet
+    if (cpu->tail && !(seq & 1) && !rcu_seq_done(seq, cpu->tail->gp_seq))
+        rcu_gp_start();
+
+    // the interrupted context isn't inside a read section
+    if (!this_cpu_read(rcu_read_depth))
+        rcu_report_qs();
+
+    seq = __atomic_load_n(&rcu_gp_seq, __ATOMIC_ACQUIRE);
+
+    if (cpu->head && rcu_seq_done(seq, cpu->head->gp_seq))
+        softirq_raise(SOFTIRQ_RCU);
+}
+
+// the current thread gives up the cpu voluntarily (interrupts off)
+// -> blocking inside a read section is a bug, don't count it then
+void rcu_note_context_switch(void)
+{
+    if (!this_cpu_read(rcu_read_depth))
+        rcu_report_qs();
+}
+
+// whether this cpu has callbacks waiting, then it must not stop it's tick (interrupts off)
+bool rcu_needs_cpu(void)
+{
+    return this_cpu_read(rcu_cpu.head) != NULL;
+}
+
+void rcu_print_stats(void)
+{
+    uint64_t seq = rcu_gp_seq;
+    uint64_t count = rcu_gp_count;
+
+    printk(GFX_CYAN, "grace periods: %llu (avg %llu us, max %llu us), %s, waiting for cpus 0x%llx\n",
+           count, count ? rcu_gp_total_ns / count / NSEC_PER_USEC : 0, rcu_gp_max_ns / NSEC_PER_USEC,
+           (seq & 1) ? "running" : "idle", (seq & 1) ? rcu_gp_pending_cpus : 0);
+
+    printk(GFX_CYAN, "%-6s%-12s%-12s%-10s%-8s\n", "cpu", "queued", "invoked", "pending", "depth");
+
+    for (size_t i = 0; i < smp_cpu_count; i++)
+    {
+        rcu_cpu_t *cpu = per_cpu_ptr(rcu_cpu, i);
+
+        printk(GFX_WHITE, "%-6d%-12llu%-12llu%-10d%-8d\n",
+               i, cpu->queued, cpu->invoked, cpu->pending, *per_cpu_ptr(rcu_read_depth, i));
+    }
+}
@@ -0,0 +1,72 @@
+/*
+	This file is part of an x86_64 hobbyist operating system called KnutOS
+	Everything is openly developed on GitHub: https://github.com/Tix3Dev/KnutOS/
+
+	Copyright (C) 2021-2022  Yves Vollmeier <https://github.com/Tix3Dev>
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <smp/percpu.h>
+#include <libk/definitions.h>
+
+#ifndef RCU_H
+#define RCU_H
+
+// deferred callback, embedded in the object it frees
+typedef struct rcu_head
+{
+    struct rcu_head	*next;
+    void		(*func)(struct rcu_head *head);
+    uint64_t		gp_seq;	    // runs once the grace period counter reached this
+} rcu_head_t;
+
+DECLARE_PER_CPU(uint32_t, rcu_read_depth);
+
+// load a pointer published with rcu_assign_pointer, only inside a read section
+#define rcu_dereference(p)	__atomic_load_n(&(p), __ATOMIC_CONSUME)
+
+// publish a fully initialized object, readers either see the old or the new one
+#define rcu_assign_pointer(p, v) __atomic_store_n(&(p), (v), __ATOMIC_RELEASE)
+
+// start a read section: the scheduler doesn't preempt this cpu until it ends
+// -> a per cpu counter, no shared cache line is written, nests, works in interrupts
+// -> the section must not block or yield
+static inline void rcu_read_lock(void)
+{
+    this_cpu_inc(rcu_read_depth);
+    asm volatile("" : : : "memory");
+}
+
+static inline void rcu_read_unlock(void)
+{
+    asm volatile("" : : : "memory");
+    this_cpu_add(rcu_read_depth, -1);
+}
+
+static inline bool rcu_read_lock_held(void)
+{
+    return this_cpu_read(rcu_read_depth) != 0;
+}
+
+void rcu_init(void);
+void call_rcu(rcu_head_t *head, void (*func)(rcu_head_t *head));
+void synchronize_rcu(void);
+void rcu_tick(void);
+void rcu_note_context_switch(void);
+bool rcu_needs_cpu(void);
+void rcu_print_stats(void);
+
+#endif
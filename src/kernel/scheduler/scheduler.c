@@ -0,0 +1,1114 @@
+/*
+	This file is part of an x86_64 hobbyist operating system called KnutOS
+	Everything is openly developed on GitHub: https://github.com/Tix3Dev/KnutOS/
+
+	Copyright (C) 2021-2022  Yves Vollmeier <https://github.com/Tix3Dev>
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <devices/apic/apic.h>
+#include <devices/cpu/cpu.h>
+#include <devices/cpu/cpuidle.h>
+#include <devices/cpu/fpu.h>
+#include <interrupts/interrupts.h>
+#include <interrupts/softirq.h>
+#include <scheduler/rcu.h>
+#include <scheduler/scheduler.h>
+#include <scheduler/thread.h>
+#include <smp/smp.h>
+#include <time/clocksource.h>
+#include <time/timer.h>
+#include <libk/lock/spinlock.h>
+#include <libk/log/log.h>
+#include <libk/stdio/stdio.h>
+
+/*  Explanation of the scheduler:
+    Every cpu's LAPIC timer fires LAPIC_TIMER_INTERRUPT SCHEDULER_TICK_HZ
+    times per second. The interrupt stub pushed the full register state
+    onto the stack of the running thread, so switching threads only means
+    storing the current rsp and handing isr_handler the saved rsp of
+    another thread, which then gets popped and iretq'ed to.
+
+    Every cpu has it's own run queue (one FIFO per priority) with it's own
+    lock, so cpus don't fight over a single global lock on every tick.
+    A thread runs until its time slice is used up, it blocks / yields, or
+    a thread of a higher priority becomes ready on the same cpu. Then the
+    oldest thread of the highest non-empty priority takes over (round robin
+    within a priority). If nothing is ready, the cpu runs it's idle thread
+    (the context that called scheduler_init_cpu).
+
+    New threads are queued on the cpu that created them and woken up
+    threads on the cpu they ran on last (warm caches). A cpu that runs
+    out of work steals from others: it looks at the cpus closest to it
+    first (same core / package, by comparing APIC IDs bit by bit), takes
+    the busiest one of them and pulls up to half of it's queued threads,
+    at most SCHEDULER_STEAL_BATCH at once.
+
+    A thread's state, on_cpu and cpu fields are protected by the lock of
+    the run queue of thread->cpu. Stealing holds both run queue locks,
+    always taken in cpu index order.
+
+    An idle cpu doesn't need a tick: it programs it's LAPIC timer in
+    one-shot (or TSC-deadline) mode for the next pending kernel timer,
+    but sleeps at most SCHEDULER_IDLE_BALANCE_MS so it still steals work
+    every now and then. Any other interrupt that made a thread ready on
+    it switches to that thread on the way out (scheduler_irq_exit) and
+    restarts the periodic tick. Threads that get ready on a cpu whose
+    tick is stopped are queued on the waking cpu instead, as nothing
+    would wake the sleeping one up in time.
+
+    Threads of the deadline class (THREAD_POLICY_DEADLINE) sit above all
+    priorities: they are queued by absolute deadline and the earliest one
+    runs whenever it's ready. A thread reserves runtime_ns every period_ns
+    for itself (thread_set_deadline), admission control only accepts it
+    if the reserved bandwidth of the cpu stays below SCHEDULER_DL_BW_LIMIT,
+    so all reservations can be met and normal threads don't starve. Every
+    tick charges the running time against the budget, once it's used up
+    the thread is throttled until it's next period starts (a per thread
+    timer replenishes it). A thread waking up after a long sleep, whose
+    remaining budget would exceed it's bandwidth until the old deadline,
+    starts a new period instead (constant bandwidth server rule).
+    Deadline threads stay on the cpu they were admitted on, they are never
+    stolen, and a cpu with reservations keeps it's tick.
+
+    Softirqs run on the way out of an interrupt before any of this, with
+    interrupts on. A nested interrupt never switches threads while they
+    run, the decision is left to the interrupt that started them.
+
+    A thread that got switched away from is still executing on it's old
+    stack until the interrupt stub loaded the new rsp. That's why it is
+    only put back into a run queue (or freed) in scheduler_finish_switch,
+    which the stub calls once it runs on the new stack.
+*/
+
+typedef struct
+{
+    spinlock_t	lock;
+    thread_t	*head[THREAD_PRIORITY_COUNT];
+    thread_t	*tail[THREAD_PRIORITY_COUNT];
+    thread_t	*dl_head;	// deadline threads, earliest deadline first
+    volatile size_t nr_queued;	// read without the lock to pick steal victims
+    volatile size_t dl_nr_queued; // part of nr_queued that can't be stolen
+    uint64_t	dl_bw;		// bandwidth reserved by deadline threads of this cpu
+    size_t	dl_nr_threads;
+
+    thread_t	*current;
+    thread_t	*idle;
+    thread_t	*prev;		// switched away from, finished by scheduler_finish_switch
+    uint64_t	ticks;
+    bool	active;
+    volatile bool tick_stopped;	// LAPIC timer in one-shot mode while idle
+    uint64_t	tick_deadline_ns; // when that one-shot fires
+
+    scheduler_stats_t stats;
+} __attribute__((aligned(64))) scheduler_cpu_t;
+
+static scheduler_cpu_t	scheduler_cpus[SMP_MAX_CPUS];
+
+static bool		scheduler_running = false;
+static bool		scheduler_tickless = true;
+static bool		scheduler_stealing = true;
+static size_t		scheduler_steal_cpu_limit = SMP_MAX_CPUS;	// only cpus below this steal
+
+static inline scheduler_cpu_t *this_scheduler_cpu(void)
+{
+    return &scheduler_cpus[smp_get_current_cpu()];
+}
+
+// the lock of cpu has to be held for all run queue functions
+
+// sorted insert, FIFO among equal deadlines
+// -> a throttled thread isn't queued, the replenish timer does that
+static void dl_queue_push(scheduler_cpu_t *cpu, thread_t *thread)
+{
+    if (thread->deadline.throttled)
+        return;
+
+    thread_t **link = &cpu->dl_head;
+
+    while (*link && (int64_t)((*link)->deadline.abs_deadline - thread->deadline.abs_deadline) <= 0)
+        link = &(*link)->next;
+
+    thread->next = *link;
+    *link = thread;
+
+    cpu->nr_queued++;
+    cpu->dl_nr_queued++;
+}
+
+static thread_t *dl_queue_pop(scheduler_cpu_t *cpu)
+{
+    thread_t *thread = cpu->dl_head;
+
+    if (!thread)
+        return NULL;
+
+    cpu->dl_head = thread->next;
+    thread->next = NULL;
+
+    // in this order, lockless readers of nr_queued - dl_nr_queued must not see it wrap
+    cpu->dl_nr_queued--;
+    cpu->nr_queued--;
+
+    return thread;
+}
+
+static void run_queue_push(scheduler_cpu_t *cpu, thread_t *thread)
+{
+    if (thread->policy == THREAD_POLICY_DEADLINE)
+    {
+        dl_queue_push(cpu, thread);
+        return;
+    }
+
+    thread->next = NULL;
+
+    if (cpu->tail[thread->priority])
+        cpu->tail[thread->priority]->next = thread;
+    else
+        cpu->head[thread->priority] = thread;
+
+    cpu->tail[thread->priority] = thread;
+    cpu->nr_queued++;
+}
+
+// take the oldest normal thread of the highest priority, ignoring priorities below lowest
+static thread_t *run_queue_pop(scheduler_cpu_t *cpu, thread_priority_t lowest)
+{
+    for (int priority = 0; priority <= (int)lowest; priority++)
+    {
+        thread_t *thread = cpu->head[priority];
+
+        if (!thread)
+            continue;
+
+        cpu->head[priority] = thread->next;
+
+        if (!cpu->head[priority])
+            cpu->tail[priority] = NULL;
+
+        thread->next = NULL;
+        cpu->nr_queued--;
+
+        return thread;
+    }
+
+    return NULL;
+}
+
+static void run_queue_remove(scheduler_cpu_t *cpu, thread_t *thread)
+{
+    thread_t *prev = NULL;
+    thread_t *entry = cpu->head[thread->priority];
+
+    while (entry && entry != thread)
+    {
+        prev = entry;
+        entry = entry->next;
+    }
+
+    if (!entry)
+        return;
+
+    if (prev)
+        prev->next = thread->next;
+    else
+        cpu->head[thread->priority] = thread->next;
+
+    if (cpu->tail[thread->priority] == thread)
+        cpu->tail[thread->priority] = prev;
+
+    thread->next = NULL;
+    cpu->nr_queued--;
+}
+
+// whether something should preempt a normal thread of priority
+static bool run_queue_has_better(scheduler_cpu_t *cpu, thread_priority_t priority)
+{
+    if (cpu->dl_head)
+        return true;
+
+    for (int i = 0; i < (int)priority; i++)
+        if (cpu->head[i])
+            return true;
+
+    return false;
+}
+
+// lock the run queue a thread belongs to
+// -> thread->cpu may change until we hold the lock, so check again afterwards
+static scheduler_cpu_t *thread_lock_run_queue(thread_t *thread)
+{
+    for (;;)
+    {
+        scheduler_cpu_t *cpu = &scheduler_cpus[thread->cpu];
+
+        spinlock_acquire(&cpu->lock);
+
+        if (&scheduler_cpus[thread->cpu] == cpu)
+            return cpu;
+
+        spinlock_release(&cpu->lock);
+    }
+}
+
+// busiest cpu among the closest ones that have something queued
+// -> cpus whose APIC IDs only differ in the lowest bits share a core / package,
+//    so try those first and widen the search one bit at a time
+static scheduler_cpu_t *scheduler_find_victim(size_t thief)
+{
+    uint32_t thief_lapic_id = smp_cpus[thief].lapic_id;
+
+    for (int level = 1; level <= 32; level++)
+    {
+        scheduler_cpu_t *victim = NULL;
+        size_t victim_queued = 0;
+
+        for (size_t i = 0; i < smp_cpu_count; i++)
+        {
+            scheduler_cpu_t *cpu = &scheduler_cpus[i];
+            size_t queued = cpu->nr_queued - cpu->dl_nr_queued;
+
+            if (i == thief || !cpu->active || queued <= victim_queued)
+                continue;
+
+            if (level < 32 && (smp_cpus[i].lapic_id ^ thief_lapic_id) >> level)
+                continue;
+
+            victim = cpu;
+            victim_queued = queued;
+        }
+
+        if (victim)
+            return victim;
+    }
+
+    return NULL;
+}
+
+// pull a batch of ready threads from another cpu onto thief's run queue
+// (interrupts have to be off, no run queue lock may be held)
+static void scheduler_steal(size_t thief)
+{
+    scheduler_cpu_t *thief_cpu = &scheduler_cpus[thief];
+
+    if (!scheduler_stealing || thief >= scheduler_steal_cpu_limit)
+        return;
+
+    thief_cpu->stats.steal_attempts++;
+
+    scheduler_cpu_t *victim = scheduler_find_victim(thief);
+
+    if (!victim)
+        return;
+
+    scheduler_cpu_t *first = victim < thief_cpu ? victim : thief_cpu;
+    scheduler_cpu_t *second = victim < thief_cpu ? thief_cpu : victim;
+
+    spinlock_acquire(&first->lock);
+    spinlock_acquire(&second->lock);
+
+    size_t batch = (victim->nr_queued - victim->dl_nr_queued + 1) / 2;
+
+    if (batch > SCHEDULER_STEAL_BATCH)
+        batch = SCHEDULER_STEAL_BATCH;
+
+    size_t pulled = 0;
+
+    while (pulled < batch)
+    {
+        thread_t *thread = run_queue_pop(victim, THREAD_PRIORITY_COUNT - 1);
+
+        if (!thread)
+            break;
+
+        thread->cpu = thief;
+        run_queue_push(thief_cpu, thread);
+        pulled++;
+    }
+
+    if (pulled)
+    {
+        thief_cpu->stats.steals++;
+        thief_cpu->stats.threads_pulled += pulled;
+        victim->stats.threads_pushed += pulled;
+    }
+
+    spinlock_release(&second->lock);
+    spinlock_release(&first->lock);
+}
+
+// periodic tick while there is something to run, otherwise sleep
+// until the next timer, at most SCHEDULER_IDLE_BALANCE_MS (lock of cpu held)
+// -> a cpu with deadline reservations never sleeps, their wakeups couldn't move elsewhere
+// -> neither does one with rcu callbacks, it has to start and notice their grace periods
+static void scheduler_program_tick(scheduler_cpu_t *cpu)
+{
+    uint64_t sleep_ns = SCHEDULER_IDLE_BALANCE_MS * NSEC_PER_MSEC;
+    bool stop = scheduler_tickless && cpu->current->is_idle && !cpu->nr_queued && !cpu->dl_bw &&
+                !rcu_needs_cpu();
+
+    if (stop)
+    {
+        uint64_t next = timer_next_expiry_ns();
+        uint64_t now = ktime_get_ns();
+
+        if (next != UINT64_MAX)
+            sleep_ns = next > now ? (next - now < sleep_ns ? next - now : sleep_ns) : 0;
+
+        // not worth it
+        stop = sleep_ns >= NSEC_PER_SEC / SCHEDULER_TICK_HZ;
+    }
+
+    if (stop)
+    {
+        lapic_timer_start_deadline_ns(LAPIC_TIMER_INTERRUPT, sleep_ns);
+        cpu->tick_stopped = true;
+        cpu->tick_deadline_ns = ktime_get_ns() + sleep_ns;
+    }
+    else if (cpu->tick_stopped)
+    {
+        lapic_timer_start_periodic(LAPIC_TIMER_INTERRUPT, SCHEDULER_TICK_HZ);
+        cpu->tick_stopped = false;
+    }
+}
+
+// queue a ready thread on cpu (lock of cpu held, returns with the lock of
+// the cpu it actually got queued on held)
+// -> a cpu whose tick is stopped would only notice it when kicked, so prefer the calling cpu then
+// -> another idle cpu gets kicked instead of waiting for it's next tick
+static scheduler_cpu_t *scheduler_enqueue(scheduler_cpu_t *cpu, thread_t *thread)
+{
+    scheduler_cpu_t *local = this_scheduler_cpu();
+
+    if (cpu != local && cpu->tick_stopped && thread->policy != THREAD_POLICY_DEADLINE)
+    {
+        // cpu->lock can't be dropped in between: scheduler_set_priority would take the
+        // ready thread for queued, so take both in address order like scheduler_steal
+        // -> if local comes first and is busy, stay on cpu, the kick below wakes it up
+        bool locked = true;
+
+        if (local > cpu)
+            spinlock_acquire(&local->lock);
+        else
+            locked = spinlock_try_acquire(&local->lock);
+
+        if (locked)
+        {
+            thread->cpu = local - scheduler_cpus;
+            spinlock_release(&cpu->lock);
+
+            cpu = local;
+        }
+    }
+
+    run_queue_push(cpu, thread);
+
+    if (cpu != local && cpu->current->is_idle)
+        cpuidle_kick(cpu - scheduler_cpus);
+
+    return cpu;
+}
+
+static uint64_t dl_ns_to_jiffies(uint64_t ns)
+{
+    return (ns + TIMER_NSEC_PER_JIFFY - 1) / TIMER_NSEC_PER_JIFFY;
+}
+
+// refill the budget for the next period, or start a fresh one if that's already over
+static void dl_replenish(thread_deadline_t *dl, uint64_t now)
+{
+    while (dl->runtime_left <= 0)
+    {
+        dl->abs_deadline += dl->period_ns;
+        dl->runtime_left += dl->runtime_ns;
+    }
+
+    if ((int64_t)(dl->abs_deadline - now) <= 0)
+    {
+        dl->abs_deadline = now + dl->deadline_ns;
+        dl->runtime_left = dl->runtime_ns;
+    }
+}
+
+// timer callback: the period of a throttled thread started, queue it again
+static void dl_replenish_timeout(void *arg)
+{
+    thread_t *thread = arg;
+    uint64_t rflags = cpu_save_and_disable_interrupts();
+    scheduler_cpu_t *cpu = thread_lock_run_queue(thread);
+
+    dl_replenish(&thread->deadline, ktime_get_ns());
+    thread->deadline.throttled = false;
+
+    // still being switched away from -> scheduler_finish_switch queues it
+    if (thread->state == THREAD_READY && !thread->on_cpu)
+        run_queue_push(cpu, thread);
+
+    spinlock_release(&cpu->lock);
+    cpu_restore_interrupts(rflags);
+}
+
+// constant bandwidth server rule for a thread that becomes ready again:
+// keep the deadline only if the rest of the budget fits into the bandwidth until then
+static void dl_wakeup(thread_deadline_t *dl, uint64_t now)
+{
+    if (dl->throttled)
+        return;
+
+    int64_t until_deadline = (int64_t)(dl->abs_deadline - now);
+
+    if (until_deadline > 0 && dl->runtime_left > 0 &&
+            ((uint64_t)dl->runtime_left << SCHEDULER_DL_BW_SHIFT) / (uint64_t)until_deadline <=
+            (dl->runtime_ns << SCHEDULER_DL_BW_SHIFT) / dl->deadline_ns)
+        return;
+
+    dl->abs_deadline = now + dl->deadline_ns;
+    dl->runtime_left = dl->runtime_ns;
+}
+
+// charge the time the running deadline thread used since the last update,
+// throttle it once the budget is gone (done is set if it blocks or exits)
+static void dl_update_current(scheduler_cpu_t *cpu, thread_t *thread, bool done)
+{
+    thread_deadline_t *dl = &thread->deadline;
+    uint64_t now = ktime_get_ns();
+
+    dl->runtime_left -= (int64_t)(now - dl->exec_start);
+    dl->exec_start = now;
+
+    if (dl->throttled || thread->state == THREAD_DEAD)
+        return;
+
+    bool late = (int64_t)(now - dl->abs_deadline) > 0;
+
+    if (dl->runtime_left > 0)
+    {
+        if (done && late)
+        {
+            dl->misses++;
+            cpu->stats.dl_misses++;
+        }
+
+        return;
+    }
+
+    if (late)
+    {
+        dl->misses++;
+        cpu->stats.dl_misses++;
+    }
+
+    dl->throttled = true;
+    dl->throttles++;
+    cpu->stats.dl_throttles++;
+
+    timer_add(&dl->replenish_timer, dl_ns_to_jiffies(dl->abs_deadline - dl->deadline_ns + dl->period_ns));
+}
+
+// the earliest deadline beats everything, otherwise the normal priorities decide
+// -> returns NULL if current should keep running (or nothing is ready)
+static thread_t *scheduler_pick_next(scheduler_cpu_t *cpu, thread_t *current, bool can_continue)
+{
+    bool current_is_dl = can_continue && current->policy == THREAD_POLICY_DEADLINE;
+
+    if (cpu->dl_head && (!current_is_dl ||
+            (int64_t)(cpu->dl_head->deadline.abs_deadline - current->deadline.abs_deadline) < 0))
+        return dl_queue_pop(cpu);
+
+    if (current_is_dl)
+        return NULL;
+
+    return run_queue_pop(cpu, can_continue ? current->priority : THREAD_PRIORITY_COUNT - 1);
+}
+
+// save rsp of the current thread and pick the next one
+// -> a thread that can keep running is only replaced by one of at least it's priority
+// a preempted thread stays runnable even if it was preparing to block,
+// otherwise it could miss the wakeup it was about to check for
+static uint64_t scheduler_switch(scheduler_cpu_t *cpu, uint64_t rsp, bool preempt)
+{
+    thread_t *current = cpu->current;
+    bool runnable = !current->is_idle && current->state != THREAD_DEAD &&
+                    (preempt || current->state != THREAD_BLOCKED);
+
+    current->rsp = rsp;
+
+    if (current->policy == THREAD_POLICY_DEADLINE)
+        dl_update_current(cpu, current, !runnable);
+
+    bool can_continue = runnable && !current->deadline.throttled;
+    thread_t *next = scheduler_pick_next(cpu, current, can_continue);
+
+    if (!next)
+    {
+        if (can_continue)
+        {
+            current->ticks_left = current->timeslice;
+            return rsp;
+        }
+
+        next = cpu->idle;
+
+        if (next == current)
+            return rsp;
+    }
+
+    if (runnable || current->is_idle)
+        current->state = THREAD_READY;
+
+    cpu->prev = current;
+    fpu_switch_out(current);
+
+    next->state = THREAD_RUNNING;
+    next->on_cpu = true;
+    next->cpu = cpu - scheduler_cpus;
+    next->ticks_left = next->timeslice;
+    next->switch_count++;
+
+    if (next->policy == THREAD_POLICY_DEADLINE)
+        next->deadline.exec_start = ktime_get_ns();
+
+    cpu->current = next;
+    cpu->stats.switches++;
+
+    return next->rsp;
+}
+
+// calibrate the LAPIC timer and start scheduling on the BSP
+void scheduler_init(void)
+{
+    lapic_timer_calibrate();
+
+    for (size_t i = 0; i < SMP_MAX_CPUS; i++)
+        spinlock_init(&scheduler_cpus[i].lock, "run queue");
+
+    softirq_register(SOFTIRQ_TIMER, timer_run);
+    rcu_init();
+
+    scheduler_running = true;
+
+    scheduler_init_cpu(0);
+
+    serial_log(INFO, "Scheduler initialized: %d Hz tick\n", SCHEDULER_TICK_HZ);
+    kernel_log(INFO, "Scheduler initialized: %d Hz tick\n", SCHEDULER_TICK_HZ);
+}
+
+// turn the calling context into the idle thread of cpu and start it's tick
+void scheduler_init_cpu(size_t cpu)
+{
+    scheduler_cpu_t *scheduler_cpu = &scheduler_cpus[cpu];
+
+    scheduler_cpu->idle = thread_create_idle(cpu);
+    scheduler_cpu->current = scheduler_cpu->idle;
+    scheduler_cpu->active = true;
+
+    timer_init_cpu();
+    lapic_timer_start_periodic(LAPIC_TIMER_INTERRUPT, SCHEDULER_TICK_HZ);
+}
+
+// make a new thread runnable on cpu
+void scheduler_add_thread(thread_t *thread, size_t cpu)
+{
+    scheduler_cpu_t *scheduler_cpu = &scheduler_cpus[cpu];
+
+    uint64_t rflags = spinlock_acquire_irqsave(&scheduler_cpu->lock);
+
+    thread->cpu = cpu;
+    thread->state = THREAD_READY;
+    scheduler_cpu = scheduler_enqueue(scheduler_cpu, thread);
+
+    spinlock_release_irqrestore(&scheduler_cpu->lock, rflags);
+}
+
+// called on every LAPIC timer interrupt (interrupts are off), after the softirqs ran
+// -> expired timers already made their threads ready
+uint64_t scheduler_tick(uint64_t rsp)
+{
+    if (!scheduler_running)
+        return rsp;
+
+    scheduler_cpu_t *cpu = this_scheduler_cpu();
+
+    if (!cpu->active)
+        return rsp;
+
+    cpu->stats.wakeups++;
+
+    if (cpu->current->is_idle && !cpu->nr_queued)
+        scheduler_steal(cpu - scheduler_cpus);
+
+    spinlock_acquire(&cpu->lock);
+
+    thread_t *current = cpu->current;
+    bool reschedule;
+
+    cpu->ticks++;
+    current->runtime_ticks++;
+
+    if (current->is_idle)
+    {
+        cpu->stats.idle_ticks++;
+        reschedule = run_queue_has_better(cpu, THREAD_PRIORITY_COUNT);
+    }
+    else if (current->policy == THREAD_POLICY_DEADLINE)
+    {
+        cpu->stats.busy_ticks++;
+
+        dl_update_current(cpu, current, false);
+
+        reschedule = current->deadline.throttled || (cpu->dl_head &&
+                     (int64_t)(cpu->dl_head->deadline.abs_deadline - current->deadline.abs_deadline) < 0);
+    }
+    else
+    {
+        cpu->stats.busy_ticks++;
+
+        if (current->ticks_left > 0)
+            current->ticks_left--;
+
+        reschedule = current->ticks_left == 0 || run_queue_has_better(cpu, current->priority);
+    }
+
+    // a nested tick must not switch away from the softirqs it interrupted,
+    // nor from a read section, the slice is over anyway, so the next tick picks it up
+    if (reschedule && !softirq_in_progress() && !rcu_read_lock_held())
+        rsp = scheduler_switch(cpu, rsp, true);
+
+    scheduler_program_tick(cpu);
+
+    spinlock_release(&cpu->lock);
+
+    return rsp;
+}
+
+// called on the way out of a hardware interrupt
+// -> an idle cpu with a stopped tick switches to a thread the handler woke up right away
+uint64_t scheduler_irq_exit(uint64_t rsp)
+{
+    if (!scheduler_running)
+        return rsp;
+
+    scheduler_cpu_t *cpu = this_scheduler_cpu();
+
+    if (!cpu->active || !cpu->current->is_idle || softirq_in_progress())
+        return rsp;
+
+    spinlock_acquire(&cpu->lock);
+
+    if (cpu->nr_queued)
+        rsp = scheduler_switch(cpu, rsp, true);
+
+    // the handler may also have added a timer
+    scheduler_program_tick(cpu);
+
+    spinlock_release(&cpu->lock);
+
+    return rsp;
+}
+
+// SCHEDULER_YIELD_INTERRUPT: the current thread yields, blocks or exits
+uint64_t scheduler_yield_from_interrupt(uint64_t rsp)
+{
+    if (!scheduler_running)
+        return rsp;
+
+    scheduler_cpu_t *cpu = this_scheduler_cpu();
+
+    // about to run out of work, look for some before settling for idle
+    if (!cpu->nr_queued)
+        scheduler_steal(cpu - scheduler_cpus);
+
+    spinlock_acquire(&cpu->lock);
+
+    rcu_note_context_switch();
+
+    // woken up again before it even got switched away
+    if (cpu->current->state == THREAD_READY)
+        cpu->current->state = THREAD_RUNNING;
+
+    rsp = scheduler_switch(cpu, rsp, false);
+
+    scheduler_program_tick(cpu);
+
+    spinlock_release(&cpu->lock);
+
+    return rsp;
+}
+
+// called by the interrupt stub after it switched to the new stack
+// -> the previous thread isn't in use anymore, requeue or free it
+void scheduler_finish_switch(void)
+{
+    if (!scheduler_running)
+        return;
+
+    scheduler_cpu_t *cpu = this_scheduler_cpu();
+    thread_t *prev = cpu->prev;
+
+    if (!prev)
+        return;
+
+    cpu->prev = NULL;
+
+    spinlock_acquire(&cpu->lock);
+
+    prev->on_cpu = false;
+
+    if (prev->state == THREAD_READY && !prev->is_idle)
+    {
+        run_queue_push(cpu, prev);
+        scheduler_program_tick(cpu);
+    }
+
+    bool is_dead = prev->state == THREAD_DEAD;
+
+    // give the reservation back
+    if (is_dead && prev->policy == THREAD_POLICY_DEADLINE)
+    {
+        cpu->dl_bw -= prev->deadline.bandwidth;
+        cpu->dl_nr_threads--;
+    }
+
+    spinlock_release(&cpu->lock);
+
+    if (is_dead)
+        thread_destroy(prev);
+}
+
+// number of threads waiting in the run queue of cpu
+size_t scheduler_get_queued(size_t cpu)
+{
+    return scheduler_cpus[cpu].nr_queued;
+}
+
+// time until the LAPIC timer of this cpu fires next, for the idle governor (interrupts off)
+uint64_t scheduler_next_tick_ns(void)
+{
+    scheduler_cpu_t *cpu = this_scheduler_cpu();
+
+    if (cpu->tick_stopped)
+    {
+        uint64_t now = ktime_get_ns();
+
+        return cpu->tick_deadline_ns > now ? cpu->tick_deadline_ns - now : 0;
+    }
+
+    if (!lapic_timer_ticks_per_ms)
+        return NSEC_PER_SEC / SCHEDULER_TICK_HZ;
+
+    return (uint64_t)lapic_read_register(APIC_TIMER_CURRENT_COUNT_REGISTER) * NSEC_PER_MSEC /
+           lapic_timer_ticks_per_ms;
+}
+
+const scheduler_stats_t *scheduler_get_stats(size_t cpu)
+{
+    return &scheduler_cpus[cpu].stats;
+}
+
+// change the effective priority of a thread, a queued one moves to it's new run queue right away
+void scheduler_set_priority(thread_t *thread, thread_priority_t priority)
+{
+    uint64_t rflags = cpu_save_and_disable_interrupts();
+    scheduler_cpu_t *cpu = thread_lock_run_queue(thread);
+
+    if (thread->priority != priority)
+    {
+        // ready and not on a cpu = sitting in a run queue
+        bool queued = thread->state == THREAD_READY && !thread->on_cpu && !thread->is_idle &&
+                      thread->policy == THREAD_POLICY_NORMAL;
+
+        if (queued)
+            run_queue_remove(cpu, thread);
+
+        thread->priority = priority;
+
+        if (queued)
+            run_queue_push(cpu, thread);
+    }
+
+    spinlock_release(&cpu->lock);
+    cpu_restore_interrupts(rflags);
+}
+
+// only let the first cpu_limit cpus steal work (0 = all of them)
+// -> the others keep running whatever got queued on them directly
+void scheduler_set_cpu_limit(size_t cpu_limit)
+{
+    scheduler_steal_cpu_limit = cpu_limit ? cpu_limit : SMP_MAX_CPUS;
+}
+
+// turn work stealing off, e.g. for benchmarks that need their threads on one cpu
+void scheduler_set_stealing(bool stealing)
+{
+    scheduler_stealing = stealing;
+}
+
+// stop the tick of idle cpus (default) or keep it running all the time
+void scheduler_set_tickless(bool tickless)
+{
+    scheduler_tickless = tickless;
+}
+
+// print run queue length, wakeups and load balancing statistics of every cpu
+// -> wakeups/s is measured since the previous call
+void scheduler_print_stats(void)
+{
+    static uint64_t last_wakeups[SMP_MAX_CPUS];
+    static uint64_t last_ns = 0;
+
+    uint64_t now = ktime_get_ns();
+    uint64_t elapsed_ms = (now - last_ns) / NSEC_PER_MSEC;
+
+    last_ns = now;
+
+    printk(GFX_CYAN, "%-4s %-7s %-9s %-10s %-10s %-10s %-9s %-8s %-8s %-8s %s\n", "cpu", "queued", "tick",
+           "wakeups/s", "switches", "busy", "idle", "tries", "steals", "pulled", "pushed");
+
+    for (size_t i = 0; i < smp_cpu_count; i++)
+    {
+        scheduler_cpu_t *cpu = &scheduler_cpus[i];
+
+        if (!cpu->active)
+            continue;
+
+        uint64_t wakeups = cpu->stats.wakeups;
+        uint64_t rate = elapsed_ms ? (wakeups - last_wakeups[i]) * 1000 / elapsed_ms : 0;
+
+        last_wakeups[i] = wakeups;
+
+        printk(GFX_WHITE, "%-4d %-7d %-9s %-10llu %-10llu %-10llu %-10llu %-9llu %-8llu %-8llu %-8llu %llu\n",
+               i, cpu->nr_queued, cpu->tick_stopped ? "stopped" : "periodic", rate, cpu->stats.switches,
+               cpu->stats.busy_ticks, cpu->stats.idle_ticks, cpu->stats.steal_attempts, cpu->stats.steals,
+               cpu->stats.threads_pulled, cpu->stats.threads_pushed);
+    }
+
+    printk(GFX_CYAN, "%-4s %-10s %-10s %-10s %-10s %s\n", "cpu", "deadline", "bandwidth", "throttled", "missed",
+           "rejected");
+
+    for (size_t i = 0; i < smp_cpu_count; i++)
+    {
+        scheduler_cpu_t *cpu = &scheduler_cpus[i];
+
+        if (!cpu->active)
+            continue;
+
+        uint64_t permille = cpu->dl_bw * 1000 / SCHEDULER_DL_BW_UNIT;
+
+        printk(GFX_WHITE, "%-4d %-10d %3llu.%llu%%     %-10llu %-10llu %llu\n", i, cpu->dl_nr_threads,
+               permille / 10, permille % 10, cpu->stats.dl_throttles, cpu->stats.dl_misses, cpu->stats.dl_rejected);
+    }
+}
+
+// interrupts are off during the lookup, so the thread can't migrate in between
+thread_t *thread_current(void)
+{
+    uint64_t rflags = cpu_save_and_disable_interrupts();
+
+    thread_t *current = this_scheduler_cpu()->current;
+
+    cpu_restore_interrupts(rflags);
+
+    return current;
+}
+
+// give the cpu to another ready thread of the same or a higher priority
+void thread_yield(void)
+{
+    asm volatile("int %0" : : "i" (SCHEDULER_YIELD_INTERRUPT) : "memory");
+}
+
+// first half of blocking: mark the current thread as blocked, then
+// check the wait condition and either thread_yield or thread_cancel_block
+// -> a thread_unblock in between isn't lost, the yield returns right away
+void thread_prepare_block(void)
+{
+    uint64_t rflags = cpu_save_and_disable_interrupts();
+    scheduler_cpu_t *cpu = this_scheduler_cpu();
+
+    spinlock_acquire(&cpu->lock);
+    cpu->current->state = THREAD_BLOCKED;
+    spinlock_release(&cpu->lock);
+
+    cpu_restore_interrupts(rflags);
+}
+
+void thread_cancel_block(void)
+{
+    uint64_t rflags = cpu_save_and_disable_interrupts();
+    scheduler_cpu_t *cpu = this_scheduler_cpu();
+
+    spinlock_acquire(&cpu->lock);
+    cpu->current->state = THREAD_RUNNING;
+    spinlock_release(&cpu->lock);
+
+    cpu_restore_interrupts(rflags);
+}
+
+// sleep until another thread or an interrupt handler calls thread_unblock
+// -> may also return early (e.g. after a preemption), callers recheck their condition
+void thread_block(void)
+{
+    thread_prepare_block();
+    thread_yield();
+}
+
+// make a blocked thread ready again, on the cpu it ran on last (if that one is awake)
+// -> if it's still being switched away from, scheduler_finish_switch queues it
+void thread_unblock(thread_t *thread)
+{
+    uint64_t rflags = cpu_save_and_disable_interrupts();
+    scheduler_cpu_t *cpu = thread_lock_run_queue(thread);
+
+    if (thread->state == THREAD_BLOCKED)
+    {
+        thread->state = THREAD_READY;
+
+        if (thread->policy == THREAD_POLICY_DEADLINE)
+            dl_wakeup(&thread->deadline, ktime_get_ns());
+
+        if (!thread->on_cpu)
+            cpu = scheduler_enqueue(cpu, thread);
+    }
+
+    spinlock_release(&cpu->lock);
+    cpu_restore_interrupts(rflags);
+}
+
+static void thread_sleep_timeout(void *arg)
+{
+    thread_unblock(arg);
+}
+
+// block the current thread for at least ms milliseconds
+void thread_sleep_ms(uint64_t ms)
+{
+    thread_sleep_until(timer_get_jiffies() + timer_ms_to_jiffies(ms) + 1);	// + 1: we are somewhere in a jiffy
+}
+
+// block the current thread until jiffy expires (returns right away if it's over)
+void thread_sleep_until(uint64_t expires)
+{
+    timer_t timer;
+
+    timer_init(&timer, thread_sleep_timeout, thread_current());
+    timer_add(&timer, expires);
+
+    for (;;)
+    {
+        thread_prepare_block();
+
+        if ((int64_t)(timer_get_jiffies() - expires) >= 0)
+        {
+            thread_cancel_block();
+            break;
+        }
+
+        thread_yield();
+    }
+
+    // the timer lives on our stack, so wait for a callback that's still running
+    timer_del_sync(&timer);
+}
+
+// turn the current thread into a deadline thread on it's cpu (runtime_ns 0 makes it normal again)
+// -> period_ns 0 means period = deadline, returns false if admission control rejects it
+bool thread_set_deadline(uint64_t runtime_ns, uint64_t deadline_ns, uint64_t period_ns)
+{
+    bool clear = runtime_ns == 0;
+
+    if (period_ns == 0)
+        period_ns = deadline_ns;
+
+    if (!clear && (runtime_ns < SCHEDULER_DL_MIN_RUNTIME_NS || runtime_ns > deadline_ns ||
+                   deadline_ns > period_ns || period_ns > SCHEDULER_DL_MAX_PERIOD_NS))
+        return false;
+
+    uint64_t bandwidth = clear ? 0 : (runtime_ns << SCHEDULER_DL_BW_SHIFT) / period_ns;
+
+    uint64_t rflags = cpu_save_and_disable_interrupts();
+    scheduler_cpu_t *cpu = this_scheduler_cpu();
+    thread_t *thread = cpu->current;
+
+    spinlock_acquire(&cpu->lock);
+
+    thread_deadline_t *dl = &thread->deadline;
+    bool was_deadline = thread->policy == THREAD_POLICY_DEADLINE;
+    uint64_t new_bw = cpu->dl_bw - (was_deadline ? dl->bandwidth : 0) + bandwidth;
+    bool admitted = !thread->is_idle && new_bw <= SCHEDULER_DL_BW_LIMIT;
+
+    // the thread runs right now, so it's in no run queue and not throttled
+    if (admitted)
+    {
+        cpu->dl_bw = new_bw;
+
+        if (clear)
+        {
+            if (was_deadline)
+                cpu->dl_nr_threads--;
+
+            thread->policy = THREAD_POLICY_NORMAL;
+        }
+        else
+        {
+            if (!was_deadline)
+            {
+                cpu->dl_nr_threads++;
+                timer_init(&dl->replenish_timer, dl_replenish_timeout, thread);
+            }
+
+            uint64_t now = ktime_get_ns();
+
+            dl->runtime_ns = runtime_ns;
+            dl->deadline_ns = deadline_ns;
+            dl->period_ns = period_ns;
+            dl->bandwidth = bandwidth;
+            dl->abs_deadline = now + deadline_ns;
+            dl->runtime_left = runtime_ns;
+            dl->exec_start = now;
+            dl->throttled = false;
+
+            thread->policy = THREAD_POLICY_DEADLINE;
+        }
+    }
+    else
+    {
+        cpu->stats.dl_rejected++;
+    }
+
+    spinlock_release(&cpu->lock);
+    cpu_restore_interrupts(rflags);
+
+    return admitted;
+}
+
+// stop the current thread for good, it gets freed after the switch away
+__attribute__((noreturn))
+void thread_exit(void)
+{
+    cpu_save_and_disable_interrupts();
+
+    scheduler_cpu_t *cpu = this_scheduler_cpu();
+
+    spinlock_acquire(&cpu->lock);
+    cpu->current->state = THREAD_DEAD;
+    spinlock_release(&cpu->lock);
+
+    thread_yield();
+
+    for (;;)
+        asm ("hlt");
+}
@@ -0,0 +1,71 @@
+/*
+	This file is part of an x86_64 hobbyist operating system called KnutOS
+	Everything is openly developed on GitHub: https://github.com/Tix3Dev/KnutOS/
+
+	Copyright (C) 2021-2022  Yves Vollmeier <https://github.com/Tix3Dev>
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <scheduler/thread.h>
+
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#define SCHEDULER_TICK_HZ	1000	// LAPIC timer frequency, one tick = 1 ms
+#define SCHEDULER_STEAL_BATCH	8	// most threads moved by a single steal
+#define SCHEDULER_IDLE_BALANCE_MS 50	// longest an idle cpu sleeps without looking for work
+
+// deadline class: bandwidth = runtime / period in fixed point, admission keeps
+// the sum per cpu below SCHEDULER_DL_BW_LIMIT so normal threads still get some time
+#define SCHEDULER_DL_BW_SHIFT	20
+#define SCHEDULER_DL_BW_UNIT	(1ULL << SCHEDULER_DL_BW_SHIFT)
+#define SCHEDULER_DL_BW_LIMIT	(SCHEDULER_DL_BW_UNIT * 95 / 100)
+#define SCHEDULER_DL_MIN_RUNTIME_NS 100000ULL		// budgets are enforced per tick anyway
+#define SCHEDULER_DL_MAX_PERIOD_NS 10000000000ULL	// 10 s, keeps the fixed point math in 64 bit
+
+// load balancing statistics of one cpu
+typedef struct
+{
+    uint64_t	switches;
+    uint64_t	busy_ticks;
+    uint64_t	idle_ticks;
+    uint64_t	wakeups;	    // LAPIC timer interrupts, periodic or one-shot
+    uint64_t	steal_attempts;	    // looked for a victim while idle
+    uint64_t	steals;		    // attempts that moved at least one thread
+    uint64_t	threads_pulled;	    // threads stolen from other cpus
+    uint64_t	threads_pushed;	    // threads other cpus stole from this one
+    uint64_t	dl_throttles;	    // deadline threads that used up their budget
+    uint64_t	dl_misses;	    // deadline threads that ran past their deadline
+    uint64_t	dl_rejected;	    // reservations admission control turned down
+} scheduler_stats_t;
+
+void scheduler_init(void);
+void scheduler_init_cpu(size_t cpu);
+void scheduler_add_thread(thread_t *thread, size_t cpu);
+uint64_t scheduler_tick(uint64_t rsp);
+uint64_t scheduler_yield_from_interrupt(uint64_t rsp);
+uint64_t scheduler_irq_exit(uint64_t rsp);
+void scheduler_finish_switch(void);
+size_t scheduler_get_queued(size_t cpu);
+uint64_t scheduler_next_tick_ns(void);
+const scheduler_stats_t *scheduler_get_stats(size_t cpu);
+void scheduler_set_priority(thread_t *thread, thread_priority_t priority);
+void scheduler_set_cpu_limit(size_t cpu_limit);
+void scheduler_set_stealing(bool stealing);
+void scheduler_set_tickless(bool tickless);
+void scheduler_print_stats(void);
+
+#endif
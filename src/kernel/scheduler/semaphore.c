@@ -0,0 +1,69 @@
+/*
+	This file is part of an x86_64 hobbyist operating system called KnutOS
+	Everything is openly developed on GitHub: https://github.com/Tix3Dev/KnutOS/
+
+	Copyright (C) 2021-2022  Yves Vollmeier <https://github.com/Tix3Dev>
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <scheduler/semaphore.h>
+#include <scheduler/wait.h>
+
+void semaphore_init(semaphore_t *semaphore, const char *name, int64_t count)
+{
+    *semaphore = (semaphore_t)SEMAPHORE_INIT(name, count);
+}
+
+// take one unit if there is one, never sleeps (usable from interrupt handlers)
+bool semaphore_try_down(semaphore_t *semaphore)
+{
+    int64_t count = __atomic_load_n(&semaphore->count, __ATOMIC_RELAXED);
+
+    while (count > 0)
+    {
+        if (__atomic_compare_exchange_n(&semaphore->count, &count, count - 1, false,
+                                        __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+            return true;
+    }
+
+    return false;
+}
+
+// take one unit, sleep until there is one
+void semaphore_down(semaphore_t *semaphore)
+{
+    if (semaphore_try_down(semaphore))
+        return;
+
+    wait_event(&semaphore->waiters, semaphore_try_down(semaphore));
+}
+
+// returns false if no unit became available within ms milliseconds
+bool semaphore_down_timeout(semaphore_t *semaphore, uint64_t ms)
+{
+    if (semaphore_try_down(semaphore))
+        return true;
+
+    return wait_event_timeout(&semaphore->waiters, semaphore_try_down(semaphore), ms);
+}
+
+// give one unit back and wake up a waiter (usable from interrupt handlers)
+void semaphore_up(semaphore_t *semaphore)
+{
+    __atomic_fetch_add(&semaphore->count, 1, __ATOMIC_SEQ_CST);
+
+    if (wait_queue_has_waiters(&semaphore->waiters))
+        wake_up_one(&semaphore->waiters);
+}
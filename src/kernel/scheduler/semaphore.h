@@ -0,0 +1,42 @@
+/*
+	This file is part of an x86_64 hobbyist operating system called KnutOS
+	Everything is openly developed on GitHub: https://github.com/Tix3Dev/KnutOS/
+
+	Copyright (C) 2021-2022  Yves Vollmeier <https://github.com/Tix3Dev>
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <scheduler/wait.h>
+
+#ifndef SEMAPHORE_H
+#define SEMAPHORE_H
+
+// counting semaphore, down sleeps while the count is 0
+typedef struct
+{
+    volatile int64_t	count;
+    wait_queue_t	waiters;
+} semaphore_t;
+
+#define SEMAPHORE_INIT(semaphore_name, initial_count)	\
+    { .count = (initial_count), .waiters = WAIT_QUEUE_INIT(semaphore_name) }
+
+void semaphore_init(semaphore_t *semaphore, const char *name, int64_t count);
+void semaphore_down(semaphore_t *semaphore);
+bool semaphore_down_timeout(semaphore_t *semaphore, uint64_t ms);
+bool semaphore_try_down(semaphore_t *semaphore);
+void semaphore_up(semaphore_t *semaphore);
+
+#endif
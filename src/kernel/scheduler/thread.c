@@ -0,0 +1,306 @@
+/*
+	This file is part of an x86_64 hobbyist operating system called KnutOS
+	Everything is openly developed on GitHub: https://github.com/Tix3Dev/KnutOS/
+
+	Copyright (C) 2021-2022  Yves Vollmeier <https://github.com/Tix3Dev>
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <boot/stivale2.h>
+#include <devices/cpu/cpu.h>
+#include <devices/cpu/fpu.h>
+#include <memory/mem.h>
+#include <scheduler/pi_mutex.h>
+#include <scheduler/scheduler.h>
+#include <scheduler/thread.h>
+#include <smp/smp.h>
+#include <time/clocksource.h>
+#include <libk/alloc/kmalloc.h>
+#include <libk/debug/debug.h>
+#include <libk/lock/rwlock.h>
+#include <libk/stdio/stdio.h>
+#include <libk/string/string.h>
+
+// time slices in scheduler ticks, interactive threads get short ones
+static const uint32_t default_timeslices[THREAD_PRIORITY_COUNT] =
+{
+    [THREAD_PRIORITY_HIGH]	= 5,
+    [THREAD_PRIORITY_NORMAL]	= 10,
+    [THREAD_PRIORITY_LOW]	= 20
+};
+
+static thread_t	    *thread_list = NULL;
+static rwlock_t	    thread_list_lock = RWLOCK_INIT("thread list");	// readers only walk the list
+static size_t	    next_tid = 0;
+
+// every thread starts here (rdi = thread) and exits once entry returns
+__attribute__((noreturn))
+static void thread_start(thread_t *thread)
+{
+    thread->entry(thread->arg);
+
+    thread_exit();
+}
+
+static void thread_list_add(thread_t *thread)
+{
+    uint64_t rflags = rwlock_write_acquire_irqsave(&thread_list_lock);
+
+    thread->list_next = thread_list;
+    thread_list = thread;
+
+    rwlock_write_release_irqrestore(&thread_list_lock, rflags);
+}
+
+static thread_t *thread_alloc(const char *name, thread_priority_t priority)
+{
+    thread_t *thread = kmalloc(sizeof(thread_t));
+
+    if (!thread)
+        return NULL;
+
+    memset(thread, 0, sizeof(thread_t));
+
+    thread->tid = __atomic_fetch_add(&next_tid, 1, __ATOMIC_RELAXED);
+    strncpy(thread->name, name, THREAD_NAME_LENGTH - 1);
+    thread->priority = priority;
+    thread->base_priority = priority;
+    thread->timeslice = default_timeslices[priority];
+
+    return thread;
+}
+
+// create a kernel thread that runs entry(arg) on it's own stack,
+// queued on the cpu of the caller
+thread_t *thread_create(const char *name, void (*entry)(void *), void *arg, thread_priority_t priority)
+{
+    return thread_create_on_cpu(name, entry, arg, priority, smp_get_current_cpu());
+}
+
+// same as thread_create, but queue it on cpu (other cpus may still steal it)
+// the initial stack looks like the thread got interrupted right
+// before the first instruction of thread_start
+thread_t *thread_create_on_cpu(const char *name, void (*entry)(void *), void *arg, thread_priority_t priority,
+                               size_t cpu)
+{
+    thread_t *thread = thread_alloc(name, priority);
+
+    if (!thread)
+        return NULL;
+
+    thread->stack = kmalloc(THREAD_STACK_SIZE);
+
+    if (!thread->stack)
+    {
+        kfree(thread);
+        return NULL;
+    }
+
+    thread->entry = entry;
+    thread->arg = arg;
+
+    uintptr_t stack_top = (uintptr_t)thread->stack + THREAD_STACK_SIZE;
+
+    // the interrupt stub keeps rsp 16 byte aligned at "call isr_handler"
+    interrupt_cpu_state_t *frame = (interrupt_cpu_state_t *)
+        ALIGN_DOWN(stack_top - 64 - sizeof(interrupt_cpu_state_t), 16);
+
+    memset(frame, 0, sizeof(interrupt_cpu_state_t));
+
+    frame->rip = (uint64_t)thread_start;
+    frame->rdi = (uint64_t)thread;
+    frame->cs = 0x08;
+    frame->ss = 0x10;
+    frame->rflags = 0x202;	// interrupts enabled
+    frame->rsp = stack_top - 8;	// as if thread_start had been called
+
+    thread->rsp = (uint64_t)frame;
+
+    thread_list_add(thread);
+    scheduler_add_thread(thread, cpu);
+
+    return thread;
+}
+
+// descriptor for the context that becomes the idle thread of a cpu
+// -> it keeps running on the stack it already has
+thread_t *thread_create_idle(size_t cpu)
+{
+    thread_t *thread = thread_alloc("idle", THREAD_PRIORITY_LOW);
+
+    if (!thread)
+        return NULL;
+
+    thread->state = THREAD_RUNNING;
+    thread->on_cpu = true;
+    thread->is_idle = true;
+    thread->cpu = cpu;
+
+    thread_list_add(thread);
+
+    return thread;
+}
+
+// free a dead thread, only called once nothing runs on it's stack anymore
+void thread_destroy(thread_t *thread)
+{
+    uint64_t rflags = rwlock_write_acquire_irqsave(&thread_list_lock);
+
+    for (thread_t **link = &thread_list; *link; link = &(*link)->list_next)
+    {
+        if (*link == thread)
+        {
+            *link = thread->list_next;
+            break;
+        }
+    }
+
+    rwlock_write_release_irqrestore(&thread_list_lock, rflags);
+
+    fpu_free_state(thread);
+    kfree(thread->stack);
+    kfree(thread);
+}
+
+// thread_list_lock has to be held, the thread can't be freed until it's released
+static thread_t *thread_find_locked(size_t tid)
+{
+    thread_t *thread = thread_list;
+
+    while (thread && thread->tid != tid)
+        thread = thread->list_next;
+
+    return thread;
+}
+
+// takes effect right away, but a priority inherited through a pi_mutex stays until it's released
+void thread_set_priority(thread_t *thread, thread_priority_t priority)
+{
+    if (thread->is_idle || priority >= THREAD_PRIORITY_COUNT)
+        return;
+
+    thread->base_priority = priority;
+    pi_mutex_adjust_priority(thread);
+}
+
+void thread_set_timeslice(thread_t *thread, uint32_t ticks)
+{
+    if (ticks == 0)
+        ticks = default_timeslices[thread->base_priority];
+
+    thread->timeslice = ticks;
+}
+
+// thread_set_priority for a thread that may exit meanwhile, returns false if there is none with tid
+bool thread_set_priority_by_tid(size_t tid, thread_priority_t priority)
+{
+    uint64_t rflags = rwlock_read_acquire_irqsave(&thread_list_lock);
+    thread_t *thread = thread_find_locked(tid);
+
+    if (thread)
+        thread_set_priority(thread, priority);
+
+    rwlock_read_release_irqrestore(&thread_list_lock, rflags);
+
+    return thread != NULL;
+}
+
+// thread_set_timeslice for a thread that may exit meanwhile
+// returns the new time slice, 0 if there is no thread with tid
+uint32_t thread_set_timeslice_by_tid(size_t tid, uint32_t ticks)
+{
+    uint64_t rflags = rwlock_read_acquire_irqsave(&thread_list_lock);
+    thread_t *thread = thread_find_locked(tid);
+
+    if (thread)
+    {
+        thread_set_timeslice(thread, ticks);
+        ticks = thread->timeslice;
+    }
+
+    rwlock_read_release_irqrestore(&thread_list_lock, rflags);
+
+    return thread ? ticks : 0;
+}
+
+uint32_t thread_default_timeslice(thread_priority_t priority)
+{
+    return default_timeslices[priority];
+}
+
+const char *thread_state_to_string(thread_state_t state)
+{
+    switch (state)
+    {
+        case THREAD_READY:
+            return "ready";
+        case THREAD_RUNNING:
+            return "running";
+        case THREAD_BLOCKED:
+            return "blocked";
+        case THREAD_DEAD:
+            return "dead";
+        default:
+            return "unknown";
+    }
+}
+
+const char *thread_priority_to_string(thread_priority_t priority)
+{
+    switch (priority)
+    {
+        case THREAD_PRIORITY_HIGH:
+            return "high";
+        case THREAD_PRIORITY_NORMAL:
+            return "normal";
+        case THREAD_PRIORITY_LOW:
+            return "low";
+        default:
+            return "unknown";
+    }
+}
+
+// print every thread with it's scheduling parameters and statistics
+void thread_print_all(void)
+{
+    uint64_t rflags = rwlock_read_acquire_irqsave(&thread_list_lock);
+
+    printk(GFX_CYAN, "%-5s %-16s %-8s %-9s %-6s %-4s %-10s %s\n",
+           "tid", "name", "state", "prio", "slice", "cpu", "ticks", "switches");
+
+    for (thread_t *thread = thread_list; thread; thread = thread->list_next)
+    {
+        const char *priority = thread->is_idle ? "idle" : thread_priority_to_string(thread->priority);
+
+        if (thread->policy == THREAD_POLICY_DEADLINE)
+            priority = "deadline";
+        else if (thread->priority != thread->base_priority)
+            priority = thread->priority == THREAD_PRIORITY_HIGH ? "high(pi)" : "norm(pi)";
+
+        printk(GFX_WHITE, "%-5d %-16s %-8s %-9s %-6d %-4d %-10llu %llu\n",
+               thread->tid, thread->name, thread_state_to_string(thread->state), priority,
+               thread->timeslice, thread->cpu, thread->runtime_ticks, thread->switch_count);
+
+        if (thread->policy == THREAD_POLICY_DEADLINE)
+        {
+            printk(GFX_WHITE, "      runtime %llu us, deadline %llu us, period %llu us | throttled %llu, missed %llu\n",
+                   thread->deadline.runtime_ns / NSEC_PER_USEC, thread->deadline.deadline_ns / NSEC_PER_USEC,
+                   thread->deadline.period_ns / NSEC_PER_USEC, thread->deadline.throttles, thread->deadline.misses);
+        }
+    }
+
+    rwlock_read_release_irqrestore(&thread_list_lock, rflags);
+}
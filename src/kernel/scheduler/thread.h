@@ -0,0 +1,135 @@
+/*
+	This file is part of an x86_64 hobbyist operating system called KnutOS
+	Everything is openly developed on GitHub: https://github.com/Tix3Dev/KnutOS/
+
+	Copyright (C) 2021-2022  Yves Vollmeier <https://github.com/Tix3Dev>
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <time/timer.h>
+
+#ifndef THREAD_H
+#define THREAD_H
+
+#define THREAD_STACK_SIZE	(16 * 1024)
+#define THREAD_NAME_LENGTH	32
+
+typedef enum
+{
+    THREAD_READY,	// waiting in a run queue (or about to be put back into one)
+    THREAD_RUNNING,
+    THREAD_BLOCKED,	// waiting for thread_unblock
+    THREAD_DEAD		// stack and descriptor get freed after the switch away
+} thread_state_t;
+
+// lower value = higher priority, a ready thread always beats lower priorities
+typedef enum
+{
+    THREAD_PRIORITY_HIGH,
+    THREAD_PRIORITY_NORMAL,
+    THREAD_PRIORITY_LOW,
+    THREAD_PRIORITY_COUNT
+} thread_priority_t;
+
+struct pi_mutex;
+
+typedef enum
+{
+    THREAD_POLICY_NORMAL,	// priority run queues, round robin with time slices
+    THREAD_POLICY_DEADLINE	// earliest deadline first, runs before any normal thread
+} thread_policy_t;
+
+// reservation of a THREAD_POLICY_DEADLINE thread: runtime_ns of cpu time
+// within deadline_ns after the start of every period
+typedef struct
+{
+    uint64_t		runtime_ns;
+    uint64_t		deadline_ns;	// relative to the start of a period
+    uint64_t		period_ns;
+    uint64_t		bandwidth;	// runtime / period, SCHEDULER_DL_BW_SHIFT fixed point
+
+    uint64_t		abs_deadline;	// ktime of the current deadline
+    int64_t		runtime_left;	// budget left until that deadline
+    uint64_t		exec_start;	// ktime the budget was charged last
+    bool		throttled;	// budget used up, waits for replenish_timer
+    timer_t		replenish_timer;
+
+    uint64_t		throttles;
+    uint64_t		misses;		// ran or finished past it's deadline
+} thread_deadline_t;
+
+typedef struct thread
+{
+    uint64_t		rsp;		// saved interrupt_cpu_state_t while not running
+    size_t		tid;
+    char		name[THREAD_NAME_LENGTH];
+
+    volatile thread_state_t state;
+    thread_priority_t	priority;	// effective priority, may be inherited through a pi_mutex
+    thread_priority_t	base_priority;	// set by thread_set_priority
+    thread_policy_t	policy;
+    uint32_t		timeslice;	// scheduler ticks per slice
+    uint32_t		ticks_left;
+
+    bool		on_cpu;		// running, or still being switched away from
+    bool		is_idle;	// per cpu idle thread, never in a run queue
+    size_t		cpu;		// cpu it ran on last
+
+    void		*stack;
+    void		(*entry)(void *);
+    void		*arg;
+
+    void		*fpu_state;	// XSAVE area, allocated on the first kernel_fpu_begin
+    size_t		fpu_cpu;	// cpu the FPU state was restored on last
+
+    thread_deadline_t	deadline;	// only used by THREAD_POLICY_DEADLINE
+
+    struct pi_mutex	*pi_blocked_on;	// pi_mutex this thread waits for
+    struct pi_mutex	*pi_held;	// held pi_mutexes that have waiters
+
+    uint64_t		runtime_ticks;
+    uint64_t		switch_count;
+
+    struct thread	*next;		// run queue link
+    struct thread	*list_next;	// list of all threads
+} thread_t;
+
+thread_t *thread_create(const char *name, void (*entry)(void *), void *arg, thread_priority_t priority);
+thread_t *thread_create_on_cpu(const char *name, void (*entry)(void *), void *arg, thread_priority_t priority,
+                               size_t cpu);
+thread_t *thread_create_idle(size_t cpu);
+void thread_destroy(thread_t *thread);
+void thread_set_priority(thread_t *thread, thread_priority_t priority);
+void thread_set_timeslice(thread_t *thread, uint32_t ticks);
+bool thread_set_priority_by_tid(size_t tid, thread_priority_t priority);
+uint32_t thread_set_timeslice_by_tid(size_t tid, uint32_t ticks);
+uint32_t thread_default_timeslice(thread_priority_t priority);
+const char *thread_state_to_string(thread_state_t state);
+const char *thread_priority_to_string(thread_priority_t priority);
+void thread_print_all(void);
+
+thread_t *thread_current(void);
+void thread_yield(void);
+void thread_prepare_block(void);
+void thread_cancel_block(void);
+void thread_block(void);
+void thread_unblock(thread_t *thread);
+void thread_sleep_ms(uint64_t ms);
+void thread_sleep_until(uint64_t expires);
+bool thread_set_deadline(uint64_t runtime_ns, uint64_t deadline_ns, uint64_t period_ns);
+__attribute__((noreturn)) void thread_exit(void);
+
+#endif
@@ -0,0 +1,211 @@
+/*
+	This file is part of an x86_64 hobbyist operating system called KnutOS
+	Everything is openly developed on GitHub: https://github.com/Tix3Dev/KnutOS/
+
+	Copyright (C) 2021-2022  Yves Vollmeier <https://github.com/Tix3Dev>
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <scheduler/thread.h>
+#include <scheduler/wait.h>
+#include <time/timer.h>
+#include <libk/lock/spinlock.h>
+
+/*  Explanation of wait queues:
+    A thread that has to wait for something (data from a device, a lock,
+    another thread finishing) puts an entry on the wait queue belonging
+    to that event and blocks, using no cpu time until it's woken up.
+
+    The order is what makes it race free: prepare_to_wait queues the
+    entry and marks the thread blocked *before* the condition is checked.
+    If the waker makes the condition true and calls wake_up_* in between,
+    the thread is already queued, so thread_unblock turns it ready again
+    and the following thread_yield returns right away instead of sleeping
+    forever. Afterwards the condition is checked again, as another thread
+    may have gotten there first.
+
+    Waking removes the entry from the queue (the waiter puts it back in
+    the next prepare_to_wait if it has to wait again), so wake_up_one
+    never wakes the same thread twice while others are still waiting.
+    The queue lock is held during thread_unblock, which keeps the entry
+    (on the waiter's stack) alive until the waker is done with it. The
+    same goes for the timeout timer: finish_wait deletes it with
+    timer_del_sync, which waits for a callback still running on another
+    cpu. Lock order: wait queue lock, then run queue lock.
+*/
+
+static void wait_queue_remove(wait_queue_t *queue, wait_queue_entry_t *entry)
+{
+    if (entry->prev)
+        entry->prev->next = entry->next;
+    else
+        queue->head = entry->next;
+
+    if (entry->next)
+        entry->next->prev = entry->prev;
+    else
+        queue->tail = entry->prev;
+
+    entry->next = NULL;
+    entry->prev = NULL;
+    entry->queued = false;
+}
+
+static void wait_timeout_expired(void *arg)
+{
+    wait_queue_entry_t *entry = arg;
+
+    entry->timed_out = true;
+    thread_unblock(entry->thread);
+}
+
+void wait_queue_init(wait_queue_t *queue, const char *name)
+{
+    spinlock_init(&queue->lock, name);
+    queue->head = NULL;
+    queue->tail = NULL;
+}
+
+// the queue's memory is about to be reused, nobody may be waiting on it
+void wait_queue_destroy(wait_queue_t *queue)
+{
+    spinlock_destroy(&queue->lock);
+}
+
+// prepare an entry for the calling thread
+void wait_entry_init(wait_queue_entry_t *entry)
+{
+    entry->thread = thread_current();
+    entry->queued = false;
+    entry->timed_out = false;
+    entry->expires = 0;
+    entry->next = NULL;
+    entry->prev = NULL;
+
+    timer_init(&entry->timer, wait_timeout_expired, entry);
+}
+
+// wake the thread up after ms milliseconds even if nobody else does
+void wait_entry_set_timeout(wait_queue_entry_t *entry, uint64_t ms)
+{
+    entry->expires = timer_get_jiffies() + timer_ms_to_jiffies(ms) + 1;	// + 1: we are somewhere in a jiffy
+
+    timer_add(&entry->timer, entry->expires);
+}
+
+// queue the entry (if it isn't yet) and mark the thread blocked,
+// the caller checks it's condition afterwards and then yields or finishes
+void prepare_to_wait(wait_queue_t *queue, wait_queue_entry_t *entry)
+{
+    uint64_t rflags = spinlock_acquire_irqsave(&queue->lock);
+
+    if (!entry->queued)
+    {
+        entry->next = NULL;
+        entry->prev = queue->tail;
+
+        if (queue->tail)
+            queue->tail->next = entry;
+        else
+            queue->head = entry;
+
+        queue->tail = entry;
+        entry->queued = true;
+    }
+
+    thread_prepare_block();
+
+    spinlock_release_irqrestore(&queue->lock, rflags);
+}
+
+// the wait is over: run again and leave the queue
+// returns whether a wake_up_* took the entry out of the queue
+bool finish_wait(wait_queue_t *queue, wait_queue_entry_t *entry)
+{
+    thread_cancel_block();
+
+    uint64_t rflags = spinlock_acquire_irqsave(&queue->lock);
+    bool woken = !entry->queued;
+
+    if (entry->queued)
+        wait_queue_remove(queue, entry);
+
+    spinlock_release_irqrestore(&queue->lock, rflags);
+
+    if (entry->expires)
+        timer_del_sync(&entry->timer);
+
+    return woken;
+}
+
+// wake_up_one with queue->lock already held, for wakers that update the condition under it
+bool wake_up_one_locked(wait_queue_t *queue)
+{
+    wait_queue_entry_t *entry = queue->head;
+
+    if (entry)
+    {
+        wait_queue_remove(queue, entry);
+        thread_unblock(entry->thread);
+    }
+
+    return entry != NULL;
+}
+
+// wake_up_all with queue->lock already held
+size_t wake_up_all_locked(wait_queue_t *queue)
+{
+    size_t woken = 0;
+
+    while (queue->head)
+    {
+        wait_queue_entry_t *entry = queue->head;
+
+        wait_queue_remove(queue, entry);
+        thread_unblock(entry->thread);
+        woken++;
+    }
+
+    return woken;
+}
+
+// wake up the thread that waits the longest, returns whether there was one
+bool wake_up_one(wait_queue_t *queue)
+{
+    uint64_t rflags = spinlock_acquire_irqsave(&queue->lock);
+    bool woken = wake_up_one_locked(queue);
+
+    spinlock_release_irqrestore(&queue->lock, rflags);
+
+    return woken;
+}
+
+// wake up every waiting thread, returns how many there were
+size_t wake_up_all(wait_queue_t *queue)
+{
+    uint64_t rflags = spinlock_acquire_irqsave(&queue->lock);
+    size_t woken = wake_up_all_locked(queue);
+
+    spinlock_release_irqrestore(&queue->lock, rflags);
+
+    return woken;
+}
+
+// racy without the queue lock, only a hint (e.g. to skip a wake up)
+bool wait_queue_has_waiters(wait_queue_t *queue)
+{
+    return queue->head != NULL;
+}
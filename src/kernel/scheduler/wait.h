@@ -0,0 +1,114 @@
+/*
+	This file is part of an x86_64 hobbyist operating system called KnutOS
+	Everything is openly developed on GitHub: https://github.com/Tix3Dev/KnutOS/
+
+	Copyright (C) 2021-2022  Yves Vollmeier <https://github.com/Tix3Dev>
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <scheduler/thread.h>
+#include <time/timer.h>
+#include <libk/lock/spinlock.h>
+
+#ifndef WAIT_H
+#define WAIT_H
+
+// one waiting thread, lives on the waiter's stack
+typedef struct wait_queue_entry
+{
+    thread_t			*thread;
+    bool			queued;		// still in the queue, cleared by the wake up
+    volatile bool		timed_out;	// set by the timeout timer
+
+    timer_t			timer;		// only used by the *_timeout waits
+    uint64_t			expires;
+
+    struct wait_queue_entry	*next;
+    struct wait_queue_entry	*prev;
+} wait_queue_entry_t;
+
+// FIFO of sleeping threads waiting for a condition
+typedef struct
+{
+    spinlock_t		lock;
+    wait_queue_entry_t	*head;
+    wait_queue_entry_t	*tail;
+} wait_queue_t;
+
+#define WAIT_QUEUE_INIT(queue_name)	{ .lock = SPINLOCK_INIT(queue_name), .head = NULL, .tail = NULL }
+
+void wait_queue_init(wait_queue_t *queue, const char *name);
+void wait_queue_destroy(wait_queue_t *queue);
+void wait_entry_init(wait_queue_entry_t *entry);
+void wait_entry_set_timeout(wait_queue_entry_t *entry, uint64_t ms);
+void prepare_to_wait(wait_queue_t *queue, wait_queue_entry_t *entry);
+bool finish_wait(wait_queue_t *queue, wait_queue_entry_t *entry);
+bool wake_up_one(wait_queue_t *queue);
+bool wake_up_one_locked(wait_queue_t *queue);
+size_t wake_up_all(wait_queue_t *queue);
+size_t wake_up_all_locked(wait_queue_t *queue);
+bool wait_queue_has_waiters(wait_queue_t *queue);
+
+// sleep until condition is true, it's rechecked after every wake up
+// -> the waker must make the condition true before calling wake_up_*
+#define wait_event(queue, condition)					\
+    do									\
+    {									\
+        wait_queue_entry_t __entry;					\
+									\
+        wait_entry_init(&__entry);					\
+									\
+        for (;;)							\
+        {								\
+            prepare_to_wait((queue), &__entry);				\
+									\
+            if (condition)						\
+                break;							\
+									\
+            thread_yield();						\
+        }								\
+									\
+        finish_wait((queue), &__entry);					\
+    } while (0)
+
+// like wait_event, but gives up after ms milliseconds
+// -> evaluates to whether the condition became true
+// -> a wake_up_one that raced with the timeout is passed on to the next waiter
+#define wait_event_timeout(queue, condition, ms)			\
+    ({									\
+        wait_queue_entry_t __entry;					\
+        bool __done;							\
+									\
+        wait_entry_init(&__entry);					\
+        wait_entry_set_timeout(&__entry, (ms));				\
+									\
+        for (;;)							\
+        {								\
+            prepare_to_wait((queue), &__entry);				\
+									\
+            if ((__done = (condition)) || __entry.timed_out)		\
+                break;							\
+									\
+            thread_yield();						\
+        }								\
+									\
+        if (finish_wait((queue), &__entry) && !__done)			\
+            wake_up_one(queue);						\
+									\
+        __done;								\
+    })
+
+#endif
@@ -0,0 +1,215 @@
+/*
+	This file is part of an x86_64 hobbyist operating system called KnutOS
+	Everything is openly developed on GitHub: https://github.com/Tix3Dev/KnutOS/
+
+	Copyright (C) 2021-2022  Yves Vollmeier <https://github.com/Tix3Dev>
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <boot/stivale2.h>
+#include <devices/cpu/cpu.h>
+#include <scheduler/thread.h>
+#include <scheduler/workqueue.h>
+#include <smp/smp.h>
+#include <libk/alloc/kmalloc.h>
+#include <libk/kprintf/kprintf.h>
+#include <libk/lock/spinlock.h>
+#include <libk/log/log.h>
+#include <libk/stdio/stdio.h>
+#include <libk/string/string.h>
+
+/*  Explanation of workqueues:
+    A workqueue has a worker thread for every cpu, each with it's own
+    FIFO of work items and it's own lock. queue_work appends the item to
+    the queue of the calling cpu and wakes that cpu's worker, so an
+    interrupt handler that queues work only takes one uncontended lock.
+    Workers are normal threads: they can block, sleep and take mutexes,
+    and they are preempted by higher priority threads like any other.
+    The scheduler may still steal a worker to another cpu, so the
+    per cpu split is about locality and lock contention, not affinity.
+
+    A work item is queued at most once at a time. The pending flag is
+    cleared right before it runs, so it can be queued again (even from
+    it's own function) and then simply runs once more. Items of the same
+    pool run one after another in the order they were queued.
+*/
+
+workqueue_t *system_workqueue = NULL;
+
+static workqueue_t  *workqueue_list = NULL;
+static spinlock_t   workqueue_list_lock = SPINLOCK_INIT("workqueue list");
+
+static void worker_thread_main(void *arg)
+{
+    worker_pool_t *pool = arg;
+
+    for (;;)
+    {
+        // marked blocked before looking, so a queue_work in between isn't lost
+        thread_prepare_block();
+
+        uint64_t rflags = spinlock_acquire_irqsave(&pool->lock);
+        work_t *work = pool->head;
+
+        if (!work)
+        {
+            spinlock_release_irqrestore(&pool->lock, rflags);
+            thread_yield();
+            continue;
+        }
+
+        pool->head = work->next;
+
+        if (!pool->head)
+            pool->tail = NULL;
+
+        work->next = NULL;
+        work->pending = false;
+        pool->executed++;
+
+        spinlock_release_irqrestore(&pool->lock, rflags);
+
+        thread_cancel_block();
+
+        work->func(work->arg);
+    }
+}
+
+// create a workqueue with a worker of the given priority on every cpu
+// -> call after smp_init, cpus started later don't get a worker
+workqueue_t *workqueue_create(const char *name, thread_priority_t priority)
+{
+    workqueue_t *workqueue = kmalloc(sizeof(workqueue_t));
+
+    if (!workqueue)
+        return NULL;
+
+    memset(workqueue, 0, sizeof(workqueue_t));
+    strncpy(workqueue->name, name, WORKQUEUE_NAME_LENGTH - 1);
+
+    workqueue->pool_count = smp_cpu_count ? smp_cpu_count : 1;
+    workqueue->pools = kcalloc(workqueue->pool_count, sizeof(worker_pool_t));
+
+    if (!workqueue->pools)
+    {
+        kfree(workqueue);
+        return NULL;
+    }
+
+    for (size_t i = 0; i < workqueue->pool_count; i++)
+    {
+        worker_pool_t *pool = &workqueue->pools[i];
+        char thread_name[THREAD_NAME_LENGTH];
+
+        spinlock_init(&pool->lock, "worker pool");
+        snprintf(thread_name, sizeof(thread_name), "%s/%d", workqueue->name, (int)i);
+
+        pool->worker = thread_create_on_cpu(thread_name, worker_thread_main, pool, priority, i);
+
+        if (!pool->worker)
+        {
+            serial_log(ERROR, "Workqueue %s: couldn't create the worker of cpu %d\n", workqueue->name, (int)i);
+            kernel_log(ERROR, "Workqueue %s: couldn't create the worker of cpu %d\n", workqueue->name, (int)i);
+        }
+    }
+
+    uint64_t rflags = spinlock_acquire_irqsave(&workqueue_list_lock);
+
+    workqueue->next = workqueue_list;
+    workqueue_list = workqueue;
+
+    spinlock_release_irqrestore(&workqueue_list_lock, rflags);
+
+    return workqueue;
+}
+
+void workqueue_init(void)
+{
+    system_workqueue = workqueue_create("events", THREAD_PRIORITY_HIGH);
+
+    serial_log(INFO, "Workqueues initialized: %d workers\n", (int)system_workqueue->pool_count);
+    kernel_log(INFO, "Workqueues initialized: %d workers\n", (int)system_workqueue->pool_count);
+}
+
+void work_init(work_t *work, void (*func)(void *), void *arg)
+{
+    work->func = func;
+    work->arg = arg;
+    work->next = NULL;
+    work->pending = false;
+}
+
+// queue work on the pool of cpu and wake it's worker
+// returns false if the work was already pending (it then runs only once)
+bool queue_work_on(workqueue_t *workqueue, work_t *work, size_t cpu)
+{
+    if (__atomic_exchange_n(&work->pending, true, __ATOMIC_ACQ_REL))
+        return false;
+
+    worker_pool_t *pool = &workqueue->pools[cpu % workqueue->pool_count];
+    uint64_t rflags = spinlock_acquire_irqsave(&pool->lock);
+
+    work->next = NULL;
+
+    if (pool->tail)
+        pool->tail->next = work;
+    else
+        pool->head = work;
+
+    pool->tail = work;
+    pool->queued++;
+
+    spinlock_release_irqrestore(&pool->lock, rflags);
+
+    if (pool->worker)
+        thread_unblock(pool->worker);
+
+    return true;
+}
+
+// queue work on the calling cpu, callable from interrupt handlers
+bool queue_work(workqueue_t *workqueue, work_t *work)
+{
+    uint64_t rflags = cpu_save_and_disable_interrupts();
+
+    bool queued = queue_work_on(workqueue, work, smp_get_current_cpu());
+
+    cpu_restore_interrupts(rflags);
+
+    return queued;
+}
+
+bool schedule_work(work_t *work)
+{
+    return queue_work(system_workqueue, work);
+}
+
+// queued and executed items of every pool of every workqueue
+void workqueue_print_stats(void)
+{
+    printk(GFX_CYAN, "%-16s %-4s %-10s %-10s %s\n", "workqueue", "cpu", "queued", "executed", "worker");
+
+    for (workqueue_t *workqueue = workqueue_list; workqueue; workqueue = workqueue->next)
+    {
+        for (size_t i = 0; i < workqueue->pool_count; i++)
+        {
+            worker_pool_t *pool = &workqueue->pools[i];
+
+            printk(GFX_WHITE, "%-16s %-4d %-10llu %-10llu %s\n", workqueue->name, i, pool->queued,
+                   pool->executed, pool->worker ? pool->worker->name : "-");
+        }
+    }
+}
@@ -0,0 +1,72 @@
+/*
+	This file is part of an x86_64 hobbyist operating system called KnutOS
+	Everything is openly developed on GitHub: https://github.com/Tix3Dev/KnutOS/
+
+	Copyright (C) 2021-2022  Yves Vollmeier <https://github.com/Tix3Dev>
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <scheduler/thread.h>
+#include <libk/lock/spinlock.h>
+
+#ifndef WORKQUEUE_H
+#define WORKQUEUE_H
+
+#define WORKQUEUE_NAME_LENGTH	16
+
+// a deferred function call, queued at most once at a time
+typedef struct work
+{
+    void		(*func)(void *);
+    void		*arg;
+
+    struct work		*next;
+    volatile bool	pending;	// queued and not yet started
+} work_t;
+
+// the queue and worker thread of one cpu
+typedef struct
+{
+    spinlock_t	lock;
+    work_t	*head;
+    work_t	*tail;
+    thread_t	*worker;
+
+    uint64_t	queued;
+    uint64_t	executed;
+} worker_pool_t;
+
+typedef struct workqueue
+{
+    char		name[WORKQUEUE_NAME_LENGTH];
+    worker_pool_t	*pools;		// one per cpu
+    size_t		pool_count;
+
+    struct workqueue	*next;		// list of all workqueues
+} workqueue_t;
+
+// high priority workers on every cpu, for work deferred by interrupt handlers
+extern workqueue_t *system_workqueue;
+
+void workqueue_init(void);
+workqueue_t *workqueue_create(const char *name, thread_priority_t priority);
+void work_init(work_t *work, void (*func)(void *), void *arg);
+bool queue_work(workqueue_t *workqueue, work_t *work);
+bool queue_work_on(workqueue_t *workqueue, work_t *work, size_t cpu);
+bool schedule_work(work_t *work);
+void workqueue_print_stats(void);
+
+#endif
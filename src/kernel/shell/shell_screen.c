@@ -15,6 +15,8 @@
 	along with this program.  If not, see <https://www.gnu.org/licenses/>.
 */
 
+#include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 
 #include <boot/stivale2.h>
@@ -26,7 +28,33 @@
 #include <libk/string/string.h>
 #include <libk/graphics/graphics.h>
 #include <libk/stdlib/stdlib.h>
+#include <libk/debug/debug.h>
+#include <libk/lock/lock_stat.h>
+#include <libk/lock/spinlock.h>
+#include <libk/log/log.h>
 #include "../fs/fs.h"
+#include <bench/async_bench.h>
+#include <bench/ipi_bench.h>
+#include <bench/kmalloc_bench.h>
+#include <bench/latency_bench.h>
+#include <bench/pi_bench.h>
+#include <bench/sched_bench.h>
+#include <devices/cpu/cpuidle.h>
+#include <devices/cpu/fpu.h>
+#include <interrupts/softirq.h>
+#include <scheduler/async.h>
+#include <scheduler/rcu.h>
+#include <scheduler/scheduler.h>
+#include <scheduler/thread.h>
+#include <scheduler/wait.h>
+#include <scheduler/workqueue.h>
+#include <memory/tlb.h>
+#include <smp/ipi.h>
+#include <smp/smp.h>
+#include <time/clocksource.h>
+#include <libk/alloc/arena.h>
+#include <libk/alloc/kmalloc.h>
+#include <libk/alloc/kmalloc_profile.h>
 
 void system_reboot(void);
 
@@ -35,15 +63,90 @@ static int shell_prompt_y_barrier;
 static int taskbar_drawn = 0;
 static int terminal_open = 0;
 
+// scratch memory of the command being executed, reset after every command
+static arena_t shell_arena;
+
+#define SHELL_KEY_QUEUE_SIZE 64
+
+// keys queued by the keyboard work item, consumed by the shell thread
+static KEY_INFO_t   shell_key_queue[SHELL_KEY_QUEUE_SIZE];
+static size_t	    shell_key_head = 0;
+static size_t	    shell_key_tail = 0;
+static spinlock_t   shell_key_lock = SPINLOCK_INIT("shell keys");
+static wait_queue_t shell_key_wait = WAIT_QUEUE_INIT("shell keys wait");
+
+static void shell_thread_main(void *arg);
+static void shell_execute_command(const char *cmd, arena_t *arena);
+
 // create a "new" screen and print a basic shell prompt
-// after that activate keyboard processing and configure it to call
-// shell_print_char
+// after that start the shell thread and let the keyboard
+// queue keys for it
 void shell_screen_init(void)
 {
     framebuffer_reset_screen();
     shell_prompt();
 
-    activate_keyboard_processing(*shell_print_char);
+    arena_init(&shell_arena, 0);
+
+    thread_create("shell", shell_thread_main, NULL, THREAD_PRIORITY_HIGH);
+
+    activate_keyboard_processing(*shell_queue_key);
+}
+
+// final keyboard handler (runs on a worker thread): only queue the key and wake the shell thread
+// -> rendering and command execution happen in the shell thread
+void shell_queue_key(KEY_INFO_t key_info)
+{
+    uint64_t rflags = spinlock_acquire_irqsave(&shell_key_lock);
+
+    if (shell_key_tail - shell_key_head < SHELL_KEY_QUEUE_SIZE)
+        shell_key_queue[shell_key_tail++ % SHELL_KEY_QUEUE_SIZE] = key_info;
+
+    spinlock_release_irqrestore(&shell_key_lock, rflags);
+
+    wake_up_one(&shell_key_wait);
+}
+
+static bool shell_dequeue_key(KEY_INFO_t *key_info)
+{
+    uint64_t rflags = spinlock_acquire_irqsave(&shell_key_lock);
+
+    bool has_key = shell_key_head != shell_key_tail;
+
+    if (has_key)
+        *key_info = shell_key_queue[shell_key_head++ % SHELL_KEY_QUEUE_SIZE];
+
+    spinlock_release_irqrestore(&shell_key_lock, rflags);
+
+    return has_key;
+}
+
+// process queued keys, sleep while there are none
+static void shell_thread_main(void *arg)
+{
+    (void)arg;
+
+    KEY_INFO_t key_info;
+
+    for (;;)
+    {
+        wait_event(&shell_key_wait, shell_dequeue_key(&key_info));
+
+        shell_print_char(key_info);
+    }
+}
+
+// "<command> &" runs in it's own low priority thread with it's own scratch arena
+static void shell_background_command(void *arg)
+{
+    char *cmd = arg;
+    arena_t arena;
+
+    arena_init(&arena, 0);
+    shell_execute_command(cmd, &arena);
+    arena_destroy(&arena);
+
+    kfree(cmd);
 }
 
 // print basic shell prompt
@@ -61,16 +164,20 @@ static char shell_input_buffer[128];
 static int shell_input_index = 0;
 
 // Use strcmp from libk string
-static void shell_execute_command(const char *cmd) {
+// scratch memory comes from arena, which the caller resets afterwards
+static void shell_execute_command(const char *cmd, arena_t *arena) {
     if (strcmp(cmd, "ls") == 0) {
-        char names[FS_MAX_FILES][FS_MAX_FILENAME];
         int count = 0;
-        fs_list(names, &count);
+        char **names = fs_list(arena, &count);
+        if (!names)
+            printk(GFX_RED, "Out of memory\n");
         for (int i = 0; i < count; ++i)
             printk(GFX_WHITE, "%s\n", names[i]);
     } else if (strncmp(cmd, "cat ", 4) == 0) {
-        char buf[FS_MAX_FILESIZE+1] = {0};
-        if (fs_read(cmd+4, buf, FS_MAX_FILESIZE) > 0)
+        char *buf = arena_zalloc(arena, FS_MAX_FILESIZE+1);
+        if (!buf)
+            printk(GFX_RED, "Out of memory\n");
+        else if (fs_read(cmd+4, buf, FS_MAX_FILESIZE) > 0)
             printk(GFX_WHITE, "%s\n", buf);
         else
             printk(GFX_RED, "File not found\n");
@@ -103,17 +210,102 @@ static void shell_execute_command(const char *cmd) {
             printk(GFX_RED, "Usage: write <file> <content>\n");
         }
     } else if (strncmp(cmd, "more ", 5) == 0) {
-        char buf[FS_MAX_FILESIZE+1] = {0};
-        if (fs_read(cmd+5, buf, FS_MAX_FILESIZE) > 0) {
+        char *buf = arena_zalloc(arena, FS_MAX_FILESIZE+1);
+        if (!buf)
+            printk(GFX_RED, "Out of memory\n");
+        else if (fs_read(cmd+5, buf, FS_MAX_FILESIZE) > 0) {
             printk(GFX_WHITE, "%s\n", buf);
         } else {
             printk(GFX_RED, "File not found\n");
         }
+    } else if (strcmp(cmd, "clock") == 0) {
+        clocksource_print_info();
+    } else if (strcmp(cmd, "cpus") == 0) {
+        smp_print_cpus();
+    } else if (strcmp(cmd, "threads") == 0) {
+        thread_print_all();
+    } else if (strcmp(cmd, "sched") == 0) {
+        scheduler_print_stats();
+    } else if (strcmp(cmd, "softirqs") == 0) {
+        softirq_print_stats();
+        workqueue_print_stats();
+        async_print_stats();
+    } else if (strcmp(cmd, "ipi") == 0) {
+        ipi_print_stats();
+        tlb_print_stats();
+    } else if (strcmp(cmd, "rcu") == 0) {
+        rcu_print_stats();
+    } else if (strcmp(cmd, "cpuidle") == 0) {
+        cpuidle_print_info();
+    } else if (strcmp(cmd, "fpu") == 0) {
+        fpu_print_info();
+    } else if (strcmp(cmd, "tickless on") == 0 || strcmp(cmd, "tickless off") == 0) {
+        scheduler_set_tickless(cmd[10] == 'n');
+        printk(GFX_GREEN, "Idle cpus %s their tick\n", cmd[10] == 'n' ? "stop" : "keep");
+    } else if (strncmp(cmd, "sleep ", 6) == 0) {
+        thread_sleep_ms(strtoul(cmd+6, NULL, 10));
+    } else if (strncmp(cmd, "nice ", 5) == 0) {
+        char *end;
+        size_t tid = strtoul(cmd+5, &end, 10);
+        thread_priority_t priority;
+        for (priority = 0; priority < THREAD_PRIORITY_COUNT; priority++)
+            if (*end == ' ' && strcmp(end+1, thread_priority_to_string(priority)) == 0)
+                break;
+        if (priority < THREAD_PRIORITY_COUNT && thread_set_priority_by_tid(tid, priority)) {
+            printk(GFX_GREEN, "Priority of thread %d set to %s\n", tid, thread_priority_to_string(priority));
+        } else {
+            printk(GFX_RED, "Usage: nice <tid> <high|normal|low>\n");
+        }
+    } else if (strncmp(cmd, "slice ", 6) == 0) {
+        char *end;
+        size_t tid = strtoul(cmd+6, &end, 10);
+        uint32_t ticks = *end == ' ' ? thread_set_timeslice_by_tid(tid, strtoul(end+1, NULL, 10)) : 0;
+        if (ticks) {
+            printk(GFX_GREEN, "Time slice of thread %d set to %d ticks\n", tid, ticks);
+        } else {
+            printk(GFX_RED, "Usage: slice <tid> <ticks, 0 = default>\n");
+        }
+    } else if (strcmp(cmd, "bench kmalloc") == 0) {
+        kmalloc_bench();
+    } else if (strcmp(cmd, "bench sched") == 0) {
+        sched_bench();
+    } else if (strcmp(cmd, "bench latency") == 0) {
+        latency_bench();
+    } else if (strcmp(cmd, "bench pi") == 0) {
+        pi_bench();
+    } else if (strcmp(cmd, "bench async") == 0) {
+        async_bench();
+    } else if (strcmp(cmd, "bench ipi") == 0) {
+        ipi_bench();
+    } else if (strcmp(cmd, "kmprof") == 0) {
+        kmalloc_profile_print_top();
+    } else if (strcmp(cmd, "kmprof dump") == 0) {
+        kmalloc_profile_dump();
+        printk(GFX_GREEN, "Allocation profile sent to serial\n");
+    } else if (strcmp(cmd, "locks") == 0) {
+        lock_stat_print_top();
+    } else if (strcmp(cmd, "locks reset") == 0) {
+        lock_stat_reset();
+        printk(GFX_GREEN, "Lock statistics reset\n");
+    } else if (strncmp(cmd, "loglevel ", 9) == 0) {
+        STATUS level;
+        for (level = TRACE; level <= ERROR; level++)
+            if (strcmp(cmd+9, log_level_to_string(level)) == 0)
+                break;
+        if (level <= ERROR) {
+            log_set_level(level);
+            printk(GFX_GREEN, "Log level set to %s\n", log_level_to_string(level));
+        } else {
+            printk(GFX_RED, "Usage: loglevel <trace|debug|info|warning|error>\n");
+        }
+    } else if (strcmp(cmd, "trace") == 0) {
+        debug_dump_trace();
+        printk(GFX_GREEN, "Trace buffer sent to serial\n");
     } else if (strcmp(cmd, "clear") == 0) {
         framebuffer_reset_screen();
         shell_prompt();
     } else if (strcmp(cmd, "help") == 0) {
-        printk(GFX_CYAN, "Commands: ls, cat <file>, rm <file>, touch <file>, write <file> <text>, more <file>, echo <text>, clear, help, shutdown, reboot\n");
+        printk(GFX_CYAN, "Commands: ls, cat <file>, rm <file>, touch <file>, write <file> <text>, more <file>, echo <text>, clock, cpus, threads, sched, softirqs, ipi, rcu, fpu, cpuidle, tickless <on|off>, sleep <ms>, nice <tid> <prio>, slice <tid> <ticks>, bench kmalloc, bench sched, bench latency, bench pi, bench async, bench ipi, kmprof [dump], locks [reset], loglevel <level>, trace, clear, help, shutdown, reboot; append \" &\" to run a command in the background\n");
     } else if (strcmp(cmd, "shutdown") == 0) {
         printk(GFX_GREEN, "Shutting down via ACPI...\n");
         acpi_shutdown();
@@ -157,7 +349,28 @@ void shell_print_char(KEY_INFO_t key_info)
     else if (key_info.ascii_character == KEY_RETURN)
     {
         shell_input_buffer[shell_input_index] = '\0';
-        shell_execute_command(shell_input_buffer);
+
+        if (shell_input_index >= 2 && strcmp(shell_input_buffer + shell_input_index - 2, " &") == 0)
+        {
+            shell_input_buffer[shell_input_index - 2] = '\0';
+
+            char *cmd = kmalloc(shell_input_index - 1);
+
+            if (cmd)
+                memcpy(cmd, shell_input_buffer, shell_input_index - 1);
+
+            if (!cmd || !thread_create(cmd, shell_background_command, cmd, THREAD_PRIORITY_LOW))
+            {
+                printk(GFX_RED, "Couldn't start background command\n");
+                kfree(cmd);
+            }
+        }
+        else
+        {
+            shell_execute_command(shell_input_buffer, &shell_arena);
+            arena_reset(&shell_arena);
+        }
+
         shell_input_index = 0;
 
         // move barrier if screen scolls
@@ -25,5 +25,6 @@ extern struct GFX_Struct gfx;
 void shell_screen_init(void);
 void shell_prompt(void);
 void shell_print_char(KEY_INFO_t key_info);
+void shell_queue_key(KEY_INFO_t key_info);
 
 #endif
@@ -0,0 +1,309 @@
+/*
+	This file is part of an x86_64 hobbyist operating system called KnutOS
+	Everything is openly developed on GitHub: https://github.com/Tix3Dev/KnutOS/
+
+	Copyright (C) 2021-2022  Yves Vollmeier <https://github.com/Tix3Dev>
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <devices/apic/apic.h>
+#include <devices/cpu/cpu.h>
+#include <interrupts/interrupts.h>
+#include <smp/ipi.h>
+#include <smp/smp.h>
+#include <libk/alloc/kmalloc.h>
+#include <libk/debug/debug.h>
+#include <libk/lock/spinlock.h>
+#include <libk/log/log.h>
+#include <libk/stdio/stdio.h>
+
+/*  Explanation of inter processor interrupts:
+    smp_call_function_* runs a function on other cpus. The sender puts
+    one shared ipi_call_t into the call queue of every target and sends
+    IPI_CALL_FUNCTION_INTERRUPT, but only to targets whose queue was
+    empty: a target runs everything that's queued before it leaves the
+    handler, so a burst of calls (e.g. several TLB shootdowns) costs one
+    IPI per target. Every target decrements left after the function
+    returned, a waiting sender spins on it.
+
+    Senders keep interrupts off the whole time, so they can't migrate.
+    Two cpus could then wait for each other, so whoever waits (for
+    left, or for room in a full queue) runs it's own queue meanwhile.
+
+    The functions run in interrupt context with interrupts off on the
+    target, they must be short and must not block.
+
+    NMIs aren't maskable, smp_stop_other_cpus uses them to halt every
+    other cpu before the exception handler takes over the screen. A cpu
+    can be halted while it holds the debug or printk lock, so it also
+    sets oops_in_progress, which makes the output bypass them.
+*/
+
+#define IPI_STOP_WAIT_LOOPS	10000000	// pause iterations to wait for the NMIs to land
+
+static ipi_queue_t  ipi_queues[SMP_MAX_CPUS];
+static bool	    ipi_ready = false;
+static volatile bool ipi_stopping = false;
+static volatile size_t ipi_stopped_cpus = 0;
+
+// run every call queued for this cpu (interrupts off)
+static void ipi_run_queue(void)
+{
+    ipi_queue_t *queue = &ipi_queues[smp_get_current_cpu()];
+
+    for (;;)
+    {
+        spinlock_acquire(&queue->lock);
+
+        if (queue->head == queue->tail)
+        {
+            spinlock_release(&queue->lock);
+
+            return;
+        }
+
+        ipi_call_t *call = queue->calls[queue->head++ % IPI_CALL_QUEUE_SIZE];
+
+        queue->calls_run++;
+
+        spinlock_release(&queue->lock);
+
+        // a waiting sender's call lives on it's stack, gone once left is 0
+        bool wait = call->wait;
+
+        call->func(call->arg);
+
+        if (__atomic_sub_fetch(&call->left, 1, __ATOMIC_ACQ_REL) == 0 && !wait)
+            kfree(call);
+    }
+}
+
+// returns whether the queue of cpu was empty, only then it needs an IPI (interrupts off)
+static bool ipi_queue_push(size_t cpu, ipi_call_t *call)
+{
+    ipi_queue_t *queue = &ipi_queues[cpu];
+
+    for (;;)
+    {
+        spinlock_acquire(&queue->lock);
+
+        size_t count = queue->tail - queue->head;
+
+        if (count < IPI_CALL_QUEUE_SIZE)
+        {
+            queue->calls[queue->tail++ % IPI_CALL_QUEUE_SIZE] = call;
+            spinlock_release(&queue->lock);
+
+            return count == 0;
+        }
+
+        spinlock_release(&queue->lock);
+
+        // the target may be busy sending calls to us
+        ipi_run_queue();
+        asm volatile("pause");
+    }
+}
+
+void ipi_init(void)
+{
+    for (size_t i = 0; i < SMP_MAX_CPUS; i++)
+        spinlock_init(&ipi_queues[i].lock, "ipi queue");
+
+    ipi_ready = true;
+
+    serial_log(INFO, "IPIs initialized: call queues of %d entries\n", IPI_CALL_QUEUE_SIZE);
+    kernel_log(INFO, "IPIs initialized: call queues of %d entries\n", IPI_CALL_QUEUE_SIZE);
+}
+
+// IPI_CALL_FUNCTION_INTERRUPT (interrupts off)
+void ipi_handle_call_function(void)
+{
+    ipi_queues[smp_get_current_cpu()].ipis_received++;
+
+    ipi_run_queue();
+}
+
+// IPI_RESCHEDULE_INTERRUPT, the interrupt exit does the actual work (interrupts off)
+void ipi_handle_reschedule(void)
+{
+    ipi_queues[smp_get_current_cpu()].reschedules++;
+}
+
+// exception 2, returns if the NMI wasn't ours
+void ipi_handle_nmi(void)
+{
+    if (!ipi_stopping)
+        return;
+
+    __atomic_fetch_add(&ipi_stopped_cpus, 1, __ATOMIC_RELEASE);
+
+    for (;;)
+        asm volatile("cli; hlt");
+}
+
+// bit i set = cpu i is online
+uint64_t smp_get_online_mask(void)
+{
+    uint64_t mask = 0;
+
+    for (size_t i = 0; i < smp_cpu_count; i++)
+    {
+        if (smp_cpus[i].state == CPU_STATE_ONLINE)
+            mask |= 1ULL << i;
+    }
+
+    return mask;
+}
+
+// run func(arg) on every online cpu in the mask except the calling one
+// -> wait: return once all of them ran it
+void smp_call_function_many(uint64_t cpus, void (*func)(void *arg), void *arg, bool wait)
+{
+    uint64_t rflags = cpu_save_and_disable_interrupts();
+    size_t self = smp_get_current_cpu();
+
+    cpus &= smp_get_online_mask() & ~(1ULL << self);
+
+    if (!ipi_ready || !cpus)
+    {
+        cpu_restore_interrupts(rflags);
+
+        return;
+    }
+
+    ipi_call_t on_stack;
+    ipi_call_t *call = wait ? &on_stack : kmalloc(sizeof(ipi_call_t));
+
+    if (!call)
+    {
+        serial_log(ERROR, "IPI: out of memory for an asynchronous call\n");
+        kernel_log(ERROR, "IPI: out of memory for an asynchronous call\n");
+
+        cpu_restore_interrupts(rflags);
+
+        return;
+    }
+
+    uint32_t targets = 0;
+
+    for (size_t i = 0; i < smp_cpu_count; i++)
+        if (cpus & (1ULL << i))
+            targets++;
+
+    call->func = func;
+    call->arg = arg;
+    call->wait = wait;
+    call->left = targets;
+
+    for (size_t i = 0; i < smp_cpu_count; i++)
+    {
+        if (!(cpus & (1ULL << i)))
+            continue;
+
+        if (ipi_queue_push(i, call))
+        {
+            lapic_send_fixed_ipi(smp_cpus[i].lapic_id, IPI_CALL_FUNCTION_INTERRUPT);
+            ipi_queues[self].ipis_sent++;
+        }
+    }
+
+    while (wait && __atomic_load_n(&call->left, __ATOMIC_ACQUIRE))
+    {
+        ipi_run_queue();
+        asm volatile("pause");
+    }
+
+    cpu_restore_interrupts(rflags);
+}
+
+// run func(arg) on one cpu, directly if that's the calling one
+void smp_call_function_single(size_t cpu, void (*func)(void *arg), void *arg, bool wait)
+{
+    uint64_t rflags = cpu_save_and_disable_interrupts();
+
+    if (cpu == smp_get_current_cpu())
+        func(arg);
+    else
+        smp_call_function_many(1ULL << cpu, func, arg, wait);
+
+    cpu_restore_interrupts(rflags);
+}
+
+// run func(arg) on every other online cpu
+void smp_call_function(void (*func)(void *arg), void *arg, bool wait)
+{
+    smp_call_function_many(~0ULL, func, arg, wait);
+}
+
+// run func(arg) on every online cpu, the calling one included
+void on_each_cpu(void (*func)(void *arg), void *arg, bool wait)
+{
+    uint64_t rflags = cpu_save_and_disable_interrupts();
+
+    func(arg);
+    smp_call_function_many(~0ULL, func, arg, wait);
+
+    cpu_restore_interrupts(rflags);
+}
+
+// make an idle cpu run the scheduler, e.g. for a thread that just got queued on it
+void smp_send_reschedule(size_t cpu)
+{
+    if (!ipi_ready || cpu >= smp_cpu_count)
+        return;
+
+    lapic_send_fixed_ipi(smp_cpus[cpu].lapic_id, IPI_RESCHEDULE_INTERRUPT);
+}
+
+// halt every other online cpu with an NMI, for fatal errors
+// -> from now on debug_impl and printk ignore their locks (oops_in_progress)
+void smp_stop_other_cpus(void)
+{
+    oops_in_progress = true;
+
+    if (!ipi_ready || __atomic_exchange_n(&ipi_stopping, true, __ATOMIC_ACQ_REL))
+        return;
+
+    uint64_t cpus = smp_get_online_mask() & ~(1ULL << smp_get_current_cpu());
+    size_t count = 0;
+
+    for (size_t i = 0; i < smp_cpu_count; i++)
+    {
+        if (cpus & (1ULL << i))
+        {
+            lapic_send_nmi(smp_cpus[i].lapic_id);
+            count++;
+        }
+    }
+
+    // they may still be half way through a message, don't mix the dump into it
+    for (size_t i = 0; i < IPI_STOP_WAIT_LOOPS && __atomic_load_n(&ipi_stopped_cpus, __ATOMIC_ACQUIRE) < count; i++)
+        asm volatile("pause");
+}
+
+void ipi_print_stats(void)
+{
+    printk(GFX_CYAN, "%-6s%-12s%-12s%-12s%-12s\n", "cpu", "sent", "received", "calls", "reschedules");
+
+    for (size_t i = 0; i < smp_cpu_count; i++)
+    {
+        ipi_queue_t *queue = &ipi_queues[i];
+
+        printk(GFX_WHITE, "%-6d%-12llu%-12llu%-12llu%-12llu\n", i, queue->ipis_sent, queue->ipis_received,
+               queue->calls_run, queue->reschedules);
+    }
+}
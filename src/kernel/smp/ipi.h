@@ -0,0 +1,66 @@
+/*
+	This file is part of an x86_64 hobbyist operating system called KnutOS
+	Everything is openly developed on GitHub: https://github.com/Tix3Dev/KnutOS/
+
+	Copyright (C) 2021-2022  Yves Vollmeier <https://github.com/Tix3Dev>
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <smp/smp.h>
+#include <libk/lock/spinlock.h>
+
+#ifndef IPI_H
+#define IPI_H
+
+#define IPI_CALL_QUEUE_SIZE	32	// calls one cpu can have queued, senders run their own queue while it's full
+
+// a function to run on other cpus, shared by all targets
+typedef struct
+{
+    void		(*func)(void *arg);
+    void		*arg;
+    volatile uint32_t	left;	    // targets that didn't run it yet
+    bool		wait;	    // the sender waits for left, otherwise the last target frees it
+} ipi_call_t;
+
+// calls waiting to run on one cpu
+typedef struct
+{
+    spinlock_t	lock;
+    ipi_call_t	*calls[IPI_CALL_QUEUE_SIZE];
+    size_t	head;
+    size_t	tail;
+
+    uint64_t	ipis_sent;
+    uint64_t	ipis_received;
+    uint64_t	calls_run;
+    uint64_t	reschedules;
+} ipi_queue_t;
+
+void ipi_init(void);
+void ipi_handle_call_function(void);
+void ipi_handle_nmi(void);
+void ipi_handle_reschedule(void);
+uint64_t smp_get_online_mask(void);
+void smp_call_function_single(size_t cpu, void (*func)(void *arg), void *arg, bool wait);
+void smp_call_function_many(uint64_t cpus, void (*func)(void *arg), void *arg, bool wait);
+void smp_call_function(void (*func)(void *arg), void *arg, bool wait);
+void on_each_cpu(void (*func)(void *arg), void *arg, bool wait);
+void smp_send_reschedule(size_t cpu);
+void smp_stop_other_cpus(void);
+void ipi_print_stats(void);
+
+#endif
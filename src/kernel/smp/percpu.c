@@ -0,0 +1,103 @@
+/*
+	This file is part of an x86_64 hobbyist operating system called KnutOS
+	Everything is openly developed on GitHub: https://github.com/Tix3Dev/KnutOS/
+
+	Copyright (C) 2021-2022  Yves Vollmeier <https://github.com/Tix3Dev>
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <boot/stivale2.h>
+#include <devices/cpu/cpu.h>
+#include <smp/percpu.h>
+#include <smp/smp.h>
+#include <libk/alloc/kmalloc.h>
+#include <libk/log/log.h>
+#include <libk/string/string.h>
+
+/*  Explanation of per-cpu data:
+    Everything defined with DEFINE_PER_CPU ends up in the .percpu section
+    (see linker.ld). That section is never used directly once a cpu is set
+    up: every cpu gets a copy of it, and IA32_GS_BASE of the cpu is set to
+    the distance between it's copy and the section. A gs relative access
+    to the address of a per-cpu variable therefore lands in the copy of
+    the cpu that executes it.
+
+    Until percpu_load ran, GS_BASE is 0 and the accesses hit the section
+    itself, so the BSP can use per-cpu data (as cpu 0) during early boot.
+
+    There is no user mode yet, so GS_BASE never has to be swapped on
+    kernel entry. IA32_KERNEL_GS_BASE gets the same value, which keeps a
+    stray swapgs harmless.
+*/
+
+extern char __percpu_start[];
+extern char __percpu_end[];
+
+DEFINE_PER_CPU(uintptr_t, percpu_offset);
+DEFINE_PER_CPU(size_t, percpu_cpu_number);
+
+uintptr_t percpu_offsets[SMP_MAX_CPUS];
+
+// set up the per-cpu data of the BSP
+void percpu_init(void)
+{
+    if (!percpu_init_cpu(0))
+    {
+        serial_log(ERROR, "Kernel halted!\n");
+        kernel_log(ERROR, "Kernel halted!\n");
+
+        for (;;)
+            asm ("hlt");
+    }
+
+    percpu_load(0);
+
+    serial_log(INFO, "Per-CPU data initialized: %d bytes per CPU\n", __percpu_end - __percpu_start);
+    kernel_log(INFO, "Per-CPU data initialized: %d bytes per CPU\n", __percpu_end - __percpu_start);
+}
+
+// allocate the copy of cpu, initialized from the template
+// -> may run on any cpu, the copy is only used after percpu_load on cpu itself
+bool percpu_init_cpu(size_t cpu)
+{
+    size_t size = __percpu_end - __percpu_start;
+    char *area = kmalloc_aligned(size, PER_CPU_ALIGN);
+
+    if (!area)
+    {
+        serial_log(ERROR, "No memory for the per-CPU data of CPU %d\n", cpu);
+        kernel_log(ERROR, "No memory for the per-CPU data of CPU %d\n", cpu);
+
+        return false;
+    }
+
+    memcpy(area, __percpu_start, size);
+
+    percpu_offsets[cpu] = (uintptr_t)area - (uintptr_t)__percpu_start;
+
+    *per_cpu_ptr(percpu_offset, cpu) = percpu_offsets[cpu];
+    *per_cpu_ptr(percpu_cpu_number, cpu) = cpu;
+
+    return true;
+}
+
+// point gs of the calling cpu to it's copy
+// has to run after the GDT got loaded, loading a selector into gs clears GS_BASE
+void percpu_load(size_t cpu)
+{
+    wrmsr(IA32_GS_BASE, percpu_offsets[cpu]);
+    wrmsr(IA32_KERNEL_GS_BASE, percpu_offsets[cpu]);
+}
@@ -0,0 +1,83 @@
+/*
+	This file is part of an x86_64 hobbyist operating system called KnutOS
+	Everything is openly developed on GitHub: https://github.com/Tix3Dev/KnutOS/
+
+	Copyright (C) 2021-2022  Yves Vollmeier <https://github.com/Tix3Dev>
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <smp/smp.h>
+
+#ifndef PERCPU_H
+#define PERCPU_H
+
+#define IA32_GS_BASE		0xC0000101
+#define IA32_KERNEL_GS_BASE	0xC0000102
+
+#define PER_CPU_ALIGN		64	// one cache line, no false sharing between entries
+
+// a variable that every cpu has it's own copy of
+// -> the definition in .percpu is only the template the copies are made from
+#define DEFINE_PER_CPU(type, name) \
+    __attribute__((section(".percpu"), aligned(PER_CPU_ALIGN))) type name
+
+#define DECLARE_PER_CPU(type, name) \
+    extern __attribute__((section(".percpu"), aligned(PER_CPU_ALIGN))) type name
+
+// GS_BASE holds (copy of this cpu - template), so %gs:var addresses
+// this cpu's copy of var with a single instruction
+// -> one instruction can't be torn by an interrupt or a migration, no atomics needed
+
+#define this_cpu_read(var)						\
+    ({									\
+        __typeof__(var) __value;					\
+        asm volatile("mov %%gs:%1, %0" : "=r" (__value) : "m" (var));	\
+        __value;							\
+    })
+
+#define this_cpu_write(var, value)					\
+    asm volatile("mov%z0 %1, %%gs:%0" : "=m" (var) : "er" ((__typeof__(var))(value)))
+
+#define this_cpu_add(var, value)					\
+    asm volatile("add%z0 %1, %%gs:%0" : "+m" (var) : "er" ((__typeof__(var))(value)))
+
+#define this_cpu_inc(var)	this_cpu_add(var, 1)
+
+#define this_cpu_or(var, value)						\
+    asm volatile("or%z0 %1, %%gs:%0" : "+m" (var) : "er" ((__typeof__(var))(value)))
+
+#define this_cpu_and(var, value)					\
+    asm volatile("and%z0 %1, %%gs:%0" : "+m" (var) : "er" ((__typeof__(var))(value)))
+
+// plain pointer to this cpu's copy
+// -> only stable while the caller can't migrate (interrupts off)
+#define this_cpu_ptr(var) \
+    ((__typeof__(&(var)))((uintptr_t)&(var) + this_cpu_read(percpu_offset)))
+
+// pointer to the copy of another cpu
+#define per_cpu_ptr(var, cpu) \
+    ((__typeof__(&(var)))((uintptr_t)&(var) + percpu_offsets[cpu]))
+
+DECLARE_PER_CPU(uintptr_t, percpu_offset);
+DECLARE_PER_CPU(size_t, percpu_cpu_number);
+
+extern uintptr_t percpu_offsets[SMP_MAX_CPUS];
+
+void percpu_init(void);
+bool percpu_init_cpu(size_t cpu);
+void percpu_load(size_t cpu);
+
+#endif
@@ -0,0 +1,223 @@
+/*
+	This file is part of an x86_64 hobbyist operating system called KnutOS
+	Everything is openly developed on GitHub: https://github.com/Tix3Dev/KnutOS/
+
+	Copyright (C) 2021-2022  Yves Vollmeier <https://github.com/Tix3Dev>
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <boot/stivale2.h>
+#include <boot/stivale2_boot.h>
+#include <devices/apic/apic.h>
+#include <devices/cpu/cpu.h>
+#include <devices/cpu/cpuidle.h>
+#include <devices/cpu/fpu.h>
+#include <gdt/gdt.h>
+#include <interrupts/idt.h>
+#include <memory/vmm.h>
+#include <scheduler/scheduler.h>
+#include <smp/percpu.h>
+#include <smp/smp.h>
+#include <libk/alloc/kmalloc.h>
+#include <libk/debug/debug.h>
+#include <libk/log/log.h>
+#include <libk/stdio/stdio.h>
+
+smp_cpu_t   smp_cpus[SMP_MAX_CPUS];
+size_t	    smp_cpu_count = 0;
+
+// first C code an AP runs, on the stack smp_init gave it
+// the bootloader left it with its own GDT and page tables, so
+// switch to the kernel's ones, load the per-cpu data and the IDT, enable the local APIC
+// and start scheduling on it
+__attribute__((noreturn))
+static void smp_ap_entry(struct stivale2_smp_info *smp_info)
+{
+    smp_cpu_t *cpu = &smp_cpus[smp_info->extra_argument];
+
+    vmm_activate_page_directory(vmm_get_kernel_page_directory());
+    gdt_init_cpu(cpu->id);
+    percpu_load(cpu->id);
+    idt_load();
+    fpu_init_cpu();
+    lapic_enable();
+    scheduler_init_cpu(cpu->id);
+
+    __atomic_store_n(&cpu->state, CPU_STATE_ONLINE, __ATOMIC_RELEASE);
+
+    // this context is the cpu's idle thread, the scheduler preempts it
+    cpuidle_loop();
+}
+
+// hand the AP a stack and its entry point, then wait until it reports back
+// -> only the bring up is sequential, an online AP already runs threads, timers and
+//    locks next to the others, so everything from scheduler_init_cpu on is shared
+static void smp_start_ap(smp_cpu_t *cpu, volatile struct stivale2_smp_info *smp_info)
+{
+    if (!percpu_init_cpu(cpu->id))
+        return;
+
+    cpu->stack = kmalloc(SMP_AP_STACK_SIZE);
+
+    if (!cpu->stack)
+    {
+        serial_log(ERROR, "SMP: No stack for CPU %d, leaving it offline\n", cpu->id);
+        kernel_log(ERROR, "SMP: No stack for CPU %d, leaving it offline\n", cpu->id);
+
+        return;
+    }
+
+    smp_info->target_stack = (uintptr_t)cpu->stack + SMP_AP_STACK_SIZE;
+    smp_info->extra_argument = cpu->id;
+
+    cpu->state = CPU_STATE_STARTING;
+
+    uint64_t start = rdtsc();
+
+    // the AP polls goto_address, so it has to be written last
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    smp_info->goto_address = (uintptr_t)smp_ap_entry;
+
+    while (__atomic_load_n(&cpu->state, __ATOMIC_ACQUIRE) != CPU_STATE_ONLINE)
+    {
+        if (rdtsc() - start > SMP_AP_TIMEOUT_CYCLES)
+        {
+            cpu->state = CPU_STATE_TIMED_OUT;
+            break;
+        }
+
+        asm volatile ("pause");
+    }
+
+    cpu->bringup_cycles = rdtsc() - start;
+}
+
+// register the BSP as cpu 0 and bring up every AP the bootloader found
+void smp_init(struct stivale2_struct *stivale2_struct)
+{
+    struct stivale2_struct_tag_smp *smp_tag = stivale2_get_tag(stivale2_struct,
+            STIVALE2_STRUCT_TAG_SMP_ID);
+
+    smp_cpu_t *bsp = &smp_cpus[smp_cpu_count++];
+
+    bsp->id = 0;
+    bsp->lapic_id = lapic_get_id();
+    bsp->is_bsp = true;
+    bsp->state = CPU_STATE_ONLINE;
+
+    if (smp_tag == NULL)
+    {
+        serial_log(WARNING, "SMP: No SMP tag from the bootloader, running on the BSP only\n");
+        kernel_log(WARNING, "SMP: No SMP tag from the bootloader, running on the BSP only\n");
+
+        return;
+    }
+
+    if (smp_tag->cpu_count > SMP_MAX_CPUS)
+    {
+        serial_log(WARNING, "SMP: %d CPUs found, only the first %d will be used\n", smp_tag->cpu_count, SMP_MAX_CPUS);
+        kernel_log(WARNING, "SMP: %d CPUs found, only the first %d will be used\n", smp_tag->cpu_count, SMP_MAX_CPUS);
+    }
+
+    uint64_t start = rdtsc();
+
+    for (uint64_t i = 0; i < smp_tag->cpu_count && smp_cpu_count < SMP_MAX_CPUS; i++)
+    {
+        volatile struct stivale2_smp_info *smp_info = &smp_tag->smp_info[i];
+
+        if (smp_info->lapic_id == smp_tag->bsp_lapic_id)
+            continue;
+
+        smp_cpu_t *cpu = &smp_cpus[smp_cpu_count];
+
+        cpu->id = smp_cpu_count++;
+        cpu->lapic_id = smp_info->lapic_id;
+        cpu->is_bsp = false;
+        cpu->state = CPU_STATE_OFFLINE;
+
+        smp_start_ap(cpu, smp_info);
+
+        if (cpu->state == CPU_STATE_ONLINE)
+        {
+            serial_log(INFO, "SMP: CPU %d (LAPIC ID %d) online after %llu cycles\n", cpu->id, cpu->lapic_id, cpu->bringup_cycles);
+            kernel_log(INFO, "SMP: CPU %d (LAPIC ID %d) online after %llu cycles\n", cpu->id, cpu->lapic_id, cpu->bringup_cycles);
+        }
+        else
+        {
+            serial_log(ERROR, "SMP: CPU %d (LAPIC ID %d) didn't come up\n", cpu->id, cpu->lapic_id);
+            kernel_log(ERROR, "SMP: CPU %d (LAPIC ID %d) didn't come up\n", cpu->id, cpu->lapic_id);
+        }
+    }
+
+    uint64_t total_cycles = rdtsc() - start;
+
+    serial_log(INFO, "SMP initialized: %d of %d CPUs online, bring-up took %llu cycles\n",
+               smp_get_online_count(), smp_cpu_count, total_cycles);
+    kernel_log(INFO, "SMP initialized: %d of %d CPUs online, bring-up took %llu cycles\n",
+               smp_get_online_count(), smp_cpu_count, total_cycles);
+}
+
+size_t smp_get_online_count(void)
+{
+    size_t online = 0;
+
+    for (size_t i = 0; i < smp_cpu_count; i++)
+        if (smp_cpus[i].state == CPU_STATE_ONLINE)
+            online++;
+
+    return online;
+}
+
+// index of the cpu this runs on, a single gs relative load
+size_t smp_get_current_cpu(void)
+{
+    return this_cpu_read(percpu_cpu_number);
+}
+
+const char *smp_cpu_state_to_string(cpu_state_t state)
+{
+    switch (state)
+    {
+        case CPU_STATE_OFFLINE:
+            return "offline";
+        case CPU_STATE_STARTING:
+            return "starting";
+        case CPU_STATE_ONLINE:
+            return "online";
+        case CPU_STATE_TIMED_OUT:
+            return "timed out";
+        default:
+            return "unknown";
+    }
+}
+
+// print id, LAPIC id, state and bring-up time of every cpu
+void smp_print_cpus(void)
+{
+    serial_set_color(TERM_PURPLE);
+
+    for (size_t i = 0; i < smp_cpu_count; i++)
+    {
+        smp_cpu_t *cpu = &smp_cpus[i];
+
+        debug("CPU %d | LAPIC ID %d | %s%s | bring-up %llu cycles\n", cpu->id, cpu->lapic_id,
+              smp_cpu_state_to_string(cpu->state), cpu->is_bsp ? " (BSP)" : "", cpu->bringup_cycles);
+        printk(GFX_PURPLE, "CPU %d | LAPIC ID %d | %s%s | bring-up %llu cycles\n", cpu->id, cpu->lapic_id,
+               smp_cpu_state_to_string(cpu->state), cpu->is_bsp ? " (BSP)" : "", cpu->bringup_cycles);
+    }
+
+    serial_set_color(TERM_COLOR_RESET);
+}
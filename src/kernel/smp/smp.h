@@ -0,0 +1,58 @@
+/*
+	This file is part of an x86_64 hobbyist operating system called KnutOS
+	Everything is openly developed on GitHub: https://github.com/Tix3Dev/KnutOS/
+
+	Copyright (C) 2021-2022  Yves Vollmeier <https://github.com/Tix3Dev>
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <boot/stivale2.h>
+
+#ifndef SMP_H
+#define SMP_H
+
+#define SMP_MAX_CPUS		64
+#define SMP_AP_STACK_SIZE	(16 * 1024)
+#define SMP_AP_TIMEOUT_CYCLES	2000000000ULL	// give up on an AP after this many TSC cycles
+
+typedef enum
+{
+    CPU_STATE_OFFLINE,
+    CPU_STATE_STARTING,
+    CPU_STATE_ONLINE,
+    CPU_STATE_TIMED_OUT
+} cpu_state_t;
+
+typedef struct
+{
+    size_t		id;		// index into smp_cpus, the BSP is always 0
+    uint32_t		lapic_id;
+    bool		is_bsp;
+    volatile cpu_state_t state;		// written by the AP itself once it's up
+    uint64_t		bringup_cycles;	// TSC cycles from goto_address until online
+    void		*stack;
+} smp_cpu_t;
+
+extern smp_cpu_t    smp_cpus[SMP_MAX_CPUS];
+extern size_t	    smp_cpu_count;
+
+void smp_init(struct stivale2_struct *stivale2_struct);
+size_t smp_get_online_count(void);
+size_t smp_get_current_cpu(void);
+const char *smp_cpu_state_to_string(cpu_state_t state);
+void smp_print_cpus(void);
+
+#endif
@@ -0,0 +1,303 @@
+/*
+	This file is part of an x86_64 hobbyist operating system called KnutOS
+	Everything is openly developed on GitHub: https://github.com/Tix3Dev/KnutOS/
+
+	Copyright (C) 2021-2022  Yves Vollmeier <https://github.com/Tix3Dev>
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <boot/stivale2.h>
+#include <devices/cpu/cpu.h>
+#include <devices/hpet/hpet.h>
+#include <devices/pit/pit.h>
+#include <firmware/acpi/acpi.h>
+#include <time/clocksource.h>
+#include <libk/io/io.h>
+#include <libk/log/log.h>
+#include <libk/stdio/stdio.h>
+
+/*  Explanation of the clocksource:
+    Time is read from a free running counter, the TSC or the HPET.
+    Converting cycles to nanoseconds would need a division by the counter
+    frequency, so instead a fixed point factor
+    mult = (NSEC_PER_SEC << CLOCKSOURCE_SHIFT) / hz is computed once:
+
+        ns = (cycles * mult) >> CLOCKSOURCE_SHIFT
+
+    The product is done in 128 bit (a single mul instruction), so it
+    doesn't overflow no matter how long the system runs. Reading the
+    time from the TSC therefore costs one rdtsc, one mul and one shift.
+
+    The TSC frequency is measured at boot against a clock with a known
+    frequency: the HPET if there is one, otherwise the ACPI PM timer if
+    the FADT has one, otherwise PIT channel 2. Only an invariant TSC
+    (CPUID 0x80000007 EDX bit 8) ticks at a constant rate through P- and
+    C-state changes, without it the time drifts whenever the cpu changes
+    it's frequency.
+
+    Every usable counter gets a rating and the highest one is selected:
+    an invariant TSC beats the HPET (rdtsc is far cheaper than an uncached
+    MMIO read), but the HPET beats a TSC that isn't invariant, which is
+    common on VMs. A 32 bit HPET counter wraps after a few minutes and is
+    only used for calibration.
+*/
+
+static uint64_t	tsc_hz = 0;
+static uint64_t	cycles_to_ns_mult = 0;
+static uint64_t	ns_to_cycles_mult = 0;
+static bool	tsc_invariant = false;
+static const char *calibration_source = "none";
+
+static clocksource_t clocksource_tsc =
+{
+    .name = "tsc",
+    .rating = CLOCKSOURCE_RATING_UNUSABLE,
+    .read = rdtsc
+};
+
+static clocksource_t clocksource_hpet =
+{
+    .name = "hpet",
+    .rating = CLOCKSOURCE_RATING_UNUSABLE,
+    .read = hpet_read_counter
+};
+
+static clocksource_t *clocksources[] = { &clocksource_tsc, &clocksource_hpet };
+static clocksource_t *current_clocksource = &clocksource_tsc;
+static uint64_t	clocksource_boot = 0;	// counter at selection, ktime_get_ns counts from here
+
+static bool tsc_check_invariant(void)
+{
+    cpuid_registers_t regs =
+    {
+        .leaf = CPUID_EXT_POWER_MANAGEMENT,
+        .subleaf = 0
+    };
+
+    if (!cpuid(&regs))
+        return false;
+
+    return regs.edx & CPUID_EXT_EDX_INVARIANT_TSC;
+}
+
+// count TSC cycles during CLOCKSOURCE_CALIBRATION_US worth of PM timer ticks
+static uint64_t tsc_calibrate_pm_timer(uint16_t port, uint32_t mask)
+{
+    uint32_t target = (uint64_t)ACPI_PM_TIMER_FREQUENCY * CLOCKSOURCE_CALIBRATION_US / 1000000;
+
+    // start right at a PM timer edge
+    uint32_t start = io_inl(port) & mask;
+    uint32_t now;
+
+    while ((now = io_inl(port) & mask) == start)
+        asm volatile("pause");
+
+    start = now;
+    uint64_t tsc_start = rdtsc();
+    uint32_t elapsed;
+
+    do
+    {
+        now = io_inl(port) & mask;
+        elapsed = (now - start) & mask;
+    } while (elapsed < target);
+
+    uint64_t tsc_elapsed = rdtsc() - tsc_start;
+
+    return tsc_elapsed * ACPI_PM_TIMER_FREQUENCY / elapsed;
+}
+
+// count TSC cycles during CLOCKSOURCE_CALIBRATION_US worth of HPET ticks
+static uint64_t tsc_calibrate_hpet(void)
+{
+    uint64_t target = hpet_ns_to_ticks(CLOCKSOURCE_CALIBRATION_US * NSEC_PER_USEC);
+    uint64_t mask = hpet_counter_is_64bit() ? UINT64_MAX : UINT32_MAX;
+
+    uint64_t start = hpet_read_counter();
+    uint64_t tsc_start = rdtsc();
+    uint64_t elapsed;
+
+    do
+    {
+        elapsed = (hpet_read_counter() - start) & mask;
+    } while (elapsed < target);
+
+    uint64_t tsc_elapsed = rdtsc() - tsc_start;
+
+    return tsc_elapsed * hpet_get_frequency() / elapsed;
+}
+
+// count TSC cycles during a CLOCKSOURCE_CALIBRATION_US PIT one-shot
+static uint64_t tsc_calibrate_pit(void)
+{
+    pit_oneshot_start(CLOCKSOURCE_CALIBRATION_US);
+
+    uint64_t tsc_start = rdtsc();
+
+    while (!pit_oneshot_expired())
+        asm volatile("pause");
+
+    uint64_t tsc_elapsed = rdtsc() - tsc_start;
+
+    return tsc_elapsed * 1000000 / CLOCKSOURCE_CALIBRATION_US;
+}
+
+static uint64_t tsc_calibrate(void)
+{
+    if (hpet_is_available())
+    {
+        calibration_source = "HPET";
+
+        return tsc_calibrate_hpet();
+    }
+
+    fadt_t *fadt = (fadt_t *)acpi_find_sdt_table("FACP");
+
+    if (fadt && fadt->header.length >= sizeof(fadt_t) && fadt->pm_tmr_blk && fadt->pm_tmr_len == 4)
+    {
+        uint32_t mask = fadt->flags & FADT_FLAG_TMR_VAL_EXT ? 0xFFFFFFFF : 0xFFFFFF;
+
+        calibration_source = "ACPI PM timer";
+
+        return tsc_calibrate_pm_timer(fadt->pm_tmr_blk, mask);
+    }
+
+    calibration_source = "PIT";
+
+    return tsc_calibrate_pit();
+}
+
+static uint64_t clocksource_compute_mult(uint64_t hz)
+{
+    return (NSEC_PER_SEC << CLOCKSOURCE_SHIFT) / hz;
+}
+
+// rate the available counters and pick the best one for ktime_get_ns
+static void clocksource_select(void)
+{
+    current_clocksource = &clocksource_tsc;
+
+    for (size_t i = 0; i < sizeof(clocksources) / sizeof(clocksources[0]); i++)
+    {
+        if (clocksources[i]->rating > current_clocksource->rating)
+            current_clocksource = clocksources[i];
+    }
+
+    clocksource_boot = current_clocksource->read();
+}
+
+// detect and calibrate the TSC, rate all counters and select one
+// -> ktime_get_ns starts counting from here
+void clocksource_init(void)
+{
+    tsc_invariant = tsc_check_invariant();
+    tsc_hz = tsc_calibrate();
+
+    cycles_to_ns_mult = clocksource_compute_mult(tsc_hz);
+
+    // (NSEC_PER_SEC << 32) still fits into 64 bit, (tsc_hz << 32) doesn't, so split it
+    ns_to_cycles_mult = ((tsc_hz / NSEC_PER_SEC) << CLOCKSOURCE_SHIFT) +
+                        ((tsc_hz % NSEC_PER_SEC) << CLOCKSOURCE_SHIFT) / NSEC_PER_SEC;
+
+    clocksource_tsc.hz = tsc_hz;
+    clocksource_tsc.mult = cycles_to_ns_mult;
+    clocksource_tsc.rating = tsc_invariant ? CLOCKSOURCE_RATING_TSC_INVARIANT : CLOCKSOURCE_RATING_TSC_UNSTABLE;
+
+    if (hpet_is_available())
+    {
+        clocksource_hpet.hz = hpet_get_frequency();
+        clocksource_hpet.mult = clocksource_compute_mult(clocksource_hpet.hz);
+        clocksource_hpet.rating = hpet_counter_is_64bit() ? CLOCKSOURCE_RATING_HPET : CLOCKSOURCE_RATING_UNUSABLE;
+    }
+
+    clocksource_select();
+
+    if (current_clocksource == &clocksource_tsc && !tsc_invariant)
+    {
+        serial_log(WARNING, "TSC is not invariant, time may drift with frequency changes\n");
+        kernel_log(WARNING, "TSC is not invariant, time may drift with frequency changes\n");
+    }
+
+    serial_log(INFO, "TSC at %llu kHz (calibrated against the %s)\n", tsc_hz / 1000, calibration_source);
+    kernel_log(INFO, "TSC at %llu kHz (calibrated against the %s)\n", tsc_hz / 1000, calibration_source);
+
+    serial_log(INFO, "Clocksource initialized: %s (rating %d)\n",
+               current_clocksource->name, current_clocksource->rating);
+    kernel_log(INFO, "Clocksource initialized: %s (rating %d)\n",
+               current_clocksource->name, current_clocksource->rating);
+}
+
+const char *clocksource_get_name(void)
+{
+    return current_clocksource->name;
+}
+
+// TSC cycles to nanoseconds, independent of the selected clocksource
+uint64_t clocksource_cycles_to_ns(uint64_t cycles)
+{
+    return ((unsigned __int128)cycles * cycles_to_ns_mult) >> CLOCKSOURCE_SHIFT;
+}
+
+// nanoseconds to TSC cycles, independent of the selected clocksource
+uint64_t clocksource_ns_to_cycles(uint64_t ns)
+{
+    return ((unsigned __int128)ns * ns_to_cycles_mult) >> CLOCKSOURCE_SHIFT;
+}
+
+uint64_t clocksource_get_tsc_hz(void)
+{
+    return tsc_hz;
+}
+
+bool clocksource_tsc_is_invariant(void)
+{
+    return tsc_invariant;
+}
+
+// nanoseconds since clocksource_init
+uint64_t ktime_get_ns(void)
+{
+    clocksource_t *cs = current_clocksource;
+
+    return ((unsigned __int128)(cs->read() - clocksource_boot) * cs->mult) >> CLOCKSOURCE_SHIFT;
+}
+
+// busy wait for at least ns nanoseconds
+void ktime_spin_ns(uint64_t ns)
+{
+    uint64_t start = ktime_get_ns();
+
+    while (ktime_get_ns() - start < ns)
+        asm volatile("pause");
+}
+
+void clocksource_print_info(void)
+{
+    uint64_t now = ktime_get_ns();
+
+    printk(GFX_WHITE, "TSC: %llu kHz, %s, calibrated against the %s\n", tsc_hz / 1000,
+           tsc_invariant ? "invariant" : "not invariant", calibration_source);
+    hpet_print_info();
+
+    for (size_t i = 0; i < sizeof(clocksources) / sizeof(clocksources[0]); i++)
+    {
+        printk(GFX_WHITE, "%c %s: rating %d\n", clocksources[i] == current_clocksource ? '*' : ' ',
+               clocksources[i]->name, clocksources[i]->rating);
+    }
+
+    printk(GFX_WHITE, "Uptime: %llu.%03llu s (%llu ns)\n", now / NSEC_PER_SEC,
+           now % NSEC_PER_SEC / NSEC_PER_MSEC, now);
+}
@@ -0,0 +1,61 @@
+/*
+	This file is part of an x86_64 hobbyist operating system called KnutOS
+	Everything is openly developed on GitHub: https://github.com/Tix3Dev/KnutOS/
+
+	Copyright (C) 2021-2022  Yves Vollmeier <https://github.com/Tix3Dev>
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifndef CLOCKSOURCE_H
+#define CLOCKSOURCE_H
+
+#define NSEC_PER_SEC			1000000000ULL
+#define NSEC_PER_MSEC			1000000ULL
+#define NSEC_PER_USEC			1000ULL
+
+#define ACPI_PM_TIMER_FREQUENCY		3579545	    // Hz, fixed by the ACPI spec
+#define CLOCKSOURCE_CALIBRATION_US	50000	    // fits into one PIT one-shot
+#define CLOCKSOURCE_SHIFT		32	    // fixed point shift of the conversion factors
+
+#define CPUID_EXT_POWER_MANAGEMENT	0x80000007
+#define CPUID_EXT_EDX_INVARIANT_TSC	(1 << 8)
+
+// the usable source with the highest rating drives ktime_get_ns
+#define CLOCKSOURCE_RATING_TSC_INVARIANT    300
+#define CLOCKSOURCE_RATING_HPET		    250
+#define CLOCKSOURCE_RATING_TSC_UNSTABLE	    100
+#define CLOCKSOURCE_RATING_UNUSABLE	    0
+
+typedef struct
+{
+    const char	*name;
+    int		rating;
+    uint64_t	(*read)(void);
+    uint64_t	hz;
+    uint64_t	mult;	// cycles to ns, fixed point with CLOCKSOURCE_SHIFT
+} clocksource_t;
+
+void clocksource_init(void);
+const char *clocksource_get_name(void);
+uint64_t clocksource_cycles_to_ns(uint64_t cycles);
+uint64_t clocksource_ns_to_cycles(uint64_t ns);
+uint64_t clocksource_get_tsc_hz(void);
+bool clocksource_tsc_is_invariant(void);
+void clocksource_print_info(void);
+
+uint64_t ktime_get_ns(void);
+void ktime_spin_ns(uint64_t ns);
+
+#endif
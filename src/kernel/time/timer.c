@@ -0,0 +1,375 @@
+/*
+	This file is part of an x86_64 hobbyist operating system called KnutOS
+	Everything is openly developed on GitHub: https://github.com/Tix3Dev/KnutOS/
+
+	Copyright (C) 2021-2022  Yves Vollmeier <https://github.com/Tix3Dev>
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <devices/cpu/cpu.h>
+#include <smp/percpu.h>
+#include <time/clocksource.h>
+#include <time/timer.h>
+#include <libk/lock/spinlock.h>
+
+/*  Explanation of the timer wheel:
+    Every cpu has it's own wheel. The root level has one slot per jiffy
+    for the next TIMER_ROOT_SIZE jiffies. The levels above have
+    TIMER_LEVEL_SIZE slots each, where a slot covers a whole revolution of
+    the level below. A timer goes into the lowest level whose range
+    covers it's distance to base->clk, so adding and deleting is O(1)
+    (slots are doubly linked lists).
+
+    Every time the root level wraps around, the next slot of level 0 gets
+    "cascaded": it's timers are inserted again and now land in the root
+    level (or level 0 again for the ones that are still far away). Level 0
+    wrapping around cascades level 1 and so on.
+
+    timer_run processes every jiffy between base->clk and now and runs
+    the callbacks of the root slot of that jiffy. It's the SOFTIRQ_TIMER
+    handler, raised by every tick. Jiffies are derived from ktime_get_ns,
+    so a cpu that skipped ticks while idle just catches up the next time
+    it runs.
+
+    Callbacks run without the base lock, so timer_del can return while
+    one is still running on the wheel's cpu. base->running records that
+    timer, timer_del_sync waits until it's done. Owners that free the
+    timer (or what the callback uses) afterwards have to use that one.
+*/
+
+typedef struct timer_base
+{
+    spinlock_t	lock;
+    uint64_t	clk;		// next jiffy to be processed
+    size_t	pending;
+    timer_t	*running;	// callback being run right now, without the lock
+    timer_t	*root[TIMER_ROOT_SIZE];
+    timer_t	*levels[TIMER_LEVELS][TIMER_LEVEL_SIZE];
+} timer_base_t;
+
+static DEFINE_PER_CPU(timer_base_t, timer_bases);
+
+// slot index of level at jiffy clk
+static inline size_t timer_level_index(uint64_t clk, size_t level)
+{
+    return (clk >> (TIMER_ROOT_BITS + level * TIMER_LEVEL_BITS)) & TIMER_LEVEL_MASK;
+}
+
+// base->lock has to be held for all wheel functions
+
+static void wheel_insert(timer_base_t *base, timer_t *timer)
+{
+    uint64_t expires = timer->expires;
+    uint64_t delta = expires - base->clk;
+    timer_t **slot;
+
+    if ((int64_t)delta < 0)
+    {
+        // already due, run it with the next processed jiffy
+        slot = &base->root[base->clk & TIMER_ROOT_MASK];
+    }
+    else if (delta < TIMER_ROOT_SIZE)
+    {
+        slot = &base->root[expires & TIMER_ROOT_MASK];
+    }
+    else
+    {
+        if (delta > TIMER_MAX_DELTA)
+            expires = base->clk + TIMER_MAX_DELTA;
+
+        size_t level = 0;
+
+        while (level < TIMER_LEVELS - 1 &&
+                delta >= 1ULL << (TIMER_ROOT_BITS + (level + 1) * TIMER_LEVEL_BITS))
+            level++;
+
+        slot = &base->levels[level][timer_level_index(expires, level)];
+    }
+
+    timer->next = *slot;
+
+    if (*slot)
+        (*slot)->pprev = &timer->next;
+
+    *slot = timer;
+    timer->pprev = slot;
+}
+
+static void wheel_remove(timer_t *timer)
+{
+    *timer->pprev = timer->next;
+
+    if (timer->next)
+        timer->next->pprev = timer->pprev;
+
+    timer->next = NULL;
+    timer->pprev = NULL;
+}
+
+// reinsert all timers of one slot, they move at least one level down
+// returns the slot index, 0 means the level wrapped around as well
+static size_t wheel_cascade(timer_base_t *base, size_t level, size_t index)
+{
+    timer_t *timer = base->levels[level][index];
+
+    base->levels[level][index] = NULL;
+
+    while (timer)
+    {
+        timer_t *next = timer->next;
+
+        wheel_insert(base, timer);
+        timer = next;
+    }
+
+    return index;
+}
+
+// lock the wheel a timer was added to
+// -> timer->base may change until we hold the lock, so check again afterwards
+static timer_base_t *timer_lock_base(timer_t *timer, uint64_t *rflags)
+{
+    for (;;)
+    {
+        timer_base_t *base = timer->base;
+
+        if (!base)
+            return NULL;
+
+        *rflags = spinlock_acquire_irqsave(&base->lock);
+
+        if (timer->base == base)
+            return base;
+
+        spinlock_release_irqrestore(&base->lock, *rflags);
+    }
+}
+
+void timer_init(timer_t *timer, void (*callback)(void *), void *arg)
+{
+    timer->expires = 0;
+    timer->callback = callback;
+    timer->arg = arg;
+    timer->next = NULL;
+    timer->pprev = NULL;
+    timer->base = NULL;
+}
+
+// run callback at jiffy expires on the calling cpu, the timer must not be pending
+void timer_add(timer_t *timer, uint64_t expires)
+{
+    uint64_t rflags = cpu_save_and_disable_interrupts();
+    timer_base_t *base = this_cpu_ptr(timer_bases);
+
+    spinlock_acquire(&base->lock);
+
+    timer->expires = expires;
+    timer->base = base;
+    wheel_insert(base, timer);
+    base->pending++;
+
+    spinlock_release(&base->lock);
+    cpu_restore_interrupts(rflags);
+}
+
+// change the expiry of a timer (pending or not), it moves to the calling cpu
+// returns whether it was pending
+bool timer_mod(timer_t *timer, uint64_t expires)
+{
+    bool was_pending = timer_del(timer);
+
+    timer_add(timer, expires);
+
+    return was_pending;
+}
+
+// returns whether the timer was pending
+// -> doesn't wait for a callback that is running right now on another cpu, see timer_del_sync
+bool timer_del(timer_t *timer)
+{
+    uint64_t rflags;
+    timer_base_t *base = timer_lock_base(timer, &rflags);
+
+    if (!base)
+        return false;
+
+    bool was_pending = timer->pprev != NULL;
+
+    if (was_pending)
+    {
+        wheel_remove(timer);
+        base->pending--;
+    }
+
+    spinlock_release_irqrestore(&base->lock, rflags);
+
+    return was_pending;
+}
+
+// timer_del that also waits for a running callback, afterwards the timer can be freed
+// -> must not be called from the callback itself or with a lock the callback takes
+bool timer_del_sync(timer_t *timer)
+{
+    for (;;)
+    {
+        uint64_t rflags;
+        timer_base_t *base = timer_lock_base(timer, &rflags);
+
+        if (!base)
+            return false;
+
+        bool was_pending = timer->pprev != NULL;
+
+        if (was_pending)
+        {
+            wheel_remove(timer);
+            base->pending--;
+        }
+
+        bool running = base->running == timer;
+
+        spinlock_release_irqrestore(&base->lock, rflags);
+
+        if (!running)
+            return was_pending;
+
+        asm volatile("pause");
+    }
+}
+
+bool timer_pending(timer_t *timer)
+{
+    return timer->pprev != NULL;
+}
+
+// jiffies since the clocksource got initialized
+uint64_t timer_get_jiffies(void)
+{
+    return ktime_get_ns() / TIMER_NSEC_PER_JIFFY;
+}
+
+uint64_t timer_ms_to_jiffies(uint64_t ms)
+{
+    return ms * TIMER_HZ / 1000;
+}
+
+// set up the wheel of the calling cpu
+void timer_init_cpu(void)
+{
+    timer_base_t *base = this_cpu_ptr(timer_bases);
+
+    spinlock_init(&base->lock, "timer wheel");
+    base->clk = timer_get_jiffies();
+}
+
+// SOFTIRQ_TIMER: run the callbacks of every timer that expired on this cpu
+// -> callbacks run with interrupts on, the base lock is only held (irqsave) in between
+void timer_run(void)
+{
+    timer_base_t *base = this_cpu_ptr(timer_bases);
+    uint64_t now = timer_get_jiffies();
+    uint64_t rflags = spinlock_acquire_irqsave(&base->lock);
+
+    while ((int64_t)(now - base->clk) >= 0)
+    {
+        // nothing to catch up on
+        if (!base->pending)
+        {
+            base->clk = now + 1;
+            break;
+        }
+
+        size_t index = base->clk & TIMER_ROOT_MASK;
+
+        if (index == 0)
+        {
+            for (size_t level = 0; level < TIMER_LEVELS; level++)
+                if (wheel_cascade(base, level, timer_level_index(base->clk, level)) != 0)
+                    break;
+        }
+
+        base->clk++;
+
+        // detach the slot, the list head lives on our stack from now on
+        timer_t *expired = base->root[index];
+
+        base->root[index] = NULL;
+
+        if (expired)
+            expired->pprev = &expired;
+
+        // timer_del on another cpu may still unlink entries while the lock is dropped
+        while (expired)
+        {
+            timer_t *timer = expired;
+
+            wheel_remove(timer);
+            base->pending--;
+
+            // the owner may free the timer as soon as the lock is dropped, unless it waits for us
+            void (*callback)(void *) = timer->callback;
+            void *arg = timer->arg;
+
+            base->running = timer;
+
+            spinlock_release_irqrestore(&base->lock, rflags);
+            callback(arg);
+            rflags = spinlock_acquire_irqsave(&base->lock);
+
+            base->running = NULL;
+        }
+    }
+
+    spinlock_release_irqrestore(&base->lock, rflags);
+}
+
+// time in ns of the next jiffy with something to do, UINT64_MAX if nothing is pending
+// -> exact within the current revolution of the root level, otherwise
+//    the next root wrap around (the earliest a cascade can bring something in)
+uint64_t timer_next_expiry_ns(void)
+{
+    timer_base_t *base = this_cpu_ptr(timer_bases);
+    uint64_t next = UINT64_MAX;
+
+    spinlock_acquire(&base->lock);
+
+    if (base->pending)
+    {
+        uint64_t clk = base->clk;
+
+        next = (clk | TIMER_ROOT_MASK) + 1;
+
+        for (size_t index = clk & TIMER_ROOT_MASK; index < TIMER_ROOT_SIZE; index++)
+        {
+            if (base->root[index])
+            {
+                next = clk + (index - (clk & TIMER_ROOT_MASK));
+                break;
+            }
+        }
+
+        next *= TIMER_NSEC_PER_JIFFY;
+    }
+
+    spinlock_release(&base->lock);
+
+    return next;
+}
+
+size_t timer_get_pending(size_t cpu)
+{
+    return per_cpu_ptr(timer_bases, cpu)->pending;
+}
@@ -0,0 +1,67 @@
+/*
+	This file is part of an x86_64 hobbyist operating system called KnutOS
+	Everything is openly developed on GitHub: https://github.com/Tix3Dev/KnutOS/
+
+	Copyright (C) 2021-2022  Yves Vollmeier <https://github.com/Tix3Dev>
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifndef TIMER_H
+#define TIMER_H
+
+#define TIMER_HZ		1000		// one jiffy = 1 ms, same as the scheduler tick
+#define TIMER_NSEC_PER_JIFFY	(1000000000ULL / TIMER_HZ)
+
+// wheel geometry: one root level of single jiffies, then levels of 64 slots,
+// each covering 64 times the range of the level below
+#define TIMER_ROOT_BITS		8
+#define TIMER_LEVEL_BITS	6
+#define TIMER_LEVELS		4		// above the root, covers 2^32 jiffies in total
+#define TIMER_ROOT_SIZE		(1 << TIMER_ROOT_BITS)
+#define TIMER_LEVEL_SIZE	(1 << TIMER_LEVEL_BITS)
+#define TIMER_ROOT_MASK		(TIMER_ROOT_SIZE - 1)
+#define TIMER_LEVEL_MASK	(TIMER_LEVEL_SIZE - 1)
+#define TIMER_MAX_DELTA		((1ULL << (TIMER_ROOT_BITS + TIMER_LEVELS * TIMER_LEVEL_BITS)) - 1)
+
+struct timer_base;
+
+// callback runs in softirq context (must not block) on the cpu the timer was added on
+typedef struct timer
+{
+    uint64_t		expires;	// jiffy the callback runs at (or shortly after)
+    void		(*callback)(void *);
+    void		*arg;
+
+    struct timer	*next;
+    struct timer	**pprev;	// link that points to this timer, NULL if not pending
+    struct timer_base	*base;		// wheel it was last added to
+} timer_t;
+
+void timer_init(timer_t *timer, void (*callback)(void *), void *arg);
+void timer_add(timer_t *timer, uint64_t expires);
+bool timer_mod(timer_t *timer, uint64_t expires);
+bool timer_del(timer_t *timer);
+bool timer_del_sync(timer_t *timer);
+bool timer_pending(timer_t *timer);
+uint64_t timer_get_jiffies(void);
+uint64_t timer_ms_to_jiffies(uint64_t ms);
+
+void timer_init_cpu(void);
+void timer_run(void);
+uint64_t timer_next_expiry_ns(void);
+size_t timer_get_pending(size_t cpu);
+
+#endif
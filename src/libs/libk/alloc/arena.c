@@ -0,0 +1,177 @@
+/*
+	This file is part of an x86_64 hobbyist operating system called KnutOS
+	Everything is openly developed on GitHub: https://github.com/Tix3Dev/KnutOS/
+
+	Copyright (C) 2021-2022  Yves Vollmeier <https://github.com/Tix3Dev>
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <boot/stivale2.h>
+#include <memory/mem.h>
+#include <memory/pmm.h>
+#include <libk/alloc/arena.h>
+#include <libk/string/string.h>
+
+// first usable byte of a chunk, keeps the bump pointer ARENA_ALIGN'ed
+#define ARENA_HEADER_SIZE	ALIGN_UP(sizeof(arena_chunk_t), ARENA_ALIGN)
+
+// get a fresh chunk of at least chunk_pages, big enough to hold size bytes
+static arena_chunk_t *arena_new_chunk(arena_t *arena, size_t size)
+{
+    size_t page_count = ALIGN_UP(ARENA_HEADER_SIZE + size, PAGE_SIZE) / PAGE_SIZE;
+
+    if (page_count < arena->chunk_pages)
+        page_count = arena->chunk_pages;
+
+    arena_chunk_t *chunk = pmm_alloc(page_count);
+
+    if (!chunk)
+        return NULL;
+
+    chunk->next = NULL;
+    chunk->size = page_count * PAGE_SIZE;
+    chunk->used = ARENA_HEADER_SIZE;
+
+    return chunk;
+}
+
+// no memory is taken from the PMM until the first allocation
+void arena_init(arena_t *arena, size_t chunk_pages)
+{
+    arena->first = NULL;
+    arena->current = NULL;
+    arena->chunk_pages = chunk_pages ? chunk_pages : ARENA_DEFAULT_PAGES;
+}
+
+// bump the offset of the current chunk
+// if it's full, move on to the next chunk kept from before a reset
+// (their offset is stale and gets rewound on entry), otherwise chain a new one
+void *arena_alloc(arena_t *arena, size_t size)
+{
+    size = ALIGN_UP(size, ARENA_ALIGN);
+
+    arena_chunk_t *chunk = arena->current;
+
+    while (chunk)
+    {
+        if (chunk->size - chunk->used >= size)
+        {
+            void *ptr = (uint8_t *)chunk + chunk->used;
+            chunk->used += size;
+            arena->current = chunk;
+
+            return ptr;
+        }
+
+        if (!chunk->next)
+            break;
+
+        chunk = chunk->next;
+        chunk->used = ARENA_HEADER_SIZE;
+    }
+
+    arena_chunk_t *new_chunk = arena_new_chunk(arena, size);
+
+    if (!new_chunk)
+        return NULL;
+
+    if (chunk)
+        chunk->next = new_chunk;
+    else
+        arena->first = new_chunk;
+
+    void *ptr = (uint8_t *)new_chunk + new_chunk->used;
+    new_chunk->used += size;
+    arena->current = new_chunk;
+
+    return ptr;
+}
+
+void *arena_zalloc(arena_t *arena, size_t size)
+{
+    void *ptr = arena_alloc(arena, size);
+
+    if (ptr)
+        memset(ptr, 0, size);
+
+    return ptr;
+}
+
+// copy at most max_length characters and always terminate the copy
+char *arena_strndup(arena_t *arena, const char *string, size_t max_length)
+{
+    size_t length = 0;
+
+    while (length < max_length && string[length])
+        length++;
+
+    char *copy = arena_alloc(arena, length + 1);
+
+    if (!copy)
+        return NULL;
+
+    memcpy(copy, string, length);
+    copy[length] = '\0';
+
+    return copy;
+}
+
+// remember the current position, everything allocated after it
+// can be dropped again with arena_release
+arena_mark_t arena_mark(arena_t *arena)
+{
+    arena_mark_t mark = {arena->current, arena->current ? arena->current->used : 0};
+
+    return mark;
+}
+
+void arena_release(arena_t *arena, arena_mark_t mark)
+{
+    if (!mark.chunk)
+    {
+        arena_reset(arena);
+        return;
+    }
+
+    arena->current = mark.chunk;
+    arena->current->used = mark.used;
+}
+
+// free everything at once in O(1)
+// -> rewind to the first chunk, the following ones are rewound lazily
+void arena_reset(arena_t *arena)
+{
+    arena->current = arena->first;
+
+    if (arena->current)
+        arena->current->used = ARENA_HEADER_SIZE;
+}
+
+// give every chunk back to the PMM
+void arena_destroy(arena_t *arena)
+{
+    arena_chunk_t *chunk = arena->first;
+
+    while (chunk)
+    {
+        arena_chunk_t *next = chunk->next;
+        pmm_free(chunk, chunk->size / PAGE_SIZE);
+        chunk = next;
+    }
+
+    arena->first = NULL;
+    arena->current = NULL;
+}
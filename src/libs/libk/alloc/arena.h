@@ -0,0 +1,62 @@
+/*
+	This file is part of an x86_64 hobbyist operating system called KnutOS
+	Everything is openly developed on GitHub: https://github.com/Tix3Dev/KnutOS/
+
+	Copyright (C) 2021-2022  Yves Vollmeier <https://github.com/Tix3Dev>
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifndef ARENA_H
+#define ARENA_H
+
+#define ARENA_ALIGN		16	// every arena_alloc result is aligned to this
+#define ARENA_DEFAULT_PAGES	2	// chunk size used when arena_init gets 0
+
+// header at the start of every chunk, the rest of the chunk is bump allocated
+typedef struct arena_chunk
+{
+    struct arena_chunk	*next;
+    size_t		size;		// bytes in the chunk, header included
+    size_t		used;		// bump offset from the chunk start
+} arena_chunk_t;
+
+// a region of scratch memory that is thrown away as a whole
+// chunks are kept across arena_reset and reused, only arena_destroy
+// gives them back to the PMM
+typedef struct
+{
+    arena_chunk_t   *first;
+    arena_chunk_t   *current;	// chunk allocations are bumped out of
+    size_t	    chunk_pages;
+} arena_t;
+
+// position inside an arena, to roll back nested scratch allocations
+typedef struct
+{
+    arena_chunk_t   *chunk;
+    size_t	    used;
+} arena_mark_t;
+
+void arena_init(arena_t *arena, size_t chunk_pages);
+void *arena_alloc(arena_t *arena, size_t size);
+void *arena_zalloc(arena_t *arena, size_t size);
+char *arena_strndup(arena_t *arena, const char *string, size_t max_length);
+arena_mark_t arena_mark(arena_t *arena);
+void arena_release(arena_t *arena, arena_mark_t mark);
+void arena_reset(arena_t *arena);
+void arena_destroy(arena_t *arena);
+
+#endif
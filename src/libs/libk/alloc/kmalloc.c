@@ -25,132 +25,259 @@
 #include <memory/pmm.h>
 #include <memory/slab.h>
 #include <libk/alloc/kmalloc.h>
+#include <libk/alloc/kmalloc_profile.h>
+#include <libk/string/string.h>
 
 #include <libk/debug/debug.h>
 
-size_t next_pow_of_two(size_t num);
+static void *kmalloc_internal(size_t size, void *caller);
+static void *kmalloc_pages(size_t page_count, void *caller);
 
 // use pmm_alloc (page based) for big size parameters
-// use slab_alloc (byte based) for small size parameters
+// use slab_cache_alloc (byte based) for small size parameters
+// -> no metadata is stored in-band, page descriptors know the size
 void *kmalloc(size_t size)
 {
-    void *ptr = NULL;
+    return kmalloc_internal(size, __builtin_return_address(0));
+}
 
-    size_t new_size = next_pow_of_two(size);
+// find out if the pointers belongs to a pmm_alloc or a slab_alloc
+// by looking at it's page descriptor
+// use pmm_free / slab_cache_free accordingly
+void kfree(void *ptr)
+{
+    if (!ptr)
+        return;
 
-    if (new_size >= PAGE_SIZE)
-    {
-        debug("kmalloc(%d) rounded to %d (+ metadata %d) - big alloc\n", size, new_size, PAGE_SIZE);
+    page_t *page = pmm_get_page(ptr);
 
-        ptr = pmm_alloc((new_size / PAGE_SIZE) + 1);
+    if (!page)
+        return;
 
-        kmalloc_metadata_t *metadata = ptr;
-        metadata->size = new_size;
+    kmalloc_profile_free(ptr);
 
-        ptr += PAGE_SIZE;
+    if (page->flags & PAGE_FLAG_SLAB)
+    {
+        slab_cache_free(ptr);
 
-        debug("(big alloc) alloc size: %d\n", metadata->size);
+        trace("(small free) freed memory at: 0x%.16llx\n", ptr);
     }
-    else
+    else if (page->flags & PAGE_FLAG_HEAD)
     {
-        debug("kmalloc(%d) rounded to %d (+ metadata %d) - small alloc\n", size, new_size, sizeof(kmalloc_metadata_t));
+        size_t page_count = page->page_count;
 
-        new_size = next_pow_of_two(size + sizeof(kmalloc_metadata_t));
+        page->flags = 0;
+        page->page_count = 0;
 
-        ptr = slab_alloc(new_size);
+        pmm_free(ptr, page_count);
 
-        kmalloc_metadata_t *metadata = ptr;
-        metadata->size = new_size;
+        trace("(big free) freed memory at: 0x%.16llx\n", ptr);
+    }
+}
 
-        ptr += sizeof(kmalloc_metadata_t);
+// return the usable size of an allocation made with kmalloc
+size_t ksize(void *ptr)
+{
+    if (!ptr)
+        return 0;
 
-        debug("(small alloc) alloc size: %d\n", metadata->size);
-    }
+    page_t *page = pmm_get_page(ptr);
 
-    debug("allocated memory at: 0x%.16llx\n", ptr);
+    if (!page)
+        return 0;
 
-    return ptr;
+    if (page->flags & PAGE_FLAG_SLAB)
+        return slab_get_size(page->slab_index);
+
+    if (page->flags & PAGE_FLAG_HEAD)
+        return (size_t)page->page_count * PAGE_SIZE;
 
+    return 0;
 }
 
-// find out if the pointers belongs to a pmm_alloc or a slab_alloc
-// use pmm_free / slab_alloc accordingly
-void kfree(void *ptr)
+// change the size of an allocation, keeping it's content
+// stays in place if the size class still fits, or if the frames following a big
+// allocation are free - otherwise allocate, copy and free
+void *krealloc(void *ptr, size_t size)
 {
+    void *caller = __builtin_return_address(0);
+
     if (!ptr)
-        return;
+        return kmalloc_internal(size, caller);
 
-    // using AND 0xFFF will return whether the last three digits (in hex) are zero
-    // if yes big alloc has been used
-    // OUTDATED: if no small alloc has been used and we need to toggle them to zero by
-    // OUTDATED: using AND ~0xFF
-    // OUTDATED: see bottom of file to see how it works using an example
+    if (size == 0)
+    {
+        kfree(ptr);
+        return NULL;
+    }
 
-    if (((uint64_t)ptr & 0xFFF) == 0)
+    page_t *page = pmm_get_page(ptr);
+
+    if (!page)
+        return NULL;
+
+    size_t old_size = ksize(ptr);
+
+    if (page->flags & PAGE_FLAG_SLAB)
+    {
+        if (size <= old_size)
+            return ptr;
+    }
+    else if (page->flags & PAGE_FLAG_HEAD)
     {
-        kmalloc_metadata_t *metadata = ptr - PAGE_SIZE;
+        size_t page_count = page->page_count;
+        size_t new_page_count = ALIGN_UP(size, PAGE_SIZE) / PAGE_SIZE;
+        bool resized = true;
 
-        pmm_free(metadata, (metadata->size / 4096) + 1);
+        // shrink: give the frames at the end back
+        // grow: take the following frames, if they are free
+        if (new_page_count < page_count)
+            pmm_free((uint8_t *)ptr + new_page_count * PAGE_SIZE, page_count - new_page_count);
+        else if (new_page_count > page_count)
+            resized = pmm_alloc_at((uint8_t *)ptr + page_count * PAGE_SIZE, new_page_count - page_count);
 
+        if (resized)
+        {
+            page->page_count = new_page_count;
 
-        debug("free size: %d\n", metadata->size);
-        debug("(big free) freed memory at: 0x%.16llx\n", ptr);
+            kmalloc_profile_free(ptr);
+            kmalloc_profile_alloc(ptr, new_page_count * PAGE_SIZE, caller);
 
-        return;
+            trace("krealloc(%d) resized 0x%.16llx in place to %d pages\n", size, ptr, new_page_count);
+
+            return ptr;
+        }
     }
+    else
+        return NULL;
 
-    // OUTDATED: ptr = (void *)((uint64_t)ptr & ~(0xFFF));
+    void *new_ptr = kmalloc_internal(size, caller);
 
-    kmalloc_metadata_t *metadata = ptr - sizeof(kmalloc_metadata_t);
+    if (!new_ptr)
+        return NULL;
 
-    slab_free(metadata); // we don't need metadata->size, automatically found by slab_free
+    memcpy(new_ptr, ptr, old_size < size ? old_size : size);
+    kfree(ptr);
 
-    debug("free size: %d\n", metadata->size);
-    debug("(small free) freed memory at: 0x%.16llx\n", ptr);
+    return new_ptr;
 }
 
-// get the next power of two
-size_t next_pow_of_two(size_t num)
+// allocate zeroed memory for an array of count elements
+void *kcalloc(size_t count, size_t size)
 {
-    // TODO: might want to make this more efficient
-    // x <<= 1 is at least better than x *= 2
-    // note the result for 0 and 1 is 2
-    // note after this size will be page aligned
-    size_t result = 2;
+    // count * size would overflow
+    if (size != 0 && count > SIZE_MAX / size)
+        return NULL;
+
+    void *ptr = kmalloc_internal(count * size, __builtin_return_address(0));
 
-    while (result < num)
-        result <<= 1;
+    if (ptr)
+        memset(ptr, 0, count * size);
 
-    return result;
+    return ptr;
 }
 
-/* Example for bitwise manipulation used to determine whether big alloc or small alloc has been used */
+// allocate memory aligned to align bytes (a power of two)
+void *kmalloc_aligned(size_t size, size_t align)
+{
+    void *caller = __builtin_return_address(0);
 
-/*  main.c
-    #include <stdio.h>
-    #include <stdint.h>
+    if (align == 0 || (align & (align - 1)) != 0)
+        return NULL;
 
-    int main() {
-    uint64_t ptr = 0xffff80000169f000;
+    // every object is at least aligned to MIN_SLAB_SIZE
+    if (align <= MIN_SLAB_SIZE)
+        return kmalloc_internal(size, caller);
 
-    printf("first:\t%lx\n", ptr);
+    size_t aligned_size = ALIGN_UP(size, align);
 
-    if (((uint64_t)ptr & 0xfff) == 0)
-      printf("true\n");
+    if (aligned_size <= MAX_SLAB_SIZE && align <= PAGE_SIZE)
+    {
+        // slabs start page aligned and every size class is a power of two
+        // or three times one, so an object is aligned to the biggest power
+        // of two dividing it's size class (up to PAGE_SIZE)
+        size_t size_class = slab_round_size(aligned_size);
 
-    printf("second:\t%lx\n", ptr);
+        if (size_class % align != 0)
+            size_class = (size_t)1 << (64 - __builtin_clzl(aligned_size - 1));
 
-    ptr = (uint64_t)ptr & ~(0xfff);
+        void *ptr = slab_cache_alloc(size_class);
 
-    printf("third:\t%lx\n", ptr);
+        kmalloc_profile_alloc(ptr, size_class, caller);
 
-    return 0;
+        trace("kmalloc_aligned(%d, %d) at 0x%.16llx - small alloc\n", size, align, ptr);
+
+        return ptr;
     }
-*/
 
-/*  output
-    first:  ffff80000169f000
-    true
-    second: ffff80000169f000
-    third:  ffff80000169f000
-*/
+    size_t page_count = ALIGN_UP(size, PAGE_SIZE) / PAGE_SIZE;
+
+    // frames are page aligned anyway
+    if (align <= PAGE_SIZE)
+        return kmalloc_pages(page_count, caller);
+
+    // over-allocate and give the frames in front of and behind the aligned block back
+    size_t extra_pages = align / PAGE_SIZE - 1;
+    uint8_t *raw = pmm_alloc(page_count + extra_pages);
+
+    if (!raw)
+        return NULL;
+
+    uint8_t *ptr = (uint8_t *)ALIGN_UP((uintptr_t)raw, align);
+    size_t lead_pages = (ptr - raw) / PAGE_SIZE;
+
+    if (lead_pages)
+        pmm_free(raw, lead_pages);
+
+    if (extra_pages - lead_pages)
+        pmm_free(ptr + page_count * PAGE_SIZE, extra_pages - lead_pages);
+
+    page_t *page = pmm_get_page(ptr);
+
+    page->flags = PAGE_FLAG_HEAD;
+    page->page_count = page_count;
+
+    kmalloc_profile_alloc(ptr, page_count * PAGE_SIZE, caller);
+
+    trace("kmalloc_aligned(%d, %d) uses %d pages at 0x%.16llx - big alloc\n", size, align, page_count, ptr);
+
+    return ptr;
+}
+
+/* utility functions */
+
+// kmalloc, accounting the allocation to caller
+static void *kmalloc_internal(size_t size, void *caller)
+{
+    if (size > MAX_SLAB_SIZE)
+        // exactly the pages needed, the size lives in the page descriptor
+        return kmalloc_pages(ALIGN_UP(size, PAGE_SIZE) / PAGE_SIZE, caller);
+
+    void *ptr = slab_cache_alloc(size);
+
+    kmalloc_profile_alloc(ptr, slab_round_size(size), caller);
+
+    trace("kmalloc(%d) at 0x%.16llx - small alloc\n", size, ptr);
+
+    return ptr;
+}
+
+// allocate page_count frames and record the count in the head frame's page descriptor
+static void *kmalloc_pages(size_t page_count, void *caller)
+{
+    void *ptr = pmm_alloc(page_count);
+
+    if (!ptr)
+        return NULL;
+
+    page_t *page = pmm_get_page(ptr);
+
+    page->flags = PAGE_FLAG_HEAD;
+    page->page_count = page_count;
+
+    kmalloc_profile_alloc(ptr, page_count * PAGE_SIZE, caller);
+
+    trace("kmalloc uses %d pages at 0x%.16llx - big alloc\n", page_count, ptr);
+
+    return ptr;
+}
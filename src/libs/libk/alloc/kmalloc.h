@@ -18,12 +18,11 @@
 #ifndef KMALLOC_H
 #define KMALLOC_H
 
-typedef struct
-{
-    size_t size;
-} kmalloc_metadata_t;
-
 void *kmalloc(size_t size);
 void kfree(void *ptr);
+size_t ksize(void *ptr);
+void *krealloc(void *ptr, size_t size);
+void *kcalloc(size_t count, size_t size);
+void *kmalloc_aligned(size_t size, size_t align);
 
 #endif
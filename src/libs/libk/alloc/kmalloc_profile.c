@@ -0,0 +1,249 @@
+/*
+	This file is part of an x86_64 hobbyist operating system called KnutOS
+	Everything is openly developed on GitHub: https://github.com/Tix3Dev/KnutOS/
+
+	Copyright (C) 2021-2022  Yves Vollmeier <https://github.com/Tix3Dev>
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <boot/stivale2.h>
+#include <libk/alloc/kmalloc_profile.h>
+#include <libk/debug/debug.h>
+#include <libk/lock/spinlock.h>
+#include <libk/log/log.h>
+#include <libk/stdio/stdio.h>
+
+/*  Explanation of the allocation profiler:
+    Every allocation is accounted to a site, i.e. the pair of the
+    caller's return address and the size class it got. Sites live
+    in a fixed-size open addressing hash table.
+
+    As allocations don't carry headers, a second fixed-size hash table
+    maps every live pointer to it's site, so that kfree can find out
+    whom to credit the freed bytes to.
+
+    Both tables use linear probing, so recording costs a hash and
+    (almost always) a single probe. If a table is full - the live table
+    counts as full at 3/4 load to keep probe sequences short - the
+    allocation is counted as untracked instead of being recorded.
+*/
+
+#if KMALLOC_PROFILE
+
+typedef struct
+{
+    void	*ptr;
+    uint32_t	site;
+} kmalloc_profile_live_t;
+
+static kmalloc_profile_site_t	sites[KMALLOC_PROFILE_SITES];
+static kmalloc_profile_live_t	live[KMALLOC_PROFILE_LIVE];
+
+static size_t	live_count = 0;
+static uint64_t untracked_count = 0;
+
+static spinlock_t profile_lock = SPINLOCK_INIT("kmprof");
+
+// fibonacci hashing, spreads aligned pointers nicely over the table
+static inline size_t profile_hash(uintptr_t key, size_t slots)
+{
+    return (size_t)((key * 0x9E3779B97F4A7C15ULL) >> 32) & (slots - 1);
+}
+
+// find or create the site of a caller and size class
+static kmalloc_profile_site_t *profile_find_site(uintptr_t caller, size_t size_class)
+{
+    size_t index = profile_hash(caller ^ size_class, KMALLOC_PROFILE_SITES);
+
+    for (size_t i = 0; i < KMALLOC_PROFILE_SITES; i++)
+    {
+        kmalloc_profile_site_t *site = &sites[(index + i) & (KMALLOC_PROFILE_SITES - 1)];
+
+        if (site->caller == caller && site->size_class == size_class)
+            return site;
+
+        if (site->caller == 0)
+        {
+            site->caller = caller;
+            site->size_class = size_class;
+
+            return site;
+        }
+    }
+
+    return NULL;
+}
+
+// account an allocation to it's site and remember the pointer
+void kmalloc_profile_alloc(void *ptr, size_t size_class, void *caller)
+{
+    if (!ptr)
+        return;
+
+    uint64_t rflags = spinlock_acquire_irqsave(&profile_lock);
+
+    kmalloc_profile_site_t *site = profile_find_site((uintptr_t)caller, size_class);
+
+    if (!site || live_count >= KMALLOC_PROFILE_LIVE / 4 * 3)
+    {
+        untracked_count++;
+        spinlock_release_irqrestore(&profile_lock, rflags);
+        return;
+    }
+
+    size_t index = profile_hash((uintptr_t)ptr, KMALLOC_PROFILE_LIVE);
+
+    for (size_t i = 0; i < KMALLOC_PROFILE_LIVE; i++)
+    {
+        kmalloc_profile_live_t *entry = &live[(index + i) & (KMALLOC_PROFILE_LIVE - 1)];
+
+        if (entry->ptr != NULL)
+            continue;
+
+        entry->ptr = ptr;
+        entry->site = site - sites;
+        live_count++;
+
+        site->alloc_count++;
+        site->live_bytes += size_class;
+
+        if (site->live_bytes > site->peak_live_bytes)
+            site->peak_live_bytes = site->live_bytes;
+
+        spinlock_release_irqrestore(&profile_lock, rflags);
+        return;
+    }
+
+    untracked_count++;
+
+    spinlock_release_irqrestore(&profile_lock, rflags);
+}
+
+// credit the freed bytes back to the site which allocated ptr
+// -> unknown pointers are ignored
+void kmalloc_profile_free(void *ptr)
+{
+    if (!ptr)
+        return;
+
+    size_t index = profile_hash((uintptr_t)ptr, KMALLOC_PROFILE_LIVE);
+    size_t i;
+
+    uint64_t rflags = spinlock_acquire_irqsave(&profile_lock);
+
+    for (i = 0; i < KMALLOC_PROFILE_LIVE; i++)
+    {
+        kmalloc_profile_live_t *entry = &live[(index + i) & (KMALLOC_PROFILE_LIVE - 1)];
+
+        if (entry->ptr == NULL || entry->ptr == ptr)
+            break;
+    }
+
+    if (i == KMALLOC_PROFILE_LIVE || live[(index + i) & (KMALLOC_PROFILE_LIVE - 1)].ptr == NULL)
+    {
+        spinlock_release_irqrestore(&profile_lock, rflags);
+        return;
+    }
+
+    size_t hole = (index + i) & (KMALLOC_PROFILE_LIVE - 1);
+    kmalloc_profile_site_t *site = &sites[live[hole].site];
+
+    site->free_count++;
+    site->live_bytes -= site->size_class;
+
+    // backward shift deletion: move following entries of the same probe
+    // sequence into the hole, so that lookups never stop too early
+    for (size_t next = (hole + 1) & (KMALLOC_PROFILE_LIVE - 1); live[next].ptr != NULL;
+            next = (next + 1) & (KMALLOC_PROFILE_LIVE - 1))
+    {
+        size_t home = profile_hash((uintptr_t)live[next].ptr, KMALLOC_PROFILE_LIVE);
+
+        // only move the entry if it's home slot doesn't lie between the hole and it's slot
+        if (((next - home) & (KMALLOC_PROFILE_LIVE - 1)) >= ((next - hole) & (KMALLOC_PROFILE_LIVE - 1)))
+        {
+            live[hole] = live[next];
+            hole = next;
+        }
+    }
+
+    live[hole].ptr = NULL;
+    live_count--;
+
+    spinlock_release_irqrestore(&profile_lock, rflags);
+}
+
+// print the sites holding the most live bytes to the framebuffer
+void kmalloc_profile_print_top(void)
+{
+    bool printed[KMALLOC_PROFILE_SITES] = {0};
+
+    printk(GFX_CYAN, "%-18s %-6s %-10s %-10s %-10s %s\n", "caller", "class", "allocs", "frees", "live", "peak");
+
+    for (size_t n = 0; n < KMALLOC_PROFILE_TOP; n++)
+    {
+        kmalloc_profile_site_t *top = NULL;
+
+        for (size_t i = 0; i < KMALLOC_PROFILE_SITES; i++)
+        {
+            if (sites[i].caller == 0 || printed[i])
+                continue;
+
+            if (!top || sites[i].live_bytes > top->live_bytes)
+                top = &sites[i];
+        }
+
+        if (!top)
+            break;
+
+        printed[top - sites] = true;
+
+        printk(GFX_WHITE, "0x%.16llx %-6d %-10llu %-10llu %-10d %d\n", top->caller, top->size_class,
+               top->alloc_count, top->free_count, top->live_bytes, top->peak_live_bytes);
+    }
+
+    printk(GFX_WHITE, "Untracked allocations: %llu\n", untracked_count);
+}
+
+// send all sites as CSV to the serial console for offline analysis
+void kmalloc_profile_dump(void)
+{
+    debug_impl("kmalloc_profile,caller,size_class,allocs,frees,live_bytes,peak_live_bytes\n");
+
+    for (size_t i = 0; i < KMALLOC_PROFILE_SITES; i++)
+    {
+        if (sites[i].caller == 0)
+            continue;
+
+        debug_impl("kmalloc_profile,0x%llx,%d,%llu,%llu,%d,%d\n", sites[i].caller, sites[i].size_class,
+              sites[i].alloc_count, sites[i].free_count, sites[i].live_bytes, sites[i].peak_live_bytes);
+    }
+
+    debug_impl("kmalloc_profile,untracked,%llu\n", untracked_count);
+}
+
+#else
+
+void kmalloc_profile_print_top(void)
+{
+    printk(GFX_RED, "kmalloc profiling is disabled, rebuild with KMALLOC_PROFILE=1\n");
+}
+
+void kmalloc_profile_dump(void)
+{
+    serial_log(WARNING, "kmalloc profiling is disabled, rebuild with KMALLOC_PROFILE=1\n");
+}
+
+#endif
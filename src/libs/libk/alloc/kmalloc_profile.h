@@ -0,0 +1,56 @@
+/*
+	This file is part of an x86_64 hobbyist operating system called KnutOS
+	Everything is openly developed on GitHub: https://github.com/Tix3Dev/KnutOS/
+
+	Copyright (C) 2021-2022  Yves Vollmeier <https://github.com/Tix3Dev>
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifndef KMALLOC_PROFILE_H
+#define KMALLOC_PROFILE_H
+
+// set by the Makefile, 1 enables per call-site allocation statistics
+#ifndef KMALLOC_PROFILE
+#define KMALLOC_PROFILE 0
+#endif
+
+#define KMALLOC_PROFILE_SITES		256	// call-site / size class pairs, power of 2
+#define KMALLOC_PROFILE_LIVE		8192	// live allocations tracked at once, power of 2
+#define KMALLOC_PROFILE_TOP		10	// entries printed by kmalloc_profile_print_top
+
+// statistics of one call-site allocating one size class
+typedef struct
+{
+    uintptr_t	caller;		// return address of the kmalloc / slab_alloc call
+    size_t	size_class;	// usable size handed out per allocation
+    uint64_t	alloc_count;
+    uint64_t	free_count;
+    size_t	live_bytes;
+    size_t	peak_live_bytes;
+} kmalloc_profile_site_t;
+
+#if KMALLOC_PROFILE
+void kmalloc_profile_alloc(void *ptr, size_t size_class, void *caller);
+void kmalloc_profile_free(void *ptr);
+#else
+// compiled out completely, the arguments aren't even evaluated
+#define kmalloc_profile_alloc(ptr, size_class, caller)	do { (void)sizeof(caller); } while (0)
+#define kmalloc_profile_free(ptr)			do { } while (0)
+#endif
+
+void kmalloc_profile_print_top(void);
+void kmalloc_profile_dump(void);
+
+#endif
@@ -16,20 +16,100 @@
 */
 
 #include <stdarg.h>
+#include <stddef.h>
 
+#include <boot/stivale2.h>
+#include <devices/cpu/cpu.h>
+#include <smp/percpu.h>
 #include <libk/debug/debug.h>
 #include <libk/kprintf/kprintf.h>
+#include <libk/lock/spinlock.h>
 
-const char debug_buffer[5120]; // big buffer so that big_logo from logo.h fits
+// every cpu formats into it's own buffer, big so that big_logo from logo.h fits
+static DEFINE_PER_CPU(char, debug_buffer[5120]);
+
+static char	trace_buffer[TRACE_BUFFER_SIZE];
+static size_t	trace_head = 0;	    // total amount of bytes ever written
+static char	trace_snapshot[TRACE_BUFFER_SIZE];
+
+volatile bool oops_in_progress = false;
+
+static spinlock_t debug_lock = SPINLOCK_INIT("debug");	// serializes the serial port between cpus
+static spinlock_t trace_lock = SPINLOCK_INIT("trace");
+static spinlock_t trace_dump_lock = SPINLOCK_INIT("trace dump");	// owns trace_snapshot
 
 // variadic function for format specifiers to print to the serial console
-void debug(char *fmt, ...)
+void debug_impl(char *fmt, ...)
 {
     va_list ptr;
     va_start(ptr, fmt);
-    vsnprintf((char *)&debug_buffer, -1, fmt, ptr);
 
-    serial_send_string((char *)debug_buffer);
+    // interrupts off: nothing else on this cpu can use the buffer meanwhile
+    uint64_t rflags = cpu_save_and_disable_interrupts();
+    char *buffer = *this_cpu_ptr(debug_buffer);
+
+    vsnprintf(buffer, -1, fmt, ptr);
+
+    if (oops_in_progress)
+    {
+        serial_send_string(buffer);
+    }
+    else
+    {
+        spinlock_acquire(&debug_lock);
+        serial_send_string(buffer);
+        spinlock_release(&debug_lock);
+    }
+
+    cpu_restore_interrupts(rflags);
+
+    va_end(ptr);
+}
+
+// variadic function for format specifiers to append to the trace ring buffer
+// old messages get overwritten once the buffer is full
+void trace_impl(char *fmt, ...)
+{
+    char message[256];
 
+    va_list ptr;
+    va_start(ptr, fmt);
+    int length = vsnprintf(message, sizeof(message), fmt, ptr);
     va_end(ptr);
+
+    if (length <= 0)
+        return;
+
+    if (length >= (int)sizeof(message))
+        length = sizeof(message) - 1;
+
+    uint64_t rflags = spinlock_acquire_irqsave(&trace_lock);
+
+    for (int i = 0; i < length; i++)
+        trace_buffer[(trace_head + i) % TRACE_BUFFER_SIZE] = message[i];
+
+    trace_head += length;
+
+    spinlock_release_irqrestore(&trace_lock, rflags);
+}
+
+// send the content of the trace ring buffer to the serial console (oldest first)
+// -> other cpus keep tracing, so copy it under the lock and send the copy
+void debug_dump_trace(void)
+{
+    spinlock_acquire(&trace_dump_lock);
+
+    uint64_t rflags = spinlock_acquire_irqsave(&trace_lock);
+    size_t head = trace_head;
+    size_t start = head > TRACE_BUFFER_SIZE ? head - TRACE_BUFFER_SIZE : 0;
+
+    for (size_t i = start; i < head; i++)
+        trace_snapshot[i - start] = trace_buffer[i % TRACE_BUFFER_SIZE];
+
+    spinlock_release_irqrestore(&trace_lock, rflags);
+
+    for (size_t i = 0; i < head - start; i++)
+        serial_send_char(trace_snapshot[i]);
+
+    spinlock_release(&trace_dump_lock);
 }
@@ -15,11 +15,39 @@
 	along with this program.  If not, see <https://www.gnu.org/licenses/>.
 */
 
+#include <stdbool.h>
+
 #ifndef DEBUG_H
 #define DEBUG_H
 
 #include <devices/serial/serial.h>
+#include <libk/log/log.h>
+
+#define TRACE_BUFFER_SIZE 16384
+
+// print to the serial console, compiled out if LOG_LEVEL > DEBUG
+// -> output that has to appear at every level (logs, exception dumps) uses debug_impl
+#define debug(...)				\
+    do {					\
+        if (log_is_enabled(DEBUG))		\
+            debug_impl(__VA_ARGS__);		\
+    } while (0)
+
+// trace messages go into an in-memory ring buffer instead of the serial port
+// -> cheap enough to leave enabled at runtime, compiled out if LOG_LEVEL > TRACE
+#define trace(...)				\
+    do {					\
+        if (log_is_enabled(TRACE))		\
+            trace_impl(__VA_ARGS__);		\
+    } while (0)
+
+// set once a fatal error stopped the other cpus (smp_stop_other_cpus)
+// -> debug_impl and printk then bypass their locks, a stopped cpu or the
+//    faulting code itself may hold them forever
+extern volatile bool oops_in_progress;
 
-void debug(char *fmt, ...);
+void debug_impl(char *fmt, ...);
+void trace_impl(char *fmt, ...);
+void debug_dump_trace(void);
 
 #endif
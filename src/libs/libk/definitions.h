@@ -15,9 +15,16 @@
 	along with this program.  If not, see <https://www.gnu.org/licenses/>.
 */
 
+#include <stddef.h>
+#include <stdint.h>
+
 #ifndef DEFINITIONS_H
 #define DEFINITIONS_H
 
+// structure that embeds member, from a pointer to that member
+#define container_of(ptr, type, member) \
+    ((type *)((uintptr_t)(ptr) - offsetof(type, member)))
+
 // address range
 typedef struct
 {
@@ -49,6 +49,21 @@ uint16_t io_inw(uint16_t port)
     return ret;
 }
 
+// sends 32-bit data to an IO port
+void io_outl(uint16_t port, uint32_t value)
+{
+    asm volatile("outl %0, %1" : : "a"(value), "Nd"(port));
+}
+
+// receives 32-bit data from an IO port
+uint32_t io_inl(uint16_t port)
+{
+    uint32_t ret;
+    asm volatile("inl %1, %0" : "=a"(ret) : "Nd"(port));
+
+    return ret;
+}
+
 // another I/0 cycle on an unused, CPU-speed independent port
 void io_wait(void)
 {
@@ -23,5 +23,7 @@ uint8_t io_inb(uint16_t port);
 void io_wait(void);
 void io_outw(uint16_t port, uint16_t value);
 uint16_t io_inw(uint16_t port);
+void io_outl(uint16_t port, uint32_t value);
+uint32_t io_inl(uint16_t port);
 
 #endif
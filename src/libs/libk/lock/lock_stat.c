@@ -0,0 +1,204 @@
+/*
+	This file is part of an x86_64 hobbyist operating system called KnutOS
+	Everything is openly developed on GitHub: https://github.com/Tix3Dev/KnutOS/
+
+	Copyright (C) 2021-2022  Yves Vollmeier <https://github.com/Tix3Dev>
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <boot/stivale2.h>
+#include <devices/cpu/cpu.h>
+#include <libk/lock/lock_stat.h>
+#include <libk/stdio/stdio.h>
+
+#if LOCK_STAT
+
+// every lock that got acquired at least once and wasn't destroyed since
+// -> locks that don't live forever (on the stack, kmalloc'd) have to be
+//    destroyed with spinlock_destroy & co., which gives their slot back
+static lock_stat_t  *lock_stats[LOCK_STAT_MAX];
+static uint64_t	    lock_stat_dropped = 0;	// registrations that found no free slot
+
+// protects lock_stats, a plain test-and-set lock as a spinlock_t would record itself
+static volatile uint32_t lock_stat_table_lock = 0;
+
+static uint64_t lock_stat_table_acquire(void)
+{
+    uint64_t rflags = cpu_save_and_disable_interrupts();
+
+    while (__atomic_exchange_n(&lock_stat_table_lock, 1, __ATOMIC_ACQUIRE))
+        asm volatile("pause");
+
+    return rflags;
+}
+
+static void lock_stat_table_release(uint64_t rflags)
+{
+    __atomic_store_n(&lock_stat_table_lock, 0, __ATOMIC_RELEASE);
+    cpu_restore_interrupts(rflags);
+}
+
+// first acquisition of a lock: claim a free slot, only one cpu wins the registered flag
+static void lock_stat_register(lock_stat_t *stat)
+{
+    if (__atomic_exchange_n(&stat->registered, 1, __ATOMIC_RELAXED))
+        return;
+
+    uint64_t rflags = lock_stat_table_acquire();
+    size_t index = 0;
+
+    while (index < LOCK_STAT_MAX && lock_stats[index])
+        index++;
+
+    if (index < LOCK_STAT_MAX)
+        lock_stats[index] = stat;
+    else
+        lock_stat_dropped++;
+
+    lock_stat_table_release(rflags);
+}
+
+// the lock is about to go away, forget it's statistics
+void lock_stat_unregister(lock_stat_t *stat)
+{
+    if (!__atomic_exchange_n(&stat->registered, 0, __ATOMIC_RELAXED))
+        return;
+
+    uint64_t rflags = lock_stat_table_acquire();
+
+    for (size_t i = 0; i < LOCK_STAT_MAX; i++)
+    {
+        if (lock_stats[i] == stat)
+        {
+            lock_stats[i] = NULL;
+            break;
+        }
+    }
+
+    lock_stat_table_release(rflags);
+}
+
+// called by the lock implementations right after they got the lock
+// -> shared (reader) acquisitions can happen concurrently, so count atomically
+void lock_stat_acquired(lock_stat_t *stat, bool contended, bool exclusive)
+{
+    if (!stat->registered)
+        lock_stat_register(stat);
+
+    __atomic_fetch_add(&stat->acquisitions, 1, __ATOMIC_RELAXED);
+
+    if (contended)
+        __atomic_fetch_add(&stat->contentions, 1, __ATOMIC_RELAXED);
+
+    if (exclusive)
+        stat->acquired_at = rdtsc();
+}
+
+// called right before an exclusive holder releases the lock
+void lock_stat_released(lock_stat_t *stat)
+{
+    uint64_t held = rdtsc() - stat->acquired_at;
+
+    if (held > stat->max_hold_cycles)
+        stat->max_hold_cycles = held;
+}
+
+// print the LOCK_STAT_TOP most contended locks
+// -> copies them under the table lock, a lock can be destroyed while we print
+void lock_stat_print_top(void)
+{
+    lock_stat_t top[LOCK_STAT_TOP];
+    bool printed[LOCK_STAT_MAX] = {0};
+    size_t top_count = 0;
+    uint64_t rflags = lock_stat_table_acquire();
+
+    for (; top_count < LOCK_STAT_TOP; top_count++)
+    {
+        lock_stat_t *best = NULL;
+        size_t best_index = 0;
+
+        for (size_t i = 0; i < LOCK_STAT_MAX; i++)
+        {
+            lock_stat_t *stat = lock_stats[i];
+
+            if (!stat || printed[i])
+                continue;
+
+            if (!best || stat->contentions > best->contentions)
+            {
+                best = stat;
+                best_index = i;
+            }
+        }
+
+        if (!best)
+            break;
+
+        printed[best_index] = true;
+        top[top_count] = *best;
+    }
+
+    uint64_t dropped = lock_stat_dropped;
+
+    lock_stat_table_release(rflags);
+
+    printk(GFX_CYAN, "%-16s %-7s %-12s %-12s %-6s %s\n", "lock", "type", "acquired", "contended", "rate", "max hold");
+
+    for (size_t n = 0; n < top_count; n++)
+    {
+        lock_stat_t *stat = &top[n];
+        uint64_t permille = stat->acquisitions ? stat->contentions * 1000 / stat->acquisitions : 0;
+
+        printk(GFX_WHITE, "%-16s %-7s %-12llu %-12llu %2llu.%llu%% %llu\n", stat->name ? stat->name : "unnamed",
+               stat->type, stat->acquisitions, stat->contentions, permille / 10, permille % 10, stat->max_hold_cycles);
+    }
+
+    if (dropped)
+        printk(GFX_YELLOW, "More than %d locks, %llu aren't tracked\n", LOCK_STAT_MAX, dropped);
+}
+
+// start counting from zero again
+void lock_stat_reset(void)
+{
+    uint64_t rflags = lock_stat_table_acquire();
+
+    for (size_t i = 0; i < LOCK_STAT_MAX; i++)
+    {
+        lock_stat_t *stat = lock_stats[i];
+
+        if (!stat)
+            continue;
+
+        stat->acquisitions = 0;
+        stat->contentions = 0;
+        stat->max_hold_cycles = 0;
+    }
+
+    lock_stat_table_release(rflags);
+}
+
+#else
+
+void lock_stat_print_top(void)
+{
+    printk(GFX_RED, "Lock statistics are disabled, rebuild with LOCK_STAT=1\n");
+}
+
+void lock_stat_reset(void)
+{
+}
+
+#endif
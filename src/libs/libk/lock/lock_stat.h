@@ -0,0 +1,62 @@
+/*
+	This file is part of an x86_64 hobbyist operating system called KnutOS
+	Everything is openly developed on GitHub: https://github.com/Tix3Dev/KnutOS/
+
+	Copyright (C) 2021-2022  Yves Vollmeier <https://github.com/Tix3Dev>
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifndef LOCK_STAT_H
+#define LOCK_STAT_H
+
+// set by the Makefile, 1 records acquisition / contention / hold time statistics of every lock
+#ifndef LOCK_STAT
+#define LOCK_STAT 0
+#endif
+
+#define LOCK_STAT_MAX	256	// locks that can be registered
+#define LOCK_STAT_TOP	10	// entries printed by lock_stat_print_top
+
+// statistics of one lock, embedded in every lock type
+typedef struct
+{
+    const char	*name;
+    const char	*type;
+#if LOCK_STAT
+    uint64_t	acquisitions;
+    uint64_t	contentions;	    // acquisitions that had to wait
+    uint64_t	max_hold_cycles;    // longest exclusive hold in TSC cycles
+    uint64_t	acquired_at;	    // TSC when the current exclusive holder got it
+    uint32_t	registered;
+#endif
+} lock_stat_t;
+
+#define LOCK_STAT_INIT(lock_name, lock_type)	{ .name = (lock_name), .type = (lock_type) }
+
+#if LOCK_STAT
+void lock_stat_acquired(lock_stat_t *stat, bool contended, bool exclusive);
+void lock_stat_released(lock_stat_t *stat);
+void lock_stat_unregister(lock_stat_t *stat);
+#else
+// compiled out completely
+#define lock_stat_acquired(stat, contended, exclusive)	do { (void)(contended); } while (0)
+#define lock_stat_released(stat)			do { } while (0)
+#define lock_stat_unregister(stat)			do { (void)(stat); } while (0)
+#endif
+
+void lock_stat_print_top(void);
+void lock_stat_reset(void);
+
+#endif
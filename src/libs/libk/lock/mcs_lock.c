@@ -0,0 +1,81 @@
+/*
+	This file is part of an x86_64 hobbyist operating system called KnutOS
+	Everything is openly developed on GitHub: https://github.com/Tix3Dev/KnutOS/
+
+	Copyright (C) 2021-2022  Yves Vollmeier <https://github.com/Tix3Dev>
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <devices/cpu/cpu.h>
+#include <libk/lock/mcs_lock.h>
+
+// append node to the queue and wait until the previous holder hands the lock over
+// -> node has to stay valid until mcs_lock_release
+void mcs_lock_acquire(mcs_lock_t *lock, mcs_node_t *node)
+{
+    node->next = NULL;
+    node->locked = 1;
+
+    mcs_node_t *prev = __atomic_exchange_n(&lock->tail, node, __ATOMIC_ACQ_REL);
+    bool contended = prev != NULL;
+
+    if (prev)
+    {
+        __atomic_store_n(&prev->next, node, __ATOMIC_RELEASE);
+
+        while (__atomic_load_n(&node->locked, __ATOMIC_ACQUIRE))
+            asm volatile("pause");
+    }
+
+    lock_stat_acquired(&lock->stat, contended, true);
+}
+
+void mcs_lock_release(mcs_lock_t *lock, mcs_node_t *node)
+{
+    lock_stat_released(&lock->stat);
+
+    mcs_node_t *next = __atomic_load_n(&node->next, __ATOMIC_ACQUIRE);
+
+    if (!next)
+    {
+        // nobody queued up -> the lock is free again
+        mcs_node_t *expected = node;
+
+        if (__atomic_compare_exchange_n(&lock->tail, &expected, NULL, false, __ATOMIC_RELEASE, __ATOMIC_RELAXED))
+            return;
+
+        // someone swapped tail but didn't link itself in yet
+        while (!(next = __atomic_load_n(&node->next, __ATOMIC_ACQUIRE)))
+            asm volatile("pause");
+    }
+
+    __atomic_store_n(&next->locked, 0, __ATOMIC_RELEASE);
+}
+
+uint64_t mcs_lock_acquire_irqsave(mcs_lock_t *lock, mcs_node_t *node)
+{
+    uint64_t rflags = cpu_save_and_disable_interrupts();
+
+    mcs_lock_acquire(lock, node);
+
+    return rflags;
+}
+
+void mcs_lock_release_irqrestore(mcs_lock_t *lock, mcs_node_t *node, uint64_t rflags)
+{
+    mcs_lock_release(lock, node);
+    cpu_restore_interrupts(rflags);
+}
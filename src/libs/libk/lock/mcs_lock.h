@@ -0,0 +1,48 @@
+/*
+	This file is part of an x86_64 hobbyist operating system called KnutOS
+	Everything is openly developed on GitHub: https://github.com/Tix3Dev/KnutOS/
+
+	Copyright (C) 2021-2022  Yves Vollmeier <https://github.com/Tix3Dev>
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <libk/lock/lock_stat.h>
+
+#ifndef MCS_LOCK_H
+#define MCS_LOCK_H
+
+// one per waiting / holding cpu, usually on the caller's stack
+typedef struct mcs_node
+{
+    struct mcs_node	*volatile next;
+    volatile uint32_t	locked;
+} mcs_node_t;
+
+// queue lock for heavily contended paths: every waiter spins on it's own node,
+// so handing the lock over only touches the cache line of the next waiter
+typedef struct
+{
+    mcs_node_t		*volatile tail;	// last waiter, NULL if the lock is free
+    lock_stat_t		stat;
+} mcs_lock_t;
+
+#define MCS_LOCK_INIT(lock_name)	{ .tail = NULL, .stat = LOCK_STAT_INIT(lock_name, "mcs") }
+
+void mcs_lock_acquire(mcs_lock_t *lock, mcs_node_t *node);
+void mcs_lock_release(mcs_lock_t *lock, mcs_node_t *node);
+uint64_t mcs_lock_acquire_irqsave(mcs_lock_t *lock, mcs_node_t *node);
+void mcs_lock_release_irqrestore(mcs_lock_t *lock, mcs_node_t *node, uint64_t rflags);
+
+#endif
@@ -0,0 +1,116 @@
+/*
+	This file is part of an x86_64 hobbyist operating system called KnutOS
+	Everything is openly developed on GitHub: https://github.com/Tix3Dev/KnutOS/
+
+	Copyright (C) 2021-2022  Yves Vollmeier <https://github.com/Tix3Dev>
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <devices/cpu/cpu.h>
+#include <libk/lock/rwlock.h>
+
+// become one more reader once neither a writer holds nor waits for the lock
+void rwlock_read_acquire(rwlock_t *lock)
+{
+    bool contended = false;
+
+    for (;;)
+    {
+        uint32_t state = __atomic_load_n(&lock->state, __ATOMIC_RELAXED);
+
+        if (!(state & (RWLOCK_WRITER | RWLOCK_WRITER_WAITING)) &&
+                __atomic_compare_exchange_n(&lock->state, &state, state + 1, false,
+                                            __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+            break;
+
+        contended = true;
+        asm volatile("pause");
+    }
+
+    lock_stat_acquired(&lock->stat, contended, false);
+}
+
+void rwlock_read_release(rwlock_t *lock)
+{
+    __atomic_fetch_sub(&lock->state, 1, __ATOMIC_RELEASE);
+}
+
+// announce the writer, so no new readers get in, then wait for the last reader to leave
+// -> several waiting writers all set RWLOCK_WRITER_WAITING, the winner clears it
+//    and the others set it again on their next round
+void rwlock_write_acquire(rwlock_t *lock)
+{
+    bool contended = false;
+
+    for (;;)
+    {
+        uint32_t state = __atomic_load_n(&lock->state, __ATOMIC_RELAXED);
+
+        if (!(state & ~RWLOCK_WRITER_WAITING))
+        {
+            if (__atomic_compare_exchange_n(&lock->state, &state, RWLOCK_WRITER, false,
+                                            __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+                break;
+
+            continue;
+        }
+
+        if (!(state & RWLOCK_WRITER_WAITING))
+            __atomic_fetch_or(&lock->state, RWLOCK_WRITER_WAITING, __ATOMIC_RELAXED);
+
+        contended = true;
+        asm volatile("pause");
+    }
+
+    lock_stat_acquired(&lock->stat, contended, true);
+}
+
+// also clears RWLOCK_WRITER_WAITING, writers still waiting set it again
+void rwlock_write_release(rwlock_t *lock)
+{
+    lock_stat_released(&lock->stat);
+
+    __atomic_store_n(&lock->state, 0, __ATOMIC_RELEASE);
+}
+
+uint64_t rwlock_read_acquire_irqsave(rwlock_t *lock)
+{
+    uint64_t rflags = cpu_save_and_disable_interrupts();
+
+    rwlock_read_acquire(lock);
+
+    return rflags;
+}
+
+void rwlock_read_release_irqrestore(rwlock_t *lock, uint64_t rflags)
+{
+    rwlock_read_release(lock);
+    cpu_restore_interrupts(rflags);
+}
+
+uint64_t rwlock_write_acquire_irqsave(rwlock_t *lock)
+{
+    uint64_t rflags = cpu_save_and_disable_interrupts();
+
+    rwlock_write_acquire(lock);
+
+    return rflags;
+}
+
+void rwlock_write_release_irqrestore(rwlock_t *lock, uint64_t rflags)
+{
+    rwlock_write_release(lock);
+    cpu_restore_interrupts(rflags);
+}
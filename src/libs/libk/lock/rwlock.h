@@ -0,0 +1,47 @@
+/*
+	This file is part of an x86_64 hobbyist operating system called KnutOS
+	Everything is openly developed on GitHub: https://github.com/Tix3Dev/KnutOS/
+
+	Copyright (C) 2021-2022  Yves Vollmeier <https://github.com/Tix3Dev>
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <stdint.h>
+
+#include <libk/lock/lock_stat.h>
+
+#ifndef RWLOCK_H
+#define RWLOCK_H
+
+#define RWLOCK_WRITER		(1U << 31)	// held by a writer
+#define RWLOCK_WRITER_WAITING	(1U << 30)	// keeps new readers out until the writer got in
+#define RWLOCK_READERS_MASK	(RWLOCK_WRITER_WAITING - 1)
+
+// many readers or a single writer, waiting writers are preferred
+typedef struct
+{
+    volatile uint32_t	state;
+    lock_stat_t		stat;
+} rwlock_t;
+
+#define RWLOCK_INIT(lock_name)	{ .state = 0, .stat = LOCK_STAT_INIT(lock_name, "rwlock") }
+
+void rwlock_read_acquire(rwlock_t *lock);
+void rwlock_read_release(rwlock_t *lock);
+void rwlock_write_acquire(rwlock_t *lock);
+void rwlock_write_release(rwlock_t *lock);
+uint64_t rwlock_read_acquire_irqsave(rwlock_t *lock);
+void rwlock_read_release_irqrestore(rwlock_t *lock, uint64_t rflags);
+uint64_t rwlock_write_acquire_irqsave(rwlock_t *lock);
+void rwlock_write_release_irqrestore(rwlock_t *lock, uint64_t rflags);
+
+#endif
@@ -0,0 +1,88 @@
+/*
+	This file is part of an x86_64 hobbyist operating system called KnutOS
+	Everything is openly developed on GitHub: https://github.com/Tix3Dev/KnutOS/
+
+	Copyright (C) 2021-2022  Yves Vollmeier <https://github.com/Tix3Dev>
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <devices/cpu/cpu.h>
+#include <libk/lock/spinlock.h>
+
+// for locks that aren't statically initialized
+void spinlock_init(spinlock_t *lock, const char *name)
+{
+    *lock = (spinlock_t)SPINLOCK_INIT(name);
+}
+
+// for locks whose memory gets reused (on the stack, kmalloc'd), must not be held
+void spinlock_destroy(spinlock_t *lock)
+{
+    lock_stat_unregister(&lock->stat);
+}
+
+// take a ticket and wait until it's called
+// -> fair (FIFO) under contention, nobody can starve like with test-and-set
+void spinlock_acquire(spinlock_t *lock)
+{
+    uint32_t ticket = __atomic_fetch_add(&lock->next, 1, __ATOMIC_RELAXED);
+    bool contended = false;
+
+    while (__atomic_load_n(&lock->owner, __ATOMIC_ACQUIRE) != ticket)
+    {
+        contended = true;
+        asm volatile("pause");
+    }
+
+    lock_stat_acquired(&lock->stat, contended, true);
+}
+
+// only take a ticket if it would be called right away
+bool spinlock_try_acquire(spinlock_t *lock)
+{
+    uint32_t owner = __atomic_load_n(&lock->owner, __ATOMIC_RELAXED);
+
+    if (!__atomic_compare_exchange_n(&lock->next, &owner, owner + 1, false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+        return false;
+
+    lock_stat_acquired(&lock->stat, false, true);
+
+    return true;
+}
+
+// only the holder writes owner, so no atomic increment is needed
+void spinlock_release(spinlock_t *lock)
+{
+    lock_stat_released(&lock->stat);
+
+    __atomic_store_n(&lock->owner, lock->owner + 1, __ATOMIC_RELEASE);
+}
+
+// for locks that are also taken in interrupt handlers
+// -> interrupts stay off while the lock is held, so the handler can't deadlock on it
+uint64_t spinlock_acquire_irqsave(spinlock_t *lock)
+{
+    uint64_t rflags = cpu_save_and_disable_interrupts();
+
+    spinlock_acquire(lock);
+
+    return rflags;
+}
+
+void spinlock_release_irqrestore(spinlock_t *lock, uint64_t rflags)
+{
+    spinlock_release(lock);
+    cpu_restore_interrupts(rflags);
+}
@@ -0,0 +1,44 @@
+/*
+	This file is part of an x86_64 hobbyist operating system called KnutOS
+	Everything is openly developed on GitHub: https://github.com/Tix3Dev/KnutOS/
+
+	Copyright (C) 2021-2022  Yves Vollmeier <https://github.com/Tix3Dev>
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <libk/lock/lock_stat.h>
+
+#ifndef SPINLOCK_H
+#define SPINLOCK_H
+
+// ticket lock: cpus get the lock in the order they asked for it
+typedef struct
+{
+    volatile uint32_t	next;	// ticket the next cpu asking for the lock gets
+    volatile uint32_t	owner;	// ticket that currently holds the lock
+    lock_stat_t		stat;
+} spinlock_t;
+
+#define SPINLOCK_INIT(lock_name)	{ .next = 0, .owner = 0, .stat = LOCK_STAT_INIT(lock_name, "ticket") }
+
+void spinlock_init(spinlock_t *lock, const char *name);
+void spinlock_destroy(spinlock_t *lock);
+void spinlock_acquire(spinlock_t *lock);
+bool spinlock_try_acquire(spinlock_t *lock);
+void spinlock_release(spinlock_t *lock);
+uint64_t spinlock_acquire_irqsave(spinlock_t *lock);
+void spinlock_release_irqrestore(spinlock_t *lock, uint64_t rflags);
+
+#endif
@@ -21,37 +21,60 @@
 #include <boot/stivale2.h>
 #include <libk/debug/debug.h>
 #include <libk/kprintf/kprintf.h>
+#include <libk/lock/spinlock.h>
 #include <libk/log/log.h>
 #include <libk/stdio/stdio.h>
 
 const char log_buffer[5120];
 
+STATUS log_level = LOG_LEVEL;
+
+// log_buffer is shared, nests outside of the printk / debug locks
+static spinlock_t log_lock = SPINLOCK_INIT("log");
+
 // variadic function for format specifiers
 // serial logging - print log message to serial console
 void serial_log_impl(char *description, int line_nr, STATUS status, char *fmt, ...)
 {
     va_list ptr;
     va_start(ptr, fmt);
+
+    uint64_t rflags = spinlock_acquire_irqsave(&log_lock);
+
     vsnprintf((char *)&log_buffer, -1, fmt, ptr);
 
-    if (status == INFO)
+    if (status == TRACE)
+    {
+        serial_set_color(TERM_WHITE);
+        debug_impl("[TRACE]   | ");
+    }
+    else if (status == DEBUG)
+    {
+        serial_set_color(TERM_GREEN);
+        debug_impl("[DEBUG]   | ");
+    }
+    else if (status == INFO)
     {
         serial_set_color(TERM_CYAN);
-        debug("[INFO]    | ");
+        debug_impl("[INFO]    | ");
     }
     else if (status == WARNING)
     {
         serial_set_color(TERM_YELLOW);
-        debug("[WARNING] | ");
+        debug_impl("[WARNING] | ");
     }
     else if (status == ERROR)
     {
         serial_set_color(TERM_RED);
-        debug("[ERROR]   | ");
+        debug_impl("[ERROR]   | ");
     }
 
-    debug("%s:%d ─→ %s", description, line_nr, (char *)log_buffer);
+    debug_impl("%s:%d ─→ %s", description, line_nr, (char *)log_buffer);
     serial_set_color(TERM_COLOR_RESET);
+
+    spinlock_release_irqrestore(&log_lock, rflags);
+
+    va_end(ptr);
 }
 
 // variadic function for format specifiers
@@ -60,12 +83,55 @@ void kernel_log_impl(char *description, int line_nr, STATUS status, char *fmt, .
 {
     va_list ptr;
     va_start(ptr, fmt);
+
+    uint64_t rflags = spinlock_acquire_irqsave(&log_lock);
+
     vsnprintf((char *)&log_buffer, -1, fmt, ptr);
 
-    if (status == INFO)
+    if (status == TRACE)
+        printk(GFX_WHITE, "[TRACE]   | %s:%d ─→ %s", description, line_nr, (char *)log_buffer);
+    else if (status == DEBUG)
+        printk(GFX_GREEN, "[DEBUG]   | %s:%d ─→ %s", description, line_nr, (char *)log_buffer);
+    else if (status == INFO)
         printk(GFX_CYAN, "[INFO]    | %s:%d ─→ %s", description, line_nr, (char *)log_buffer);
     else if (status == WARNING)
         printk(GFX_YELLOW, "[WARNING] | %s:%d ─→ %s", description, line_nr, (char *)log_buffer);
     else if (status == ERROR)
         printk(GFX_RED, "[ERROR]   | %s:%d ─→ %s", description, line_nr, (char *)log_buffer);
+
+    spinlock_release_irqrestore(&log_lock, rflags);
+
+    va_end(ptr);
+}
+
+// change the runtime log level
+// levels below the compile-time LOG_LEVEL stay compiled out
+void log_set_level(STATUS status)
+{
+    log_level = status;
+}
+
+// return matching string for a log level
+const char *log_level_to_string(STATUS status)
+{
+    switch (status)
+    {
+        case TRACE:
+            return "trace";
+
+        case DEBUG:
+            return "debug";
+
+        case INFO:
+            return "info";
+
+        case WARNING:
+            return "warning";
+
+        case ERROR:
+            return "error";
+
+        default:
+            return "unknown";
+    }
 }
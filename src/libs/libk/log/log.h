@@ -18,16 +18,49 @@
 #ifndef LOG_H
 #define LOG_H
 
-#define serial_log(...) serial_log_impl(__FILE__, __LINE__, __VA_ARGS__);
-#define kernel_log(...) kernel_log_impl(__FILE__, __LINE__, __VA_ARGS__);
+// numeric log levels, usable in preprocessor conditions
+#define LOG_LEVEL_TRACE		0
+#define LOG_LEVEL_DEBUG		1
+#define LOG_LEVEL_INFO		2
+#define LOG_LEVEL_WARNING	3
+#define LOG_LEVEL_ERROR		4
+
+// compile-time log level, set by the Makefile
+// everything below it is compiled out completely
+#ifndef LOG_LEVEL
+#define LOG_LEVEL LOG_LEVEL_TRACE
+#endif
 
 typedef enum {
-    INFO,
-    WARNING,
-    ERROR
+    TRACE	= LOG_LEVEL_TRACE,
+    DEBUG	= LOG_LEVEL_DEBUG,
+    INFO	= LOG_LEVEL_INFO,
+    WARNING	= LOG_LEVEL_WARNING,
+    ERROR	= LOG_LEVEL_ERROR
 } STATUS;
 
+// runtime log level, can only be raised above LOG_LEVEL
+extern STATUS log_level;
+
+// the first comparison is constant, so the compiler drops disabled levels
+// the second one costs a single load and compare
+#define log_is_enabled(status) ((status) >= LOG_LEVEL && (status) >= log_level)
+
+#define serial_log(status, ...)							\
+    do {									\
+        if (log_is_enabled(status))						\
+            serial_log_impl(__FILE__, __LINE__, status, __VA_ARGS__);	\
+    } while (0)
+
+#define kernel_log(status, ...)							\
+    do {									\
+        if (log_is_enabled(status))						\
+            kernel_log_impl(__FILE__, __LINE__, status, __VA_ARGS__);	\
+    } while (0)
+
 void serial_log_impl(char *file, int line_nr, STATUS status, char *fmt, ...);
 void kernel_log_impl(char *file, int line_nr, STATUS status, char *fmt, ...);
+void log_set_level(STATUS status);
+const char *log_level_to_string(STATUS status);
 
 #endif
@@ -16,22 +16,191 @@
 */
 
 #include <stdarg.h>
+#include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 
 #include <boot/stivale2.h>
+#include <devices/cpu/cpu.h>
+#include <interrupts/interrupts.h>
+#include <scheduler/mutex.h>
+#include <scheduler/rcu.h>
+#include <scheduler/thread.h>
+#include <scheduler/workqueue.h>
+#include <smp/percpu.h>
+#include <libk/debug/debug.h>
 #include <libk/stdio/stdio.h>
 #include <libk/kprintf/kprintf.h>
+#include <libk/lock/spinlock.h>
+#include <libk/string/string.h>
 
-const char printk_buffer[5120]; // big buffer so that big_logo from logo.h fits
+/*  Explanation of printk:
+    Rendering text is slow, a scroll copies the whole framebuffer, so
+    it must not run with interrupts off. A preemptible thread formats
+    into printk_text and renders it while holding printk_mutex, with
+    interrupts on; other threads that print meanwhile sleep.
+
+    Interrupt handlers, softirqs, rcu readers and code that has
+    interrupts off can't sleep. They format into the per-cpu buffer
+    (interrupts are off anyway) and only render right away if the
+    mutex is free. Otherwise the text is appended to printk_deferred
+    and printed by the next holder of the mutex, or by
+    printk_flush_work on the system workqueue, whichever comes first.
+
+    After a fatal error (oops_in_progress) the mutex is ignored: the
+    faulting code or a halted cpu may hold it, the dump has to get out.
+*/
+
+#define PRINTK_BUFFER_SIZE	5120	// big so that big_logo from logo.h fits
+#define PRINTK_DEFERRED_SIZE	8192
+
+// header of a deferred message, followed by it's NUL terminated text
+typedef struct
+{
+    uint32_t	foreground_color;
+    uint32_t	size;		// bytes after the header, text padded to keep records aligned
+} printk_record_t;
+
+// format buffer of callers that can't sleep, only used with interrupts off
+static DEFINE_PER_CPU(char, printk_buffer[PRINTK_BUFFER_SIZE]);
+
+// serializes the framebuffer cursor, printk_text and printk_flush_buffer
+static mutex_t printk_mutex = MUTEX_INIT("printk");
+static char printk_text[PRINTK_BUFFER_SIZE];
+static char printk_flush_buffer[PRINTK_DEFERRED_SIZE];
+
+static spinlock_t printk_deferred_lock = SPINLOCK_INIT("printk deferred");
+static char printk_deferred[PRINTK_DEFERRED_SIZE];
+static size_t printk_deferred_used = 0;
+static uint64_t printk_deferred_dropped = 0;
+
+static void printk_flush_work(void *arg);
+
+static work_t printk_work = { .func = printk_flush_work, .arg = NULL, .next = NULL, .pending = false };
+
+// print what the callers that couldn't sleep left behind (printk_mutex held)
+static void printk_flush_deferred(void)
+{
+    for (;;)
+    {
+        uint64_t rflags = spinlock_acquire_irqsave(&printk_deferred_lock);
+        size_t used = printk_deferred_used;
+        uint64_t dropped = printk_deferred_dropped;
+
+        memcpy(printk_flush_buffer, printk_deferred, used);
+        printk_deferred_used = 0;
+        printk_deferred_dropped = 0;
+
+        spinlock_release_irqrestore(&printk_deferred_lock, rflags);
+
+        if (!used && !dropped)
+            return;
+
+        for (size_t offset = 0; offset < used;)
+        {
+            printk_record_t *record = (printk_record_t *)&printk_flush_buffer[offset];
+
+            framebuffer_print_string((char *)(record + 1), record->foreground_color);
+            offset += sizeof(printk_record_t) + record->size;
+        }
+
+        if (dropped)
+        {
+            snprintf(printk_text, sizeof(printk_text), "[%llu printk messages dropped]\n", dropped);
+            framebuffer_print_string(printk_text, GFX_YELLOW);
+        }
+    }
+}
+
+static void printk_flush_work(void *arg)
+{
+    (void)arg;
+
+    mutex_lock(&printk_mutex);
+    printk_flush_deferred();
+    mutex_unlock(&printk_mutex);
+}
+
+// interrupts off: render right away if nobody else does, otherwise leave it for the mutex holder
+static void printk_atomic(uint32_t foreground_color, char *text)
+{
+    if (mutex_trylock(&printk_mutex))
+    {
+        framebuffer_print_string(text, foreground_color);
+        printk_flush_deferred();
+        mutex_unlock(&printk_mutex);
+
+        return;
+    }
+
+    size_t length = strlen(text) + 1;
+    size_t size = (length + 7) & ~7ULL;
+
+    spinlock_acquire(&printk_deferred_lock);
+
+    if (printk_deferred_used + sizeof(printk_record_t) + size <= PRINTK_DEFERRED_SIZE)
+    {
+        printk_record_t *record = (printk_record_t *)&printk_deferred[printk_deferred_used];
+
+        record->foreground_color = foreground_color;
+        record->size = size;
+        memcpy(record + 1, text, length);
+
+        printk_deferred_used += sizeof(printk_record_t) + size;
+    }
+    else
+    {
+        printk_deferred_dropped++;
+    }
+
+    spinlock_release(&printk_deferred_lock);
+
+    // the holder may have flushed already, the work then finds nothing to do
+    if (system_workqueue)
+        schedule_work(&printk_work);
+}
 
 // variadic function for format specifiers to print to the framebuffer
 void printk(uint32_t foreground_color, char *fmt, ...)
 {
     va_list ptr;
     va_start(ptr, fmt);
-    vsnprintf((char *)&printk_buffer, -1, fmt, ptr);
 
-    framebuffer_print_string((char *)printk_buffer, foreground_color);
+    uint64_t rflags = cpu_save_and_disable_interrupts();
+    thread_t *thread = thread_current();
+
+    if (oops_in_progress)
+    {
+        char *buffer = *this_cpu_ptr(printk_buffer);
+
+        vsnprintf(buffer, PRINTK_BUFFER_SIZE, fmt, ptr);
+        framebuffer_print_string(buffer, foreground_color);
+
+        cpu_restore_interrupts(rflags);
+    }
+    else if ((rflags & (1 << 9)) && !in_interrupt() && !rcu_read_lock_held() && thread && !thread->is_idle)
+    {
+        // a preemptible thread: render with interrupts on, sleep if someone else prints
+        cpu_restore_interrupts(rflags);
+
+        mutex_lock(&printk_mutex);
+
+        vsnprintf(printk_text, sizeof(printk_text), fmt, ptr);
+        framebuffer_print_string(printk_text, foreground_color);
+        printk_flush_deferred();
+
+        mutex_unlock(&printk_mutex);
+    }
+    else
+    {
+        // interrupts off: nothing else on this cpu can use the buffer meanwhile
+        char *buffer = *this_cpu_ptr(printk_buffer);
+
+        vsnprintf(buffer, PRINTK_BUFFER_SIZE, fmt, ptr);
+        printk_atomic(foreground_color, buffer);
+
+        cpu_restore_interrupts(rflags);
+    }
 
     va_end(ptr);
 }
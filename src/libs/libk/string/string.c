@@ -19,12 +19,23 @@
 #include <stddef.h>
 
 // fill a block of memory with a certain value
+// -> 8 bytes at a time with rep stosq, the rest with rep stosb
 void *memset(void *pointer, uint32_t value, size_t size)
 {
-    uint8_t *buffer_pointer = (uint8_t *)pointer;
+    void *destination = pointer;
+    uint64_t pattern = (uint8_t)value * 0x0101010101010101ULL;
+    size_t qwords = size / 8;
+    size_t bytes = size % 8;
 
-    for (size_t i = 0; i < size; i++)
-        *buffer_pointer++ = value;
+    asm volatile("rep stosq"
+                 : "+D" (destination), "+c" (qwords)
+                 : "a" (pattern)
+                 : "memory");
+
+    asm volatile("rep stosb"
+                 : "+D" (destination), "+c" (bytes)
+                 : "a" (pattern)
+                 : "memory");
 
     return pointer;
 }
@@ -95,11 +106,23 @@ size_t strlen(const char *s) {
     return len;
 }
 
-// Standard memcpy implementation
-void *memcpy(void *dest, const void *src, size_t n) {
-    unsigned char *d = dest;
-    const unsigned char *s = src;
-    for (size_t i = 0; i < n; i++)
-        d[i] = s[i];
+// copy n bytes from src to dest (the areas must not overlap)
+// -> 8 bytes at a time with rep movsq, the rest with rep movsb
+void *memcpy(void *dest, const void *src, size_t n)
+{
+    void *destination = dest;
+    size_t qwords = n / 8;
+    size_t bytes = n % 8;
+
+    asm volatile("rep movsq"
+                 : "+D" (destination), "+S" (src), "+c" (qwords)
+                 :
+                 : "memory");
+
+    asm volatile("rep movsb"
+                 : "+D" (destination), "+S" (src), "+c" (bytes)
+                 :
+                 : "memory");
+
     return dest;
 }
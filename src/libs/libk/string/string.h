@@ -19,7 +19,7 @@
 #define STRING_H
 #include <stdint.h>
 
-void *memset(uint32_t *pointer, uint32_t value, size_t size);
+void *memset(void *pointer, uint32_t value, size_t size);
 void *memcpy(void *dest, const void *src, size_t n);
 int memcmp(const void *string1, const void *string2, size_t n);
 int strcmp(const char *s1, const char *s2);